@@ -0,0 +1,18 @@
+#ifndef VULKANBASE_ALLOCATIONCOUNTER_H
+#define VULKANBASE_ALLOCATIONCOUNTER_H
+
+#include <cstdint>
+
+/*
+ * Counts the calls to the global operator new, to check that the frame loop does not touch the heap.
+ * Only builds configured with COUNT_ALLOCATIONS replace operator new, otherwise the count stays at zero.
+ * Allocations done by C libraries through malloc, like the ones of GLFW or the driver, are not seen.
+ */
+namespace AllocationCounter {
+    bool enabled();
+
+    uint64_t count();
+}
+
+
+#endif //VULKANBASE_ALLOCATIONCOUNTER_H
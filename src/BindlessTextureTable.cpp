@@ -0,0 +1,84 @@
+#include "BindlessTextureTable.h"
+#include <stdexcept>
+
+void BindlessTextureTable::vulkanInit(VkDevice device, VkShaderStageFlags stages) {
+    this->device = device;
+
+    VkDescriptorSetLayoutBinding textureArrayBinding{};
+    textureArrayBinding.binding = 0;
+    textureArrayBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    textureArrayBinding.descriptorCount = BINDLESS_MAX_TEXTURES;
+    textureArrayBinding.stageFlags = stages;
+
+    //Slots that were never written are allowed as long as the shader does not access them
+    VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+                                            VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCreateInfo{};
+    bindingFlagsCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsCreateInfo.bindingCount = 1;
+    bindingFlagsCreateInfo.pBindingFlags = &bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{};
+    descriptorSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descriptorSetLayoutInfo.pNext = &bindingFlagsCreateInfo;
+    descriptorSetLayoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    descriptorSetLayoutInfo.bindingCount = 1;
+    descriptorSetLayoutInfo.pBindings = &textureArrayBinding;
+    VK_ASSERT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutInfo, nullptr, &layout));
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSize.descriptorCount = BINDLESS_MAX_TEXTURES;
+    VkDescriptorPoolCreateInfo vkDescriptorPoolCreateInfo{};
+    vkDescriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    vkDescriptorPoolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    vkDescriptorPoolCreateInfo.poolSizeCount = 1;
+    vkDescriptorPoolCreateInfo.pPoolSizes = &poolSize;
+    vkDescriptorPoolCreateInfo.maxSets = 1;
+    VK_ASSERT(vkCreateDescriptorPool(device, &vkDescriptorPoolCreateInfo, nullptr, &pool));
+
+    VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{};
+    descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descriptorSetAllocateInfo.descriptorPool = pool;
+    descriptorSetAllocateInfo.descriptorSetCount = 1;
+    descriptorSetAllocateInfo.pSetLayouts = &layout;
+    VK_ASSERT(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &descriptorSet));
+}
+
+uint32_t BindlessTextureTable::vulkanRegisterTexture(const Texture2D &texture, VkImageLayout imageLayout) {
+    if (textureCount >= BINDLESS_MAX_TEXTURES) {
+        throw std::runtime_error("Bindless texture table is full");
+    }
+    uint32_t index = textureCount++;
+    vulkanUpdateTexture(index, texture, imageLayout);
+    return index;
+}
+
+void BindlessTextureTable::vulkanUpdateTexture(uint32_t index, const Texture2D &texture, VkImageLayout imageLayout) {
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.imageView = texture.imageView;
+    imageInfo.sampler = texture.sampler;
+    imageInfo.imageLayout = imageLayout;
+
+    VkWriteDescriptorSet writeDescriptorSet{};
+    writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writeDescriptorSet.dstSet = descriptorSet;
+    writeDescriptorSet.dstBinding = 0;
+    writeDescriptorSet.dstArrayElement = index;
+    writeDescriptorSet.descriptorCount = 1;
+    writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    writeDescriptorSet.pImageInfo = &imageInfo;
+    vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+}
+
+uint32_t BindlessTextureTable::getTextureCount() const {
+    return textureCount;
+}
+
+void BindlessTextureTable::vulkanDestroy() {
+    vkDestroyDescriptorPool(device, pool, nullptr);
+    vkDestroyDescriptorSetLayout(device, layout, nullptr);
+    pool = VK_NULL_HANDLE;
+    layout = VK_NULL_HANDLE;
+    descriptorSet = VK_NULL_HANDLE;
+}
@@ -0,0 +1,38 @@
+#ifndef VULKANBASE_BINDLESSTEXTURETABLE_H
+#define VULKANBASE_BINDLESSTEXTURETABLE_H
+
+#define GLFW_INCLUDE_VULKAN
+
+#include <GLFW/glfw3.h>
+#include "VulkanStructures.h"
+
+/*
+ * A single descriptor set holding a partially bound, update after bind array of BINDLESS_MAX_TEXTURES samplers.
+ * Textures are registered once and addressed by index from the shaders, so adding textures never needs a rebind.
+ */
+class BindlessTextureTable {
+public:
+    VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+    void vulkanInit(VkDevice device, VkShaderStageFlags stages);
+
+    /*
+     * Write the texture in the next free slot and return its index, valid even while the set is bound
+     */
+    uint32_t vulkanRegisterTexture(const Texture2D &texture, VkImageLayout imageLayout);
+
+    void vulkanUpdateTexture(uint32_t index, const Texture2D &texture, VkImageLayout imageLayout);
+
+    uint32_t getTextureCount() const;
+
+    void vulkanDestroy();
+
+private:
+    VkDevice device = VK_NULL_HANDLE;
+    VkDescriptorPool pool = VK_NULL_HANDLE;
+    uint32_t textureCount = 0;
+};
+
+
+#endif //VULKANBASE_BINDLESSTEXTURETABLE_H
@@ -6,7 +6,7 @@
 
 
 VkCommandPool
-CommandBufferUtils::vulkanCreateCommandPool(const VulkanHandles vulkanHandles, const int queueFamilyIndex) {
+CommandBufferUtils::vulkanCreateCommandPool(const VulkanHandles &vulkanHandles, const int queueFamilyIndex) {
     VkCommandPoolCreateInfo vkCommandPoolCreateInfo{};
     vkCommandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     vkCommandPoolCreateInfo.queueFamilyIndex = queueFamilyIndex;
@@ -17,7 +17,7 @@ CommandBufferUtils::vulkanCreateCommandPool(const VulkanHandles vulkanHandles, c
 }
 
 std::vector<VkCommandBuffer>
-CommandBufferUtils::vulkanCreateCommandBuffers(const VulkanHandles vulkanHandles, const VkCommandPool vkCommandPool,
+CommandBufferUtils::vulkanCreateCommandBuffers(const VulkanHandles &vulkanHandles, const VkCommandPool vkCommandPool,
                                                const int commandBufferCount) {
     std::vector<VkCommandBuffer> commandBuffers(commandBufferCount);
     VkCommandBufferAllocateInfo vkCommandBufferAllocateInfo{};
@@ -29,8 +29,8 @@ CommandBufferUtils::vulkanCreateCommandBuffers(const VulkanHandles vulkanHandles
     return commandBuffers;
 }
 
-void CommandBufferUtils::vulkanBeginCommandBuffer(const VulkanHandles vulkanHandles, VkCommandBuffer commandBuffer,
-                                                  VkCommandBufferUsageFlags flags, std::vector<VkFence> fences,
+void CommandBufferUtils::vulkanBeginCommandBuffer(const VulkanHandles &vulkanHandles, VkCommandBuffer commandBuffer,
+                                                  VkCommandBufferUsageFlags flags, Span<VkFence> fences,
                                                   bool resetFences) {
     VkCommandBufferBeginInfo bufferBegin{};
     bufferBegin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -41,8 +41,8 @@ void CommandBufferUtils::vulkanBeginCommandBuffer(const VulkanHandles vulkanHand
 
 void CommandBufferUtils::vulkanSubmitCommandBuffer(VkQueue queue,
                                                    VkCommandBuffer commandBuffer,
-                                                   std::vector<VkSemaphore> waitSemaphores,
-                                                   std::vector<VkSemaphore> signalSemaphores,
+                                                   Span<VkSemaphore> waitSemaphores,
+                                                   Span<VkSemaphore> signalSemaphores,
                                                    VkPipelineStageFlags *waitDstStageFlags, VkFence fence) {
     VK_ASSERT(vkEndCommandBuffer(commandBuffer));
     VkSubmitInfo transferSubmitInfo{};
@@ -59,11 +59,11 @@ void CommandBufferUtils::vulkanSubmitCommandBuffer(VkQueue queue,
     VK_ASSERT(vkQueueSubmit(queue, 1, &transferSubmitInfo, fence));
 }
 
-void CommandBufferUtils::vulkanWaitForFences(const VulkanHandles vulkanHandles, std::vector<VkFence> fences,
+void CommandBufferUtils::vulkanWaitForFences(const VulkanHandles &vulkanHandles, Span<VkFence> fences,
                                              bool resetFences) {
     if (!fences.empty()) {
         VK_ASSERT(vkWaitForFences(vulkanHandles.device, fences.size(), fences.data(), VK_TRUE, UINT64_MAX));
         if (resetFences)
-            VK_ASSERT(vkResetFences(vulkanHandles.device, 1, fences.data()));
+            VK_ASSERT(vkResetFences(vulkanHandles.device, fences.size(), fences.data()));
     }
 }
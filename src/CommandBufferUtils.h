@@ -9,24 +9,25 @@
 
 #include <GLFW/glfw3.h>
 #include "VulkanStructures.h"
+#include "Span.h"
 #include <vector>
 #include <iostream>
 
 class CommandBufferUtils {
 public:
 
-    static VkCommandPool vulkanCreateCommandPool(const VulkanHandles vulkanHandles, const int queueFamilyIndex);
+    static VkCommandPool vulkanCreateCommandPool(const VulkanHandles &vulkanHandles, const int queueFamilyIndex);
 
-    static std::vector<VkCommandBuffer> vulkanCreateCommandBuffers(const VulkanHandles vulkanHandles,
+    static std::vector<VkCommandBuffer> vulkanCreateCommandBuffers(const VulkanHandles &vulkanHandles,
                                                                    VkCommandPool const vkCommandPool,
                                                                    const int commandBufferCount);
 
     /*
      * Begin a command buffer and wait for fences, if any provided, reset fences automatically
      */
-    static void vulkanBeginCommandBuffer(const VulkanHandles vulkanHandles, VkCommandBuffer commandBuffer,
+    static void vulkanBeginCommandBuffer(const VulkanHandles &vulkanHandles, VkCommandBuffer commandBuffer,
                                          VkCommandBufferUsageFlags flags,
-                                         std::vector<VkFence> fence = std::vector<VkFence>(0),
+                                         Span<VkFence> fences = Span<VkFence>(),
                                          bool resetFences = true);
 
     /*
@@ -35,12 +36,12 @@ public:
     static void
     vulkanSubmitCommandBuffer(VkQueue queue,
                               VkCommandBuffer commandBuffer,
-                              std::vector<VkSemaphore> waitSemaphores,
-                              std::vector<VkSemaphore> signalSemaphores,
+                              Span<VkSemaphore> waitSemaphores,
+                              Span<VkSemaphore> signalSemaphores,
                               VkPipelineStageFlags *waitDstStageFlags, VkFence fence);
 
     static void
-    vulkanWaitForFences(const VulkanHandles vulkanHandles, std::vector<VkFence> fences, bool resetFences = true);
+    vulkanWaitForFences(const VulkanHandles &vulkanHandles, Span<VkFence> fences, bool resetFences = true);
 };
 
 
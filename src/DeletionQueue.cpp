@@ -0,0 +1,115 @@
+#include "DeletionQueue.h"
+#include <iostream>
+
+namespace {
+    template<typename Handle>
+    size_t destroyAll(VkDevice device, std::vector<Handle> &handles,
+                      void (VKAPI_PTR *destroy)(VkDevice, Handle, const VkAllocationCallbacks *)) {
+        for (auto handle : handles) destroy(device, handle, nullptr);
+        size_t count = handles.size();
+        handles.clear();
+        return count;
+    }
+}
+
+DeletionQueue::DeletionQueue(const DeviceContext &deviceContext, DeviceMemoryTracker &memoryTracker,
+                             uint32_t framesInFlight) : deviceContext(deviceContext), memoryTracker(memoryTracker),
+                                                        batches(framesInFlight) {}
+
+void DeletionQueue::destroyBuffer(uint32_t frameIndex, const Buffer &buffer) {
+    push(frameIndex, &Batch::buffers, buffer.buffer);
+    push(frameIndex, &Batch::memory, buffer.deviceMemory);
+}
+
+void DeletionQueue::destroyTexture(uint32_t frameIndex, const Texture2D &texture) {
+    push(frameIndex, &Batch::imageViews, texture.imageView);
+    push(frameIndex, &Batch::samplers, texture.sampler);
+    push(frameIndex, &Batch::images, texture.image);
+    push(frameIndex, &Batch::memory, texture.deviceMemory);
+}
+
+void DeletionQueue::destroyImage(uint32_t frameIndex, VkImage image) {
+    push(frameIndex, &Batch::images, image);
+}
+
+void DeletionQueue::destroyImageView(uint32_t frameIndex, VkImageView imageView) {
+    push(frameIndex, &Batch::imageViews, imageView);
+}
+
+void DeletionQueue::destroySampler(uint32_t frameIndex, VkSampler sampler) {
+    push(frameIndex, &Batch::samplers, sampler);
+}
+
+void DeletionQueue::destroyFramebuffer(uint32_t frameIndex, VkFramebuffer framebuffer) {
+    push(frameIndex, &Batch::framebuffers, framebuffer);
+}
+
+void DeletionQueue::destroyRenderPass(uint32_t frameIndex, VkRenderPass renderPass) {
+    push(frameIndex, &Batch::renderPasses, renderPass);
+}
+
+void DeletionQueue::destroyPipeline(uint32_t frameIndex, VkPipeline pipeline) {
+    push(frameIndex, &Batch::pipelines, pipeline);
+}
+
+void DeletionQueue::destroyPipelineLayout(uint32_t frameIndex, VkPipelineLayout pipelineLayout) {
+    push(frameIndex, &Batch::pipelineLayouts, pipelineLayout);
+}
+
+void DeletionQueue::destroyDescriptorSetLayout(uint32_t frameIndex, VkDescriptorSetLayout descriptorSetLayout) {
+    push(frameIndex, &Batch::descriptorSetLayouts, descriptorSetLayout);
+}
+
+void DeletionQueue::destroyDescriptorPool(uint32_t frameIndex, VkDescriptorPool descriptorPool) {
+    push(frameIndex, &Batch::descriptorPools, descriptorPool);
+}
+
+void DeletionQueue::destroyShaderModule(uint32_t frameIndex, VkShaderModule shaderModule) {
+    push(frameIndex, &Batch::shaderModules, shaderModule);
+}
+
+void DeletionQueue::freeMemory(uint32_t frameIndex, VkDeviceMemory deviceMemory) {
+    push(frameIndex, &Batch::memory, deviceMemory);
+}
+
+void DeletionQueue::vulkanRetireFrame(uint32_t frameIndex) {
+    vulkanDestroyBatch(batches[frameIndex]);
+}
+
+void DeletionQueue::vulkanFlush() {
+    for (auto &batch : batches) {
+        vulkanDestroyBatch(batch);
+    }
+}
+
+void DeletionQueue::vulkanDestroy() {
+    vulkanFlush();
+    std::cout << "DELETION QUEUE: " << destroyedCount << " resources destroyed in " << retireCount
+              << " batches, peak " << peakPending << " pending" << std::endl;
+    memoryTracker.reportLeaks();
+}
+
+void DeletionQueue::vulkanDestroyBatch(Batch &batch) {
+    if (batch.size == 0) return;
+    VkDevice device = deviceContext.handles.device;
+    //Users before what they use: framebuffers and pipelines hold on to their render passes, views and layouts
+    size_t destroyed = destroyAll(device, batch.framebuffers, vkDestroyFramebuffer);
+    destroyed += destroyAll(device, batch.pipelines, vkDestroyPipeline);
+    destroyed += destroyAll(device, batch.pipelineLayouts, vkDestroyPipelineLayout);
+    destroyed += destroyAll(device, batch.descriptorSetLayouts, vkDestroyDescriptorSetLayout);
+    destroyed += destroyAll(device, batch.descriptorPools, vkDestroyDescriptorPool);
+    destroyed += destroyAll(device, batch.renderPasses, vkDestroyRenderPass);
+    destroyed += destroyAll(device, batch.shaderModules, vkDestroyShaderModule);
+    destroyed += destroyAll(device, batch.imageViews, vkDestroyImageView);
+    destroyed += destroyAll(device, batch.samplers, vkDestroySampler);
+    destroyed += destroyAll(device, batch.images, vkDestroyImage);
+    destroyed += destroyAll(device, batch.buffers, vkDestroyBuffer);
+    for (auto deviceMemory : batch.memory) {
+        memoryTracker.vulkanFree(deviceMemory);
+    }
+    destroyed += batch.memory.size();
+    batch.memory.clear();
+    batch.size = 0;
+    destroyedCount += destroyed;
+    retireCount++;
+}
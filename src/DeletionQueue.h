@@ -0,0 +1,109 @@
+#ifndef VULKANBASE_DELETIONQUEUE_H
+#define VULKANBASE_DELETIONQUEUE_H
+
+#define GLFW_INCLUDE_VULKAN
+
+#include <GLFW/glfw3.h>
+#include <vector>
+#include "VulkanStructures.h"
+#include "DeviceContext.h"
+#include "DeviceMemoryTracker.h"
+
+/*
+ * Destroys GPU resources once the frames that may still use them are finished, without waiting the device idle.
+ * There is one queue per frame in flight. A resource is queued in the slot of the frame being recorded and destroyed
+ * by the next vulkanRetireFrame of that slot, which must come right after its fence was waited. Queue only after the
+ * fence of the current slot was waited, anything queued before would be destroyed with the frame still on the GPU.
+ * Each retire destroys in batches of one kind, framebuffers and views before their images, the memory last.
+ */
+class DeletionQueue {
+public:
+    DeletionQueue(const DeviceContext &deviceContext, DeviceMemoryTracker &memoryTracker, uint32_t framesInFlight);
+
+    void destroyBuffer(uint32_t frameIndex, const Buffer &buffer);
+
+    /*
+     * The image, its view, its sampler and its memory
+     */
+    void destroyTexture(uint32_t frameIndex, const Texture2D &texture);
+
+    void destroyImage(uint32_t frameIndex, VkImage image);
+
+    void destroyImageView(uint32_t frameIndex, VkImageView imageView);
+
+    void destroySampler(uint32_t frameIndex, VkSampler sampler);
+
+    void destroyFramebuffer(uint32_t frameIndex, VkFramebuffer framebuffer);
+
+    void destroyRenderPass(uint32_t frameIndex, VkRenderPass renderPass);
+
+    void destroyPipeline(uint32_t frameIndex, VkPipeline pipeline);
+
+    void destroyPipelineLayout(uint32_t frameIndex, VkPipelineLayout pipelineLayout);
+
+    void destroyDescriptorSetLayout(uint32_t frameIndex, VkDescriptorSetLayout descriptorSetLayout);
+
+    void destroyDescriptorPool(uint32_t frameIndex, VkDescriptorPool descriptorPool);
+
+    void destroyShaderModule(uint32_t frameIndex, VkShaderModule shaderModule);
+
+    /*
+     * The memory must come from the tracker
+     */
+    void freeMemory(uint32_t frameIndex, VkDeviceMemory deviceMemory);
+
+    /*
+     * Destroy what was queued in the slot, the caller must have waited the frame fence
+     */
+    void vulkanRetireFrame(uint32_t frameIndex);
+
+    /*
+     * Destroy every queue at once, the caller must have waited the device idle
+     */
+    void vulkanFlush();
+
+    /*
+     * Flush and print how much went through the queues and the device memory still allocated, which leaked
+     */
+    void vulkanDestroy();
+
+private:
+    struct Batch {
+        std::vector<VkFramebuffer> framebuffers;
+        std::vector<VkPipeline> pipelines;
+        std::vector<VkPipelineLayout> pipelineLayouts;
+        std::vector<VkDescriptorSetLayout> descriptorSetLayouts;
+        std::vector<VkDescriptorPool> descriptorPools;
+        std::vector<VkRenderPass> renderPasses;
+        std::vector<VkShaderModule> shaderModules;
+        std::vector<VkImageView> imageViews;
+        std::vector<VkSampler> samplers;
+        std::vector<VkImage> images;
+        std::vector<VkBuffer> buffers;
+        std::vector<VkDeviceMemory> memory;
+        size_t size = 0;
+    };
+
+    const DeviceContext &deviceContext;
+    DeviceMemoryTracker &memoryTracker;
+    std::vector<Batch> batches;
+    uint64_t destroyedCount = 0;
+    uint64_t retireCount = 0;
+    size_t peakPending = 0;
+
+    template<typename Handle>
+    void push(uint32_t frameIndex, std::vector<Handle> Batch::*list, Handle handle) {
+        if (handle == VK_NULL_HANDLE) return;
+        Batch &batch = batches[frameIndex];
+        (batch.*list).push_back(handle);
+        batch.size++;
+        size_t pending = 0;
+        for (auto &frameBatch : batches) pending += frameBatch.size;
+        if (pending > peakPending) peakPending = pending;
+    }
+
+    void vulkanDestroyBatch(Batch &batch);
+};
+
+
+#endif //VULKANBASE_DELETIONQUEUE_H
@@ -0,0 +1,282 @@
+#include "DescriptorAllocator.h"
+#include <stdexcept>
+#include <algorithm>
+
+//Descriptors reserved per set in every pool, scaled by the amount of sets of the pool
+static const std::pair<VkDescriptorType, float> POOL_RATIOS[] = {
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         2.0f},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.0f},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         1.0f},
+        {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,          1.0f},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,          1.0f}
+};
+
+void DescriptorAllocator::vulkanInit(VkDevice device, uint32_t framesInFlight, uint32_t setsPerPool) {
+    this->device = device;
+    persistentPools.nextPoolSets = setsPerPool;
+    //Cached sets are given back when what they reference is destroyed, transient pools are only reset
+    persistentPools.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+    transientPools = std::vector<PoolList>(framesInFlight);
+    for (auto &poolList : transientPools) {
+        poolList.nextPoolSets = setsPerPool;
+    }
+}
+
+VkDescriptorPool DescriptorAllocator::vulkanCreatePool(uint32_t maxSets, VkDescriptorPoolCreateFlags flags) {
+    std::vector<VkDescriptorPoolSize> poolSizes;
+    for (auto &ratio : POOL_RATIOS) {
+        VkDescriptorPoolSize poolSize{};
+        poolSize.type = ratio.first;
+        poolSize.descriptorCount = (uint32_t) (ratio.second * maxSets);
+        poolSizes.push_back(poolSize);
+    }
+    VkDescriptorPoolCreateInfo vkDescriptorPoolCreateInfo{};
+    vkDescriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    vkDescriptorPoolCreateInfo.poolSizeCount = poolSizes.size();
+    vkDescriptorPoolCreateInfo.pPoolSizes = poolSizes.data();
+    vkDescriptorPoolCreateInfo.maxSets = maxSets;
+    vkDescriptorPoolCreateInfo.flags = flags;
+    VkDescriptorPool pool;
+    VK_ASSERT(vkCreateDescriptorPool(device, &vkDescriptorPoolCreateInfo, nullptr, &pool));
+    return pool;
+}
+
+VkDescriptorPool DescriptorAllocator::vulkanGrabPool(PoolList &poolList) {
+    if (!poolList.freePools.empty()) {
+        VkDescriptorPool pool = poolList.freePools.back();
+        poolList.freePools.pop_back();
+        return pool;
+    }
+    VkDescriptorPool pool = vulkanCreatePool(poolList.nextPoolSets, poolList.flags);
+    //Each new pool doubles the size of the previous one, so the amount of pools grows logarithmically
+    poolList.nextPoolSets = std::min(poolList.nextPoolSets * 2, maxSetsPerPool);
+    return pool;
+}
+
+VkDescriptorSet DescriptorAllocator::vulkanAllocateFromList(PoolList &poolList, VkDescriptorSetLayout layout,
+                                                            VkDescriptorPool *pool) {
+    if (poolList.currentPool == VK_NULL_HANDLE) {
+        poolList.currentPool = vulkanGrabPool(poolList);
+    }
+    VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{};
+    descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descriptorSetAllocateInfo.descriptorPool = poolList.currentPool;
+    descriptorSetAllocateInfo.descriptorSetCount = 1;
+    descriptorSetAllocateInfo.pSetLayouts = &layout;
+    VkDescriptorSet descriptorSet;
+    VkResult result = vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &descriptorSet);
+    if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+        poolList.usedPools.push_back(poolList.currentPool);
+        poolList.currentPool = vulkanGrabPool(poolList);
+        descriptorSetAllocateInfo.descriptorPool = poolList.currentPool;
+        result = vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &descriptorSet);
+    }
+    VK_ASSERT(result);
+    if (pool != nullptr) *pool = descriptorSetAllocateInfo.descriptorPool;
+    return descriptorSet;
+}
+
+VkDescriptorSet DescriptorAllocator::vulkanAllocateDescriptorSet(VkDescriptorSetLayout layout, VkDescriptorPool *pool) {
+    return vulkanAllocateFromList(persistentPools, layout, pool);
+}
+
+void DescriptorAllocator::vulkanFreeDescriptorSet(VkDescriptorPool pool, VkDescriptorSet descriptorSet) {
+    VK_ASSERT(vkFreeDescriptorSets(device, pool, 1, &descriptorSet));
+}
+
+VkDescriptorSet
+DescriptorAllocator::vulkanAllocateTransientDescriptorSet(uint32_t frameIndex, VkDescriptorSetLayout layout) {
+    return vulkanAllocateFromList(transientPools[frameIndex], layout, nullptr);
+}
+
+VkDescriptorSet
+DescriptorAllocator::vulkanAllocateTransientDescriptorSet(uint32_t frameIndex, VkDescriptorSetLayout layout,
+                                                          const DescriptorBinding *bindings, uint32_t bindingCount) {
+    VkDescriptorSet descriptorSet = vulkanAllocateFromList(transientPools[frameIndex], layout, nullptr);
+    vulkanWriteDescriptorSet(device, descriptorSet, bindings, bindingCount);
+    return descriptorSet;
+}
+
+void DescriptorAllocator::vulkanResetFrame(uint32_t frameIndex) {
+    PoolList &poolList = transientPools[frameIndex];
+    if (poolList.currentPool != VK_NULL_HANDLE) {
+        poolList.usedPools.push_back(poolList.currentPool);
+        poolList.currentPool = VK_NULL_HANDLE;
+    }
+    for (auto pool : poolList.usedPools) {
+        VK_ASSERT(vkResetDescriptorPool(device, pool, 0));
+        poolList.freePools.push_back(pool);
+    }
+    poolList.usedPools.clear();
+}
+
+void DescriptorAllocator::vulkanDestroyList(PoolList &poolList) {
+    if (poolList.currentPool != VK_NULL_HANDLE) {
+        vkDestroyDescriptorPool(device, poolList.currentPool, nullptr);
+        poolList.currentPool = VK_NULL_HANDLE;
+    }
+    for (auto pool : poolList.usedPools) {
+        vkDestroyDescriptorPool(device, pool, nullptr);
+    }
+    for (auto pool : poolList.freePools) {
+        vkDestroyDescriptorPool(device, pool, nullptr);
+    }
+    poolList.usedPools.clear();
+    poolList.freePools.clear();
+}
+
+void DescriptorAllocator::vulkanDestroy() {
+    vulkanDestroyList(persistentPools);
+    for (auto &poolList : transientPools) {
+        vulkanDestroyList(poolList);
+    }
+}
+
+DescriptorBinding DescriptorBinding::buffer(uint32_t binding, VkDescriptorType descriptorType, const Buffer &buffer) {
+    DescriptorBinding descriptorBinding{};
+    descriptorBinding.binding = binding;
+    descriptorBinding.descriptorType = descriptorType;
+    descriptorBinding.bufferInfo.buffer = buffer.buffer;
+    descriptorBinding.bufferInfo.offset = 0;
+    descriptorBinding.bufferInfo.range = buffer.size;
+    return descriptorBinding;
+}
+
+DescriptorBinding DescriptorBinding::image(uint32_t binding, VkDescriptorType descriptorType, const Texture2D &texture,
+                                           VkImageLayout imageLayout) {
+    return image(binding, descriptorType, texture.imageView, texture.sampler, imageLayout);
+}
+
+DescriptorBinding DescriptorBinding::image(uint32_t binding, VkDescriptorType descriptorType, VkImageView imageView,
+                                           VkSampler sampler, VkImageLayout imageLayout) {
+    DescriptorBinding descriptorBinding{};
+    descriptorBinding.binding = binding;
+    descriptorBinding.descriptorType = descriptorType;
+    descriptorBinding.imageInfo.imageView = imageView;
+    descriptorBinding.imageInfo.sampler = descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE ? VK_NULL_HANDLE : sampler;
+    descriptorBinding.imageInfo.imageLayout = imageLayout;
+    return descriptorBinding;
+}
+
+void vulkanWriteDescriptorSet(VkDevice device, VkDescriptorSet descriptorSet, const DescriptorBinding *bindings,
+                              uint32_t bindingCount) {
+    //On the stack, transient sets are written every frame
+    const uint32_t maxBindings = 16;
+    if (bindingCount > maxBindings) {
+        throw std::runtime_error("DESCRIPTOR SET WRITE WITH MORE THAN 16 BINDINGS");
+    }
+    VkWriteDescriptorSet descriptorWrites[maxBindings];
+    for (uint32_t i = 0; i < bindingCount; ++i) {
+        const DescriptorBinding &binding = bindings[i];
+        bool isImage = binding.imageInfo.imageView != VK_NULL_HANDLE || binding.imageInfo.sampler != VK_NULL_HANDLE;
+        descriptorWrites[i] = {};
+        descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[i].dstSet = descriptorSet;
+        descriptorWrites[i].dstBinding = binding.binding;
+        descriptorWrites[i].dstArrayElement = 0;
+        descriptorWrites[i].descriptorCount = 1;
+        descriptorWrites[i].descriptorType = binding.descriptorType;
+        descriptorWrites[i].pBufferInfo = isImage ? nullptr : &binding.bufferInfo;
+        descriptorWrites[i].pImageInfo = isImage ? &binding.imageInfo : nullptr;
+    }
+    vkUpdateDescriptorSets(device, bindingCount, descriptorWrites, 0, nullptr);
+}
+
+DescriptorCache::DescriptorCache(DescriptorAllocator &descriptorAllocator) : descriptorAllocator(descriptorAllocator) {}
+
+static void hashCombine(uint64_t &hash, uint64_t value) {
+    //FNV-1a over the 8 bytes of the value
+    for (int i = 0; i < 8; ++i) {
+        hash ^= (value >> (i * 8)) & 0xFF;
+        hash *= 1099511628211ull;
+    }
+}
+
+uint64_t DescriptorCache::hash(VkDescriptorSetLayout layout, const DescriptorBinding *bindings, uint32_t bindingCount) {
+    uint64_t hash = 14695981039346656037ull;
+    hashCombine(hash, (uint64_t) layout);
+    for (uint32_t i = 0; i < bindingCount; ++i) {
+        hashCombine(hash, bindings[i].binding);
+        hashCombine(hash, bindings[i].descriptorType);
+        hashCombine(hash, (uint64_t) bindings[i].bufferInfo.buffer);
+        hashCombine(hash, bindings[i].bufferInfo.offset);
+        hashCombine(hash, bindings[i].bufferInfo.range);
+        hashCombine(hash, (uint64_t) bindings[i].imageInfo.imageView);
+        hashCombine(hash, (uint64_t) bindings[i].imageInfo.sampler);
+        hashCombine(hash, bindings[i].imageInfo.imageLayout);
+    }
+    return hash;
+}
+
+bool DescriptorCache::matches(const CachedSet &cachedSet, VkDescriptorSetLayout layout,
+                              const DescriptorBinding *bindings, uint32_t bindingCount) {
+    if (cachedSet.layout != layout || cachedSet.bindings.size() != bindingCount) return false;
+    for (uint32_t i = 0; i < bindingCount; ++i) {
+        const DescriptorBinding &a = cachedSet.bindings[i];
+        const DescriptorBinding &b = bindings[i];
+        if (a.binding != b.binding || a.descriptorType != b.descriptorType ||
+            a.bufferInfo.buffer != b.bufferInfo.buffer || a.bufferInfo.offset != b.bufferInfo.offset ||
+            a.bufferInfo.range != b.bufferInfo.range || a.imageInfo.imageView != b.imageInfo.imageView ||
+            a.imageInfo.sampler != b.imageInfo.sampler || a.imageInfo.imageLayout != b.imageInfo.imageLayout)
+            return false;
+    }
+    return true;
+}
+
+VkDescriptorSet DescriptorCache::vulkanGetDescriptorSet(VkDevice device, VkDescriptorSetLayout layout,
+                                                        const DescriptorBinding *bindings, uint32_t bindingCount) {
+    uint64_t key = hash(layout, bindings, bindingCount);
+    auto range = cache.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (matches(it->second, layout, bindings, bindingCount)) return it->second.descriptorSet;
+    }
+
+    CachedSet cachedSet{};
+    cachedSet.layout = layout;
+    cachedSet.bindings = std::vector<DescriptorBinding>(bindings, bindings + bindingCount);
+    cachedSet.descriptorSet = descriptorAllocator.vulkanAllocateDescriptorSet(layout, &cachedSet.pool);
+    vulkanWriteDescriptorSet(device, cachedSet.descriptorSet, cachedSet.bindings.data(), bindingCount);
+
+    VkDescriptorSet descriptorSet = cachedSet.descriptorSet;
+    cache.emplace(key, std::move(cachedSet));
+    return descriptorSet;
+}
+
+VkDescriptorSet DescriptorCache::vulkanGetDescriptorSet(VkDevice device, VkDescriptorSetLayout layout,
+                                                        const std::vector<DescriptorBinding> &bindings) {
+    return vulkanGetDescriptorSet(device, layout, bindings.data(), bindings.size());
+}
+
+void DescriptorCache::vulkanInvalidateImageView(VkImageView imageView) {
+    //Null would match every binding of the other kinds
+    if (imageView == VK_NULL_HANDLE) return;
+    vulkanInvalidate([imageView](const DescriptorBinding &binding) {
+        return binding.imageInfo.imageView == imageView;
+    });
+}
+
+void DescriptorCache::vulkanInvalidateSampler(VkSampler sampler) {
+    if (sampler == VK_NULL_HANDLE) return;
+    vulkanInvalidate([sampler](const DescriptorBinding &binding) { return binding.imageInfo.sampler == sampler; });
+}
+
+void DescriptorCache::vulkanInvalidateBuffer(VkBuffer buffer) {
+    if (buffer == VK_NULL_HANDLE) return;
+    vulkanInvalidate([buffer](const DescriptorBinding &binding) { return binding.bufferInfo.buffer == buffer; });
+}
+
+void DescriptorCache::vulkanInvalidate(const std::function<bool(const DescriptorBinding &)> &references) {
+    for (auto it = cache.begin(); it != cache.end();) {
+        const CachedSet &cachedSet = it->second;
+        if (std::any_of(cachedSet.bindings.begin(), cachedSet.bindings.end(), references)) {
+            descriptorAllocator.vulkanFreeDescriptorSet(cachedSet.pool, cachedSet.descriptorSet);
+            it = cache.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void DescriptorCache::clear() {
+    cache.clear();
+}
@@ -0,0 +1,148 @@
+#ifndef VULKANBASE_DESCRIPTORALLOCATOR_H
+#define VULKANBASE_DESCRIPTORALLOCATOR_H
+
+#define GLFW_INCLUDE_VULKAN
+
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include "VulkanStructures.h"
+
+struct DescriptorBinding;
+
+/*
+ * Hands out descriptor sets from a growing list of pools instead of a single fixed size pool.
+ * Persistent sets live until they are freed or destroy, transient sets live until the frame that allocated them is
+ * reset. Sets whose bindings change from frame to frame, like the ones of swapchain sized images, should be transient.
+ */
+class DescriptorAllocator {
+public:
+    void vulkanInit(VkDevice device, uint32_t framesInFlight, uint32_t setsPerPool = 64);
+
+    /*
+     * The pool the set came from is written to pool when given, vulkanFreeDescriptorSet needs it
+     */
+    VkDescriptorSet vulkanAllocateDescriptorSet(VkDescriptorSetLayout layout, VkDescriptorPool *pool = nullptr);
+
+    /*
+     * Give a persistent set back to its pool, the GPU must be done with it
+     */
+    void vulkanFreeDescriptorSet(VkDescriptorPool pool, VkDescriptorSet descriptorSet);
+
+    /*
+     * Allocate a set that is only valid while the frame is in flight, it is released by vulkanResetFrame
+     */
+    VkDescriptorSet vulkanAllocateTransientDescriptorSet(uint32_t frameIndex, VkDescriptorSetLayout layout);
+
+    /*
+     * Allocate a transient set and write the bindings into it, without touching the heap
+     */
+    VkDescriptorSet vulkanAllocateTransientDescriptorSet(uint32_t frameIndex, VkDescriptorSetLayout layout,
+                                                         const DescriptorBinding *bindings, uint32_t bindingCount);
+
+    /*
+     * Reset every transient pool of the frame at once, the caller must have waited the frame fence
+     */
+    void vulkanResetFrame(uint32_t frameIndex);
+
+    void vulkanDestroy();
+
+private:
+    struct PoolList {
+        VkDescriptorPool currentPool = VK_NULL_HANDLE;
+        std::vector<VkDescriptorPool> usedPools;
+        std::vector<VkDescriptorPool> freePools;
+        uint32_t nextPoolSets = 0;
+        VkDescriptorPoolCreateFlags flags = 0;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    uint32_t maxSetsPerPool = 4096;
+    PoolList persistentPools;
+    std::vector<PoolList> transientPools;
+
+    VkDescriptorPool vulkanCreatePool(uint32_t maxSets, VkDescriptorPoolCreateFlags flags);
+
+    VkDescriptorPool vulkanGrabPool(PoolList &poolList);
+
+    VkDescriptorSet vulkanAllocateFromList(PoolList &poolList, VkDescriptorSetLayout layout, VkDescriptorPool *pool);
+
+    void vulkanDestroyList(PoolList &poolList);
+};
+
+struct DescriptorBinding {
+    uint32_t binding;
+    VkDescriptorType descriptorType;
+    VkDescriptorBufferInfo bufferInfo;
+    VkDescriptorImageInfo imageInfo;
+
+    static DescriptorBinding buffer(uint32_t binding, VkDescriptorType descriptorType, const Buffer &buffer);
+
+    static DescriptorBinding image(uint32_t binding, VkDescriptorType descriptorType, const Texture2D &texture,
+                                   VkImageLayout imageLayout);
+
+    /*
+     * For images that are not a Texture2D, the sampler is ignored by storage images
+     */
+    static DescriptorBinding image(uint32_t binding, VkDescriptorType descriptorType, VkImageView imageView,
+                                   VkSampler sampler, VkImageLayout imageLayout);
+};
+
+/*
+ * Write every binding into the set, at most 16 bindings
+ */
+void vulkanWriteDescriptorSet(VkDevice device, VkDescriptorSet descriptorSet, const DescriptorBinding *bindings,
+                              uint32_t bindingCount);
+
+/*
+ * Returns the same descriptor set for the same layout and binding content, writing it only the first time.
+ * Sets come from the persistent pools of the allocator and are kept until invalidated. The cache only knows handle
+ * values: whoever destroys a view, sampler or buffer must invalidate it at the same time, or a new object that gets
+ * the same handle would be handed a set that still points at the destroyed one.
+ */
+class DescriptorCache {
+public:
+    explicit DescriptorCache(DescriptorAllocator &descriptorAllocator);
+
+    VkDescriptorSet vulkanGetDescriptorSet(VkDevice device, VkDescriptorSetLayout layout,
+                                           const DescriptorBinding *bindings, uint32_t bindingCount);
+
+    VkDescriptorSet vulkanGetDescriptorSet(VkDevice device, VkDescriptorSetLayout layout,
+                                           const std::vector<DescriptorBinding> &bindings);
+
+    /*
+     * Free the sets that reference the handle, the GPU must be done with them as with the handle being destroyed
+     */
+    void vulkanInvalidateImageView(VkImageView imageView);
+
+    void vulkanInvalidateSampler(VkSampler sampler);
+
+    void vulkanInvalidateBuffer(VkBuffer buffer);
+
+    /*
+     * Forget every set without freeing them, for when the allocator is destroyed
+     */
+    void clear();
+
+private:
+    struct CachedSet {
+        VkDescriptorSetLayout layout;
+        std::vector<DescriptorBinding> bindings;
+        VkDescriptorSet descriptorSet;
+        VkDescriptorPool pool;
+    };
+
+    DescriptorAllocator &descriptorAllocator;
+    std::unordered_multimap<uint64_t, CachedSet> cache;
+
+    void vulkanInvalidate(const std::function<bool(const DescriptorBinding &)> &references);
+
+    static uint64_t hash(VkDescriptorSetLayout layout, const DescriptorBinding *bindings, uint32_t bindingCount);
+
+    static bool matches(const CachedSet &cachedSet, VkDescriptorSetLayout layout, const DescriptorBinding *bindings,
+                        uint32_t bindingCount);
+};
+
+
+#endif //VULKANBASE_DESCRIPTORALLOCATOR_H
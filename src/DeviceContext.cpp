@@ -0,0 +1,38 @@
+#include "DeviceContext.h"
+#include <stdexcept>
+
+DeviceContext::DeviceContext(const VulkanHandles &handles, const PhysicalDeviceInfo &physicalDeviceInfo) : handles(handles),
+                                                                                                         physicalDeviceInfo(physicalDeviceInfo) {}
+
+UniqueHandle<VkFence> DeviceContext::vulkanCreateFence(VkFenceCreateFlags flags) const {
+    VkFenceCreateInfo fenceCreateInfo{};
+    fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceCreateInfo.flags = flags;
+    VkFence vkFence;
+    VK_ASSERT(vkCreateFence(handles.device, &fenceCreateInfo, nullptr, &vkFence));
+    return UniqueHandle<VkFence>(handles.device, vkFence, [](VkDevice device, VkFence fence) {
+        vkDestroyFence(device, fence, nullptr);
+    });
+}
+
+UniqueHandle<VkSemaphore> DeviceContext::vulkanCreateSemaphore() const {
+    VkSemaphoreCreateInfo vkSemaphoreCreateInfo{};
+    vkSemaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    VkSemaphore vkSemaphore;
+    VK_ASSERT(vkCreateSemaphore(handles.device, &vkSemaphoreCreateInfo, nullptr, &vkSemaphore));
+    return UniqueHandle<VkSemaphore>(handles.device, vkSemaphore, [](VkDevice device, VkSemaphore semaphore) {
+        vkDestroySemaphore(device, semaphore, nullptr);
+    });
+}
+
+UniqueHandle<VkQueryPool> DeviceContext::vulkanCreateQueryPool(VkQueryType queryType, uint32_t queryCount) const {
+    VkQueryPoolCreateInfo vkQueryPoolCreateInfo{};
+    vkQueryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    vkQueryPoolCreateInfo.queryType = queryType;
+    vkQueryPoolCreateInfo.queryCount = queryCount;
+    VkQueryPool vkQueryPool;
+    VK_ASSERT(vkCreateQueryPool(handles.device, &vkQueryPoolCreateInfo, nullptr, &vkQueryPool));
+    return UniqueHandle<VkQueryPool>(handles.device, vkQueryPool, [](VkDevice device, VkQueryPool queryPool) {
+        vkDestroyQueryPool(device, queryPool, nullptr);
+    });
+}
@@ -0,0 +1,29 @@
+#ifndef VULKANBASE_DEVICECONTEXT_H
+#define VULKANBASE_DEVICECONTEXT_H
+
+#define GLFW_INCLUDE_VULKAN
+
+#include <GLFW/glfw3.h>
+#include "VulkanStructures.h"
+#include "UniqueHandle.h"
+
+/*
+ * The device handles and what was queried about the physical device, referenced instead of copied into every call.
+ * Both referenced structures must outlive the context, the swapchain handle can change under it when recreated.
+ */
+class DeviceContext {
+public:
+    const VulkanHandles &handles;
+    const PhysicalDeviceInfo &physicalDeviceInfo;
+
+    DeviceContext(const VulkanHandles &handles, const PhysicalDeviceInfo &physicalDeviceInfo);
+
+    UniqueHandle<VkFence> vulkanCreateFence(VkFenceCreateFlags flags) const;
+
+    UniqueHandle<VkSemaphore> vulkanCreateSemaphore() const;
+
+    UniqueHandle<VkQueryPool> vulkanCreateQueryPool(VkQueryType queryType, uint32_t queryCount) const;
+};
+
+
+#endif //VULKANBASE_DEVICECONTEXT_H
@@ -0,0 +1,211 @@
+#include "DeviceMemoryTracker.h"
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+const char *memoryTagName(MemoryTag tag) {
+    switch (tag) {
+        case MEMORY_TAG_TERRAIN:
+            return "TERRAIN";
+        case MEMORY_TAG_TEXTURES:
+            return "TEXTURES";
+        case MEMORY_TAG_UNIFORMS:
+            return "UNIFORMS";
+        case MEMORY_TAG_STAGING:
+            return "STAGING";
+        case MEMORY_TAG_ATTACHMENTS:
+            return "ATTACHMENTS";
+        default:
+            return "UNKNOWN";
+    }
+}
+
+DeviceMemoryTracker::DeviceMemoryTracker(const DeviceContext &deviceContext) : deviceContext(deviceContext) {
+    heaps.resize(deviceContext.physicalDeviceInfo.memoryProperties.memoryHeapCount);
+    vulkanUpdateBudget();
+}
+
+VkDeviceMemory DeviceMemoryTracker::vulkanAllocate(const VkMemoryRequirements &memoryRequirements,
+                                                   VkMemoryPropertyFlags propertyFlags, MemoryTag tag) {
+    int typeIndex = memoryTypeIndex(memoryRequirements.memoryTypeBits, propertyFlags);
+    if (typeIndex < 0) {
+        throw std::runtime_error("NO MEMORY TYPE WITH PROPERTIES " + std::to_string(propertyFlags) + " FOR " +
+                                 memoryTagName(tag));
+    }
+    uint32_t heap = deviceContext.physicalDeviceInfo.memoryProperties.memoryTypes[typeIndex].heapIndex;
+    VkDeviceSize size = memoryRequirements.size;
+    if (budgetSupported()) vulkanUpdateBudget();
+    if (projectedUsage(heap) + size > heaps[heap].budget) {
+        evict(heap, heaps[heap].budget > size ? heaps[heap].budget - size : 0);
+        if (projectedUsage(heap) + size > heaps[heap].budget) overBudgetAllocations++;
+    }
+
+    VkMemoryAllocateInfo vkMemoryAllocateInfo{};
+    vkMemoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    vkMemoryAllocateInfo.memoryTypeIndex = typeIndex;
+    vkMemoryAllocateInfo.allocationSize = size;
+    VkDeviceMemory deviceMemory = VK_NULL_HANDLE;
+    VkResult result = vkAllocateMemory(deviceContext.handles.device, &vkMemoryAllocateInfo, nullptr, &deviceMemory);
+    if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY || result == VK_ERROR_OUT_OF_HOST_MEMORY) {
+        //The budget is an estimate, the driver may refuse below it
+        VkDeviceSize usage = projectedUsage(heap);
+        evict(heap, usage > size ? usage - size : 0);
+        result = vkAllocateMemory(deviceContext.handles.device, &vkMemoryAllocateInfo, nullptr, &deviceMemory);
+    }
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("CANNOT ALLOCATE " + std::to_string(size) + " BYTES FOR " + memoryTagName(tag) +
+                                 " IN HEAP " + std::to_string(heap) + ", " + std::to_string(projectedUsage(heap)) +
+                                 " OF " + std::to_string(heaps[heap].budget) + " BYTES IN USE");
+    }
+
+    allocations[deviceMemory] = {size, heap, tag};
+    Heap &heapState = heaps[heap];
+    heapState.trackedUsage += size;
+    heapState.peakTrackedUsage = std::max(heapState.peakTrackedUsage, heapState.trackedUsage);
+    heapState.allocationCount++;
+    tagUsages[tag] += size;
+    return deviceMemory;
+}
+
+void DeviceMemoryTracker::vulkanFree(VkDeviceMemory deviceMemory) {
+    if (deviceMemory == VK_NULL_HANDLE) return;
+    auto allocation = allocations.find(deviceMemory);
+    if (allocation == allocations.end()) {
+        throw std::runtime_error("FREEING DEVICE MEMORY THAT WAS NOT ALLOCATED BY THE TRACKER");
+    }
+    Heap &heap = heaps[allocation->second.heapIndex];
+    heap.trackedUsage -= allocation->second.size;
+    heap.allocationCount--;
+    tagUsages[allocation->second.tag] -= allocation->second.size;
+    allocations.erase(allocation);
+    vkFreeMemory(deviceContext.handles.device, deviceMemory, nullptr);
+}
+
+void DeviceMemoryTracker::vulkanUpdateBudget() {
+    const VkPhysicalDeviceMemoryProperties &memoryProperties = deviceContext.physicalDeviceInfo.memoryProperties;
+    if (!budgetSupported()) {
+        for (uint32_t i = 0; i < heaps.size(); ++i) {
+            heaps[i].budget = (VkDeviceSize) (memoryProperties.memoryHeaps[i].size * (double) fallbackBudgetFraction);
+        }
+        return;
+    }
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+    budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    VkPhysicalDeviceMemoryProperties2 memoryProperties2{};
+    memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    memoryProperties2.pNext = &budgetProperties;
+    vkGetPhysicalDeviceMemoryProperties2(deviceContext.handles.physicalDevice, &memoryProperties2);
+    for (uint32_t i = 0; i < heaps.size(); ++i) {
+        heaps[i].budget = budgetProperties.heapBudget[i];
+        //Swapchain images, pipelines and whatever the driver allocates for the process
+        VkDeviceSize usage = budgetProperties.heapUsage[i];
+        heaps[i].untrackedUsage = usage > heaps[i].trackedUsage ? usage - heaps[i].trackedUsage : 0;
+    }
+}
+
+uint32_t DeviceMemoryTracker::addEvictionHandler(EvictionHandler handler) {
+    return evictionHandlers.add(std::move(handler));
+}
+
+void DeviceMemoryTracker::removeEvictionHandler(uint32_t handlerId) {
+    evictionHandlers.remove(handlerId);
+}
+
+uint32_t DeviceMemoryTracker::heapIndex(uint32_t memoryTypeBits, VkMemoryPropertyFlags propertyFlags) const {
+    int typeIndex = memoryTypeIndex(memoryTypeBits, propertyFlags);
+    if (typeIndex < 0) {
+        throw std::runtime_error("NO MEMORY TYPE WITH PROPERTIES " + std::to_string(propertyFlags));
+    }
+    return deviceContext.physicalDeviceInfo.memoryProperties.memoryTypes[typeIndex].heapIndex;
+}
+
+VkDeviceSize DeviceMemoryTracker::availableBytes(uint32_t heapIndex) const {
+    VkDeviceSize usage = projectedUsage(heapIndex);
+    return heaps[heapIndex].budget > usage ? heaps[heapIndex].budget - usage : 0;
+}
+
+uint32_t DeviceMemoryTracker::heapCount() const {
+    return (uint32_t) heaps.size();
+}
+
+DeviceMemoryTracker::HeapStatistics DeviceMemoryTracker::heapStatistics(uint32_t heapIndex) const {
+    const VkMemoryHeap &memoryHeap = deviceContext.physicalDeviceInfo.memoryProperties.memoryHeaps[heapIndex];
+    const Heap &heap = heaps[heapIndex];
+    HeapStatistics statistics{};
+    statistics.size = memoryHeap.size;
+    statistics.budget = heap.budget;
+    statistics.usage = projectedUsage(heapIndex);
+    statistics.trackedUsage = heap.trackedUsage;
+    statistics.peakTrackedUsage = heap.peakTrackedUsage;
+    statistics.allocationCount = heap.allocationCount;
+    statistics.deviceLocal = (memoryHeap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+    return statistics;
+}
+
+VkDeviceSize DeviceMemoryTracker::tagUsage(MemoryTag tag) const {
+    return tagUsages[tag];
+}
+
+bool DeviceMemoryTracker::budgetSupported() const {
+    return deviceContext.physicalDeviceInfo.memoryBudgetSupported;
+}
+
+void DeviceMemoryTracker::vulkanReport() {
+    vulkanUpdateBudget();
+    const double megabyte = 1024.0 * 1024.0;
+    std::cout << "DEVICE MEMORY (MB, budget " << (budgetSupported() ? "from VK_EXT_memory_budget" : "estimated") << "):"
+              << std::endl;
+    for (uint32_t i = 0; i < heaps.size(); ++i) {
+        HeapStatistics statistics = heapStatistics(i);
+        std::cout << "    HEAP " << i << (statistics.deviceLocal ? " DEVICE LOCAL" : " HOST") << ": "
+                  << statistics.usage / megabyte << " of " << statistics.budget / megabyte << " budget, "
+                  << statistics.size / megabyte << " size, tracked " << statistics.trackedUsage / megabyte << " in "
+                  << statistics.allocationCount << " allocations, peak " << statistics.peakTrackedUsage / megabyte
+                  << std::endl;
+    }
+    std::cout << "   ";
+    for (uint32_t tag = 0; tag < MEMORY_TAG_COUNT; ++tag) {
+        std::cout << " " << memoryTagName((MemoryTag) tag) << " " << tagUsages[tag] / megabyte;
+    }
+    std::cout << std::endl;
+    if (overBudgetAllocations > 0) {
+        std::cout << "    OVER BUDGET ALLOCATIONS: " << overBudgetAllocations << std::endl;
+    }
+}
+
+void DeviceMemoryTracker::reportLeaks() const {
+    if (allocations.empty()) {
+        std::cout << "NO DEVICE MEMORY LEAKED" << std::endl;
+        return;
+    }
+    uint32_t tagAllocations[MEMORY_TAG_COUNT] = {};
+    for (auto &allocation : allocations) {
+        tagAllocations[allocation.second.tag]++;
+    }
+    std::cout << "DEVICE MEMORY LEAKED: " << allocations.size() << " allocations,";
+    for (uint32_t tag = 0; tag < MEMORY_TAG_COUNT; ++tag) {
+        if (tagAllocations[tag] == 0) continue;
+        std::cout << " " << memoryTagName((MemoryTag) tag) << " " << tagAllocations[tag] << " (" << tagUsages[tag]
+                  << " bytes)";
+    }
+    std::cout << std::endl;
+}
+
+int DeviceMemoryTracker::memoryTypeIndex(uint32_t memoryTypeBits, VkMemoryPropertyFlags propertyFlags) const {
+    const VkPhysicalDeviceMemoryProperties &memoryProperties = deviceContext.physicalDeviceInfo.memoryProperties;
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i) {
+        if ((memoryTypeBits & (1u << i)) && (memoryProperties.memoryTypes[i].propertyFlags & propertyFlags) == propertyFlags) {
+            return (int) i;
+        }
+    }
+    return -1;
+}
+
+void DeviceMemoryTracker::evict(uint32_t heapIndex, VkDeviceSize targetUsage) {
+    evictionHandlers.evict(heapIndex, targetUsage, [this, heapIndex]() { return projectedUsage(heapIndex); });
+}
+
+VkDeviceSize DeviceMemoryTracker::projectedUsage(uint32_t heapIndex) const {
+    return heaps[heapIndex].trackedUsage + heaps[heapIndex].untrackedUsage;
+}
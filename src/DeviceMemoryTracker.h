@@ -0,0 +1,139 @@
+#ifndef VULKANBASE_DEVICEMEMORYTRACKER_H
+#define VULKANBASE_DEVICEMEMORYTRACKER_H
+
+#define GLFW_INCLUDE_VULKAN
+
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <unordered_map>
+#include "DeviceContext.h"
+#include "EvictionHandlers.h"
+
+//What an allocation is for, only used for the statistics
+enum MemoryTag : uint32_t {
+    //Vertex, index, patch and culling buffers
+    MEMORY_TAG_TERRAIN,
+    //Sampled images, like the heightmap and its bounds
+    MEMORY_TAG_TEXTURES,
+    MEMORY_TAG_UNIFORMS,
+    MEMORY_TAG_STAGING,
+    //Depth and Hi-Z, recreated with the swapchain
+    MEMORY_TAG_ATTACHMENTS,
+    MEMORY_TAG_COUNT
+};
+
+const char *memoryTagName(MemoryTag tag);
+
+/*
+ * Every vkAllocateMemory and vkFreeMemory goes through here, so the usage of each heap and tag is known.
+ * The budget of a heap comes from VK_EXT_memory_budget when the device has it, a fraction of the heap size otherwise.
+ * An allocation that would go over the budget first asks the eviction handlers to release memory of that heap, and
+ * only then allocates, over budget if nothing could be released. When the driver still refuses, the handlers are
+ * asked once more for the whole size before the allocation throws.
+ * Not thread safe, allocate and free from the thread that owns the device resources.
+ */
+class DeviceMemoryTracker {
+public:
+    struct HeapStatistics {
+        VkDeviceSize size;
+        VkDeviceSize budget;
+        //Tracked allocations plus what the process used outside of the tracker when the budget was last queried
+        VkDeviceSize usage;
+        VkDeviceSize trackedUsage;
+        VkDeviceSize peakTrackedUsage;
+        uint32_t allocationCount;
+        bool deviceLocal;
+    };
+
+    /*
+     * Frees memory of the heap through vulkanFree, see EvictionHandlers::Handler
+     */
+    using EvictionHandler = EvictionHandlers::Handler;
+
+    //Used as budget when the device does not report one
+    float fallbackBudgetFraction = 0.8f;
+
+    explicit DeviceMemoryTracker(const DeviceContext &deviceContext);
+
+    /*
+     * Throws if no memory type has the properties or if the driver is out of memory after evicting
+     */
+    VkDeviceMemory vulkanAllocate(const VkMemoryRequirements &memoryRequirements, VkMemoryPropertyFlags propertyFlags,
+                                  MemoryTag tag);
+
+    /*
+     * Null handles are ignored
+     */
+    void vulkanFree(VkDeviceMemory deviceMemory);
+
+    /*
+     * Refresh the budget and the untracked usage, the driver only updates them at submits and allocations
+     */
+    void vulkanUpdateBudget();
+
+    uint32_t addEvictionHandler(EvictionHandler handler);
+
+    void removeEvictionHandler(uint32_t handlerId);
+
+    /*
+     * Heap the memory type chosen for these requirements lives in, throws like vulkanAllocate when there is none
+     */
+    uint32_t heapIndex(uint32_t memoryTypeBits, VkMemoryPropertyFlags propertyFlags) const;
+
+    /*
+     * Bytes left before the heap goes over budget, streaming systems should stop growing when it gets low
+     */
+    VkDeviceSize availableBytes(uint32_t heapIndex) const;
+
+    uint32_t heapCount() const;
+
+    HeapStatistics heapStatistics(uint32_t heapIndex) const;
+
+    VkDeviceSize tagUsage(MemoryTag tag) const;
+
+    bool budgetSupported() const;
+
+    /*
+     * Print the heaps and tags to the console, queries the budget first
+     */
+    void vulkanReport();
+
+    /*
+     * Print the allocations still alive by tag, meant for shutdown once everything owned was freed
+     */
+    void reportLeaks() const;
+
+private:
+    struct Allocation {
+        VkDeviceSize size;
+        uint32_t heapIndex;
+        MemoryTag tag;
+    };
+
+    struct Heap {
+        VkDeviceSize budget = 0;
+        VkDeviceSize untrackedUsage = 0;
+        VkDeviceSize trackedUsage = 0;
+        VkDeviceSize peakTrackedUsage = 0;
+        uint32_t allocationCount = 0;
+    };
+
+    const DeviceContext &deviceContext;
+    std::vector<Heap> heaps;
+    VkDeviceSize tagUsages[MEMORY_TAG_COUNT] = {};
+    std::unordered_map<VkDeviceMemory, Allocation> allocations;
+    EvictionHandlers evictionHandlers;
+    uint32_t overBudgetAllocations = 0;
+
+    int memoryTypeIndex(uint32_t memoryTypeBits, VkMemoryPropertyFlags propertyFlags) const;
+
+    /*
+     * Ask the handlers, in the order they were added, until the usage of the heap is down to the target
+     */
+    void evict(uint32_t heapIndex, VkDeviceSize targetUsage);
+
+    VkDeviceSize projectedUsage(uint32_t heapIndex) const;
+};
+
+
+#endif //VULKANBASE_DEVICEMEMORYTRACKER_H
@@ -0,0 +1,26 @@
+#include "EvictionHandlers.h"
+
+uint32_t EvictionHandlers::add(Handler handler) {
+    handlers.emplace_back(nextHandlerId, std::move(handler));
+    return nextHandlerId++;
+}
+
+void EvictionHandlers::remove(uint32_t handlerId) {
+    for (auto handler = handlers.begin(); handler != handlers.end(); ++handler) {
+        if (handler->first == handlerId) {
+            handlers.erase(handler);
+            return;
+        }
+    }
+}
+
+void EvictionHandlers::evict(uint32_t heapIndex, uint64_t targetUsage, const std::function<uint64_t()> &usage) const {
+    for (auto &handler : handlers) {
+        while (usage() > targetUsage) {
+            uint64_t usageBefore = usage();
+            handler.second(heapIndex, usageBefore - targetUsage);
+            if (usage() >= usageBefore) break;
+        }
+        if (usage() <= targetUsage) return;
+    }
+}
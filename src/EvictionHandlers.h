@@ -0,0 +1,38 @@
+#ifndef VULKANBASE_EVICTIONHANDLERS_H
+#define VULKANBASE_EVICTIONHANDLERS_H
+
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+/*
+ * The eviction handlers of the device memory heaps and the order they are asked in, kept apart from the Vulkan calls
+ * so the policy runs without a device
+ */
+class EvictionHandlers {
+public:
+    /*
+     * Called with the heap and the bytes to release, must free memory of that heap through its allocator.
+     * Only memory the GPU is done with may be freed, and no handler may be added or removed from inside one.
+     * Returning without freeing anything stops asking that handler for the current eviction.
+     */
+    using Handler = std::function<void(uint32_t heapIndex, uint64_t bytes)>;
+
+    uint32_t add(Handler handler);
+
+    void remove(uint32_t handlerId);
+
+    /*
+     * Ask the handlers, in the order they were added, until the usage of the heap is down to the target.
+     * A handler is asked again as long as each call lowers the usage.
+     */
+    void evict(uint32_t heapIndex, uint64_t targetUsage, const std::function<uint64_t()> &usage) const;
+
+private:
+    std::vector<std::pair<uint32_t, Handler>> handlers;
+    uint32_t nextHandlerId = 0;
+};
+
+
+#endif //VULKANBASE_EVICTIONHANDLERS_H
@@ -1,9 +1,12 @@
 #include "Bitmap.h"
+#include "BitmapKernels.h"
+#include "ImageOpGraph.h"
 #include <string>
 #include <fstream>
 #include <iostream>
 #include <cmath>
 #include <cstring>
+#include <utility>
 
 using namespace std;
 
@@ -38,7 +41,7 @@ void Bitmap::closeFile(fstream &file) {
     file.close();
 }
 
-void Bitmap::loadFileHeader(fstream &file) {
+void Bitmap::loadFileHeader(istream &file) {
     file.read(reinterpret_cast<char *>(&fileHeader.BfType), 2);
     file.read(reinterpret_cast<char *>(&fileHeader.BfSize), 4);
     file.read(reinterpret_cast<char *>(&fileHeader.BfReser1), 2);
@@ -46,7 +49,7 @@ void Bitmap::loadFileHeader(fstream &file) {
     file.read(reinterpret_cast<char *>(&fileHeader.BfOffSetBits), 4);
 }
 
-void Bitmap::loadBitmapHeader(fstream &file) {
+void Bitmap::loadBitmapHeader(istream &file) {
     file.read(reinterpret_cast<char *>(&bitmapHeader.BiSize), 4);
     file.read(reinterpret_cast<char *>(&bitmapHeader.BiWidth), 4);
     file.read(reinterpret_cast<char *>(&bitmapHeader.BiHeight), 4);
@@ -60,13 +63,13 @@ void Bitmap::loadBitmapHeader(fstream &file) {
     file.read(reinterpret_cast<char *>(&bitmapHeader.BiClrImpor), 4);
 }
 
-bool Bitmap::checkColorPallete(fstream &file) {
+bool Bitmap::checkColorPallete(istream &file) {
     if (bitmapHeader.BiBitCount < 24)
         return true;
     return false;
 }
 
-void Bitmap::loadColorPallete(fstream &file) {
+void Bitmap::loadColorPallete(istream &file) {
     int palleteCount = pow(2, bitmapHeader.BiBitCount);
     colorPallete = new glm::vec4[palleteCount];
     unsigned char pallete[4];
@@ -88,73 +91,154 @@ glm::vec4 Bitmap::getPixelFromPallete(const unsigned char pixelValue) {
     return p;
 }
 
-void Bitmap::loadImage(fstream &file) {
-    file.clear();
-    file.seekg(fileHeader.BfOffSetBits, ios::beg);
-    int rowSize = std::ceil((bitmapHeader.BiBitCount * bitmapHeader.BiWidth) / 32) * 4;
-    int padding = rowSize - (bitmapHeader.BiBitCount / 8 * bitmapHeader.BiWidth);
-    int bitmapSize = bitmapHeader.BiWidth * bitmapHeader.BiHeight;
-    unsigned char *byteArray = new unsigned char[rowSize];
+void Bitmap::loadImage(istream &file) {
+    //Rows are decoded straight into the current image
+    class ImageSink : public BitmapSink {
+    public:
+        glm::vec4 *pixels;
+        uint32_t width = 0;
 
-    bitmapArray = new glm::vec4[bitmapSize + 1];
+        void begin(uint32_t width, uint32_t height) override {
+            this->width = width;
+        }
 
+        uint32_t acquireRows(uint32_t firstRow, uint32_t rowCount, glm::vec4 *&rows) override {
+            rows = pixels + (size_t) firstRow * width;
+            return rowCount;
+        }
+
+        void commitRows(uint32_t firstRow, uint32_t rowCount) override {}
+    };
+
+    int bitmapSize = bitmapHeader.BiWidth * bitmapHeader.BiHeight;
+    reserveBitmap(bitmapSize);
     cout << "Bitmap size:" << bitmapSize << endl;
-    cout << "Row Size:" << rowSize << endl;
-    cout << "Padding:" << padding << endl;
 
-    if (colorPalleteExists) {
-        for (int l = 0; l < bitmapHeader.BiHeight; l++) {
-            file.read(reinterpret_cast<char *>(byteArray), rowSize);
+    ImageSink sink;
+    sink.pixels = bitmapArray;
+    streamImage(file, sink);
 
-            for (int i = 0; i <= rowSize - padding; i++) {
+    originalBitmapArray = new glm::vec4[bitmapSize];
+    std::memcpy(originalBitmapArray, bitmapArray, bitmapSize * sizeof(glm::vec4));
+}
 
-                if (bitmapHeader.BiBitCount == 1) {
-                    for (int j = 0; j < 8; j++) {
+Bitmap::Bitmap() {}
 
-                        unsigned char pixelValue = (byteArray[i] << j) >> 7;
+bool Bitmap::decode(const string fileName, BitmapSink &sink) {
+    fstream file;
+    file.open(fileName, fstream::in | fstream::binary);
+    if (!file.is_open())
+        return false;
+    return decodeStream(file, sink);
+}
 
-                        bitmapArray[l * bitmapHeader.BiWidth + i + j] = getPixelFromPallete(pixelValue) / 255.f;
-                    }
-                }
-                if (bitmapHeader.BiBitCount == 4) {
-                    for (int j = 0; j < 2; j++) {
+namespace {
+    //Read only stream over a buffer, seekable so the header parsing works as it does on a file
+    class MemoryStreamBuffer : public std::streambuf {
+    public:
+        MemoryStreamBuffer(const uint8_t *data, size_t size) {
+            char *begin = const_cast<char *>(reinterpret_cast<const char *>(data));
+            setg(begin, begin, begin + size);
+        }
 
-                        unsigned char pixelValue = (byteArray[i] << j) >> 4;
-                        bitmapArray[l * bitmapHeader.BiWidth + i + j] = getPixelFromPallete(pixelValue) / 255.f;
-                    }
-                }
-                if (bitmapHeader.BiBitCount == 8) {
+    protected:
+        pos_type seekoff(off_type offset, ios_base::seekdir direction, ios_base::openmode which) override {
+            off_type base = direction == ios_base::beg ? 0 : direction == ios_base::cur ? gptr() - eback() : egptr() - eback();
+            return seekpos(pos_type(base + offset), which);
+        }
 
-                    unsigned char pixelValue = byteArray[i];
-                    bitmapArray[l * bitmapHeader.BiWidth + i] = getPixelFromPallete(pixelValue) / 255.f;
-                }
-            }
+        pos_type seekpos(pos_type position, ios_base::openmode which) override {
+            off_type offset = off_type(position);
+            if (!(which & ios_base::in) || offset < 0 || offset > egptr() - eback()) return pos_type(off_type(-1));
+            setg(eback(), eback() + offset, egptr());
+            return position;
         }
-    } else {
-
-        for (int l = 0; l < bitmapHeader.BiHeight; l++) {
-            file.read(reinterpret_cast<char *>(byteArray), rowSize);
-            for (int i = 0, j = 0; i <= rowSize - padding - 3; i += (int) (bitmapHeader.BiBitCount / 8), j++) {
-                glm::vec4 p;
-                if (bitmapHeader.BiBitCount == 24) {
-                    p[0] = byteArray[i + 2];
-                    p[1] = byteArray[i + 1];
-                    p[2] = byteArray[i + 0];
-                    p[3] = 255;
-                } else {
-                    p[0] = byteArray[i + 2];
-                    p[1] = byteArray[i + 1];
-                    p[2] = byteArray[i + 0];
-                    p[3] = byteArray[i + 3];
-                }
-
-                bitmapArray[l * bitmapHeader.BiWidth + j] = p / 255.f;
-            }
+    };
+}
+
+bool Bitmap::decode(const uint8_t *data, size_t size, BitmapSink &sink) {
+    MemoryStreamBuffer buffer(data, size);
+    istream stream(&buffer);
+    return decodeStream(stream, sink);
+}
+
+bool Bitmap::decodeStream(istream &file, BitmapSink &sink) {
+    Bitmap bitmap;
+    bitmap.loadFileHeader(file);
+    bitmap.loadBitmapHeader(file);
+    //Only what streamImage can read: "BM", bottom up rows, uncompressed or 32 bits with the usual masks
+    short bitCount = bitmap.bitmapHeader.BiBitCount;
+    if (!file || bitmap.fileHeader.BfType != 0x4D42 || bitmap.bitmapHeader.BiWidth <= 0 ||
+        bitmap.bitmapHeader.BiHeight <= 0 ||
+        (bitCount != 1 && bitCount != 4 && bitCount != 8 && bitCount != 24 && bitCount != 32) ||
+        (bitmap.bitmapHeader.BiCompress != 0 && bitmap.bitmapHeader.BiCompress != 3)) {
+        return false;
+    }
+    bitmap.colorPalleteExists = bitmap.checkColorPallete(file);
+    if (bitmap.colorPalleteExists) {
+        bitmap.loadColorPallete(file);
+    }
+    bitmap.streamImage(file, sink);
+    delete[] bitmap.colorPallete;
+    return true;
+}
+
+void Bitmap::streamImage(istream &file, BitmapSink &sink) {
+    file.clear();
+    file.seekg(fileHeader.BfOffSetBits, ios::beg);
+    uint32_t width = bitmapHeader.BiWidth;
+    uint32_t height = bitmapHeader.BiHeight;
+    //Rows are padded to 4 bytes
+    int rowSize = (bitmapHeader.BiBitCount * bitmapHeader.BiWidth + 31) / 32 * 4;
+    unsigned char *byteRow = new unsigned char[rowSize];
+
+    sink.begin(width, height);
+    for (uint32_t l = 0; l < height;) {
+        glm::vec4 *rows;
+        uint32_t rowCount = sink.acquireRows(l, height - l, rows);
+        for (uint32_t r = 0; r < rowCount; r++) {
+            file.read(reinterpret_cast<char *>(byteRow), rowSize);
+            decodeRow(byteRow, rows + (size_t) r * width);
         }
+        sink.commitRows(l, rowCount);
+        l += rowCount;
     }
+    delete[] byteRow;
+}
 
-    originalBitmapArray = new glm::vec4[bitmapSize + 1];
-    std::memcpy(originalBitmapArray, bitmapArray, bitmapSize * sizeof(glm::vec4));
+void Bitmap::decodeRow(const unsigned char *byteRow, glm::vec4 *row) const {
+    int width = bitmapHeader.BiWidth;
+    switch (bitmapHeader.BiBitCount) {
+        case 1:
+            for (int c = 0; c < width; c++) {
+                unsigned char pixelValue = (byteRow[c >> 3] >> (7 - (c & 7))) & 1;
+                row[c] = colorPallete[pixelValue] / 255.f;
+            }
+            break;
+        case 4:
+            for (int c = 0; c < width; c++) {
+                unsigned char pixelValue = (byteRow[c >> 1] >> ((c & 1) ? 0 : 4)) & 15;
+                row[c] = colorPallete[pixelValue] / 255.f;
+            }
+            break;
+        case 8:
+            for (int c = 0; c < width; c++) {
+                row[c] = colorPallete[byteRow[c]] / 255.f;
+            }
+            break;
+        case 24:
+            for (int c = 0; c < width; c++) {
+                const unsigned char *p = byteRow + c * 3;
+                row[c] = glm::vec4(p[2], p[1], p[0], 255) / 255.f;
+            }
+            break;
+        default:
+            for (int c = 0; c < width; c++) {
+                const unsigned char *p = byteRow + c * 4;
+                row[c] = glm::vec4(p[2], p[1], p[0], p[3]) / 255.f;
+            }
+            break;
+    }
 }
 
 glm::vec4 Bitmap::getPixelColorAtPosition(const int l, const int c) const {
@@ -176,29 +260,32 @@ void Bitmap::scaleImage(const float scale) {
     lastScale = scale;
 }
 
+void Bitmap::setThreadPool(ThreadPool *threadPool) {
+    this->threadPool = threadPool;
+}
+
+void Bitmap::reserveBitmap(size_t pixelCount) {
+    if (bitmapCapacity >= pixelCount) return;
+    delete[] bitmapArray;
+    bitmapArray = new glm::vec4[pixelCount];
+    bitmapCapacity = pixelCount;
+}
+
+void Bitmap::reserveScratch(size_t pixelCount) {
+    if (scratchCapacity >= pixelCount) return;
+    delete[] scratchArray;
+    scratchArray = new glm::vec4[pixelCount];
+    scratchCapacity = pixelCount;
+}
+
 void Bitmap::_scaleImage(const float scale) {
     int oldHeight = this->bitmapHeader.BiHeight;
     int oldWidth = this->bitmapHeader.BiWidth;
     this->height = oldHeight * scale;
     this->width = oldWidth * scale;
-    glm::vec4 *newBitmapArray = new glm::vec4[height * width];
-    for (int l = 0; l < height; l++) {
-        for (int c = 0; c < width; c++) {
-            int oldL = floor(l * (1 / scale));
-            int oldC = floor(c * (1 / scale));
-            int oldIdx = oldL * oldWidth + oldC;
-            glm::vec4 color = originalBitmapArray[oldIdx];
-
-            int idx = l * width + c;
-            newBitmapArray[idx] = color;
-        }
-    }
-    if (bitmapArray != NULL) {
-        delete[] bitmapArray;
-        bitmapArray = NULL;
-    }
-
-    bitmapArray = newBitmapArray;
+    //Reads the original image, so the current one is overwritten and only grows when the result is larger
+    reserveBitmap((size_t) height * width);
+    BitmapKernels::scaleNearest(originalBitmapArray, oldWidth, oldHeight, bitmapArray, width, height, threadPool);
     lastScale = scale;
 }
 
@@ -207,15 +294,7 @@ void Bitmap::flipImageInX() {
 }
 
 void Bitmap::_flipImageInX() {
-    for (int l = 0; l < height; l++) {
-        for (int c = 0; c < width / 2; c++) {
-            int newIdx = l * width + (width - 1 - c);
-            int idx = l * width + c;
-            glm::vec4 tmp = bitmapArray[idx];
-            bitmapArray[idx] = bitmapArray[newIdx];
-            bitmapArray[newIdx] = tmp;
-        }
-    }
+    BitmapKernels::flipX(bitmapArray, width, height, threadPool);
 }
 
 void Bitmap::flipImageInY() {
@@ -223,15 +302,7 @@ void Bitmap::flipImageInY() {
 }
 
 void Bitmap::_flipImageInY() {
-    for (int l = 0; l < height / 2; l++) {
-        for (int c = 0; c < width; c++) {
-            int newIdx = (height - 1 - l) * width + c;
-            int idx = l * width + c;
-            glm::vec4 tmp = bitmapArray[idx];
-            bitmapArray[idx] = bitmapArray[newIdx];
-            bitmapArray[newIdx] = tmp;
-        }
-    }
+    BitmapKernels::flipY(bitmapArray, width, height, threadPool);
 }
 
 void Bitmap::rotateImage(const float angle) {
@@ -245,33 +316,14 @@ void Bitmap::nearestNeighbourRotation(const float angle) {
 void Bitmap::_nearestNeighbourRotation(const float angle) {
 
     int diagonal = ceil(sqrt((width * width) + (height * height)));
-    glm::vec4 *newBitmapArray = new glm::vec4[diagonal * diagonal];
-    for (int l = 0; l < diagonal; l++) {
-        for (int c = 0; c < diagonal; c++) {
-            float translatedC = c - diagonal / 2;
-            float translatedL = l - diagonal / 2;
-            float newC = (translatedC * cos(-angle) + translatedL * sin(-angle));
-            float newL = ((-translatedC * sin(-angle)) + translatedL * cos(-angle));
-            glm::vec2 pos = {newC + width / 2, newL + height / 2};
-
-            int idx = l * diagonal + c;
-            glm::vec4 color;
-            if (pos.x < 0 || pos.x >= width || pos.y < 0 || pos.y >= height) {
-                color[0] = 0;
-                color[1] = 0;
-                color[2] = 0;
-                color[3] = 255;
-                newBitmapArray[idx] = color;
-                continue;
-            }
-            color = getPixelColorAtPosition(pos.y, pos.x);
-            newBitmapArray[idx] = color;
-        }
-    }
-    delete[] bitmapArray;
+    reserveScratch((size_t) diagonal * diagonal);
+    BitmapKernels::rotateNearest(bitmapArray, width, height, scratchArray, diagonal, diagonal, angle,
+                                 glm::vec4(0, 0, 0, 255), threadPool);
+    //The rotated image becomes the current one, the previous one is kept as the next scratch
+    std::swap(bitmapArray, scratchArray);
+    std::swap(bitmapCapacity, scratchCapacity);
     width = diagonal;
     height = diagonal;
-    bitmapArray = newBitmapArray;
     lastRotation = angle;
 }
 
@@ -280,19 +332,7 @@ void Bitmap::convertImageToGrayScale() {
 }
 
 void Bitmap::_convertImageToGrayScale() {
-    for (int l = 0; l < height; l++) {
-        for (int c = 0; c < width; c++) {
-            int idx = l * width + c;
-
-            float grayScaleColor =
-                    bitmapArray[idx][0] * 0.299 + bitmapArray[idx][1] * 0.587 + bitmapArray[idx][2] * 0.114;
-            glm::vec4 color;
-            color[0] = grayScaleColor;
-            color[1] = grayScaleColor;
-            color[2] = grayScaleColor;
-            bitmapArray[idx] = color;
-        }
-    }
+    BitmapKernels::grayscale(bitmapArray, width, height, threadPool);
 }
 
 //int *Bitmap::getHistogramForChannel(const Channel c) const {
@@ -325,52 +365,51 @@ void Bitmap::_convertImageToGrayScale() {
 //    }
 //}
 
-//void Bitmap::applyTransformations(bool applyScale, bool applyRotation, bool applyFilters) {
-//    resetImage();
-//    if (applyScale)
-//        _scaleImage(lastScale);
-//    if (applyRotation) {
-//        _nearestNeighbourRotation(lastRotation);
-//    }
-//    if (applyFilters) {
-//        for (int i = 0; i < filters.size(); i++) {
-//            Filter f = filters[i];
-//
-//            if (f == Filter::FlipX)
-//                _flipImageInX();
-//            if (f == Filter::FlipY)
-//                _flipImageInY();
-//            if (f == Filter::Greyscale)
-//                _convertImageToGrayScale();
-//            if (f == Filter::RedC)
-//                _convertToSingleChannel(Channel::Red);
-//            if (f == Filter::GreenC)
-//                _convertToSingleChannel(Channel::Green);
-//            if (f == Filter::BlueC)
-//                _convertToSingleChannel(Channel::Blue);
-//        }
-//    }
-//}
-
-void Bitmap::resetImage() {
-    if (bitmapArray != NULL) {
-        delete[] bitmapArray;
-        bitmapArray = NULL;
+ImageOpGraph Bitmap::transformations(bool applyScale, bool applyRotation, bool applyFilters) const {
+    ImageOpGraph graph(originalBitmapArray, bitmapHeader.BiWidth, bitmapHeader.BiHeight);
+    if (applyScale)
+        graph.scale(lastScale);
+    if (applyRotation)
+        graph.rotate(lastRotation, glm::vec4(0, 0, 0, 255));
+    if (applyFilters) {
+        for (int i = 0; i < filters.size(); i++) {
+            Filter f = filters[i];
+
+            if (f == Filter::FlipX)
+                graph.flipX();
+            if (f == Filter::FlipY)
+                graph.flipY();
+            if (f == Filter::Greyscale)
+                graph.grayscale();
+            if (f == Filter::RedC)
+                graph.keepChannel(0);
+            if (f == Filter::GreenC)
+                graph.keepChannel(1);
+            if (f == Filter::BlueC)
+                graph.keepChannel(2);
+        }
     }
+    return graph;
+}
+
+void Bitmap::applyTransformations(bool applyScale, bool applyRotation, bool applyFilters) {
+    //One pass from the original image, no intermediate image per transform
+    ImageOpGraph graph = transformations(applyScale, applyRotation, applyFilters);
+    width = graph.getWidth();
+    height = graph.getHeight();
+    reserveBitmap((size_t) width * height);
+    graph.evaluate(0, 0, width, height, bitmapArray, width, threadPool);
+}
 
-    bitmapArray = new glm::vec4[bitmapHeader.BiHeight * bitmapHeader.BiWidth];
+void Bitmap::resetImage() {
+    reserveBitmap((size_t) bitmapHeader.BiHeight * bitmapHeader.BiWidth);
     memcpy(bitmapArray, originalBitmapArray, sizeof(glm::vec4) * bitmapHeader.BiHeight * bitmapHeader.BiWidth);
     this->height = bitmapHeader.BiHeight;
     this->width = bitmapHeader.BiWidth;
 }
 
 void Bitmap::resetImageToDefault() {
-    if (bitmapArray != NULL) {
-        delete[] bitmapArray;
-        bitmapArray = NULL;
-    }
-
-    bitmapArray = new glm::vec4[bitmapHeader.BiHeight * bitmapHeader.BiWidth];
+    reserveBitmap((size_t) bitmapHeader.BiHeight * bitmapHeader.BiWidth);
     memcpy(bitmapArray, originalBitmapArray, sizeof(glm::vec4) * bitmapHeader.BiHeight * bitmapHeader.BiWidth);
     this->height = bitmapHeader.BiHeight;
     this->width = bitmapHeader.BiWidth;
@@ -16,13 +16,17 @@
 #define BITMAP_H
 
 #include <string>
+#include <cstdint>
 #include <vector>
 #include <fstream>
 #include <iostream>
+#include <cstddef>
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
 #include <glm/vec2.hpp>
+#include "ImageOpGraph.h"
 
+class ThreadPool;
 
 class FileHeader {
 public:
@@ -79,6 +83,37 @@ enum Filter {
     BlueC
 };
 
+/*
+ * Receives the rows of a bitmap while the file is read, so they can go straight to where they are used (a mapped
+ * staging buffer, a height plane) without the whole decoded image being held in memory.
+ * Rows come in file order, bottom row first, like Bitmap::originalBitmapArray.
+ */
+class BitmapSink {
+public:
+    virtual ~BitmapSink() = default;
+
+    //Called once with the image size, before any row
+    virtual void begin(uint32_t width, uint32_t height) = 0;
+
+    //Memory for up to rowCount tightly packed rows starting at firstRow, returns how many it takes, at least one
+    virtual uint32_t acquireRows(uint32_t firstRow, uint32_t rowCount, glm::vec4 *&rows) = 0;
+
+    /*
+     * For decoders of height only images that produce their rows on worker threads: memory for up to rowCount rows
+     * starting at firstRow and, when the sink keeps heights, the matching rows of its height plane (null otherwise).
+     * The decoder writes both from any thread and never reads them, so they may be write combined staging memory.
+     * Returns how many rows it takes, at least one, whole tile rows are decompressed once when it takes them all.
+     * By default the memory of acquireRows and no heights.
+     */
+    virtual uint32_t acquireHeightRows(uint32_t firstRow, uint32_t rowCount, glm::vec4 *&rows, float *&heights) {
+        heights = nullptr;
+        return acquireRows(firstRow, rowCount, rows);
+    }
+
+    //The rows of the last acquireRows or acquireHeightRows are decoded
+    virtual void commitRows(uint32_t firstRow, uint32_t rowCount) = 0;
+};
+
 class Bitmap {
 public:
     std::string fileName;
@@ -87,6 +122,12 @@ public:
 
     Bitmap(const std::string fileName);
 
+    //Decodes the file row by row into the sink, no image is kept. False when the file cannot be opened.
+    static bool decode(const std::string fileName, BitmapSink &sink);
+
+    //Same as above for a whole file already in memory
+    static bool decode(const uint8_t *data, size_t size, BitmapSink &sink);
+
     glm::vec4 sampleBitmao(const float u, const float v) const;
 
     glm::vec4 getPixelColorAtPosition(const int l, const int c) const;
@@ -109,8 +150,14 @@ public:
 
     void applyTransformations(bool applyScale, bool applyRotation, bool applyFilters);
 
+    //Transforms of applyTransformations over the original image, evaluated only for the regions asked of it
+    ImageOpGraph transformations(bool applyScale, bool applyRotation, bool applyFilters) const;
+
     void resetImageToDefault();
 
+    //Splits the transforms across the pool, null runs them on the calling thread
+    void setThreadPool(ThreadPool *threadPool);
+
 //    int *getHistogramForChannel(const Channel c) const;
 
 
@@ -118,8 +165,13 @@ public:
 private:
     FileHeader fileHeader;
     BitmapHeader bitmapHeader;
-    glm::vec4 *colorPallete;
-    glm::vec4 *bitmapArray;
+    glm::vec4 *colorPallete = NULL;
+    glm::vec4 *bitmapArray = NULL;
+    size_t bitmapCapacity = 0;
+    //Destination of the transforms that cannot work in place, swapped with bitmapArray afterwards
+    glm::vec4 *scratchArray = NULL;
+    size_t scratchCapacity = 0;
+    ThreadPool *threadPool = NULL;
     bool colorPalleteExists;
     float imageRotation;
 
@@ -141,23 +193,35 @@ private:
 
     void resetImage();
 
+    void reserveBitmap(size_t pixelCount);
+
+    void reserveScratch(size_t pixelCount);
+
     void openFile(const std::string filename, std::fstream &file);
 
     void closeFile(std::fstream &file);
 
-    void loadFileHeader(std::fstream &file);
+    void loadFileHeader(std::istream &file);
+
+    void loadBitmapHeader(std::istream &file);
 
-    void loadBitmapHeader(std::fstream &file);
+    bool checkColorPallete(std::istream &file);
 
-    bool checkColorPallete(std::fstream &file);
+    void loadColorPallete(std::istream &file);
 
-    void loadColorPallete(std::fstream &file);
+    void loadImage(std::istream &file);
 
-    void loadImage(std::fstream &file);
+    void streamImage(std::istream &file, BitmapSink &sink);
+
+    static bool decodeStream(std::istream &file, BitmapSink &sink);
+
+    void decodeRow(const unsigned char *byteRow, glm::vec4 *row) const;
 
     glm::vec4 getPixelFromPallete(const unsigned char pixelValue);
 
     Bitmap(const int width, const int height);
+
+    Bitmap();
 };
 
 #endif
\ No newline at end of file
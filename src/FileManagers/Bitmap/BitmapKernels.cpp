@@ -0,0 +1,216 @@
+#include "BitmapKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+
+#if defined(__SSE2__)
+
+#include <emmintrin.h>
+
+#endif
+
+namespace {
+    //Square tiles of the rotation, a tile row of the destination is one task
+    const uint32_t ROTATION_TILE = 64;
+
+    void forRowTiles(uint32_t rows, ThreadPool *threadPool, const std::function<void(uint32_t, uint32_t)> &body) {
+        if (threadPool != nullptr && rows > BitmapKernels::TILE_ROWS) {
+            threadPool->parallelFor(rows, BitmapKernels::TILE_ROWS, body);
+        } else {
+            body(0, rows);
+        }
+    }
+}
+
+uint32_t BitmapKernels::packRGBA8(glm::vec4 color) {
+    glm::vec4 scaled = glm::round(glm::clamp(color, glm::vec4(0), glm::vec4(1)) * 255.0f);
+    return (uint32_t) scaled.r | (uint32_t) scaled.g << 8 | (uint32_t) scaled.b << 16 | (uint32_t) scaled.a << 24;
+}
+
+glm::vec4 BitmapKernels::unpackRGBA8(uint32_t color) {
+    return glm::vec4(color & 0xFF, (color >> 8) & 0xFF, (color >> 16) & 0xFF, color >> 24) / 255.0f;
+}
+
+void BitmapKernels::packRGBA8(const glm::vec4 *source, uint32_t *destination, uint32_t width, uint32_t height,
+                              ThreadPool *threadPool) {
+    forRowTiles(height, threadPool, [&](uint32_t rowBegin, uint32_t rowEnd) {
+        size_t i = (size_t) rowBegin * width, end = (size_t) rowEnd * width;
+#if defined(__SSE2__)
+        //Four pixels of four channels become 16 bytes: convert, then saturate down to 16 and to 8 bits
+        const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), scale = _mm_set1_ps(255.0f);
+        for (; i + 4 <= end; i += 4) {
+            __m128i c[4];
+            for (int k = 0; k < 4; ++k) {
+                __m128 color = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(&source[i + k].x), zero), one);
+                c[k] = _mm_cvtps_epi32(_mm_mul_ps(color, scale));
+            }
+            __m128i packed = _mm_packus_epi16(_mm_packs_epi32(c[0], c[1]), _mm_packs_epi32(c[2], c[3]));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(destination + i), packed);
+        }
+#endif
+        for (; i < end; ++i) {
+            destination[i] = packRGBA8(source[i]);
+        }
+    });
+}
+
+template<typename Pixel>
+void BitmapKernels::flipX(Pixel *pixels, uint32_t width, uint32_t height, ThreadPool *threadPool) {
+    forRowTiles(height, threadPool, [&](uint32_t rowBegin, uint32_t rowEnd) {
+        for (uint32_t l = rowBegin; l < rowEnd; ++l) {
+            Pixel *row = pixels + (size_t) l * width;
+            std::reverse(row, row + width);
+        }
+    });
+}
+
+template<typename Pixel>
+void BitmapKernels::flipY(Pixel *pixels, uint32_t width, uint32_t height, ThreadPool *threadPool) {
+    //Only the top half is walked, each row is swapped with its mirror
+    forRowTiles(height / 2, threadPool, [&](uint32_t rowBegin, uint32_t rowEnd) {
+        for (uint32_t l = rowBegin; l < rowEnd; ++l) {
+            Pixel *row = pixels + (size_t) l * width;
+            Pixel *mirror = pixels + (size_t) (height - 1 - l) * width;
+            std::swap_ranges(row, row + width, mirror);
+        }
+    });
+}
+
+void BitmapKernels::grayscale(glm::vec4 *pixels, uint32_t width, uint32_t height, ThreadPool *threadPool) {
+    forRowTiles(height, threadPool, [&](uint32_t rowBegin, uint32_t rowEnd) {
+        size_t i = (size_t) rowBegin * width, end = (size_t) rowEnd * width;
+#if defined(__SSE2__)
+        //Four pixels are transposed so each register holds one channel of all of them
+        const __m128 red = _mm_set1_ps(0.299f), green = _mm_set1_ps(0.587f), blue = _mm_set1_ps(0.114f);
+        for (; i + 4 <= end; i += 4) {
+            __m128 p0 = _mm_loadu_ps(&pixels[i].x), p1 = _mm_loadu_ps(&pixels[i + 1].x);
+            __m128 p2 = _mm_loadu_ps(&pixels[i + 2].x), p3 = _mm_loadu_ps(&pixels[i + 3].x);
+            _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+            __m128 luminance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p0, red), _mm_mul_ps(p1, green)), _mm_mul_ps(p2, blue));
+            p0 = luminance;
+            p1 = luminance;
+            p2 = luminance;
+            _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+            _mm_storeu_ps(&pixels[i].x, p0);
+            _mm_storeu_ps(&pixels[i + 1].x, p1);
+            _mm_storeu_ps(&pixels[i + 2].x, p2);
+            _mm_storeu_ps(&pixels[i + 3].x, p3);
+        }
+#endif
+        for (; i < end; ++i) {
+            float luminance = pixels[i].r * 0.299f + pixels[i].g * 0.587f + pixels[i].b * 0.114f;
+            pixels[i] = glm::vec4(luminance, luminance, luminance, pixels[i].a);
+        }
+    });
+}
+
+void BitmapKernels::grayscale(uint32_t *pixels, uint32_t width, uint32_t height, ThreadPool *threadPool) {
+    //Weights in 8 bit fixed point, they add up to 256 so white stays white
+    const uint32_t redWeight = 77, greenWeight = 150, blueWeight = 29;
+    forRowTiles(height, threadPool, [&](uint32_t rowBegin, uint32_t rowEnd) {
+        size_t i = (size_t) rowBegin * width, end = (size_t) rowEnd * width;
+#if defined(__SSE2__)
+        //The channels are widened to 32 bit lanes, the 16 bit multiply is exact since the products fit in 16 bits
+        const __m128i channelMask = _mm_set1_epi32(0xFF), alphaMask = _mm_set1_epi32((int) 0xFF000000);
+        const __m128i red = _mm_set1_epi32(redWeight), green = _mm_set1_epi32(greenWeight), blue = _mm_set1_epi32(blueWeight);
+        const __m128i rounding = _mm_set1_epi32(128);
+        for (; i + 4 <= end; i += 4) {
+            __m128i color = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels + i));
+            __m128i r = _mm_and_si128(color, channelMask);
+            __m128i g = _mm_and_si128(_mm_srli_epi32(color, 8), channelMask);
+            __m128i b = _mm_and_si128(_mm_srli_epi32(color, 16), channelMask);
+            __m128i luminance = _mm_add_epi32(_mm_add_epi32(_mm_mullo_epi16(r, red), _mm_mullo_epi16(g, green)),
+                                              _mm_add_epi32(_mm_mullo_epi16(b, blue), rounding));
+            luminance = _mm_srli_epi32(luminance, 8);
+            __m128i gray = _mm_or_si128(_mm_or_si128(luminance, _mm_slli_epi32(luminance, 8)),
+                                        _mm_or_si128(_mm_slli_epi32(luminance, 16), _mm_and_si128(color, alphaMask)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(pixels + i), gray);
+        }
+#endif
+        for (; i < end; ++i) {
+            uint32_t color = pixels[i];
+            uint32_t luminance = ((color & 0xFF) * redWeight + ((color >> 8) & 0xFF) * greenWeight +
+                                  ((color >> 16) & 0xFF) * blueWeight + 128) >> 8;
+            pixels[i] = luminance | luminance << 8 | luminance << 16 | (color & 0xFF000000);
+        }
+    });
+}
+
+template<typename Pixel>
+void BitmapKernels::scaleNearest(const Pixel *source, uint32_t sourceWidth, uint32_t sourceHeight, Pixel *destination,
+                                 uint32_t destinationWidth, uint32_t destinationHeight, ThreadPool *threadPool) {
+    if (destinationWidth == 0 || destinationHeight == 0) return;
+    //Source pixels per destination pixel in 32.32 fixed point, so the integer part is floor(c * source / destination)
+    uint64_t stepX = ((uint64_t) sourceWidth << 32) / destinationWidth;
+    uint64_t stepY = ((uint64_t) sourceHeight << 32) / destinationHeight;
+    forRowTiles(destinationHeight, threadPool, [&](uint32_t rowBegin, uint32_t rowEnd) {
+        for (uint32_t l = rowBegin; l < rowEnd; ++l) {
+            const Pixel *sourceRow = source + (size_t) ((l * stepY) >> 32) * sourceWidth;
+            Pixel *row = destination + (size_t) l * destinationWidth;
+            uint64_t sourceX = 0;
+            for (uint32_t c = 0; c < destinationWidth; ++c, sourceX += stepX) {
+                row[c] = sourceRow[sourceX >> 32];
+            }
+        }
+    });
+}
+
+template<typename Pixel>
+void BitmapKernels::rotateNearest(const Pixel *source, uint32_t sourceWidth, uint32_t sourceHeight, Pixel *destination,
+                                  uint32_t destinationWidth, uint32_t destinationHeight, float angle, Pixel background,
+                                  ThreadPool *threadPool) {
+    //Moving one destination column moves the source position by (cos, sin), one row by (-sin, cos).
+    //The steps are in double so the error accumulated along a row of thousands of pixels stays far below a pixel.
+    double cosine = std::cos((double) angle), sine = std::sin((double) angle);
+    double centerX = (double) (destinationWidth / 2), centerY = (double) (destinationHeight / 2);
+    double sourceCenterX = (double) (sourceWidth / 2), sourceCenterY = (double) (sourceHeight / 2);
+    uint32_t tileRows = (destinationHeight + ROTATION_TILE - 1) / ROTATION_TILE;
+
+    auto rotateTileRows = [&](uint32_t tileBegin, uint32_t tileEnd) {
+        for (uint32_t tileRow = tileBegin; tileRow < tileEnd; ++tileRow) {
+            uint32_t rowBegin = tileRow * ROTATION_TILE;
+            uint32_t rowEnd = std::min(rowBegin + ROTATION_TILE, destinationHeight);
+            for (uint32_t columnBegin = 0; columnBegin < destinationWidth; columnBegin += ROTATION_TILE) {
+                uint32_t columnEnd = std::min(columnBegin + ROTATION_TILE, destinationWidth);
+                for (uint32_t l = rowBegin; l < rowEnd; ++l) {
+                    double translatedC = columnBegin - centerX, translatedL = l - centerY;
+                    double x = translatedC * cosine - translatedL * sine + sourceCenterX;
+                    double y = translatedC * sine + translatedL * cosine + sourceCenterY;
+                    Pixel *row = destination + (size_t) l * destinationWidth;
+                    for (uint32_t c = columnBegin; c < columnEnd; ++c, x += cosine, y += sine) {
+                        if (x < 0 || x >= sourceWidth || y < 0 || y >= sourceHeight) {
+                            row[c] = background;
+                        } else {
+                            row[c] = source[(size_t) y * sourceWidth + (size_t) x];
+                        }
+                    }
+                }
+            }
+        }
+    };
+    if (threadPool != nullptr && tileRows > 1) {
+        threadPool->parallelFor(tileRows, 1, rotateTileRows);
+    } else {
+        rotateTileRows(0, tileRows);
+    }
+}
+
+template void BitmapKernels::flipX<glm::vec4>(glm::vec4 *, uint32_t, uint32_t, ThreadPool *);
+
+template void BitmapKernels::flipX<uint32_t>(uint32_t *, uint32_t, uint32_t, ThreadPool *);
+
+template void BitmapKernels::flipY<glm::vec4>(glm::vec4 *, uint32_t, uint32_t, ThreadPool *);
+
+template void BitmapKernels::flipY<uint32_t>(uint32_t *, uint32_t, uint32_t, ThreadPool *);
+
+template void BitmapKernels::scaleNearest<glm::vec4>(const glm::vec4 *, uint32_t, uint32_t, glm::vec4 *, uint32_t, uint32_t,
+                                                     ThreadPool *);
+
+template void BitmapKernels::scaleNearest<uint32_t>(const uint32_t *, uint32_t, uint32_t, uint32_t *, uint32_t, uint32_t,
+                                                    ThreadPool *);
+
+template void BitmapKernels::rotateNearest<glm::vec4>(const glm::vec4 *, uint32_t, uint32_t, glm::vec4 *, uint32_t, uint32_t,
+                                                      float, glm::vec4, ThreadPool *);
+
+template void BitmapKernels::rotateNearest<uint32_t>(const uint32_t *, uint32_t, uint32_t, uint32_t *, uint32_t, uint32_t,
+                                                     float, uint32_t, ThreadPool *);
@@ -0,0 +1,63 @@
+#ifndef VULKANBASE_BITMAPKERNELS_H
+#define VULKANBASE_BITMAPKERNELS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <glm/vec4.hpp>
+#include "../../ThreadPool.h"
+
+/*
+ * Pixel transforms of the Bitmap over row major images, for float RGBA (glm::vec4) and packed RGBA8
+ * (r | g << 8 | b << 16 | a << 24, a quarter of the memory). Rows are split in tiles across the thread pool when
+ * one is given, without it everything runs on the calling thread. The transforms that keep the size work in place.
+ */
+namespace BitmapKernels {
+    //Rows handed to a task at once
+    const uint32_t TILE_ROWS = 32;
+
+    uint32_t packRGBA8(glm::vec4 color);
+
+    glm::vec4 unpackRGBA8(uint32_t color);
+
+    void packRGBA8(const glm::vec4 *source, uint32_t *destination, uint32_t width, uint32_t height,
+                   ThreadPool *threadPool = nullptr);
+
+    /*
+     * Mirror every row, in place
+     */
+    template<typename Pixel>
+    void flipX(Pixel *pixels, uint32_t width, uint32_t height, ThreadPool *threadPool = nullptr);
+
+    /*
+     * Swap the rows top to bottom, in place
+     */
+    template<typename Pixel>
+    void flipY(Pixel *pixels, uint32_t width, uint32_t height, ThreadPool *threadPool = nullptr);
+
+    /*
+     * Luminance with the Rec. 601 weights in the color channels, alpha is kept. In place.
+     */
+    void grayscale(glm::vec4 *pixels, uint32_t width, uint32_t height, ThreadPool *threadPool = nullptr);
+
+    void grayscale(uint32_t *pixels, uint32_t width, uint32_t height, ThreadPool *threadPool = nullptr);
+
+    /*
+     * Nearest neighbour resize, the source pixel of every destination row and column is stepped in 32.32 fixed point
+     */
+    template<typename Pixel>
+    void scaleNearest(const Pixel *source, uint32_t sourceWidth, uint32_t sourceHeight, Pixel *destination,
+                      uint32_t destinationWidth, uint32_t destinationHeight, ThreadPool *threadPool = nullptr);
+
+    /*
+     * Nearest neighbour rotation around the centers of both images, destination pixels outside the source get the
+     * background. The source position is stepped along each row instead of evaluating the rotation per pixel, and
+     * the destination is walked in square tiles so the rotated reads stay close in memory.
+     */
+    template<typename Pixel>
+    void rotateNearest(const Pixel *source, uint32_t sourceWidth, uint32_t sourceHeight, Pixel *destination,
+                       uint32_t destinationWidth, uint32_t destinationHeight, float angle, Pixel background,
+                       ThreadPool *threadPool = nullptr);
+}
+
+
+#endif //VULKANBASE_BITMAPKERNELS_H
@@ -0,0 +1,165 @@
+#include "ImageOpGraph.h"
+#include "BitmapKernels.h"
+#include <algorithm>
+#include <cmath>
+
+ImageOpGraph::ImageOpGraph(const glm::vec4 *source, uint32_t width, uint32_t height) : source(source),
+                                                                                      sourceWidth(width),
+                                                                                      sourceHeight(height),
+                                                                                      width(width),
+                                                                                      height(height) {}
+
+ImageOpGraph &ImageOpGraph::scale(float scale) {
+    Operation operation{};
+    operation.type = OPERATION_SCALE;
+    operation.sourceWidth = width;
+    operation.sourceHeight = height;
+    operation.width = (uint32_t) (width * scale);
+    operation.height = (uint32_t) (height * scale);
+    //Same 32.32 steps as BitmapKernels::scaleNearest
+    operation.stepX = operation.width > 0 ? ((uint64_t) width << 32) / operation.width : 0;
+    operation.stepY = operation.height > 0 ? ((uint64_t) height << 32) / operation.height : 0;
+    operations.push_back(operation);
+    width = operation.width;
+    height = operation.height;
+    return *this;
+}
+
+ImageOpGraph &ImageOpGraph::rotate(float angle, glm::vec4 background) {
+    Operation operation{};
+    operation.type = OPERATION_ROTATE;
+    operation.sourceWidth = width;
+    operation.sourceHeight = height;
+    uint32_t diagonal = (uint32_t) std::ceil(std::sqrt((double) width * width + (double) height * height));
+    operation.width = diagonal;
+    operation.height = diagonal;
+    operation.cosine = std::cos((double) angle);
+    operation.sine = std::sin((double) angle);
+    operation.background = background;
+    operations.push_back(operation);
+    width = diagonal;
+    height = diagonal;
+    return *this;
+}
+
+ImageOpGraph &ImageOpGraph::flipX() {
+    Operation operation{};
+    operation.type = OPERATION_FLIP_X;
+    operation.sourceWidth = operation.width = width;
+    operation.sourceHeight = operation.height = height;
+    operations.push_back(operation);
+    return *this;
+}
+
+ImageOpGraph &ImageOpGraph::flipY() {
+    Operation operation{};
+    operation.type = OPERATION_FLIP_Y;
+    operation.sourceWidth = operation.width = width;
+    operation.sourceHeight = operation.height = height;
+    operations.push_back(operation);
+    return *this;
+}
+
+void ImageOpGraph::addColorTransform(const glm::mat4 &transform) {
+    colorTransform = transform * colorTransform;
+    //A background is a constant, the color operations after its rotation are applied to it right away
+    for (auto &operation : operations) {
+        if (operation.type == OPERATION_ROTATE) operation.background = transform * operation.background;
+    }
+}
+
+ImageOpGraph &ImageOpGraph::grayscale() {
+    //Columns are the input channels, alpha is kept
+    glm::mat4 transform(glm::vec4(0.299f, 0.299f, 0.299f, 0), glm::vec4(0.587f, 0.587f, 0.587f, 0),
+                        glm::vec4(0.114f, 0.114f, 0.114f, 0), glm::vec4(0, 0, 0, 1));
+    addColorTransform(transform);
+    return *this;
+}
+
+ImageOpGraph &ImageOpGraph::keepChannel(uint32_t channel) {
+    glm::mat4 transform(0);
+    transform[channel][channel] = 1;
+    transform[3][3] = 1;
+    addColorTransform(transform);
+    return *this;
+}
+
+uint32_t ImageOpGraph::getWidth() const {
+    return width;
+}
+
+uint32_t ImageOpGraph::getHeight() const {
+    return height;
+}
+
+glm::vec4 ImageOpGraph::gather(int64_t x, int64_t y) const {
+    for (size_t i = operations.size(); i-- > 0;) {
+        const Operation &operation = operations[i];
+        switch (operation.type) {
+            case OPERATION_FLIP_X:
+                x = operation.width - 1 - x;
+                break;
+            case OPERATION_FLIP_Y:
+                y = operation.height - 1 - y;
+                break;
+            case OPERATION_SCALE:
+                x = (int64_t) (((uint64_t) x * operation.stepX) >> 32);
+                y = (int64_t) (((uint64_t) y * operation.stepY) >> 32);
+                break;
+            case OPERATION_ROTATE: {
+                //Same arithmetic as BitmapKernels::rotateNearest, evaluated for one pixel
+                double translatedC = (double) x - (double) (operation.width / 2);
+                double translatedL = (double) y - (double) (operation.height / 2);
+                double sourceX = translatedC * operation.cosine - translatedL * operation.sine + (double) (operation.sourceWidth / 2);
+                double sourceY = translatedC * operation.sine + translatedL * operation.cosine + (double) (operation.sourceHeight / 2);
+                if (sourceX < 0 || sourceX >= operation.sourceWidth || sourceY < 0 || sourceY >= operation.sourceHeight) {
+                    return operation.background;
+                }
+                x = (int64_t) sourceX;
+                y = (int64_t) sourceY;
+                break;
+            }
+        }
+    }
+    return colorTransform * source[(size_t) y * sourceWidth + (size_t) x];
+}
+
+template<typename Pixel, typename Store>
+void ImageOpGraph::evaluateTiles(uint32_t x, uint32_t y, uint32_t regionWidth, uint32_t regionHeight, Pixel *destination,
+                                 uint32_t destinationStride, ThreadPool *threadPool, Store store) const {
+    regionWidth = std::min(regionWidth, width > x ? width - x : 0);
+    regionHeight = std::min(regionHeight, height > y ? height - y : 0);
+    if (regionWidth == 0 || regionHeight == 0) return;
+    uint32_t tileRows = (regionHeight + TILE_SIZE - 1) / TILE_SIZE;
+    auto evaluateTileRows = [&](uint32_t tileBegin, uint32_t tileEnd) {
+        for (uint32_t tileRow = tileBegin; tileRow < tileEnd; ++tileRow) {
+            uint32_t rowBegin = tileRow * TILE_SIZE, rowEnd = std::min(rowBegin + TILE_SIZE, regionHeight);
+            for (uint32_t columnBegin = 0; columnBegin < regionWidth; columnBegin += TILE_SIZE) {
+                uint32_t columnEnd = std::min(columnBegin + TILE_SIZE, regionWidth);
+                for (uint32_t l = rowBegin; l < rowEnd; ++l) {
+                    Pixel *row = destination + (size_t) l * destinationStride;
+                    for (uint32_t c = columnBegin; c < columnEnd; ++c) {
+                        row[c] = store(gather(x + c, y + l));
+                    }
+                }
+            }
+        }
+    };
+    if (threadPool != nullptr && tileRows > 1) {
+        threadPool->parallelFor(tileRows, 1, evaluateTileRows);
+    } else {
+        evaluateTileRows(0, tileRows);
+    }
+}
+
+void ImageOpGraph::evaluate(uint32_t x, uint32_t y, uint32_t width, uint32_t height, glm::vec4 *destination,
+                            uint32_t destinationStride, ThreadPool *threadPool) const {
+    evaluateTiles(x, y, width, height, destination, destinationStride, threadPool,
+                  [](glm::vec4 color) { return color; });
+}
+
+void ImageOpGraph::evaluate(uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint32_t *destination,
+                            uint32_t destinationStride, ThreadPool *threadPool) const {
+    evaluateTiles(x, y, width, height, destination, destinationStride, threadPool,
+                  [](glm::vec4 color) { return BitmapKernels::packRGBA8(color); });
+}
@@ -0,0 +1,107 @@
+#ifndef VULKANBASE_IMAGEOPGRAPH_H
+#define VULKANBASE_IMAGEOPGRAPH_H
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "../../ThreadPool.h"
+
+/*
+ * Chain of Bitmap transforms over a source image that is only evaluated when a region of the result is asked for.
+ * Nothing is computed when an operation is added: the geometric ones are kept as the inverse mapping from a result
+ * pixel to a source pixel and the color ones are folded in a single matrix. Evaluating a region walks it in tiles
+ * and gathers every pixel straight from the source, without intermediate images, so the cost only depends on the
+ * size of the region. The result is the same as running the transforms one after the other with BitmapKernels.
+ * The source must outlive the graph.
+ */
+class ImageOpGraph {
+public:
+    ImageOpGraph(const glm::vec4 *source, uint32_t width, uint32_t height);
+
+    /*
+     * Nearest neighbour resize to the current size times scale, truncated
+     */
+    ImageOpGraph &scale(float scale);
+
+    /*
+     * Nearest neighbour rotation into a square as large as the diagonal, uncovered pixels get the background
+     */
+    ImageOpGraph &rotate(float angle, glm::vec4 background);
+
+    ImageOpGraph &flipX();
+
+    ImageOpGraph &flipY();
+
+    ImageOpGraph &grayscale();
+
+    /*
+     * Zero every color channel except the given one, alpha is kept
+     */
+    ImageOpGraph &keepChannel(uint32_t channel);
+
+    uint32_t getWidth() const;
+
+    uint32_t getHeight() const;
+
+    /*
+     * Evaluate the rectangle of the result starting at x, y. Rows of the destination are destinationStride pixels
+     * apart, so a region can be written straight into a larger image or a mapped staging buffer.
+     */
+    void evaluate(uint32_t x, uint32_t y, uint32_t width, uint32_t height, glm::vec4 *destination,
+                  uint32_t destinationStride, ThreadPool *threadPool = nullptr) const;
+
+    /*
+     * Same as above, packed as RGBA8 like BitmapKernels
+     */
+    void evaluate(uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint32_t *destination,
+                  uint32_t destinationStride, ThreadPool *threadPool = nullptr) const;
+
+private:
+    enum OperationType {
+        OPERATION_SCALE,
+        OPERATION_ROTATE,
+        OPERATION_FLIP_X,
+        OPERATION_FLIP_Y
+    };
+
+    struct Operation {
+        OperationType type;
+        //Size of the image the operation reads
+        uint32_t sourceWidth;
+        uint32_t sourceHeight;
+        //Size of the image it produces
+        uint32_t width;
+        uint32_t height;
+        uint64_t stepX;
+        uint64_t stepY;
+        double cosine;
+        double sine;
+        //Of a rotation, with the color operations added after it already applied
+        glm::vec4 background;
+    };
+
+    //Side of the square tiles evaluated by one task
+    static const uint32_t TILE_SIZE = 64;
+
+    const glm::vec4 *source;
+    uint32_t sourceWidth;
+    uint32_t sourceHeight;
+    uint32_t width;
+    uint32_t height;
+    std::vector<Operation> operations;
+    glm::mat4 colorTransform = glm::mat4(1);
+
+    void addColorTransform(const glm::mat4 &transform);
+
+    /*
+     * Color of the result pixel, the inverse mappings are run from the last operation to the first
+     */
+    glm::vec4 gather(int64_t x, int64_t y) const;
+
+    template<typename Pixel, typename Store>
+    void evaluateTiles(uint32_t x, uint32_t y, uint32_t regionWidth, uint32_t regionHeight, Pixel *destination,
+                       uint32_t destinationStride, ThreadPool *threadPool, Store store) const;
+};
+
+
+#endif //VULKANBASE_IMAGEOPGRAPH_H
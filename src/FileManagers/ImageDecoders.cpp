@@ -0,0 +1,435 @@
+#include "ImageDecoders.h"
+#include "Inflate.h"
+#include "MappedFile.h"
+#include "TiledHeightfield.h"
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+namespace {
+    //Bounds for untrusted headers, far above any heightmap the renderer can take
+    const uint32_t MAX_DIMENSION = 1 << 16;
+    const uint64_t MAX_PIXELS = 1ull << 28;
+
+    bool validSize(uint64_t width, uint64_t height) {
+        return width > 0 && height > 0 && width <= MAX_DIMENSION && height <= MAX_DIMENSION &&
+               width * height <= MAX_PIXELS;
+    }
+
+    uint32_t readBigEndian32(const uint8_t *bytes) {
+        return (uint32_t) bytes[0] << 24 | (uint32_t) bytes[1] << 16 | (uint32_t) bytes[2] << 8 | bytes[3];
+    }
+
+    /*
+     * Hands the rows to the sink in the order it expects, bottom first. decodeRow(fileRow, destination) converts
+     * one row of a top first file.
+     */
+    template<typename RowDecoder>
+    void emitRows(BitmapSink &sink, uint32_t width, uint32_t height, RowDecoder decodeRow) {
+        sink.begin(width, height);
+        for (uint32_t l = 0; l < height;) {
+            glm::vec4 *rows;
+            uint32_t rowCount = sink.acquireRows(l, height - l, rows);
+            for (uint32_t r = 0; r < rowCount; ++r) {
+                decodeRow(height - 1 - (l + r), rows + (size_t) r * width);
+            }
+            sink.commitRows(l, rowCount);
+            l += rowCount;
+        }
+    }
+
+    template<typename Decode>
+    bool decodeMapped(const std::string &path, BitmapSink &sink, Decode decode) {
+        MappedFile file;
+        if (!file.open(path)) return false;
+        return decode(file.data(), file.size(), sink);
+    }
+
+    struct PngHeader {
+        uint32_t width;
+        uint32_t height;
+        uint32_t bitDepth;
+        uint32_t colorType;
+        uint32_t channels;
+    };
+
+    bool readPngHeader(const uint8_t *chunk, PngHeader &header) {
+        header.width = readBigEndian32(chunk);
+        header.height = readBigEndian32(chunk + 4);
+        header.bitDepth = chunk[8];
+        header.colorType = chunk[9];
+        //Compression and filter methods have a single defined value, Adam7 interlacing is not supported
+        if (chunk[10] != 0 || chunk[11] != 0 || chunk[12] != 0) return false;
+        if (!validSize(header.width, header.height)) return false;
+        uint32_t depth = header.bitDepth;
+        bool anyDepth = depth == 1 || depth == 2 || depth == 4 || depth == 8 || depth == 16;
+        switch (header.colorType) {
+            case 0:
+                header.channels = 1;
+                return anyDepth;
+            case 2:
+                header.channels = 3;
+                return depth == 8 || depth == 16;
+            case 3:
+                header.channels = 1;
+                return anyDepth && depth != 16;
+            case 4:
+                header.channels = 2;
+                return depth == 8 || depth == 16;
+            case 6:
+                header.channels = 4;
+                return depth == 8 || depth == 16;
+            default:
+                return false;
+        }
+    }
+
+    uint8_t paeth(int left, int up, int upLeft) {
+        int estimate = left + up - upLeft;
+        int distanceLeft = std::abs(estimate - left);
+        int distanceUp = std::abs(estimate - up);
+        int distanceUpLeft = std::abs(estimate - upLeft);
+        if (distanceLeft <= distanceUp && distanceLeft <= distanceUpLeft) return (uint8_t) left;
+        if (distanceUp <= distanceUpLeft) return (uint8_t) up;
+        return (uint8_t) upLeft;
+    }
+
+    /*
+     * Undoes the scanline filters in place, every row keeps its filter byte in front
+     */
+    bool unfilterPng(uint8_t *scanlines, uint32_t height, size_t rowBytes, uint32_t pixelBytes) {
+        std::vector<uint8_t> zeroRow(rowBytes, 0);
+        const uint8_t *prior = zeroRow.data();
+        for (uint32_t y = 0; y < height; ++y) {
+            uint8_t *line = scanlines + (size_t) y * (rowBytes + 1);
+            uint8_t filter = line[0];
+            uint8_t *current = line + 1;
+            switch (filter) {
+                case 0:
+                    break;
+                case 1:
+                    for (size_t i = pixelBytes; i < rowBytes; ++i) current[i] += current[i - pixelBytes];
+                    break;
+                case 2:
+                    for (size_t i = 0; i < rowBytes; ++i) current[i] += prior[i];
+                    break;
+                case 3:
+                    for (size_t i = 0; i < pixelBytes && i < rowBytes; ++i) current[i] += prior[i] >> 1;
+                    for (size_t i = pixelBytes; i < rowBytes; ++i) {
+                        current[i] += (uint8_t) (((uint32_t) current[i - pixelBytes] + prior[i]) >> 1);
+                    }
+                    break;
+                case 4:
+                    for (size_t i = 0; i < pixelBytes && i < rowBytes; ++i) current[i] += prior[i];
+                    for (size_t i = pixelBytes; i < rowBytes; ++i) {
+                        current[i] += paeth(current[i - pixelBytes], prior[i], prior[i - pixelBytes]);
+                    }
+                    break;
+                default:
+                    return false;
+            }
+            prior = current;
+        }
+        return true;
+    }
+
+    uint32_t pngSample(const uint8_t *row, size_t index, uint32_t depth) {
+        if (depth == 16) return (uint32_t) row[2 * index] << 8 | row[2 * index + 1];
+        if (depth == 8) return row[index];
+        size_t bit = index * depth;
+        return (row[bit >> 3] >> (8 - depth - (bit & 7))) & ((1u << depth) - 1);
+    }
+
+    void convertPngRow(const PngHeader &header, const uint8_t *row, const glm::vec4 *palette, glm::vec4 *destination) {
+        uint32_t depth = header.bitDepth;
+        float scale = 1.0f / (float) ((1u << depth) - 1);
+        uint32_t width = header.width;
+        switch (header.colorType) {
+            case 0:
+                if (depth == 16) {
+                    for (uint32_t x = 0; x < width; ++x) {
+                        float value = (float) ((uint32_t) row[2 * x] << 8 | row[2 * x + 1]) * scale;
+                        destination[x] = glm::vec4(value, value, value, 1);
+                    }
+                } else {
+                    for (uint32_t x = 0; x < width; ++x) {
+                        float value = (float) pngSample(row, x, depth) * scale;
+                        destination[x] = glm::vec4(value, value, value, 1);
+                    }
+                }
+                break;
+            case 2:
+                for (uint32_t x = 0; x < width; ++x) {
+                    destination[x] = glm::vec4(pngSample(row, 3 * x, depth), pngSample(row, 3 * x + 1, depth),
+                                               pngSample(row, 3 * x + 2, depth), 0) * scale;
+                    destination[x].a = 1;
+                }
+                break;
+            case 3:
+                for (uint32_t x = 0; x < width; ++x) destination[x] = palette[pngSample(row, x, depth)];
+                break;
+            case 4:
+                for (uint32_t x = 0; x < width; ++x) {
+                    float value = (float) pngSample(row, 2 * x, depth) * scale;
+                    destination[x] = glm::vec4(value, value, value, (float) pngSample(row, 2 * x + 1, depth) * scale);
+                }
+                break;
+            default:
+                for (uint32_t x = 0; x < width; ++x) {
+                    destination[x] = glm::vec4(pngSample(row, 4 * x, depth), pngSample(row, 4 * x + 1, depth),
+                                               pngSample(row, 4 * x + 2, depth), pngSample(row, 4 * x + 3, depth)) * scale;
+                }
+                break;
+        }
+    }
+
+    bool isSpace(uint8_t character) {
+        return character == ' ' || character == '\t' || character == '\n' || character == '\r' ||
+               character == '\v' || character == '\f';
+    }
+
+    /*
+     * Next decimal field of a netpbm header, skipping whitespace and comments
+     */
+    bool readPgmField(const uint8_t *data, size_t size, size_t &position, uint32_t &value) {
+        for (;;) {
+            while (position < size && isSpace(data[position])) position++;
+            if (position < size && data[position] == '#') {
+                while (position < size && data[position] != '\n' && data[position] != '\r') position++;
+                continue;
+            }
+            break;
+        }
+        if (position >= size || data[position] < '0' || data[position] > '9') return false;
+        uint64_t result = 0;
+        while (position < size && data[position] >= '0' && data[position] <= '9') {
+            result = result * 10 + (data[position++] - '0');
+            if (result > 0xFFFFFFFFull) return false;
+        }
+        value = (uint32_t) result;
+        return true;
+    }
+
+    //Side of a square of size bytes made of pixelBytes pixels, 0 if it is not one
+    uint32_t squareSide(size_t size, size_t pixelBytes) {
+        if (size == 0 || size % pixelBytes != 0) return 0;
+        size_t pixels = size / pixelBytes;
+        uint64_t side = (uint64_t) std::llround(std::sqrt((double) pixels));
+        if (side * side != pixels || !validSize(side, side)) return 0;
+        return (uint32_t) side;
+    }
+}
+
+bool ImageDecoders::decodePNG(const uint8_t *data, size_t size, BitmapSink &sink) {
+    static const uint8_t SIGNATURE[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    if (size < 8 || memcmp(data, SIGNATURE, 8) != 0) return false;
+
+    PngHeader header{};
+    bool hasHeader = false;
+    glm::vec4 palette[256];
+    uint32_t paletteSize = 0;
+    //The image data may be split in many chunks, a single one is inflated in place
+    const uint8_t *compressed = nullptr;
+    size_t compressedSize = 0;
+    std::vector<uint8_t> joinedChunks;
+    uint32_t dataChunks = 0;
+    for (size_t position = 8;;) {
+        if (size - position < 12) return false;
+        uint32_t length = readBigEndian32(data + position);
+        const uint8_t *type = data + position + 4;
+        const uint8_t *chunk = data + position + 8;
+        if (length > size - position - 12) return false;
+        position += 12 + (size_t) length;
+
+        if (memcmp(type, "IHDR", 4) == 0) {
+            if (hasHeader || length != 13 || !readPngHeader(chunk, header)) return false;
+            hasHeader = true;
+        } else if (!hasHeader) {
+            return false;
+        } else if (memcmp(type, "PLTE", 4) == 0) {
+            if (length == 0 || length % 3 != 0 || length / 3 > 256) return false;
+            paletteSize = length / 3;
+            for (uint32_t i = 0; i < paletteSize; ++i) {
+                palette[i] = glm::vec4(chunk[3 * i], chunk[3 * i + 1], chunk[3 * i + 2], 255) / 255.f;
+            }
+        } else if (memcmp(type, "tRNS", 4) == 0) {
+            //Only the palette alpha is kept, a color key has no meaning for heights
+            if (header.colorType == 3) {
+                for (uint32_t i = 0; i < length && i < paletteSize; ++i) palette[i].a = chunk[i] / 255.f;
+            }
+        } else if (memcmp(type, "IDAT", 4) == 0) {
+            if (dataChunks++ == 0) {
+                compressed = chunk;
+                compressedSize = length;
+            } else {
+                if (dataChunks == 2) joinedChunks.assign(compressed, compressed + compressedSize);
+                joinedChunks.insert(joinedChunks.end(), chunk, chunk + length);
+                compressed = joinedChunks.data();
+                compressedSize = joinedChunks.size();
+            }
+        } else if (memcmp(type, "IEND", 4) == 0) {
+            break;
+        } else if ((type[0] & 32) == 0) {
+            //An unknown critical chunk changes how the pixels are read
+            return false;
+        }
+    }
+    if (dataChunks == 0 || (header.colorType == 3 && paletteSize == 0)) return false;
+
+    size_t rowBytes = ((size_t) header.width * header.channels * header.bitDepth + 7) / 8;
+    uint32_t pixelBytes = std::max<uint32_t>(header.channels * header.bitDepth / 8, 1);
+    std::vector<uint8_t> scanlines((size_t) header.height * (rowBytes + 1));
+    if (!Inflate::zlibDecompress(compressed, compressedSize, scanlines.data(), scanlines.size())) return false;
+    if (!unfilterPng(scanlines.data(), header.height, rowBytes, pixelBytes)) return false;
+    if (header.colorType == 3) {
+        for (uint32_t y = 0; y < header.height; ++y) {
+            const uint8_t *row = scanlines.data() + (size_t) y * (rowBytes + 1) + 1;
+            for (uint32_t x = 0; x < header.width; ++x) {
+                if (pngSample(row, x, header.bitDepth) >= paletteSize) return false;
+            }
+        }
+    }
+
+    emitRows(sink, header.width, header.height, [&](uint32_t fileRow, glm::vec4 *destination) {
+        convertPngRow(header, scanlines.data() + (size_t) fileRow * (rowBytes + 1) + 1, palette, destination);
+    });
+    return true;
+}
+
+bool ImageDecoders::decodePNG(const std::string &path, BitmapSink &sink) {
+    return decodeMapped(path, sink, [](const uint8_t *data, size_t size, BitmapSink &sink) {
+        return decodePNG(data, size, sink);
+    });
+}
+
+bool ImageDecoders::decodePGM(const uint8_t *data, size_t size, BitmapSink &sink) {
+    if (size < 2 || data[0] != 'P' || data[1] != '5') return false;
+    size_t position = 2;
+    uint32_t width, height, maximum;
+    if (!readPgmField(data, size, position, width) || !readPgmField(data, size, position, height) ||
+        !readPgmField(data, size, position, maximum))
+        return false;
+    //A single whitespace separates the header from the samples
+    if (position >= size || !isSpace(data[position])) return false;
+    position++;
+    if (!validSize(width, height) || maximum == 0 || maximum > 65535) return false;
+    size_t sampleBytes = maximum < 256 ? 1 : 2;
+    size_t rowBytes = (size_t) width * sampleBytes;
+    if ((size - position) / rowBytes < height) return false;
+
+    const uint8_t *samples = data + position;
+    float scale = 1.0f / (float) maximum;
+    emitRows(sink, width, height, [&](uint32_t fileRow, glm::vec4 *destination) {
+        const uint8_t *row = samples + (size_t) fileRow * rowBytes;
+        for (uint32_t x = 0; x < width; ++x) {
+            uint32_t sample = sampleBytes == 1 ? row[x] : (uint32_t) row[2 * x] << 8 | row[2 * x + 1];
+            float value = std::min((float) sample * scale, 1.0f);
+            destination[x] = glm::vec4(value, value, value, 1);
+        }
+    });
+    return true;
+}
+
+bool ImageDecoders::decodePGM(const std::string &path, BitmapSink &sink) {
+    return decodeMapped(path, sink, [](const uint8_t *data, size_t size, BitmapSink &sink) {
+        return decodePGM(data, size, sink);
+    });
+}
+
+bool ImageDecoders::decodeRaw16(const uint8_t *data, size_t size, BitmapSink &sink) {
+    uint32_t side = squareSide(size, 2);
+    if (side == 0) return false;
+    emitRows(sink, side, side, [&](uint32_t fileRow, glm::vec4 *destination) {
+        const uint8_t *row = data + (size_t) fileRow * side * 2;
+        for (uint32_t x = 0; x < side; ++x) {
+            float value = (float) (row[2 * x] | (uint32_t) row[2 * x + 1] << 8) * (1.0f / 65535.0f);
+            destination[x] = glm::vec4(value, value, value, 1);
+        }
+    });
+    return true;
+}
+
+bool ImageDecoders::decodeRaw16(const std::string &path, BitmapSink &sink) {
+    return decodeMapped(path, sink, [](const uint8_t *data, size_t size, BitmapSink &sink) {
+        return decodeRaw16(data, size, sink);
+    });
+}
+
+bool ImageDecoders::decodeRaw32(const uint8_t *data, size_t size, BitmapSink &sink) {
+    uint32_t side = squareSide(size, 4);
+    if (side == 0) return false;
+    emitRows(sink, side, side, [&](uint32_t fileRow, glm::vec4 *destination) {
+        const uint8_t *row = data + (size_t) fileRow * side * 4;
+        for (uint32_t x = 0; x < side; ++x) {
+            //The file is little endian like every platform the renderer runs on
+            float value;
+            memcpy(&value, row + 4 * x, sizeof(float));
+            destination[x] = glm::vec4(value, value, value, 1);
+        }
+    });
+    return true;
+}
+
+bool ImageDecoders::decodeRaw32(const std::string &path, BitmapSink &sink) {
+    return decodeMapped(path, sink, [](const uint8_t *data, size_t size, BitmapSink &sink) {
+        return decodeRaw32(data, size, sink);
+    });
+}
+
+ImageDecoderRegistry::ImageDecoderRegistry() {
+    registerDecoder("bmp", [](const uint8_t *data, size_t size, BitmapSink &sink) {
+        return Bitmap::decode(data, size, sink);
+    });
+    registerDecoder("png", [](const uint8_t *data, size_t size, BitmapSink &sink) {
+        return ImageDecoders::decodePNG(data, size, sink);
+    });
+    registerDecoder("pgm", [](const uint8_t *data, size_t size, BitmapSink &sink) {
+        return ImageDecoders::decodePGM(data, size, sink);
+    });
+    registerDecoder("r16", [](const uint8_t *data, size_t size, BitmapSink &sink) {
+        return ImageDecoders::decodeRaw16(data, size, sink);
+    });
+    registerDecoder("r32", [](const uint8_t *data, size_t size, BitmapSink &sink) {
+        return ImageDecoders::decodeRaw32(data, size, sink);
+    });
+    registerDecoder("vth", [](const uint8_t *data, size_t size, BitmapSink &sink) {
+        return TiledHeightfield::decode(data, size, sink, nullptr);
+    });
+}
+
+void ImageDecoderRegistry::registerDecoder(const std::string &extension, Decoder decoder) {
+    std::string key = extension;
+    std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return (char) std::tolower(c); });
+    decoders[key] = std::move(decoder);
+}
+
+bool ImageDecoderRegistry::canDecode(const std::string &path) const {
+    return decoders.count(extensionOf(path)) > 0;
+}
+
+bool ImageDecoderRegistry::decode(const std::string &path, BitmapSink &sink) const {
+    auto decoder = decoders.find(extensionOf(path));
+    if (decoder == decoders.end()) return false;
+    MappedFile file;
+    if (!file.open(path)) return false;
+    return decoder->second(file.data(), file.size(), sink);
+}
+
+bool ImageDecoderRegistry::decode(const std::string &name, const uint8_t *data, size_t size, BitmapSink &sink) const {
+    auto decoder = decoders.find(extensionOf(name));
+    if (decoder == decoders.end()) return false;
+    return decoder->second(data, size, sink);
+}
+
+std::string ImageDecoderRegistry::extensionOf(const std::string &path) {
+    size_t dot = path.find_last_of('.');
+    size_t separator = path.find_last_of("/\\");
+    if (dot == std::string::npos || (separator != std::string::npos && dot < separator)) return "";
+    std::string extension = path.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return (char) std::tolower(c); });
+    return extension;
+}
@@ -0,0 +1,82 @@
+#ifndef VULKANBASE_IMAGEDECODERS_H
+#define VULKANBASE_IMAGEDECODERS_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <unordered_map>
+#include "Bitmap/Bitmap.h"
+
+/*
+ * Decoders of the image formats a heightmap can come in, all writing rows to a BitmapSink the way Bitmap::decode does:
+ * normalized RGBA floats, bottom row first. Single channel formats are replicated in RGB with alpha 1, so
+ * 16 bit and float heights keep their full precision through the float rows.
+ * The memory overloads take the whole encoded file and treat it as untrusted, any inconsistency makes them return
+ * false before a row is written. The path overloads map the file instead of reading it.
+ */
+namespace ImageDecoders {
+    /*
+     * Non interlaced PNG of every color type, 1 to 16 bits. Chunk CRCs are not checked, the zlib stream is.
+     */
+    bool decodePNG(const uint8_t *data, size_t size, BitmapSink &sink);
+
+    bool decodePNG(const std::string &path, BitmapSink &sink);
+
+    /*
+     * Binary PGM (P5), 8 or 16 bits depending on the maximum value
+     */
+    bool decodePGM(const uint8_t *data, size_t size, BitmapSink &sink);
+
+    bool decodePGM(const std::string &path, BitmapSink &sink);
+
+    /*
+     * Headerless square heightfields, little endian unsigned 16 bit or 32 bit float, the side comes from the size.
+     * Rows convert straight from the mapping, there is nothing to decode.
+     */
+    bool decodeRaw16(const uint8_t *data, size_t size, BitmapSink &sink);
+
+    bool decodeRaw16(const std::string &path, BitmapSink &sink);
+
+    bool decodeRaw32(const uint8_t *data, size_t size, BitmapSink &sink);
+
+    bool decodeRaw32(const std::string &path, BitmapSink &sink);
+}
+
+/*
+ * Picks the decoder of a file by its extension, case insensitive.
+ * Comes with bmp, png, pgm, r16, r32 and vth (TiledHeightfield, decoded on the calling thread) registered, other
+ * formats can be added or replace them.
+ * Decoders take the whole encoded file, so the bytes can come from a mapping, a pack archive or the network alike.
+ */
+class ImageDecoderRegistry {
+public:
+    using Decoder = std::function<bool(const uint8_t *data, size_t size, BitmapSink &sink)>;
+
+    ImageDecoderRegistry();
+
+    /*
+     * Extension without the dot
+     */
+    void registerDecoder(const std::string &extension, Decoder decoder);
+
+    bool canDecode(const std::string &path) const;
+
+    /*
+     * Maps the file. False when no decoder handles the extension or the file cannot be opened or decoded.
+     */
+    bool decode(const std::string &path, BitmapSink &sink) const;
+
+    /*
+     * The name only picks the decoder
+     */
+    bool decode(const std::string &name, const uint8_t *data, size_t size, BitmapSink &sink) const;
+
+private:
+    std::unordered_map<std::string, Decoder> decoders;
+
+    static std::string extensionOf(const std::string &path);
+};
+
+
+#endif //VULKANBASE_IMAGEDECODERS_H
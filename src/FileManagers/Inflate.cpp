@@ -0,0 +1,310 @@
+#include "Inflate.h"
+#include <cstring>
+
+namespace {
+    const uint16_t LENGTH_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99,
+                                      115, 131, 163, 195, 227, 258};
+    const uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    const uint16_t DISTANCE_BASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+                                        1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+    const uint8_t DISTANCE_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11,
+                                        12, 12, 13, 13};
+    const uint8_t CODE_LENGTH_ORDER[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+    //Codes up to this long are decoded with one table lookup, longer ones bit by bit
+    const uint32_t FAST_BITS = 10;
+    const uint32_t MAX_CODE_LENGTH = 15;
+
+    struct Huffman {
+        //Symbol << 4 | code length, indexed by the next FAST_BITS of the stream. 0 for codes longer than FAST_BITS.
+        uint16_t fast[1 << FAST_BITS];
+        uint16_t counts[MAX_CODE_LENGTH + 1];
+        //Symbols sorted by code
+        uint16_t symbols[288];
+
+        bool build(const uint8_t *lengths, uint32_t count) {
+            memset(counts, 0, sizeof(counts));
+            memset(fast, 0, sizeof(fast));
+            for (uint32_t i = 0; i < count; ++i) counts[lengths[i]]++;
+            counts[0] = 0;
+            //Over subscribed codes are invalid, incomplete ones are allowed as a single distance code is common
+            int left = 1;
+            for (uint32_t length = 1; length <= MAX_CODE_LENGTH; ++length) {
+                left <<= 1;
+                left -= counts[length];
+                if (left < 0) return false;
+            }
+            uint16_t offsets[MAX_CODE_LENGTH + 2];
+            uint32_t nextCode[MAX_CODE_LENGTH + 1];
+            offsets[1] = 0;
+            uint32_t code = 0;
+            for (uint32_t length = 1; length <= MAX_CODE_LENGTH; ++length) {
+                offsets[length + 1] = offsets[length] + counts[length];
+                code = (code + counts[length - 1]) << 1;
+                nextCode[length] = code;
+            }
+            for (uint32_t symbol = 0; symbol < count; ++symbol) {
+                uint32_t length = lengths[symbol];
+                if (length == 0) continue;
+                symbols[offsets[length]++] = symbol;
+                uint32_t symbolCode = nextCode[length]++;
+                if (length > FAST_BITS) continue;
+                //The stream holds codes most significant bit first
+                uint32_t reversed = 0;
+                for (uint32_t bit = 0; bit < length; ++bit) reversed |= ((symbolCode >> bit) & 1) << (length - 1 - bit);
+                for (uint32_t index = reversed; index < (1u << FAST_BITS); index += 1u << length) {
+                    fast[index] = (uint16_t) (symbol << 4 | length);
+                }
+            }
+            return true;
+        }
+    };
+
+    class BitReader {
+    public:
+        BitReader(const uint8_t *data, size_t size) : data(data), size(size) {}
+
+        //Keeps at least 57 bits buffered, past the end of the data zeros are read
+        void refill() {
+            while (count <= 56) {
+                uint64_t byte = position < size ? data[position] : 0;
+                buffer |= byte << count;
+                count += 8;
+                position++;
+            }
+        }
+
+        uint32_t peek(uint32_t bits) const {
+            return (uint32_t) (buffer & ((1ull << bits) - 1));
+        }
+
+        void consume(uint32_t bits) {
+            buffer >>= bits;
+            count -= bits;
+        }
+
+        uint32_t read(uint32_t bits) {
+            if (count < bits) refill();
+            uint32_t value = peek(bits);
+            consume(bits);
+            return value;
+        }
+
+        //Bytes taken so far, rounded up
+        size_t consumedBytes() const {
+            return position - count / 8;
+        }
+
+        bool overrun() const {
+            return consumedBytes() > size;
+        }
+
+        void alignToByte() {
+            consume(count % 8);
+        }
+
+        /*
+         * Copies whole bytes after alignToByte, bypassing the bit buffer
+         */
+        bool copyBytes(uint8_t *destination, size_t bytes) {
+            position -= count / 8;
+            buffer = 0;
+            count = 0;
+            if (position > size || bytes > size - position) return false;
+            memcpy(destination, data + position, bytes);
+            position += bytes;
+            return true;
+        }
+
+        //Decodes a symbol, -1 for a code that is not in the table
+        int decode(const Huffman &huffman) {
+            if (count < MAX_CODE_LENGTH) refill();
+            uint16_t entry = huffman.fast[peek(FAST_BITS)];
+            if (entry != 0) {
+                consume(entry & 15);
+                return entry >> 4;
+            }
+            //Canonical decode one bit at a time, the first code of every length follows the last of the previous
+            int code = 0, first = 0, index = 0;
+            for (uint32_t length = 1; length <= MAX_CODE_LENGTH; ++length) {
+                code |= (int) (buffer & 1);
+                consume(1);
+                int lengthCount = huffman.counts[length];
+                if (code - lengthCount < first) return huffman.symbols[index + (code - first)];
+                index += lengthCount;
+                first += lengthCount;
+                first <<= 1;
+                code <<= 1;
+            }
+            return -1;
+        }
+
+    private:
+        const uint8_t *data;
+        size_t size;
+        size_t position = 0;
+        uint64_t buffer = 0;
+        uint32_t count = 0;
+    };
+
+    const Huffman &fixedLiteralHuffman() {
+        static const Huffman huffman = []() {
+            uint8_t lengths[288];
+            memset(lengths, 8, 144);
+            memset(lengths + 144, 9, 112);
+            memset(lengths + 256, 7, 24);
+            memset(lengths + 280, 8, 8);
+            Huffman result{};
+            result.build(lengths, 288);
+            return result;
+        }();
+        return huffman;
+    }
+
+    const Huffman &fixedDistanceHuffman() {
+        static const Huffman huffman = []() {
+            uint8_t lengths[30];
+            memset(lengths, 5, 30);
+            Huffman result{};
+            result.build(lengths, 30);
+            return result;
+        }();
+        return huffman;
+    }
+
+    bool readDynamicTables(BitReader &reader, Huffman &literals, Huffman &distances) {
+        uint32_t literalCount = reader.read(5) + 257;
+        uint32_t distanceCount = reader.read(5) + 1;
+        uint32_t codeLengthCount = reader.read(4) + 4;
+        if (literalCount > 286 || distanceCount > 30) return false;
+
+        uint8_t codeLengthLengths[19] = {};
+        for (uint32_t i = 0; i < codeLengthCount; ++i) {
+            codeLengthLengths[CODE_LENGTH_ORDER[i]] = (uint8_t) reader.read(3);
+        }
+        Huffman codeLengths{};
+        if (!codeLengths.build(codeLengthLengths, 19)) return false;
+
+        uint8_t lengths[286 + 30];
+        uint32_t total = literalCount + distanceCount;
+        for (uint32_t i = 0; i < total;) {
+            int symbol = reader.decode(codeLengths);
+            if (symbol < 0) return false;
+            if (symbol < 16) {
+                lengths[i++] = (uint8_t) symbol;
+                continue;
+            }
+            uint8_t repeated = 0;
+            uint32_t repeat;
+            if (symbol == 16) {
+                if (i == 0) return false;
+                repeated = lengths[i - 1];
+                repeat = 3 + reader.read(2);
+            } else if (symbol == 17) {
+                repeat = 3 + reader.read(3);
+            } else {
+                repeat = 11 + reader.read(7);
+            }
+            if (repeat > total - i) return false;
+            memset(lengths + i, repeated, repeat);
+            i += repeat;
+        }
+        //A block without an end of block code could never finish
+        if (lengths[256] == 0) return false;
+        return literals.build(lengths, literalCount) && distances.build(lengths + literalCount, distanceCount);
+    }
+
+    bool inflateBlock(BitReader &reader, const Huffman &literals, const Huffman &distances, uint8_t *destination,
+                      size_t destinationSize, size_t &written) {
+        for (;;) {
+            int symbol = reader.decode(literals);
+            if (symbol < 256) {
+                if (symbol < 0 || written == destinationSize) return false;
+                destination[written++] = (uint8_t) symbol;
+                continue;
+            }
+            if (symbol == 256) return true;
+            symbol -= 257;
+            if (symbol >= 29) return false;
+            uint32_t length = LENGTH_BASE[symbol] + reader.read(LENGTH_EXTRA[symbol]);
+            int distanceSymbol = reader.decode(distances);
+            if (distanceSymbol < 0 || distanceSymbol >= 30) return false;
+            size_t distance = DISTANCE_BASE[distanceSymbol] + reader.read(DISTANCE_EXTRA[distanceSymbol]);
+            if (distance > written || length > destinationSize - written) return false;
+            uint8_t *target = destination + written;
+            const uint8_t *match = target - distance;
+            if (distance >= length) {
+                memcpy(target, match, length);
+            } else {
+                //Overlapping matches repeat the last distance bytes
+                for (uint32_t i = 0; i < length; ++i) target[i] = match[i];
+            }
+            written += length;
+        }
+    }
+}
+
+bool Inflate::inflate(const uint8_t *source, size_t sourceSize, uint8_t *destination, size_t destinationSize,
+                      size_t *consumed) {
+    BitReader reader(source, sourceSize);
+    size_t written = 0;
+    Huffman literals, distances;
+    bool lastBlock;
+    do {
+        reader.refill();
+        lastBlock = reader.read(1) == 1;
+        uint32_t type = reader.read(2);
+        if (type == 0) {
+            reader.alignToByte();
+            uint32_t length = reader.read(16);
+            uint32_t lengthComplement = reader.read(16);
+            if ((length ^ 0xFFFF) != lengthComplement || length > destinationSize - written) return false;
+            if (!reader.copyBytes(destination + written, length)) return false;
+            written += length;
+        } else if (type == 1) {
+            if (!inflateBlock(reader, fixedLiteralHuffman(), fixedDistanceHuffman(), destination, destinationSize,
+                              written))
+                return false;
+        } else if (type == 2) {
+            if (!readDynamicTables(reader, literals, distances)) return false;
+            if (!inflateBlock(reader, literals, distances, destination, destinationSize, written)) return false;
+        } else {
+            return false;
+        }
+        //Zeros read past the end decode as valid empty blocks, a truncated stream stops here
+        if (reader.overrun()) return false;
+    } while (!lastBlock);
+    if (consumed != nullptr) *consumed = reader.consumedBytes();
+    return written == destinationSize;
+}
+
+bool Inflate::zlibDecompress(const uint8_t *source, size_t sourceSize, uint8_t *destination, size_t destinationSize) {
+    if (sourceSize < 6) return false;
+    uint32_t method = source[0], flags = source[1];
+    //Deflate with a window up to 32K, no preset dictionary
+    if ((method & 15) != 8 || (method >> 4) > 7 || (method << 8 | flags) % 31 != 0 || (flags & 32) != 0) return false;
+    size_t consumed = 0;
+    if (!inflate(source + 2, sourceSize - 2, destination, destinationSize, &consumed)) return false;
+    if (sourceSize - 2 - consumed < 4) return false;
+    const uint8_t *checksum = source + 2 + consumed;
+    uint32_t expected = (uint32_t) checksum[0] << 24 | (uint32_t) checksum[1] << 16 | (uint32_t) checksum[2] << 8 |
+                        checksum[3];
+    return adler32(destination, destinationSize) == expected;
+}
+
+uint32_t Inflate::adler32(const uint8_t *data, size_t size, uint32_t adler) {
+    uint32_t a = adler & 0xFFFF, b = adler >> 16;
+    while (size > 0) {
+        //Largest run that cannot overflow the sums before the modulo
+        size_t run = size < 5552 ? size : 5552;
+        size -= run;
+        for (size_t i = 0; i < run; ++i) {
+            a += data[i];
+            b += a;
+        }
+        data += run;
+        a %= 65521;
+        b %= 65521;
+    }
+    return b << 16 | a;
+}
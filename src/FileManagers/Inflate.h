@@ -0,0 +1,28 @@
+#ifndef VULKANBASE_INFLATE_H
+#define VULKANBASE_INFLATE_H
+
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Deflate (RFC 1951) decompression into a buffer of known size, for the formats that embed it like PNG.
+ * Input is untrusted: every length, distance and code is checked, a corrupt stream only makes the calls return false.
+ */
+namespace Inflate {
+    /*
+     * Raw deflate stream. True when it decodes to exactly destinationSize bytes.
+     * consumed, when given, receives the bytes of the source the stream took.
+     */
+    bool inflate(const uint8_t *source, size_t sourceSize, uint8_t *destination, size_t destinationSize,
+                 size_t *consumed = nullptr);
+
+    /*
+     * Zlib wrapped stream (RFC 1950), the header and the Adler-32 of the output are checked as well
+     */
+    bool zlibDecompress(const uint8_t *source, size_t sourceSize, uint8_t *destination, size_t destinationSize);
+
+    uint32_t adler32(const uint8_t *data, size_t size, uint32_t adler = 1);
+}
+
+
+#endif //VULKANBASE_INFLATE_H
@@ -0,0 +1,150 @@
+#include "LZ4.h"
+#include <cstring>
+#include <vector>
+
+namespace {
+    const size_t MIN_MATCH = 4;
+    //The format requires the last 5 bytes to be literals and the last match to start 12 bytes before the end
+    const size_t LAST_LITERALS = 5;
+    const size_t MATCH_LIMIT = 12;
+    const size_t MAX_DISTANCE = 65535;
+    const uint32_t HASH_BITS = 16;
+    const size_t FAST_COPY = 16;
+
+    uint32_t read32(const uint8_t *data) {
+        uint32_t value;
+        memcpy(&value, data, 4);
+        return value;
+    }
+
+    uint32_t hash(uint32_t sequence) {
+        return (sequence * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    //The 15 of the token was already written, the rest goes in bytes of up to 255
+    uint8_t *writeLength(uint8_t *destination, size_t length) {
+        for (; length >= 255; length -= 255) *destination++ = 255;
+        *destination++ = (uint8_t) length;
+        return destination;
+    }
+
+    //Reads the bytes that follow a token nibble of 15, false if the block ends first
+    bool readLength(const uint8_t *source, size_t sourceSize, size_t &position, size_t &length) {
+        uint8_t byte;
+        do {
+            if (position >= sourceSize) return false;
+            byte = source[position++];
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+
+    //Null when the sequence does not fit in the destination
+    uint8_t *writeSequence(uint8_t *destination, const uint8_t *destinationEnd, const uint8_t *literals,
+                           size_t literalCount, size_t distance, size_t matchLength, bool last) {
+        size_t worstCase = 1 + literalCount / 255 + 1 + literalCount + (last ? 0 : 2 + matchLength / 255 + 1);
+        if (worstCase > (size_t) (destinationEnd - destination)) return nullptr;
+        uint8_t *token = destination++;
+        *token = (uint8_t) ((literalCount >= 15 ? 15 : literalCount) << 4);
+        if (literalCount >= 15) destination = writeLength(destination, literalCount - 15);
+        if (literalCount > 0) memcpy(destination, literals, literalCount);
+        destination += literalCount;
+        if (last) return destination;
+        *destination++ = (uint8_t) (distance & 0xFF);
+        *destination++ = (uint8_t) (distance >> 8);
+        size_t matchCode = matchLength - MIN_MATCH;
+        *token |= (uint8_t) (matchCode >= 15 ? 15 : matchCode);
+        if (matchCode >= 15) destination = writeLength(destination, matchCode - 15);
+        return destination;
+    }
+}
+
+size_t LZ4::compressBound(size_t sourceSize) {
+    return sourceSize + sourceSize / 255 + 16;
+}
+
+size_t LZ4::compress(const uint8_t *source, size_t sourceSize, uint8_t *destination, size_t destinationSize) {
+    uint8_t *output = destination;
+    const uint8_t *outputEnd = destination + destinationSize;
+    size_t anchor = 0;
+    if (sourceSize > MATCH_LIMIT) {
+        //Position + 1 of the last sequence with each hash, 0 for none
+        std::vector<uint32_t> table(1u << HASH_BITS, 0);
+        size_t position = 0;
+        while (position + MATCH_LIMIT <= sourceSize) {
+            uint32_t sequence = read32(source + position);
+            uint32_t &slot = table[hash(sequence)];
+            size_t candidate = slot;
+            slot = (uint32_t) (position + 1);
+            if (candidate == 0 || position - (candidate - 1) > MAX_DISTANCE || read32(source + candidate - 1) != sequence) {
+                //Incompressible runs are skipped faster the longer they get
+                position += 1 + ((position - anchor) >> 6);
+                continue;
+            }
+            size_t reference = candidate - 1;
+            size_t matchEnd = position + MIN_MATCH;
+            size_t limit = sourceSize - LAST_LITERALS;
+            while (matchEnd < limit && source[matchEnd] == source[reference + (matchEnd - position)]) matchEnd++;
+            while (position > anchor && reference > 0 && source[position - 1] == source[reference - 1]) {
+                position--;
+                reference--;
+            }
+            output = writeSequence(output, outputEnd, source + anchor, position - anchor, position - reference,
+                                   matchEnd - position, false);
+            if (output == nullptr) return 0;
+            position = anchor = matchEnd;
+        }
+    }
+    output = writeSequence(output, outputEnd, source + anchor, sourceSize - anchor, 0, 0, true);
+    if (output == nullptr) return 0;
+    return (size_t) (output - destination);
+}
+
+bool LZ4::decompress(const uint8_t *source, size_t sourceSize, uint8_t *destination, size_t destinationSize) {
+    size_t input = 0, written = 0;
+    for (;;) {
+        if (input >= sourceSize) return false;
+        uint8_t token = source[input++];
+        size_t literalCount = token >> 4;
+        if (literalCount == 15 && !readLength(source, sourceSize, input, literalCount)) return false;
+        if (literalCount > sourceSize - input || literalCount > destinationSize - written) return false;
+        //Short runs are copied with a fixed size, which compiles to two moves, when both buffers have the room
+        if (literalCount <= FAST_COPY && sourceSize - input >= FAST_COPY && destinationSize - written >= FAST_COPY) {
+            memcpy(destination + written, source + input, FAST_COPY);
+        } else if (literalCount > 0) {
+            memcpy(destination + written, source + input, literalCount);
+        }
+        input += literalCount;
+        written += literalCount;
+        //Only the last sequence ends without a match
+        if (input == sourceSize) return written == destinationSize;
+
+        if (sourceSize - input < 2) return false;
+        size_t distance = source[input] | (size_t) source[input + 1] << 8;
+        input += 2;
+        if (distance == 0 || distance > written) return false;
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !readLength(source, sourceSize, input, matchLength)) return false;
+        matchLength += MIN_MATCH;
+        if (matchLength > destinationSize - written) return false;
+        uint8_t *target = destination + written;
+        const uint8_t *match = target - distance;
+        if (matchLength <= FAST_COPY && distance >= FAST_COPY && destinationSize - written >= FAST_COPY) {
+            memcpy(target, match, FAST_COPY);
+        } else if (distance >= matchLength) {
+            memcpy(target, match, matchLength);
+        } else {
+            //Overlapping matches repeat the last distance bytes, and so repeat any multiple of them: the period is
+            //doubled after every copy so runs (distance 1) take a logarithmic number of copies
+            size_t period = distance;
+            for (size_t remaining = matchLength; remaining > 0;) {
+                size_t chunk = period < remaining ? period : remaining;
+                memcpy(target, target - period, chunk);
+                target += chunk;
+                remaining -= chunk;
+                period *= 2;
+            }
+        }
+        written += matchLength;
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef VULKANBASE_LZ4_H
+#define VULKANBASE_LZ4_H
+
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * LZ4 block format, no frame: the sizes live in the pack index. Compression is the greedy single hash probe of the
+ * reference implementation, meant for cooking assets offline. Decompression treats the block as untrusted, a corrupt
+ * one only makes it return false.
+ */
+namespace LZ4 {
+    /*
+     * Worst case compressed size of sourceSize bytes
+     */
+    size_t compressBound(size_t sourceSize);
+
+    /*
+     * Returns the compressed size, 0 when it does not fit in destinationSize
+     */
+    size_t compress(const uint8_t *source, size_t sourceSize, uint8_t *destination, size_t destinationSize);
+
+    /*
+     * True when the block decodes to exactly destinationSize bytes
+     */
+    bool decompress(const uint8_t *source, size_t sourceSize, uint8_t *destination, size_t destinationSize);
+}
+
+
+#endif //VULKANBASE_LZ4_H
@@ -0,0 +1,153 @@
+#include "MappedFile.h"
+#include <utility>
+
+#if defined(_WIN32)
+
+#include <windows.h>
+
+#else
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+        close();
+        std::swap(mapping, other.mapping);
+        std::swap(length, other.length);
+#if defined(_WIN32)
+        std::swap(fileHandle, other.fileHandle);
+        std::swap(mappingHandle, other.mappingHandle);
+#endif
+    }
+    return *this;
+}
+
+#if defined(_WIN32)
+
+bool MappedFile::open(const std::string &path) {
+    close();
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        return false;
+    }
+    fileHandle = file;
+    length = (size_t) fileSize.QuadPart;
+    if (length == 0) return true;
+    mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mappingHandle != nullptr) {
+        mapping = static_cast<const uint8_t *>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (mapping == nullptr) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::prefetch(size_t offset, size_t size) const {
+    //PrefetchVirtualMemory needs Windows 8, the first touch reads the pages otherwise
+#if _WIN32_WINNT >= 0x0602
+    if (mapping == nullptr || offset >= length) return;
+    WIN32_MEMORY_RANGE_ENTRY range;
+    range.VirtualAddress = const_cast<uint8_t *>(mapping + offset);
+    range.NumberOfBytes = size < length - offset ? size : length - offset;
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif
+}
+
+bool MappedFile::dropCachedPages(const std::string &path) {
+    return false;
+}
+
+void MappedFile::close() {
+    if (mapping != nullptr) UnmapViewOfFile(mapping);
+    if (mappingHandle != nullptr) CloseHandle(mappingHandle);
+    if (fileHandle != nullptr) CloseHandle(fileHandle);
+    mapping = nullptr;
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+    length = 0;
+}
+
+#else
+
+bool MappedFile::open(const std::string &path) {
+    close();
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) return false;
+    struct stat fileStatus{};
+    if (fstat(file, &fileStatus) != 0) {
+        ::close(file);
+        return false;
+    }
+    length = (size_t) fileStatus.st_size;
+    if (length > 0) {
+        void *address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, file, 0);
+        if (address == MAP_FAILED) {
+            ::close(file);
+            length = 0;
+            return false;
+        }
+        //Decoders read front to back
+        madvise(address, length, MADV_SEQUENTIAL);
+        mapping = static_cast<const uint8_t *>(address);
+    }
+    //The mapping keeps its own reference to the file
+    ::close(file);
+    return true;
+}
+
+void MappedFile::prefetch(size_t offset, size_t size) const {
+    if (mapping == nullptr || offset >= length) return;
+    size_t end = size < length - offset ? offset + size : length;
+    //madvise takes page aligned addresses
+    size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+    size_t begin = offset / pageSize * pageSize;
+    madvise(const_cast<uint8_t *>(mapping) + begin, end - begin, MADV_WILLNEED);
+}
+
+bool MappedFile::dropCachedPages(const std::string &path) {
+#if defined(__APPLE__)
+    return false;
+#else
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) return false;
+    //Dirty pages are not dropped, a file just written has to reach the disk first
+    bool dropped = fdatasync(file) == 0 && posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    ::close(file);
+    return dropped;
+#endif
+}
+
+void MappedFile::close() {
+    if (mapping != nullptr) munmap(const_cast<uint8_t *>(mapping), length);
+    mapping = nullptr;
+    length = 0;
+}
+
+#endif
+
+const uint8_t *MappedFile::data() const {
+    return mapping;
+}
+
+size_t MappedFile::size() const {
+    return length;
+}
@@ -0,0 +1,59 @@
+#ifndef VULKANBASE_MAPPEDFILE_H
+#define VULKANBASE_MAPPEDFILE_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Read only memory mapping of a whole file, pages are only read from disk when touched.
+ * Move only, the mapping is released with the object.
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    ~MappedFile();
+
+    MappedFile(MappedFile &&other) noexcept;
+
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    /*
+     * Maps the file, closing any previous one. False when it cannot be opened or mapped.
+     * An empty file opens with a null data pointer.
+     */
+    bool open(const std::string &path);
+
+    void close();
+
+    const uint8_t *data() const;
+
+    size_t size() const;
+
+    /*
+     * Asks the system to start reading a range in the background, a hint that never blocks
+     */
+    void prefetch(size_t offset, size_t size) const;
+
+    /*
+     * Evicts the file from the page cache so the next read comes from the disk, for cold load measurements.
+     * False where the platform cannot do it without privileges.
+     */
+    static bool dropCachedPages(const std::string &path);
+
+private:
+    const uint8_t *mapping = nullptr;
+    size_t length = 0;
+#if defined(_WIN32)
+    void *fileHandle = nullptr;
+    void *mappingHandle = nullptr;
+#endif
+};
+
+
+#endif //VULKANBASE_MAPPEDFILE_H
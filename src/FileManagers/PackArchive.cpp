@@ -0,0 +1,189 @@
+#include "PackArchive.h"
+#include "LZ4.h"
+#include <cstring>
+
+namespace {
+    const char MAGIC[4] = {'V', 'P', 'A', 'K'};
+    const size_t INDEX_ENTRY_SIZE = 32;
+
+    uint32_t readLittleEndian32(const uint8_t *data) {
+        return (uint32_t) data[0] | (uint32_t) data[1] << 8 | (uint32_t) data[2] << 16 | (uint32_t) data[3] << 24;
+    }
+
+    uint64_t readLittleEndian64(const uint8_t *data) {
+        return (uint64_t) readLittleEndian32(data) | (uint64_t) readLittleEndian32(data + 4) << 32;
+    }
+
+    void writeLittleEndian32(uint8_t *data, uint32_t value) {
+        for (int i = 0; i < 4; ++i) data[i] = (uint8_t) (value >> (8 * i));
+    }
+
+    void writeLittleEndian64(uint8_t *data, uint64_t value) {
+        for (int i = 0; i < 8; ++i) data[i] = (uint8_t) (value >> (8 * i));
+    }
+}
+
+bool PackArchive::open(const std::string &path) {
+    entries.clear();
+    if (!file.open(path)) return false;
+    const uint8_t *data = file.data();
+    uint64_t fileSize = file.size();
+    if (fileSize < HEADER_SIZE || memcmp(data, MAGIC, 4) != 0 || readLittleEndian32(data + 4) != VERSION) {
+        file.close();
+        return false;
+    }
+    uint32_t entryCount = readLittleEndian32(data + 8);
+    uint64_t indexOffset = readLittleEndian64(data + 16);
+    uint64_t indexSize = readLittleEndian64(data + 24);
+    if (indexOffset > fileSize || indexSize > fileSize - indexOffset) {
+        file.close();
+        return false;
+    }
+    const uint8_t *index = data + indexOffset;
+    uint64_t position = 0;
+    for (uint32_t i = 0; i < entryCount; ++i) {
+        if (indexSize - position < INDEX_ENTRY_SIZE) break;
+        const uint8_t *record = index + position;
+        Entry entry{};
+        entry.offset = readLittleEndian64(record);
+        entry.storedSize = readLittleEndian64(record + 8);
+        entry.size = readLittleEndian64(record + 16);
+        entry.flags = readLittleEndian32(record + 24);
+        uint32_t nameLength = readLittleEndian32(record + 28);
+        position += INDEX_ENTRY_SIZE;
+        bool valid = nameLength <= indexSize - position && entry.offset <= indexOffset &&
+                     entry.storedSize <= indexOffset - entry.offset && entry.size <= SIZE_MAX &&
+                     (entry.flags & ~(uint32_t) COMPRESSED_LZ4) == 0 &&
+                     ((entry.flags & COMPRESSED_LZ4) != 0 || entry.storedSize == entry.size) &&
+                     //LZ4 cannot expand more than 255 times, a larger size would only allocate for a failing read
+                     entry.size / 255 <= entry.storedSize;
+        if (!valid) break;
+        entries.emplace(std::string(reinterpret_cast<const char *>(index + position), nameLength), entry);
+        position += nameLength;
+    }
+    if (entries.size() != entryCount || position != indexSize) {
+        entries.clear();
+        file.close();
+        return false;
+    }
+    return true;
+}
+
+const PackArchive::Entry *PackArchive::find(const std::string &name) const {
+    auto entry = entries.find(name);
+    return entry == entries.end() ? nullptr : &entry->second;
+}
+
+const uint8_t *PackArchive::storedData(const Entry &entry) const {
+    return file.data() + entry.offset;
+}
+
+bool PackArchive::read(const Entry &entry, uint8_t *destination) const {
+    if ((entry.flags & COMPRESSED_LZ4) != 0) {
+        return LZ4::decompress(storedData(entry), entry.storedSize, destination, entry.size);
+    }
+    if (entry.size > 0) memcpy(destination, storedData(entry), entry.size);
+    return true;
+}
+
+void PackArchive::prefetch(const Entry &entry) const {
+    file.prefetch(entry.offset, entry.storedSize);
+}
+
+std::vector<std::string> PackArchive::names() const {
+    std::vector<std::string> result;
+    result.reserve(entries.size());
+    for (auto &entry : entries) result.push_back(entry.first);
+    return result;
+}
+
+PackArchiveWriter::PackArchiveWriter(uint32_t alignment) : alignment(alignment == 0 ? 1 : alignment) {}
+
+PackArchiveWriter::~PackArchiveWriter() {
+    if (output != nullptr) fclose(output);
+}
+
+bool PackArchiveWriter::open(const std::string &path) {
+    if (output != nullptr) fclose(output);
+    index.clear();
+    position = 0;
+    storedBytes = 0;
+    output = fopen(path.c_str(), "wb");
+    if (output == nullptr) return false;
+    //The header is rewritten by finish once the index offset is known
+    uint8_t header[PackArchive::HEADER_SIZE] = {};
+    return write(header, sizeof(header));
+}
+
+bool PackArchiveWriter::add(const std::string &name, const uint8_t *data, size_t size, bool compress) {
+    if (output == nullptr || !pad()) return false;
+    IndexEntry indexEntry{name, {}};
+    indexEntry.entry.offset = position;
+    indexEntry.entry.size = size;
+    bool written = false;
+    if (compress && size > 0) {
+        std::vector<uint8_t> compressed(LZ4::compressBound(size));
+        size_t compressedSize = LZ4::compress(data, size, compressed.data(), compressed.size());
+        if (compressedSize > 0 && compressedSize < size) {
+            if (!write(compressed.data(), compressedSize)) return false;
+            indexEntry.entry.storedSize = compressedSize;
+            indexEntry.entry.flags = PackArchive::COMPRESSED_LZ4;
+            written = true;
+        }
+    }
+    if (!written) {
+        if (!write(data, size)) return false;
+        indexEntry.entry.storedSize = size;
+        indexEntry.entry.flags = 0;
+    }
+    storedBytes += indexEntry.entry.storedSize;
+    index.push_back(std::move(indexEntry));
+    return true;
+}
+
+bool PackArchiveWriter::finish() {
+    if (output == nullptr) return false;
+    uint64_t indexOffset = position;
+    bool success = true;
+    for (auto &indexEntry : index) {
+        uint8_t record[INDEX_ENTRY_SIZE];
+        writeLittleEndian64(record, indexEntry.entry.offset);
+        writeLittleEndian64(record + 8, indexEntry.entry.storedSize);
+        writeLittleEndian64(record + 16, indexEntry.entry.size);
+        writeLittleEndian32(record + 24, indexEntry.entry.flags);
+        writeLittleEndian32(record + 28, (uint32_t) indexEntry.name.size());
+        success = success && write(record, sizeof(record)) && write(indexEntry.name.data(), indexEntry.name.size());
+    }
+    uint8_t header[PackArchive::HEADER_SIZE];
+    memcpy(header, MAGIC, 4);
+    writeLittleEndian32(header + 4, PackArchive::VERSION);
+    writeLittleEndian32(header + 8, (uint32_t) index.size());
+    writeLittleEndian32(header + 12, alignment);
+    writeLittleEndian64(header + 16, indexOffset);
+    writeLittleEndian64(header + 24, position - indexOffset);
+    success = success && fseek(output, 0, SEEK_SET) == 0 && fwrite(header, 1, sizeof(header), output) == sizeof(header);
+    success = fclose(output) == 0 && success;
+    output = nullptr;
+    return success;
+}
+
+uint64_t PackArchiveWriter::getStoredBytes() const {
+    return storedBytes;
+}
+
+bool PackArchiveWriter::write(const void *data, size_t size) {
+    if (size > 0 && fwrite(data, 1, size, output) != size) return false;
+    position += size;
+    return true;
+}
+
+bool PackArchiveWriter::pad() {
+    static const uint8_t zeros[256] = {};
+    uint64_t padding = (alignment - position % alignment) % alignment;
+    while (padding > 0) {
+        size_t chunk = padding < sizeof(zeros) ? (size_t) padding : sizeof(zeros);
+        if (!write(zeros, chunk)) return false;
+        padding -= chunk;
+    }
+    return true;
+}
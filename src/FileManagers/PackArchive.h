@@ -0,0 +1,114 @@
+#ifndef VULKANBASE_PACKARCHIVE_H
+#define VULKANBASE_PACKARCHIVE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <unordered_map>
+#include "MappedFile.h"
+
+/*
+ * Single file holding many assets, read through a memory mapping so uncompressed entries are used in place.
+ * Layout, little endian:
+ *  header: "VPAK", version, entry count, blob alignment (u32 each), index offset, index size (u64 each)
+ *  blobs: one per entry, each starting at a multiple of the alignment
+ *  index: per entry offset, stored size, size (u64 each), flags, name length (u32 each), name bytes
+ * Names are relative paths with forward slashes.
+ */
+class PackArchive {
+public:
+    enum Flags : uint32_t {
+        //The blob is an LZ4 block that decodes to size bytes
+        COMPRESSED_LZ4 = 1
+    };
+
+    struct Entry {
+        uint64_t offset;
+        uint64_t storedSize;
+        uint64_t size;
+        uint32_t flags;
+    };
+
+    static const uint32_t VERSION = 1;
+    static const size_t HEADER_SIZE = 32;
+
+    /*
+     * Maps the archive and loads its index. False when it cannot be opened or any entry falls outside the file.
+     */
+    bool open(const std::string &path);
+
+    /*
+     * Null when the archive has no entry with that name
+     */
+    const Entry *find(const std::string &name) const;
+
+    /*
+     * The stored bytes of an entry, compressed or not
+     */
+    const uint8_t *storedData(const Entry &entry) const;
+
+    /*
+     * Writes the entry decompressed to destination, which holds entry.size bytes. False for a corrupt blob.
+     */
+    bool read(const Entry &entry, uint8_t *destination) const;
+
+    /*
+     * Asks the system to start reading the blob of an entry in the background
+     */
+    void prefetch(const Entry &entry) const;
+
+    std::vector<std::string> names() const;
+
+private:
+    MappedFile file;
+    std::unordered_map<std::string, Entry> entries;
+};
+
+/*
+ * Builds a pack archive by appending the blobs as they are added, only the index is kept in memory until finish
+ */
+class PackArchiveWriter {
+public:
+    explicit PackArchiveWriter(uint32_t alignment = 64);
+
+    ~PackArchiveWriter();
+
+    PackArchiveWriter(const PackArchiveWriter &) = delete;
+
+    PackArchiveWriter &operator=(const PackArchiveWriter &) = delete;
+
+    bool open(const std::string &path);
+
+    /*
+     * With compress the blob is stored as LZ4 only when that makes it smaller
+     */
+    bool add(const std::string &name, const uint8_t *data, size_t size, bool compress);
+
+    /*
+     * Writes the index and the header and closes the file
+     */
+    bool finish();
+
+    uint64_t getStoredBytes() const;
+
+private:
+    struct IndexEntry {
+        std::string name;
+        PackArchive::Entry entry;
+    };
+
+    uint32_t alignment;
+    FILE *output = nullptr;
+    uint64_t position = 0;
+    uint64_t storedBytes = 0;
+    std::vector<IndexEntry> index;
+
+    bool write(const void *data, size_t size);
+
+    bool pad();
+};
+
+
+#endif //VULKANBASE_PACKARCHIVE_H
@@ -0,0 +1,348 @@
+#include "TiledHeightfield.h"
+#include "LZ4.h"
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+
+#ifdef HAVE_ZSTD
+
+#include <zstd.h>
+
+#endif
+
+namespace {
+    const char MAGIC[4] = {'V', 'T', 'H', 'F'};
+    const size_t HEADER_SIZE = 32;
+    const size_t TILE_RECORD_SIZE = 16;
+    //Same bounds as the image decoders for the untrusted header
+    const uint32_t MAX_DIMENSION = 1 << 16;
+    const uint64_t MAX_PIXELS = 1ull << 28;
+    const uint32_t MIN_TILE_SIZE = 16;
+    const uint32_t MAX_TILE_SIZE = 4096;
+    //Bands of tiles are decoded together until they hold about this many samples, as RGBA float rows in the sink
+    const size_t BAND_SAMPLES = 1024 * 1024;
+
+    struct Header {
+        uint32_t width;
+        uint32_t height;
+        uint32_t tileSize;
+        TiledHeightfield::SampleFormat format;
+        uint32_t tilesX;
+        uint32_t tilesY;
+    };
+
+    struct TileRecord {
+        uint64_t offset;
+        uint32_t storedSize;
+        TiledHeightfield::Codec codec;
+    };
+
+    //Where the decoded rows of a tile go, the rows of the sink and its heights if it keeps them, stride samples apart
+    struct TileDestination {
+        glm::vec4 *rows;
+        float *heights;
+        size_t stride;
+    };
+
+    uint32_t readLittleEndian32(const uint8_t *data) {
+        return (uint32_t) data[0] | (uint32_t) data[1] << 8 | (uint32_t) data[2] << 16 | (uint32_t) data[3] << 24;
+    }
+
+    uint64_t readLittleEndian64(const uint8_t *data) {
+        return (uint64_t) readLittleEndian32(data) | (uint64_t) readLittleEndian32(data + 4) << 32;
+    }
+
+    void writeLittleEndian32(uint8_t *data, uint32_t value) {
+        for (int i = 0; i < 4; ++i) data[i] = (uint8_t) (value >> (8 * i));
+    }
+
+    void writeLittleEndian64(uint8_t *data, uint64_t value) {
+        for (int i = 0; i < 8; ++i) data[i] = (uint8_t) (value >> (8 * i));
+    }
+
+    uint32_t sampleBytes(TiledHeightfield::SampleFormat format) {
+        return format == TiledHeightfield::UNORM16 ? 2 : 4;
+    }
+
+    uint32_t sampleBits(float height, TiledHeightfield::SampleFormat format) {
+        if (format == TiledHeightfield::UNORM16) {
+            return (uint32_t) std::lround(std::min(std::max(height, 0.0f), 1.0f) * 65535.0f);
+        }
+        uint32_t bits;
+        memcpy(&bits, &height, sizeof(float));
+        return bits;
+    }
+
+    float sampleHeight(uint32_t bits, TiledHeightfield::SampleFormat format) {
+        if (format == TiledHeightfield::UNORM16) return bits / 65535.0f;
+        float height;
+        memcpy(&height, &bits, sizeof(float));
+        return height;
+    }
+
+    /*
+     * Stored bytes of a tile: little endian samples, filtered into byte planes when the codec compresses
+     */
+    void encodeSamples(const float *heights, size_t stride, uint32_t tileWidth, uint32_t tileHeight,
+                       TiledHeightfield::SampleFormat format, bool filter, uint8_t *bytes) {
+        uint32_t byteCount = sampleBytes(format);
+        size_t count = (size_t) tileWidth * tileHeight;
+        //Samples wrap around on overflow, so the deltas are reversible for any bit pattern
+        uint32_t mask = byteCount == 2 ? 0xFFFFu : 0xFFFFFFFFu;
+        for (uint32_t y = 0; y < tileHeight; ++y) {
+            uint32_t previous = 0;
+            for (uint32_t x = 0; x < tileWidth; ++x) {
+                uint32_t bits = sampleBits(heights[y * stride + x], format);
+                size_t index = (size_t) y * tileWidth + x;
+                if (!filter) {
+                    for (uint32_t b = 0; b < byteCount; ++b) bytes[index * byteCount + b] = (uint8_t) (bits >> (8 * b));
+                    continue;
+                }
+                uint32_t delta = (bits - previous) & mask;
+                previous = bits;
+                for (uint32_t b = 0; b < byteCount; ++b) bytes[b * count + index] = (uint8_t) (delta >> (8 * b));
+            }
+        }
+    }
+
+    /*
+     * Rows firstRow to firstRow + rowCount of the tile, every row is filtered on its own.
+     * Sample size as a template argument so the byte loops unroll, this is the hot loop of a load.
+     */
+    template<uint32_t BYTE_COUNT>
+    void decodeSamples(const uint8_t *bytes, uint32_t tileWidth, uint32_t tileHeight, uint32_t firstRow,
+                       uint32_t rowCount, bool filtered, const TileDestination &destination) {
+        const TiledHeightfield::SampleFormat format = BYTE_COUNT == 2 ? TiledHeightfield::UNORM16
+                                                                      : TiledHeightfield::FLOAT32;
+        const uint32_t mask = BYTE_COUNT == 2 ? 0xFFFFu : 0xFFFFFFFFu;
+        size_t count = (size_t) tileWidth * tileHeight;
+        for (uint32_t y = firstRow; y < firstRow + rowCount; ++y) {
+            uint32_t previous = 0;
+            size_t rowOffset = (y - firstRow) * destination.stride;
+            glm::vec4 *row = destination.rows + rowOffset;
+            float *heightRow = destination.heights != nullptr ? destination.heights + rowOffset : nullptr;
+            for (uint32_t x = 0; x < tileWidth; ++x) {
+                size_t index = (size_t) y * tileWidth + x;
+                uint32_t bits = 0;
+                if (filtered) {
+                    for (uint32_t b = 0; b < BYTE_COUNT; ++b) bits |= (uint32_t) bytes[b * count + index] << (8 * b);
+                    bits = (bits + previous) & mask;
+                    previous = bits;
+                } else {
+                    for (uint32_t b = 0; b < BYTE_COUNT; ++b) bits |= (uint32_t) bytes[index * BYTE_COUNT + b] << (8 * b);
+                }
+                float height = sampleHeight(bits, format);
+                row[x] = glm::vec4(height, height, height, 1.0f);
+                if (heightRow != nullptr) heightRow[x] = height;
+            }
+        }
+    }
+
+    void decodeSamples(const uint8_t *bytes, uint32_t tileWidth, uint32_t tileHeight, uint32_t firstRow,
+                       uint32_t rowCount, TiledHeightfield::SampleFormat format, bool filtered,
+                       const TileDestination &destination) {
+        if (format == TiledHeightfield::UNORM16) {
+            decodeSamples<2>(bytes, tileWidth, tileHeight, firstRow, rowCount, filtered, destination);
+        } else {
+            decodeSamples<4>(bytes, tileWidth, tileHeight, firstRow, rowCount, filtered, destination);
+        }
+    }
+
+    bool readHeader(const uint8_t *data, size_t size, Header &header) {
+        if (size < HEADER_SIZE || memcmp(data, MAGIC, 4) != 0 ||
+            readLittleEndian32(data + 4) != TiledHeightfield::VERSION)
+            return false;
+        header.width = readLittleEndian32(data + 8);
+        header.height = readLittleEndian32(data + 12);
+        header.tileSize = readLittleEndian32(data + 16);
+        uint32_t format = readLittleEndian32(data + 20);
+        if (header.width == 0 || header.height == 0 || header.width > MAX_DIMENSION || header.height > MAX_DIMENSION ||
+            (uint64_t) header.width * header.height > MAX_PIXELS || header.tileSize < MIN_TILE_SIZE ||
+            header.tileSize > MAX_TILE_SIZE || format > TiledHeightfield::FLOAT32)
+            return false;
+        header.format = (TiledHeightfield::SampleFormat) format;
+        header.tilesX = (header.width + header.tileSize - 1) / header.tileSize;
+        header.tilesY = (header.height + header.tileSize - 1) / header.tileSize;
+        return true;
+    }
+
+    uint32_t tileExtent(uint32_t tile, uint32_t tileSize, uint32_t size) {
+        return std::min(tileSize, size - tile * tileSize);
+    }
+
+    /*
+     * Decompresses the whole tile into scratch, then writes rows firstRow to firstRow + rowCount of it
+     */
+    bool decodeTile(const uint8_t *data, const Header &header, const TileRecord &record, uint32_t tileWidth,
+                    uint32_t tileHeight, uint32_t firstRow, uint32_t rowCount, std::vector<uint8_t> &scratch,
+                    const TileDestination &destination) {
+        size_t tileBytes = (size_t) tileWidth * tileHeight * sampleBytes(header.format);
+        const uint8_t *stored = data + record.offset;
+        if (record.codec == TiledHeightfield::CODEC_RAW) {
+            decodeSamples(stored, tileWidth, tileHeight, firstRow, rowCount, header.format, false, destination);
+            return true;
+        }
+        scratch.resize(tileBytes);
+        if (record.codec == TiledHeightfield::CODEC_LZ4) {
+            if (!LZ4::decompress(stored, record.storedSize, scratch.data(), tileBytes)) return false;
+        } else {
+#ifdef HAVE_ZSTD
+            size_t decompressed = ZSTD_decompress(scratch.data(), tileBytes, stored, record.storedSize);
+            if (ZSTD_isError(decompressed) || decompressed != tileBytes) return false;
+#else
+            return false;
+#endif
+        }
+        decodeSamples(scratch.data(), tileWidth, tileHeight, firstRow, rowCount, header.format, true, destination);
+        return true;
+    }
+}
+
+bool TiledHeightfield::codecSupported(Codec codec) {
+#ifdef HAVE_ZSTD
+    return codec <= CODEC_ZSTD;
+#else
+    return codec <= CODEC_LZ4;
+#endif
+}
+
+bool TiledHeightfield::write(const std::string &path, const float *heights, uint32_t width, uint32_t height,
+                             SampleFormat format, Codec codec, uint32_t tileSize, int level, ThreadPool *threadPool) {
+    if (!codecSupported(codec) || width == 0 || height == 0 || tileSize < MIN_TILE_SIZE || tileSize > MAX_TILE_SIZE)
+        return false;
+    uint32_t tilesX = (width + tileSize - 1) / tileSize;
+    uint32_t tilesY = (height + tileSize - 1) / tileSize;
+    uint32_t tileCount = tilesX * tilesY;
+    std::vector<std::vector<uint8_t>> tiles(tileCount);
+    std::vector<Codec> codecs(tileCount, codec);
+    auto encodeTiles = [&](uint32_t begin, uint32_t end) {
+        std::vector<uint8_t> samples;
+        for (uint32_t tile = begin; tile < end; ++tile) {
+            uint32_t tileX = tile % tilesX, tileY = tile / tilesX;
+            uint32_t tileWidth = tileExtent(tileX, tileSize, width), tileHeight = tileExtent(tileY, tileSize, height);
+            size_t tileBytes = (size_t) tileWidth * tileHeight * sampleBytes(format);
+            const float *origin = heights + (size_t) tileY * tileSize * width + (size_t) tileX * tileSize;
+            std::vector<uint8_t> &stored = tiles[tile];
+            if (codec != CODEC_RAW) {
+                samples.resize(tileBytes);
+                encodeSamples(origin, width, tileWidth, tileHeight, format, true, samples.data());
+                size_t storedSize = 0;
+                if (codec == CODEC_LZ4) {
+                    stored.resize(LZ4::compressBound(tileBytes));
+                    storedSize = LZ4::compress(samples.data(), tileBytes, stored.data(), stored.size());
+                } else {
+#ifdef HAVE_ZSTD
+                    stored.resize(ZSTD_compressBound(tileBytes));
+                    storedSize = ZSTD_compress(stored.data(), stored.size(), samples.data(), tileBytes, level);
+                    if (ZSTD_isError(storedSize)) storedSize = 0;
+#endif
+                }
+                //Tiles that do not compress, like noise, are kept raw
+                if (storedSize > 0 && storedSize < tileBytes) {
+                    stored.resize(storedSize);
+                    continue;
+                }
+            }
+            codecs[tile] = CODEC_RAW;
+            stored.resize(tileBytes);
+            encodeSamples(origin, width, tileWidth, tileHeight, format, false, stored.data());
+        }
+    };
+    if (threadPool != nullptr) threadPool->parallelFor(tileCount, 1, encodeTiles);
+    else encodeTiles(0, tileCount);
+
+    std::vector<uint8_t> header(HEADER_SIZE + (size_t) tileCount * TILE_RECORD_SIZE, 0);
+    memcpy(header.data(), MAGIC, 4);
+    writeLittleEndian32(&header[4], VERSION);
+    writeLittleEndian32(&header[8], width);
+    writeLittleEndian32(&header[12], height);
+    writeLittleEndian32(&header[16], tileSize);
+    writeLittleEndian32(&header[20], format);
+    uint64_t offset = header.size();
+    for (uint32_t tile = 0; tile < tileCount; ++tile) {
+        uint8_t *record = &header[HEADER_SIZE + (size_t) tile * TILE_RECORD_SIZE];
+        writeLittleEndian64(record, offset);
+        writeLittleEndian32(record + 8, (uint32_t) tiles[tile].size());
+        writeLittleEndian32(record + 12, codecs[tile]);
+        offset += tiles[tile].size();
+    }
+    FILE *output = fopen(path.c_str(), "wb");
+    if (output == nullptr) return false;
+    bool success = fwrite(header.data(), 1, header.size(), output) == header.size();
+    for (auto &tile : tiles) {
+        success = success && fwrite(tile.data(), 1, tile.size(), output) == tile.size();
+    }
+    return fclose(output) == 0 && success;
+}
+
+bool TiledHeightfield::decode(const uint8_t *data, size_t size, BitmapSink &sink, ThreadPool *threadPool) {
+    Header header{};
+    if (!readHeader(data, size, header)) return false;
+    uint64_t tileCount = (uint64_t) header.tilesX * header.tilesY;
+    if (tileCount > (size - HEADER_SIZE) / TILE_RECORD_SIZE) return false;
+    std::vector<TileRecord> records(tileCount);
+    for (uint32_t tile = 0; tile < tileCount; ++tile) {
+        const uint8_t *record = data + HEADER_SIZE + (size_t) tile * TILE_RECORD_SIZE;
+        TileRecord &tileRecord = records[tile];
+        tileRecord.offset = readLittleEndian64(record);
+        tileRecord.storedSize = readLittleEndian32(record + 8);
+        uint32_t codec = readLittleEndian32(record + 12);
+        if (codec > CODEC_ZSTD || !codecSupported((Codec) codec)) return false;
+        tileRecord.codec = (Codec) codec;
+        if (tileRecord.offset > size || tileRecord.storedSize > size - tileRecord.offset) return false;
+        uint32_t tileWidth = tileExtent(tile % header.tilesX, header.tileSize, header.width);
+        uint32_t tileHeight = tileExtent(tile / header.tilesX, header.tileSize, header.height);
+        size_t tileBytes = (size_t) tileWidth * tileHeight * sampleBytes(header.format);
+        if (tileRecord.codec == CODEC_RAW && tileRecord.storedSize != tileBytes) return false;
+    }
+
+    //Enough tile rows per band to give every thread a few tiles, while the band stays a few MB
+    uint32_t threads = threadPool != nullptr ? threadPool->getThreadCount() + 1 : 1;
+    uint32_t bandTileRows = std::max<uint32_t>(1, (threads * 4 + header.tilesX - 1) / header.tilesX);
+    bandTileRows = std::min<uint32_t>(bandTileRows, (uint32_t) std::max<size_t>(
+            1, BAND_SAMPLES / ((size_t) header.width * header.tileSize)));
+    uint32_t bandRows = bandTileRows * header.tileSize;
+
+    sink.begin(header.width, header.height);
+    for (uint32_t firstRow = 0; firstRow < header.height;) {
+        //Up to the end of the band, a sink that takes it all gets every tile decompressed once
+        uint32_t bandEnd = std::min(header.height, (firstRow / bandRows + 1) * bandRows);
+        glm::vec4 *rows;
+        float *heights;
+        uint32_t rowCount = sink.acquireHeightRows(firstRow, bandEnd - firstRow, rows, heights);
+        uint32_t endRow = firstRow + rowCount;
+        uint32_t firstTileRow = firstRow / header.tileSize;
+        uint32_t tileRows = (endRow - 1) / header.tileSize + 1 - firstTileRow;
+        std::atomic<bool> corrupt(false);
+        //The workers write the rows of their tiles straight into the sink
+        auto decodeTiles = [&](uint32_t begin, uint32_t end) {
+            std::vector<uint8_t> scratch;
+            for (uint32_t i = begin; i < end; ++i) {
+                uint32_t tileX = i % header.tilesX, tileY = firstTileRow + i / header.tilesX;
+                uint32_t tileWidth = tileExtent(tileX, header.tileSize, header.width);
+                uint32_t tileHeight = tileExtent(tileY, header.tileSize, header.height);
+                //Rows of the tile the sink took
+                uint32_t tileFirstRow = std::max(firstRow, tileY * header.tileSize);
+                uint32_t tileEndRow = std::min(endRow, tileY * header.tileSize + tileHeight);
+                size_t offset = (size_t) (tileFirstRow - firstRow) * header.width + (size_t) tileX * header.tileSize;
+                TileDestination destination{rows + offset, heights != nullptr ? heights + offset : nullptr,
+                                            header.width};
+                if (!decodeTile(data, header, records[(size_t) tileY * header.tilesX + tileX], tileWidth, tileHeight,
+                                tileFirstRow - tileY * header.tileSize, tileEndRow - tileFirstRow, scratch,
+                                destination)) {
+                    corrupt = true;
+                }
+            }
+        };
+        uint32_t rangeTiles = tileRows * header.tilesX;
+        if (threadPool != nullptr) threadPool->parallelFor(rangeTiles, 1, decodeTiles);
+        else decodeTiles(0, rangeTiles);
+        if (corrupt) return false;
+        sink.commitRows(firstRow, rowCount);
+        firstRow = endRow;
+    }
+    return true;
+}
@@ -0,0 +1,60 @@
+#ifndef VULKANBASE_TILEDHEIGHTFIELD_H
+#define VULKANBASE_TILEDHEIGHTFIELD_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include "Bitmap/Bitmap.h"
+#include "../ThreadPool.h"
+
+/*
+ * Cooked heightfield split in square tiles, each compressed on its own so the tiles decode in parallel.
+ * Layout, little endian:
+ *  header: "VTHF", version, width, height, tile size, sample format, 2 reserved (u32 each)
+ *  tile index: per tile, bottom tile row first, offset (u64), stored size, codec (u32 each)
+ *  tiles: the samples of the tile row by row, bottom row first, the tiles on the right and top edges are clipped
+ * Compressed tiles are filtered first: every sample minus its left neighbour, then the bytes split in planes (all
+ * the low bytes, then the next ones), which turns smooth terrain into the long runs compressors like.
+ */
+class TiledHeightfield {
+public:
+    enum SampleFormat : uint32_t {
+        //Heights in [0, 1]
+        UNORM16 = 0,
+        FLOAT32 = 1
+    };
+
+    enum Codec : uint32_t {
+        CODEC_RAW = 0,
+        //Fastest to decode
+        CODEC_LZ4 = 1,
+        //Best ratio, only available when built with Zstd
+        CODEC_ZSTD = 2
+    };
+
+    static const uint32_t VERSION = 1;
+    static const uint32_t DEFAULT_TILE_SIZE = 256;
+
+    static bool codecSupported(Codec codec);
+
+    /*
+     * heights holds width * height samples, bottom row first like the rows of a BitmapSink.
+     * Tiles are compressed in parallel when a pool is given, level only applies to Zstd.
+     */
+    static bool write(const std::string &path, const float *heights, uint32_t width, uint32_t height,
+                      SampleFormat format, Codec codec, uint32_t tileSize = DEFAULT_TILE_SIZE, int level = 9,
+                      ThreadPool *threadPool = nullptr);
+
+    /*
+     * Decodes to the sink like the image decoders, heights replicated in RGB with alpha 1.
+     * Rows are taken from the sink with acquireHeightRows a band at a time, and the tiles of a band decompress in
+     * parallel on the pool, each worker writing the rows of its tiles straight into the sink. Null decodes on the
+     * calling thread.
+     * The header and the tile index are checked before any row is written, a corrupt tile is only found when its
+     * band is decoded and makes it return false with the previous bands already committed.
+     */
+    static bool decode(const uint8_t *data, size_t size, BitmapSink &sink, ThreadPool *threadPool);
+};
+
+
+#endif //VULKANBASE_TILEDHEIGHTFIELD_H
@@ -0,0 +1,113 @@
+#include "VirtualFileSystem.h"
+#include <stdexcept>
+
+namespace {
+    //Reads a byte of every page so the consumer of an async read does not wait on the disk
+    void touchPages(const uint8_t *data, size_t size) {
+        volatile uint8_t sink = 0;
+        for (size_t offset = 0; offset < size; offset += 4096) sink ^= data[offset];
+        (void) sink;
+    }
+}
+
+const uint8_t *FileData::data() const {
+    return pointer;
+}
+
+size_t FileData::size() const {
+    return length;
+}
+
+VirtualFileSystem::VirtualFileSystem(ThreadPool &threadPool) : threadPool(threadPool) {}
+
+void VirtualFileSystem::mountDirectory(const std::string &mountPoint, const std::string &directory) {
+    Mount mount;
+    mount.point = normalize(mountPoint);
+    if (!mount.point.empty()) mount.point += '/';
+    mount.directory = directory;
+    if (!mount.directory.empty() && mount.directory.back() != '/' && mount.directory.back() != '\\') {
+        mount.directory += '/';
+    }
+    mounts.push_back(mount);
+}
+
+bool VirtualFileSystem::mountArchive(const std::string &mountPoint, const std::string &archivePath) {
+    auto archive = std::make_shared<PackArchive>();
+    if (!archive->open(archivePath)) return false;
+    Mount mount;
+    mount.point = normalize(mountPoint);
+    if (!mount.point.empty()) mount.point += '/';
+    mount.archive = archive;
+    mounts.push_back(mount);
+    return true;
+}
+
+bool VirtualFileSystem::exists(const std::string &path) const {
+    std::string name = normalize(path);
+    for (auto mount = mounts.rbegin(); mount != mounts.rend(); ++mount) {
+        if (name.compare(0, mount->point.size(), mount->point) != 0) continue;
+        std::string relative = name.substr(mount->point.size());
+        if (mount->archive != nullptr) {
+            if (mount->archive->find(relative) != nullptr) return true;
+        } else {
+            MappedFile mapping;
+            if (mapping.open(mount->directory + relative)) return true;
+        }
+    }
+    return false;
+}
+
+bool VirtualFileSystem::read(const std::string &path, FileData &file) const {
+    std::string name = normalize(path);
+    for (auto mount = mounts.rbegin(); mount != mounts.rend(); ++mount) {
+        if (name.compare(0, mount->point.size(), mount->point) != 0) continue;
+        std::string relative = name.substr(mount->point.size());
+        file = FileData();
+        if (mount->archive != nullptr) {
+            const PackArchive::Entry *entry = mount->archive->find(relative);
+            if (entry == nullptr) continue;
+            file.length = (size_t) entry->size;
+            if ((entry->flags & PackArchive::COMPRESSED_LZ4) != 0) {
+                file.bytes.resize(file.length);
+                if (!mount->archive->read(*entry, file.bytes.data())) return false;
+                file.pointer = file.bytes.data();
+            } else {
+                mount->archive->prefetch(*entry);
+                file.mapping = mount->archive;
+                file.pointer = mount->archive->storedData(*entry);
+            }
+            return true;
+        }
+        auto mapping = std::make_shared<MappedFile>();
+        if (!mapping->open(mount->directory + relative)) continue;
+        mapping->prefetch(0, mapping->size());
+        file.length = mapping->size();
+        file.pointer = mapping->data();
+        file.mapping = mapping;
+        return true;
+    }
+    return false;
+}
+
+std::future<FileData> VirtualFileSystem::readAsync(const std::string &path) const {
+    return threadPool.submit([this, path]() {
+        FileData file;
+        if (!read(path, file)) throw std::runtime_error("CANNOT READ FILE: " + path);
+        touchPages(file.data(), file.size());
+        return file;
+    });
+}
+
+std::string VirtualFileSystem::normalize(const std::string &path) {
+    std::string result;
+    result.reserve(path.size());
+    for (char c : path) {
+        if (c == '\\') c = '/';
+        //Repeated separators and the leading ones are dropped
+        if (c == '/' && (result.empty() || result.back() == '/')) continue;
+        result += c;
+    }
+    while (result.compare(0, 2, "./") == 0) result.erase(0, 2);
+    if (!result.empty() && result.back() == '/') result.pop_back();
+    return result;
+}
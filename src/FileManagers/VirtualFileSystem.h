@@ -0,0 +1,79 @@
+#ifndef VULKANBASE_VIRTUALFILESYSTEM_H
+#define VULKANBASE_VIRTUALFILESYSTEM_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <future>
+#include <cstdint>
+#include <cstddef>
+#include "PackArchive.h"
+#include "../ThreadPool.h"
+
+/*
+ * Contents of a file read through the virtual file system. Uncompressed files are a view into a mapping that the
+ * object keeps alive, compressed pack entries are decompressed into a buffer it owns.
+ */
+class FileData {
+public:
+    const uint8_t *data() const;
+
+    size_t size() const;
+
+private:
+    friend class VirtualFileSystem;
+
+    std::shared_ptr<const void> mapping;
+    std::vector<uint8_t> bytes;
+    const uint8_t *pointer = nullptr;
+    size_t length = 0;
+};
+
+/*
+ * Resolves asset paths like "Shaders/vert.spv" against mounted directories and pack archives, so the same code
+ * loads loose files while developing and a single cooked archive when shipping.
+ * A path goes to the most recent mount whose mount point prefixes it, falling back to the older ones when that
+ * mount does not have the file. Mounting is not thread safe, reads are.
+ */
+class VirtualFileSystem {
+public:
+    explicit VirtualFileSystem(ThreadPool &threadPool);
+
+    /*
+     * An empty mount point mounts at the root
+     */
+    void mountDirectory(const std::string &mountPoint, const std::string &directory);
+
+    /*
+     * False when the archive cannot be opened or its index is invalid
+     */
+    bool mountArchive(const std::string &mountPoint, const std::string &archivePath);
+
+    bool exists(const std::string &path) const;
+
+    /*
+     * False when no mount has the file or a compressed entry is corrupt
+     */
+    bool read(const std::string &path, FileData &file) const;
+
+    /*
+     * Reads on the thread pool, the pages of the file are resident once the future is ready.
+     * The future throws std::runtime_error when the file cannot be read.
+     */
+    std::future<FileData> readAsync(const std::string &path) const;
+
+private:
+    struct Mount {
+        std::string point;
+        std::string directory;
+        std::shared_ptr<PackArchive> archive;
+    };
+
+    ThreadPool &threadPool;
+    std::vector<Mount> mounts;
+
+    static std::string normalize(const std::string &path);
+};
+
+
+#endif //VULKANBASE_VIRTUALFILESYSTEM_H
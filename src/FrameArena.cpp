@@ -0,0 +1,65 @@
+#include "FrameArena.h"
+#include <cstdlib>
+#include <new>
+
+FrameArena::FrameArena(uint32_t frameSlots, size_t bytesPerFrame) : slots(frameSlots) {
+    for (auto &slot : slots) {
+        slot.block.resize(bytesPerFrame);
+    }
+}
+
+FrameArena::~FrameArena() {
+    for (auto &slot : slots) {
+        releaseOverflow(slot);
+    }
+}
+
+void FrameArena::releaseOverflow(FrameSlot &slot) {
+    while (slot.overflow != nullptr) {
+        OverflowBlock *next = slot.overflow->next;
+        std::free(slot.overflow);
+        slot.overflow = next;
+    }
+    slot.overflowBytes = 0;
+}
+
+void FrameArena::resetFrame(uint32_t frameIndex) {
+    currentSlot = frameIndex;
+    FrameSlot &slot = slots[frameIndex];
+    slot.offset = 0;
+    releaseOverflow(slot);
+}
+
+void *FrameArena::allocate(size_t size, size_t alignment) {
+    FrameSlot &slot = slots[currentSlot];
+    //Aligned on the address, the block itself only has the alignment of the global allocator
+    uintptr_t base = reinterpret_cast<uintptr_t>(slot.block.data());
+    uintptr_t start = (base + slot.offset + alignment - 1) & ~(uintptr_t) (alignment - 1);
+    if (start + size <= base + slot.block.size()) {
+        slot.offset = start + size - base;
+        return reinterpret_cast<void *>(start);
+    }
+
+    //Room for the header and enough slack to align the result past it
+    size_t headerSize = sizeof(OverflowBlock) + alignment;
+    void *memory = std::malloc(headerSize + size);
+    if (memory == nullptr) throw std::bad_alloc();
+    OverflowBlock *overflowBlock = static_cast<OverflowBlock *>(memory);
+    overflowBlock->next = slot.overflow;
+    slot.overflow = overflowBlock;
+    slot.overflowBytes += size;
+    uintptr_t data = reinterpret_cast<uintptr_t>(memory) + sizeof(OverflowBlock);
+    return reinterpret_cast<void *>((data + alignment - 1) & ~(uintptr_t) (alignment - 1));
+}
+
+size_t FrameArena::frameUsage() const {
+    return slots[currentSlot].offset;
+}
+
+size_t FrameArena::frameOverflow() const {
+    return slots[currentSlot].overflowBytes;
+}
+
+size_t FrameArena::frameCapacity() const {
+    return slots[currentSlot].block.size();
+}
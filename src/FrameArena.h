@@ -0,0 +1,109 @@
+#ifndef VULKANBASE_FRAMEARENA_H
+#define VULKANBASE_FRAMEARENA_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Linear allocator for CPU data that only lives while its frame is in flight.
+ * Every frame slot owns a fixed block, allocating is a pointer bump and nothing is freed individually,
+ * the whole block is released at once when the slot is reset. A request that does not fit the block is served
+ * by an overflow allocation from the heap, released with the slot, and reported so the block can be made larger.
+ */
+class FrameArena {
+public:
+    FrameArena(uint32_t frameSlots, size_t bytesPerFrame);
+
+    ~FrameArena();
+
+    FrameArena(const FrameArena &) = delete;
+
+    FrameArena &operator=(const FrameArena &) = delete;
+
+    /*
+     * Release everything allocated the last time the slot was used and make it the current one,
+     * the caller must have waited the frame fence
+     */
+    void resetFrame(uint32_t frameIndex);
+
+    void *allocate(size_t size, size_t alignment);
+
+    template<typename T>
+    T *allocateArray(size_t count) {
+        return static_cast<T *>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    /*
+     * Bytes of the block used by the current frame so far, overflow allocations are not included
+     */
+    size_t frameUsage() const;
+
+    /*
+     * Bytes served from the heap because the block of the current frame was full
+     */
+    size_t frameOverflow() const;
+
+    size_t frameCapacity() const;
+
+private:
+    //Header of an overflow allocation, they are chained per slot and freed on reset
+    struct OverflowBlock {
+        OverflowBlock *next;
+    };
+
+    struct FrameSlot {
+        std::vector<uint8_t> block;
+        size_t offset = 0;
+        size_t overflowBytes = 0;
+        OverflowBlock *overflow = nullptr;
+    };
+
+    std::vector<FrameSlot> slots;
+    uint32_t currentSlot = 0;
+
+    static void releaseOverflow(FrameSlot &slot);
+};
+
+/*
+ * Standard allocator over a FrameArena, deallocate does nothing since the memory goes away with the frame.
+ * Containers using it must not outlive the frame that created them.
+ */
+template<typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(FrameArena &arena) : arena(&arena) {}
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+    T *allocate(size_t count) {
+        return arena->allocateArray<T>(count);
+    }
+
+    void deallocate(T *, size_t) {}
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U> &other) const {
+        return arena == other.arena;
+    }
+
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U> &other) const {
+        return arena != other.arena;
+    }
+
+private:
+    template<typename U>
+    friend class ArenaAllocator;
+
+    FrameArena *arena;
+};
+
+template<typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T>>;
+
+
+#endif //VULKANBASE_FRAMEARENA_H
@@ -0,0 +1,134 @@
+#include "FrameProfiler.h"
+#include <iostream>
+#include <algorithm>
+
+FrameProfiler::FrameProfiler(uint32_t frameSlots, uint32_t reportInterval) : reportInterval(reportInterval),
+                                                                             inputTimes(frameSlots),
+                                                                             waitingGpu(frameSlots, false) {}
+
+double FrameProfiler::milliseconds(Clock::time_point start, Clock::time_point end) {
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void FrameProfiler::beginFrame(uint32_t frameSlot) {
+    frameStart = Clock::now();
+    inputTimes[frameSlot] = frameStart;
+    waitingGpu[frameSlot] = true;
+}
+
+void FrameProfiler::markGpuFinished(uint32_t frameSlot) {
+    if (!waitingGpu[frameSlot]) return;
+    waitingGpu[frameSlot] = false;
+    accumulatedLatency += milliseconds(inputTimes[frameSlot], Clock::now());
+    latencySamples++;
+}
+
+void FrameProfiler::endFrame(const char *presentModeName) {
+    Clock::time_point frameEnd = Clock::now();
+    accumulatedCpuTime += milliseconds(frameStart, frameEnd);
+    if (hasLastFrame) {
+        accumulatedFrameTime += milliseconds(lastFrameEnd, frameEnd);
+    }
+    lastFrameEnd = frameEnd;
+    hasLastFrame = true;
+    frameCount++;
+
+    if (frameCount < reportInterval) return;
+    double frameTime = accumulatedFrameTime / frameCount;
+    std::cout << "FRAME: " << frameTime << "ms (" << (frameTime > 0 ? 1000.0 / frameTime : 0) << " fps)"
+              << " CPU: " << accumulatedCpuTime / frameCount << "ms";
+    if (gpuSamples > 0) {
+        std::cout << " GPU: " << accumulatedGpuTime / gpuSamples << "ms";
+    }
+    std::cout << " INPUT TO PRESENT: " << (latencySamples > 0 ? accumulatedLatency / latencySamples : 0) << "ms"
+              << " PRESENT MODE: " << presentModeName
+              << (latencyMode ? " [LATENCY MODE]" : "");
+    if (label != nullptr) {
+        std::cout << " [" << label << "]";
+    }
+    std::cout << std::endl;
+    if (cullingSamples > 0) {
+        std::cout << "PATCHES PER FRAME: drawn " << (double) accumulatedCulling[0] / cullingSamples
+                  << " outside frustum " << (double) accumulatedCulling[1] / cullingSamples
+                  << " occluded " << (double) accumulatedCulling[2] / cullingSamples
+                  << " recovered by re-test " << (double) accumulatedCulling[3] / cullingSamples << std::endl;
+    }
+    if (allocationSamples > 0) {
+        std::cout << "HEAP ALLOCATIONS PER FRAME: avg " << (double) accumulatedAllocations / allocationSamples
+                  << " max " << maxAllocations << std::endl;
+    }
+    if (arenaRecorded) {
+        std::cout << "FRAME ARENA: peak " << peakArenaUsage << " of " << arenaCapacity << " bytes";
+        if (peakArenaOverflow > 0) {
+            std::cout << " OVERFLOW: " << peakArenaOverflow << " bytes from the heap";
+        }
+        std::cout << std::endl;
+    }
+    frameCount = 0;
+    arenaRecorded = false;
+    peakArenaUsage = 0;
+    peakArenaOverflow = 0;
+    allocationSamples = 0;
+    accumulatedAllocations = 0;
+    maxAllocations = 0;
+    cullingSamples = 0;
+    gpuSamples = 0;
+    accumulatedGpuTime = 0;
+    std::fill(accumulatedCulling, accumulatedCulling + 4, 0);
+    latencySamples = 0;
+    accumulatedFrameTime = 0;
+    accumulatedCpuTime = 0;
+    accumulatedLatency = 0;
+}
+
+void FrameProfiler::recordCulling(uint32_t drawn, uint32_t frustumRejected, uint32_t occlusionRejected,
+                                  uint32_t retestRecovered) {
+    accumulatedCulling[0] += drawn;
+    accumulatedCulling[1] += frustumRejected;
+    accumulatedCulling[2] += occlusionRejected;
+    accumulatedCulling[3] += retestRecovered;
+    cullingSamples++;
+}
+
+void FrameProfiler::recordGpuTime(double milliseconds) {
+    accumulatedGpuTime += milliseconds;
+    gpuSamples++;
+}
+
+void FrameProfiler::recordAllocations(uint64_t allocations) {
+    accumulatedAllocations += allocations;
+    maxAllocations = std::max(maxAllocations, allocations);
+    allocationSamples++;
+}
+
+void FrameProfiler::recordArena(size_t usage, size_t overflow, size_t capacity) {
+    arenaRecorded = true;
+    arenaCapacity = capacity;
+    peakArenaUsage = std::max(peakArenaUsage, usage);
+    peakArenaOverflow = std::max(peakArenaOverflow, overflow);
+}
+
+StartupTimeline::StartupTimeline() : origin(Clock::now()) {}
+
+StartupTimeline::PhaseScope::PhaseScope(StartupTimeline &timeline, const std::string &name) : timeline(timeline),
+                                                                                            name(name),
+                                                                                            start(Clock::now()) {}
+
+StartupTimeline::PhaseScope::~PhaseScope() {
+    std::lock_guard<std::mutex> lock(timeline.recordsMutex);
+    timeline.records.push_back({name, start, Clock::now()});
+}
+
+void StartupTimeline::report(const std::string &finalPhaseName) {
+    Clock::time_point now = Clock::now();
+    std::lock_guard<std::mutex> lock(recordsMutex);
+    std::sort(records.begin(), records.end(), [](const PhaseRecord &a, const PhaseRecord &b) {
+        return a.start < b.start;
+    });
+    std::cout << "STARTUP TIMELINE:" << std::endl;
+    for (auto &record : records) {
+        std::cout << "    " << record.name << ": start " << FrameProfiler::milliseconds(origin, record.start)
+                  << "ms, took " << FrameProfiler::milliseconds(record.start, record.end) << "ms" << std::endl;
+    }
+    std::cout << "    " << finalPhaseName << ": " << FrameProfiler::milliseconds(origin, now) << "ms" << std::endl;
+}
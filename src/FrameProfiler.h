@@ -0,0 +1,131 @@
+#ifndef VULKANBASE_FRAMEPROFILER_H
+#define VULKANBASE_FRAMEPROFILER_H
+
+#include <chrono>
+#include <vector>
+#include <string>
+#include <mutex>
+
+/*
+ * CPU side frame timings averaged over a fixed amount of frames and printed to the console.
+ * Input to present latency is measured from the moment the input of a frame is sampled until the fence of
+ * that frame is seen signaled, so it is exact in latency mode, where the fence is waited right after present,
+ * and an upper bound otherwise.
+ */
+class FrameProfiler {
+public:
+    bool latencyMode = false;
+    //Appended to the report, names the variant being measured. Static strings only, it is not copied.
+    const char *label = nullptr;
+
+    FrameProfiler(uint32_t frameSlots, uint32_t reportInterval = 300);
+
+    /*
+     * Call right after the input of the frame was polled
+     */
+    void beginFrame(uint32_t frameSlot);
+
+    /*
+     * Call once the fence of the frame slot was waited
+     */
+    void markGpuFinished(uint32_t frameSlot);
+
+    /*
+     * Call after the frame was presented
+     */
+    void endFrame(const char *presentModeName);
+
+    /*
+     * Patch counters read back from the culling pass of a finished frame
+     */
+    void recordCulling(uint32_t drawn, uint32_t frustumRejected, uint32_t occlusionRejected, uint32_t retestRecovered);
+
+    /*
+     * GPU duration of a finished frame, measured with timestamp queries
+     */
+    void recordGpuTime(double milliseconds);
+
+    /*
+     * Heap allocations made by one frame, only reported when allocations are counted
+     */
+    void recordAllocations(uint64_t allocations);
+
+    /*
+     * Bytes a frame took from its FrameArena block and from the heap once the block was full
+     */
+    void recordArena(size_t usage, size_t overflow, size_t capacity);
+
+    static double milliseconds(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    uint32_t reportInterval;
+    std::vector<Clock::time_point> inputTimes;
+    std::vector<bool> waitingGpu;
+    Clock::time_point frameStart;
+    Clock::time_point lastFrameEnd;
+    bool hasLastFrame = false;
+
+    uint32_t frameCount = 0;
+    uint32_t latencySamples = 0;
+    double accumulatedFrameTime = 0;
+    double accumulatedCpuTime = 0;
+    double accumulatedLatency = 0;
+    uint32_t gpuSamples = 0;
+    double accumulatedGpuTime = 0;
+    uint32_t cullingSamples = 0;
+    uint64_t accumulatedCulling[4] = {0, 0, 0, 0};
+    uint32_t allocationSamples = 0;
+    uint64_t accumulatedAllocations = 0;
+    uint64_t maxAllocations = 0;
+    bool arenaRecorded = false;
+    size_t arenaCapacity = 0;
+    size_t peakArenaUsage = 0;
+    size_t peakArenaOverflow = 0;
+};
+
+/*
+ * Wall clock timeline of the startup phases, phases may run on any thread.
+ * The report lists when every phase started and how long it took relative to the construction of the timeline.
+ */
+class StartupTimeline {
+public:
+    StartupTimeline();
+
+    /*
+     * Run the phase on the calling thread and record its duration
+     */
+    template<typename Phase>
+    auto measure(const std::string &name, Phase phase) -> decltype(phase()) {
+        PhaseScope scope(*this, name);
+        return phase();
+    }
+
+    void report(const std::string &finalPhaseName);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct PhaseRecord {
+        std::string name;
+        Clock::time_point start;
+        Clock::time_point end;
+    };
+
+    struct PhaseScope {
+        StartupTimeline &timeline;
+        std::string name;
+        Clock::time_point start;
+
+        PhaseScope(StartupTimeline &timeline, const std::string &name);
+
+        ~PhaseScope();
+    };
+
+    Clock::time_point origin;
+    std::mutex recordsMutex;
+    std::vector<PhaseRecord> records;
+};
+
+#endif //VULKANBASE_FRAMEPROFILER_H
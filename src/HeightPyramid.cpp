@@ -0,0 +1,139 @@
+#include "HeightPyramid.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+
+#include <emmintrin.h>
+
+#endif
+
+void HeightPyramid::build(const glm::vec4 *pixels, uint32_t width, uint32_t height, uint32_t channel,
+                          ThreadPool *threadPool) {
+    std::vector<float> heights((size_t) width * height);
+    for (size_t i = 0; i < heights.size(); ++i) {
+        heights[i] = pixels[i][channel];
+    }
+    build(std::move(heights), width, height, threadPool);
+}
+
+void HeightPyramid::build(std::vector<float> &&heights, uint32_t width, uint32_t height, ThreadPool *threadPool) {
+    levels.clear();
+    Level base{};
+    base.width = width;
+    base.height = height;
+    base.minimum = std::move(heights);
+    levels.push_back(std::move(base));
+
+    while (levels.back().width > 1 || levels.back().height > 1) {
+        uint32_t previous = levels.size() - 1;
+        Level level{};
+        level.width = (levels[previous].width + 1) / 2;
+        level.height = (levels[previous].height + 1) / 2;
+        level.minimum.resize((size_t) level.width * level.height);
+        level.maximum.resize((size_t) level.width * level.height);
+        levels.push_back(std::move(level));
+
+        const Level &source = levels[previous];
+        Level &destination = levels.back();
+        const float *sourceMinimum = minimumPlane(previous);
+        const float *sourceMaximum = maximumPlane(previous);
+        auto reduce = [&](uint32_t rowBegin, uint32_t rowEnd) {
+            reduceRows(sourceMinimum, source.width, source.height, destination.minimum.data(), destination.width,
+                       rowBegin, rowEnd, false);
+            reduceRows(sourceMaximum, source.width, source.height, destination.maximum.data(), destination.width,
+                       rowBegin, rowEnd, true);
+        };
+        //Small levels are not worth the scheduling
+        if (threadPool != nullptr && (size_t) destination.width * destination.height >= 64 * 64) {
+            threadPool->parallelFor(destination.height, 16, reduce);
+        } else {
+            reduce(0, destination.height);
+        }
+    }
+}
+
+void HeightPyramid::reduceRows(const float *source, uint32_t sourceWidth, uint32_t sourceHeight, float *destination,
+                               uint32_t destinationWidth, uint32_t rowBegin, uint32_t rowEnd, bool maximum) {
+    for (uint32_t y = rowBegin; y < rowEnd; ++y) {
+        //Odd sizes repeat the last row and column, which does not change the min or max
+        const float *rowA = source + (size_t) std::min(2 * y, sourceHeight - 1) * sourceWidth;
+        const float *rowB = source + (size_t) std::min(2 * y + 1, sourceHeight - 1) * sourceWidth;
+        float *output = destination + (size_t) y * destinationWidth;
+        uint32_t x = 0;
+#if defined(__SSE2__)
+        //Four outputs from eight columns of two rows: vertical min/max, then min/max of the even and odd lanes
+        for (; 2 * x + 8 <= sourceWidth; x += 4) {
+            __m128 a0 = _mm_loadu_ps(rowA + 2 * x), a1 = _mm_loadu_ps(rowA + 2 * x + 4);
+            __m128 b0 = _mm_loadu_ps(rowB + 2 * x), b1 = _mm_loadu_ps(rowB + 2 * x + 4);
+            __m128 v0 = maximum ? _mm_max_ps(a0, b0) : _mm_min_ps(a0, b0);
+            __m128 v1 = maximum ? _mm_max_ps(a1, b1) : _mm_min_ps(a1, b1);
+            __m128 even = _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 odd = _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(3, 1, 3, 1));
+            _mm_storeu_ps(output + x, maximum ? _mm_max_ps(even, odd) : _mm_min_ps(even, odd));
+        }
+#endif
+        for (; x < destinationWidth; ++x) {
+            uint32_t x0 = 2 * x, x1 = std::min(2 * x + 1, sourceWidth - 1);
+            if (maximum) {
+                output[x] = std::max(std::max(rowA[x0], rowA[x1]), std::max(rowB[x0], rowB[x1]));
+            } else {
+                output[x] = std::min(std::min(rowA[x0], rowA[x1]), std::min(rowB[x0], rowB[x1]));
+            }
+        }
+    }
+}
+
+const float *HeightPyramid::minimumPlane(uint32_t level) const {
+    return levels[level].minimum.data();
+}
+
+const float *HeightPyramid::maximumPlane(uint32_t level) const {
+    //Level 0 has a single height per texel
+    return level == 0 ? levels[0].minimum.data() : levels[level].maximum.data();
+}
+
+uint32_t HeightPyramid::getLevelCount() const {
+    return levels.size();
+}
+
+uint32_t HeightPyramid::getLevelWidth(uint32_t level) const {
+    return levels[level].width;
+}
+
+uint32_t HeightPyramid::getLevelHeight(uint32_t level) const {
+    return levels[level].height;
+}
+
+const float *HeightPyramid::getHeights() const {
+    return levels[0].minimum.data();
+}
+
+glm::vec2 HeightPyramid::getRange(uint32_t level, uint32_t x, uint32_t y) const {
+    size_t index = (size_t) y * levels[level].width + x;
+    return glm::vec2(minimumPlane(level)[index], maximumPlane(level)[index]);
+}
+
+glm::vec2 HeightPyramid::queryRange(glm::vec2 uvMin, glm::vec2 uvMax) const {
+    uint32_t width = levels[0].width, height = levels[0].height;
+    auto texel = [](float uv, uint32_t size) {
+        return (uint32_t) glm::clamp((int64_t) std::floor(uv * size), (int64_t) 0, (int64_t) size - 1);
+    };
+    uint32_t x0 = texel(std::min(uvMin.x, uvMax.x), width), x1 = texel(std::max(uvMin.x, uvMax.x), width);
+    uint32_t y0 = texel(std::min(uvMin.y, uvMax.y), height), y1 = texel(std::max(uvMin.y, uvMax.y), height);
+
+    //At the first level whose texels are as large as the rectangle, the rectangle touches at most 2x2 texels
+    uint32_t span = std::max(x1 - x0, y1 - y0) + 1;
+    uint32_t level = 0;
+    while ((1u << level) < span && level + 1 < levels.size()) level++;
+
+    glm::vec2 range(INFINITY, -INFINITY);
+    for (uint32_t y = y0 >> level; y <= (y1 >> level); ++y) {
+        for (uint32_t x = x0 >> level; x <= (x1 >> level); ++x) {
+            glm::vec2 texelRange = getRange(level, x, y);
+            range.x = std::min(range.x, texelRange.x);
+            range.y = std::max(range.y, texelRange.y);
+        }
+    }
+    return range;
+}
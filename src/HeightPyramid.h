@@ -0,0 +1,69 @@
+#ifndef VULKANBASE_HEIGHTPYRAMID_H
+#define VULKANBASE_HEIGHTPYRAMID_H
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "ThreadPool.h"
+
+/*
+ * Hierarchical min/max of a heightmap. Level 0 is the heightmap itself, every next level halves both dimensions
+ * (rounding up) and keeps the minimum and maximum of the 2x2 texels below it.
+ * Each level stores its minimums and maximums as two separate row major planes, level 0 stores a single plane.
+ */
+class HeightPyramid {
+public:
+    /*
+     * Reads the given channel of a row major RGBA image, row 0 maps to v = 0.
+     * The reduction of each level is split across the thread pool when one is given.
+     */
+    void build(const glm::vec4 *pixels, uint32_t width, uint32_t height, uint32_t channel = 0,
+               ThreadPool *threadPool = nullptr);
+
+    /*
+     * Same from a row major plane of heights, which becomes level 0 without a copy
+     */
+    void build(std::vector<float> &&heights, uint32_t width, uint32_t height, ThreadPool *threadPool = nullptr);
+
+    uint32_t getLevelCount() const;
+
+    uint32_t getLevelWidth(uint32_t level) const;
+
+    uint32_t getLevelHeight(uint32_t level) const;
+
+    /*
+     * Level 0, one height per texel in row major order
+     */
+    const float *getHeights() const;
+
+    /*
+     * Min and max of the texel of the level, as x and y
+     */
+    glm::vec2 getRange(uint32_t level, uint32_t x, uint32_t y) const;
+
+    /*
+     * Conservative min and max of every texel touched by the UV rectangle, as x and y.
+     * Reads at most 2x2 texels of the level where one texel is as large as the rectangle.
+     */
+    glm::vec2 queryRange(glm::vec2 uvMin, glm::vec2 uvMax) const;
+
+private:
+    struct Level {
+        uint32_t width;
+        uint32_t height;
+        std::vector<float> minimum;
+        std::vector<float> maximum;
+    };
+
+    std::vector<Level> levels;
+
+    const float *minimumPlane(uint32_t level) const;
+
+    const float *maximumPlane(uint32_t level) const;
+
+    static void reduceRows(const float *source, uint32_t sourceWidth, uint32_t sourceHeight, float *destination,
+                           uint32_t destinationWidth, uint32_t rowBegin, uint32_t rowEnd, bool maximum);
+};
+
+
+#endif //VULKANBASE_HEIGHTPYRAMID_H
@@ -0,0 +1,35 @@
+#include "ProcessMemory.h"
+
+#if defined(_WIN32)
+
+#include <windows.h>
+#include <psapi.h>
+
+uint64_t ProcessMemory::peakResidentBytes() {
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize;
+}
+
+#elif defined(__unix__) || defined(__APPLE__)
+
+#include <sys/resource.h>
+
+uint64_t ProcessMemory::peakResidentBytes() {
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#if defined(__APPLE__)
+    //Bytes on macOS, kilobytes everywhere else
+    return (uint64_t) usage.ru_maxrss;
+#else
+    return (uint64_t) usage.ru_maxrss * 1024;
+#endif
+}
+
+#else
+
+uint64_t ProcessMemory::peakResidentBytes() {
+    return 0;
+}
+
+#endif
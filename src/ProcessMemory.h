@@ -0,0 +1,16 @@
+#ifndef VULKANBASE_PROCESSMEMORY_H
+#define VULKANBASE_PROCESSMEMORY_H
+
+#include <cstdint>
+
+/*
+ * Resident memory of the process as seen by the OS, for reporting how much a loading path costs.
+ * Zero where the platform offers no way to query it.
+ */
+namespace ProcessMemory {
+    //Highest resident set size reached so far, in bytes
+    uint64_t peakResidentBytes();
+}
+
+
+#endif //VULKANBASE_PROCESSMEMORY_H
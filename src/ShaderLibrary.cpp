@@ -0,0 +1,288 @@
+#include "ShaderLibrary.h"
+#include "VulkanStructures.h"
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <set>
+#include <cstdlib>
+#include <algorithm>
+
+#ifdef __linux__
+
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#endif
+
+#ifndef GLSLC_EXECUTABLE
+#define GLSLC_EXECUTABLE "glslc"
+#endif
+
+ShaderLibrary::ShaderLibrary(const std::string &shaderDirectory, ThreadPool &threadPool) : shaderDirectory(shaderDirectory),
+                                                                                         threadPool(threadPool) {}
+
+std::string ShaderLibrary::path(const std::string &file) const {
+    return shaderDirectory + "/" + file;
+}
+
+bool ShaderLibrary::readFile(const std::string &filename, std::vector<char> &bytes) {
+    std::ifstream file(filename, std::ios::binary | std::ios::in | std::ios::ate);
+    if (!file.is_open()) return false;
+    size_t fileSize = (size_t) file.tellg();
+    bytes.resize(fileSize);
+    file.seekg(0);
+    file.read(bytes.data(), fileSize);
+    return file.good() && fileSize > 0;
+}
+
+uint64_t ShaderLibrary::hashBytes(const std::vector<char> &bytes) {
+    //FNV-1a, SPIR-V modules are small enough that hashing them byte by byte is irrelevant
+    uint64_t hash = 14695981039346656037ull;
+    for (char byte : bytes) {
+        hash ^= (unsigned char) byte;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+void ShaderLibrary::registerShader(const std::string &name, const std::string &sourceFile, const std::string &binaryFile) {
+    std::lock_guard<std::mutex> lock(libraryMutex);
+    ShaderEntry entry{};
+    entry.sourceFile = sourceFile;
+    entry.binaryFile = binaryFile;
+    shaders[name] = entry;
+}
+
+void ShaderLibrary::loadBinaries(const VirtualFileSystem &fileSystem, const std::string &directory) {
+    std::lock_guard<std::mutex> lock(libraryMutex);
+    for (auto &shader : shaders) {
+        std::string binaryPath = directory + "/" + shader.second.binaryFile;
+        FileData file;
+        if (!fileSystem.read(binaryPath, file) || file.size() == 0) {
+            throw std::runtime_error("CANNOT OPEN SHADER FILE: " + binaryPath);
+        }
+        const char *bytes = reinterpret_cast<const char *>(file.data());
+        shader.second.bytes.assign(bytes, bytes + file.size());
+        shader.second.hash = hashBytes(shader.second.bytes);
+    }
+}
+
+VkShaderModule ShaderLibrary::vulkanAcquireModule(const std::vector<char> &bytes, uint64_t hash) {
+    auto module = modulesByHash.find(hash);
+    if (module != modulesByHash.end()) {
+        moduleReferences[hash]++;
+        return module->second;
+    }
+    VkShaderModuleCreateInfo vkShaderModuleCreateInfo{};
+    vkShaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    vkShaderModuleCreateInfo.codeSize = bytes.size();
+    vkShaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t *>(bytes.data());
+
+    VkShaderModule shaderModule;
+    VK_ASSERT(vkCreateShaderModule(device, &vkShaderModuleCreateInfo, nullptr, &shaderModule));
+    modulesByHash[hash] = shaderModule;
+    moduleReferences[hash] = 1;
+    return shaderModule;
+}
+
+void ShaderLibrary::vulkanReleaseModule(uint64_t hash) {
+    if (--moduleReferences[hash] > 0) return;
+    vkDestroyShaderModule(device, modulesByHash[hash], nullptr);
+    modulesByHash.erase(hash);
+    moduleReferences.erase(hash);
+}
+
+void ShaderLibrary::vulkanCreateModules(VkDevice device) {
+    std::lock_guard<std::mutex> lock(libraryMutex);
+    this->device = device;
+    for (auto &shader : shaders) {
+        vulkanAcquireModule(shader.second.bytes, shader.second.hash);
+    }
+}
+
+VkShaderModule ShaderLibrary::getModule(const std::string &name) {
+    std::lock_guard<std::mutex> lock(libraryMutex);
+    auto shader = shaders.find(name);
+    if (shader == shaders.end()) {
+        throw std::runtime_error("UNKNOWN SHADER: " + name);
+    }
+    return modulesByHash.at(shader->second.hash);
+}
+
+uint32_t ShaderLibrary::registerPipeline(VkPipeline *target, const std::vector<std::string> &shaderNames,
+                                         PipelineBuilder builder) {
+    std::lock_guard<std::mutex> lock(libraryMutex);
+    PipelineEntry entry{};
+    entry.target = target;
+    entry.shaderNames = shaderNames;
+    entry.builder = std::move(builder);
+    pipelines.push_back(entry);
+    return pipelines.size() - 1;
+}
+
+VkPipeline ShaderLibrary::vulkanBuildPipeline(uint32_t pipelineId) {
+    PipelineBuilder builder;
+    {
+        std::lock_guard<std::mutex> lock(libraryMutex);
+        builder = pipelines[pipelineId].builder;
+    }
+    return builder([this](const std::string &name) { return getModule(name); });
+}
+
+bool ShaderLibrary::enableHotReload() {
+#ifdef __linux__
+    inotifyDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyDescriptor < 0) return false;
+    //Editors often save by renaming a temporary file over the original, so moves count as writes
+    watchDescriptor = inotify_add_watch(inotifyDescriptor, shaderDirectory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (watchDescriptor < 0) {
+        close(inotifyDescriptor);
+        inotifyDescriptor = -1;
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void ShaderLibrary::pollChanges() {
+#ifdef __linux__
+    if (inotifyDescriptor < 0) return;
+    std::set<std::string> changedSources, changedBinaries;
+    alignas(inotify_event) char buffer[4096];
+    ssize_t length;
+    while ((length = read(inotifyDescriptor, buffer, sizeof(buffer))) > 0) {
+        for (char *event = buffer; event < buffer + length;) {
+            inotify_event *inotifyEvent = reinterpret_cast<inotify_event *>(event);
+            if (inotifyEvent->len > 0) {
+                std::string fileName = inotifyEvent->name;
+                //An include like PatchData.glsl may be in any source, the reload skips the binaries that did not change
+                bool include = fileName.size() > 5 && fileName.compare(fileName.size() - 5, 5, ".glsl") == 0;
+                std::lock_guard<std::mutex> lock(libraryMutex);
+                for (auto &shader : shaders) {
+                    if (shader.second.sourceFile == fileName || (include && !shader.second.sourceFile.empty())) {
+                        changedSources.insert(shader.first);
+                    } else if (shader.second.binaryFile == fileName) {
+                        changedBinaries.insert(shader.first);
+                    }
+                }
+            }
+            event += sizeof(inotify_event) + inotifyEvent->len;
+        }
+    }
+    for (auto &shaderName : changedSources) {
+        reloadTasks.push_back(threadPool.submit([this, shaderName]() { reload(shaderName, true); }));
+    }
+    for (auto &shaderName : changedBinaries) {
+        if (changedSources.count(shaderName)) continue;
+        reloadTasks.push_back(threadPool.submit([this, shaderName]() { reload(shaderName, false); }));
+    }
+    reloadTasks.erase(std::remove_if(reloadTasks.begin(), reloadTasks.end(), [](std::future<void> &task) {
+        return task.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }), reloadTasks.end());
+#endif
+}
+
+void ShaderLibrary::reload(const std::string &shaderName, bool compile) {
+    std::lock_guard<std::mutex> reloadLock(reloadMutex);
+    ShaderEntry entry;
+    {
+        std::lock_guard<std::mutex> lock(libraryMutex);
+        entry = shaders[shaderName];
+    }
+
+    if (compile) {
+        std::string command = std::string(GLSLC_EXECUTABLE) + " \"" + path(entry.sourceFile) + "\" -o \"" +
+                              path(entry.binaryFile) + "\"";
+        if (std::system(command.c_str()) != 0) {
+            std::cerr << "SHADER COMPILATION FAILED, KEEPING THE PREVIOUS VERSION: " << entry.sourceFile << std::endl;
+            return;
+        }
+    }
+
+    std::vector<char> bytes;
+    if (!readFile(path(entry.binaryFile), bytes)) {
+        std::cerr << "CANNOT RELOAD SHADER FILE: " << entry.binaryFile << std::endl;
+        return;
+    }
+    uint64_t hash = hashBytes(bytes);
+
+    std::vector<uint32_t> affectedPipelines;
+    uint64_t previousHash;
+    {
+        std::lock_guard<std::mutex> lock(libraryMutex);
+        ShaderEntry &shader = shaders[shaderName];
+        //The binary written by our own compilation triggers another event, the hash filters it out
+        if (shader.hash == hash) return;
+        vulkanAcquireModule(bytes, hash);
+        previousHash = shader.hash;
+        shader.bytes = std::move(bytes);
+        shader.hash = hash;
+        for (uint32_t i = 0; i < pipelines.size(); ++i) {
+            for (auto &name : pipelines[i].shaderNames) {
+                if (name == shaderName) {
+                    affectedPipelines.push_back(i);
+                    break;
+                }
+            }
+        }
+    }
+
+    PendingReload pendingReload{};
+    pendingReload.shaderName = shaderName;
+    pendingReload.previousHash = previousHash;
+    for (auto pipelineId : affectedPipelines) {
+        pendingReload.pipelines.emplace_back(pipelineId, vulkanBuildPipeline(pipelineId));
+    }
+    std::cout << "SHADER RELOADED: " << shaderName << ", " << affectedPipelines.size() << " PIPELINES REBUILT" << std::endl;
+
+    std::lock_guard<std::mutex> lock(libraryMutex);
+    pendingReloads.push_back(pendingReload);
+}
+
+bool ShaderLibrary::vulkanApplyReloads(DeletionQueue &deletionQueue, uint32_t frameIndex) {
+    std::lock_guard<std::mutex> lock(libraryMutex);
+    if (pendingReloads.empty()) return false;
+    for (auto &pendingReload : pendingReloads) {
+        for (auto &pipeline : pendingReload.pipelines) {
+            VkPipeline *target = pipelines[pipeline.first].target;
+            //The old pipeline may still be used by frames in flight
+            deletionQueue.destroyPipeline(frameIndex, *target);
+            *target = pipeline.second;
+        }
+        vulkanReleaseModule(pendingReload.previousHash);
+    }
+    pendingReloads.clear();
+    return true;
+}
+
+void ShaderLibrary::vulkanDestroy() {
+#ifdef __linux__
+    if (inotifyDescriptor >= 0) {
+        close(inotifyDescriptor);
+        inotifyDescriptor = -1;
+    }
+#endif
+    //Wait for the scheduled reloads before destroying what they use
+    for (auto &task : reloadTasks) {
+        task.wait();
+    }
+    reloadTasks.clear();
+    std::lock_guard<std::mutex> lock(libraryMutex);
+    for (auto &pendingReload : pendingReloads) {
+        for (auto &pipeline : pendingReload.pipelines) {
+            vkDestroyPipeline(device, pipeline.second, nullptr);
+        }
+    }
+    pendingReloads.clear();
+    for (auto &pipeline : pipelines) {
+        vkDestroyPipeline(device, *pipeline.target, nullptr);
+    }
+    pipelines.clear();
+    for (auto &module : modulesByHash) {
+        vkDestroyShaderModule(device, module.second, nullptr);
+    }
+    modulesByHash.clear();
+    moduleReferences.clear();
+}
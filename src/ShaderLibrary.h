@@ -0,0 +1,125 @@
+#ifndef VULKANBASE_SHADERLIBRARY_H
+#define VULKANBASE_SHADERLIBRARY_H
+
+#define GLFW_INCLUDE_VULKAN
+
+#include <GLFW/glfw3.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include "ThreadPool.h"
+#include "FileManagers/VirtualFileSystem.h"
+#include "DeletionQueue.h"
+
+/*
+ * Owns the shader modules and the pipelines built from them.
+ * Modules are created once per distinct SPIR-V content, so two names pointing to the same bytes share a module.
+ * When hot reload is enabled the shader directory is watched with inotify, an edited GLSL source is recompiled
+ * with glslc on the thread pool and only the pipelines using it are rebuilt, the new pipelines replace the old
+ * ones when vulkanApplyReloads is called at a frame boundary. An edited .glsl include recompiles every source.
+ */
+class ShaderLibrary {
+public:
+    using ModuleLookup = std::function<VkShaderModule(const std::string &name)>;
+    using PipelineBuilder = std::function<VkPipeline(const ModuleLookup &module)>;
+
+    ShaderLibrary(const std::string &shaderDirectory, ThreadPool &threadPool);
+
+    /*
+     * The source is optional, a shader without it can still be reloaded by replacing the binary
+     */
+    void registerShader(const std::string &name, const std::string &sourceFile, const std::string &binaryFile);
+
+    /*
+     * Read every registered binary from directory in the file system, which may be a pack archive mount, hot reload
+     * still reads the loose files of the shader directory. Does not need the device so it can run before the
+     * device exists. Throws if a binary cannot be read.
+     */
+    void loadBinaries(const VirtualFileSystem &fileSystem, const std::string &directory);
+
+    void vulkanCreateModules(VkDevice device);
+
+    VkShaderModule getModule(const std::string &name);
+
+    /*
+     * The library writes the rebuilt pipeline to target when a shader it uses changes, and destroys it on vulkanDestroy
+     */
+    uint32_t registerPipeline(VkPipeline *target, const std::vector<std::string> &shaderNames, PipelineBuilder builder);
+
+    /*
+     * Build a registered pipeline with the current modules, safe to call from any thread
+     */
+    VkPipeline vulkanBuildPipeline(uint32_t pipelineId);
+
+    /*
+     * Start watching the shader directory, returns false when the platform has no inotify
+     */
+    bool enableHotReload();
+
+    /*
+     * Consume the file events and schedule the reloads, non blocking
+     */
+    void pollChanges();
+
+    /*
+     * Swap the finished reloads in, the replaced pipelines go to the deletion queue in the slot of the frame being
+     * recorded, so call it after the fence of that slot was waited. Returns true if any pipeline changed.
+     */
+    bool vulkanApplyReloads(DeletionQueue &deletionQueue, uint32_t frameIndex);
+
+    void vulkanDestroy();
+
+private:
+    struct ShaderEntry {
+        std::string sourceFile;
+        std::string binaryFile;
+        std::vector<char> bytes;
+        uint64_t hash = 0;
+    };
+
+    struct PipelineEntry {
+        VkPipeline *target;
+        std::vector<std::string> shaderNames;
+        PipelineBuilder builder;
+    };
+
+    struct PendingReload {
+        std::string shaderName;
+        uint64_t previousHash;
+        std::vector<std::pair<uint32_t, VkPipeline>> pipelines;
+    };
+
+    std::string shaderDirectory;
+    ThreadPool &threadPool;
+    VkDevice device = VK_NULL_HANDLE;
+    int inotifyDescriptor = -1;
+    int watchDescriptor = -1;
+    std::vector<std::future<void>> reloadTasks;
+
+    std::mutex libraryMutex;
+    std::unordered_map<std::string, ShaderEntry> shaders;
+    std::unordered_map<uint64_t, VkShaderModule> modulesByHash;
+    std::unordered_map<uint64_t, uint32_t> moduleReferences;
+    std::vector<PipelineEntry> pipelines;
+    std::vector<PendingReload> pendingReloads;
+
+    //Reloads run one at a time so two edits in a row are applied in order
+    std::mutex reloadMutex;
+
+    std::string path(const std::string &file) const;
+
+    VkShaderModule vulkanAcquireModule(const std::vector<char> &bytes, uint64_t hash);
+
+    void vulkanReleaseModule(uint64_t hash);
+
+    void reload(const std::string &shaderName, bool compile);
+
+    static bool readFile(const std::string &filename, std::vector<char> &bytes);
+
+    static uint64_t hashBytes(const std::vector<char> &bytes);
+};
+
+
+#endif //VULKANBASE_SHADERLIBRARY_H
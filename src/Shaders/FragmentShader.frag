@@ -13,10 +13,26 @@ layout(set = 0, binding = 1) uniform LightInformation{
     vec3 cameraPosition;
 }lightInformation;
 
+//Specialization constants, see TerrainVariant
+layout(constant_id = 3) const uint SHADING_MODEL = 0;
+const uint SHADING_MODEL_DIFFUSE = 0;
+const uint SHADING_MODEL_BLINN_PHONG = 1;
+const uint SHADING_MODEL_NORMALS = 2;
 
 void main(){
+    vec3 normal = normalize(inNormal);
+    if (SHADING_MODEL == SHADING_MODEL_NORMALS) {
+        fragColor = vec4(normal * 0.5 + 0.5, 1);
+        return;
+    }
+    vec3 lightDirection = normalize(lightInformation.position - inPos);
     float dist = length(lightInformation.position - inPos);
-    float diffuse = dot(normalize(inNormal), normalize(lightInformation.position - inPos)) / (dist *dist);
+    float diffuse = dot(normal, lightDirection) / (dist *dist);
     if (diffuse < 0) diffuse = 0;
-    fragColor = vec4(0.4, 0.3, 0.6, 1) * min((diffuse + 0.05),1.0);
+    float specular = 0;
+    if (SHADING_MODEL == SHADING_MODEL_BLINN_PHONG) {
+        vec3 halfVector = normalize(lightDirection + normalize(lightInformation.cameraPosition - inPos));
+        specular = pow(max(dot(normal, halfVector), 0.0), 32.0) / (dist * dist);
+    }
+    fragColor = vec4(0.4, 0.3, 0.6, 1) * min((diffuse + 0.05),1.0) + vec4(specular);
 }
\ No newline at end of file
@@ -0,0 +1,32 @@
+#ifndef PATCH_DATA_GLSL
+#define PATCH_DATA_GLSL
+
+//Where the patches are bound, the terrain pipelines use set 1 binding 1 and the culling pass defines its own
+#ifndef PATCH_DATA_SET
+#define PATCH_DATA_SET 1
+#endif
+#ifndef PATCH_DATA_BINDING
+#define PATCH_DATA_BINDING 1
+#endif
+
+//Per patch data, must match PatchData in main.cpp. The draws index it with the instance index they were issued with.
+struct PatchData {
+    mat4 model;
+    vec4 tessLevelOuter;
+    vec2 tessLevelInner;
+    vec2 uvOffset;
+    vec2 uvScale;
+    uint heightmapIndex;
+    uint firstIndex;
+    uint indexCount;
+    int vertexOffset;
+    uint padding[2];
+    vec4 boundsMin;
+    vec4 boundsMax;
+};
+
+layout(std430, set = PATCH_DATA_SET, binding = PATCH_DATA_BINDING) readonly buffer Patches{
+    PatchData patches[];
+};
+
+#endif
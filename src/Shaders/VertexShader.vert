@@ -1,13 +1,20 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
 
-layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec2 inUV;
+//Corner of the shared unit quad, in [0, 1]
+layout(location = 0) in vec2 inPosition;
 //
 //In parameters.
 layout (location = 0) out vec2 outUV;
 layout (location = 1) out vec3 outPosition;
+layout (location = 2) out uint outPatchIndex;
+
+#include "PatchData.glsl"
 
 void main(){
-    outPosition = inPosition;
-    outUV = inUV;
-}
\ No newline at end of file
+    //firstInstance of every draw is the index of its patch
+    outPatchIndex = gl_InstanceIndex;
+    PatchData patchData = patches[outPatchIndex];
+    outPosition = vec3(inPosition.x - 0.5, 0, inPosition.y - 0.5);
+    outUV = patchData.uvOffset + inPosition * patchData.uvScale;
+}
@@ -3,3 +3,9 @@
 /bin/glslc tessControlShader.tesc -o tessControl.spv
 /bin/glslc tessEvaluationShader.tese -o tessEval.spv
 /bin/glslc geometry.geom -o geometry.spv
+/bin/glslc tessEvaluationShaderBindless.tese -o tessEvalBindless.spv
+/bin/glslc cullPatches.comp -o cullPatches.spv
+/bin/glslc hiZReduce.comp -o hiZReduce.spv
+/bin/glslc tessControlQuad.tesc -o tessControlQuad.spv
+/bin/glslc tessEvaluationQuad.tese -o tessEvalQuad.spv
+/bin/glslc tessEvaluationQuadBindless.tese -o tessEvalQuadBindless.spv
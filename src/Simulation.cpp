@@ -0,0 +1,172 @@
+#include "Simulation.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+    const char RECORDING_MAGIC[4] = {'V', 'B', 'S', 'I'};
+    const uint32_t RECORDING_VERSION = 1;
+
+    template<typename T>
+    void hashValue(uint64_t &hash, const T &value) {
+        unsigned char bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        for (unsigned char byte : bytes) {
+            hash ^= byte;
+            hash *= 1099511628211ull;
+        }
+    }
+}
+
+FixedStepSimulation::FixedStepSimulation(double stepSeconds, const SimulationState &initialState) : stepSeconds(stepSeconds),
+                                                                                                   previousState(initialState),
+                                                                                                   currentState(initialState) {}
+
+void FixedStepSimulation::setTerrain(const TerrainHeightField *terrain) {
+    this->terrain = terrain;
+}
+
+bool FixedStepSimulation::startRecording(const std::string &path) {
+    recording.open(path, std::ios::binary | std::ios::out | std::ios::trunc);
+    if (!recording.is_open()) return false;
+    recording.write(RECORDING_MAGIC, sizeof(RECORDING_MAGIC));
+    recording.write(reinterpret_cast<const char *>(&RECORDING_VERSION), sizeof(RECORDING_VERSION));
+    recording.write(reinterpret_cast<const char *>(&stepSeconds), sizeof(stepSeconds));
+    return recording.good();
+}
+
+bool FixedStepSimulation::startReplay(const std::string &path) {
+    replay.open(path, std::ios::binary | std::ios::in);
+    if (!replay.is_open()) return false;
+    char magic[4];
+    uint32_t version = 0;
+    double recordedStep = 0;
+    replay.read(magic, sizeof(magic));
+    replay.read(reinterpret_cast<char *>(&version), sizeof(version));
+    replay.read(reinterpret_cast<char *>(&recordedStep), sizeof(recordedStep));
+    //A different step size would give different states from the same input
+    if (!replay.good() || std::memcmp(magic, RECORDING_MAGIC, sizeof(magic)) != 0 || version != RECORDING_VERSION ||
+        recordedStep != stepSeconds) {
+        replay.close();
+        return false;
+    }
+    replaying = true;
+    return true;
+}
+
+bool FixedStepSimulation::isReplaying() const {
+    return replaying;
+}
+
+bool FixedStepSimulation::replayFinished() const {
+    return replayEnded;
+}
+
+bool FixedStepSimulation::readReplayInput(SimulationInput &input) {
+    replay.read(reinterpret_cast<char *>(&input.heldKeys), sizeof(input.heldKeys));
+    replay.read(reinterpret_cast<char *>(&input.actions), sizeof(input.actions));
+    replay.read(reinterpret_cast<char *>(&input.look.x), sizeof(input.look.x));
+    replay.read(reinterpret_cast<char *>(&input.look.y), sizeof(input.look.y));
+    return replay.good();
+}
+
+uint32_t FixedStepSimulation::advance(double elapsedSeconds, const SimulationInput &input) {
+    //Presses and look between steps are kept until a step takes them, frames can be shorter than a step
+    pendingInput.heldKeys = input.heldKeys;
+    pendingInput.actions |= input.actions;
+    pendingInput.look += input.look;
+
+    accumulator += elapsedSeconds;
+    uint32_t steps = 0;
+    while (accumulator >= stepSeconds && !replayEnded) {
+        if (steps == MAX_STEPS_PER_ADVANCE) {
+            accumulator = std::fmod(accumulator, stepSeconds);
+            break;
+        }
+        SimulationInput stepInput = pendingInput;
+        if (replaying && !readReplayInput(stepInput)) {
+            replayEnded = true;
+            break;
+        }
+        previousState = currentState;
+        step(stepInput);
+        if (recording.is_open()) {
+            recording.write(reinterpret_cast<const char *>(&stepInput.heldKeys), sizeof(stepInput.heldKeys));
+            recording.write(reinterpret_cast<const char *>(&stepInput.actions), sizeof(stepInput.actions));
+            recording.write(reinterpret_cast<const char *>(&stepInput.look.x), sizeof(stepInput.look.x));
+            recording.write(reinterpret_cast<const char *>(&stepInput.look.y), sizeof(stepInput.look.y));
+        }
+        pendingInput.actions = 0;
+        pendingInput.look = glm::vec2(0);
+        accumulator -= stepSeconds;
+        steps++;
+    }
+    if (replayEnded) accumulator = 0;
+    return steps;
+}
+
+void FixedStepSimulation::step(const SimulationInput &input) {
+    SimulationState &state = currentState;
+    float deltaTime = (float) stepSeconds;
+
+    state.angle += input.look;
+    state.angle.x = glm::clamp(state.angle.x, -89.0f, 89.0f);
+    if (input.actions & SIMULATION_ACTION_NEXT_CAMERA_MODE) {
+        state.cameraMode = (CameraMode) ((state.cameraMode + 1) % 3);
+    }
+
+    float pitch = glm::radians(state.angle.x), yaw = glm::radians(state.angle.y);
+    glm::vec3 up(0, 1, 0);
+    glm::vec3 forward(std::cos(yaw) * std::cos(pitch), std::sin(pitch), std::sin(yaw) * std::cos(pitch));
+    glm::vec3 right = glm::normalize(glm::cross(forward, up));
+    bool walking = state.cameraMode == CAMERA_MODE_TERRAIN_FOLLOW && terrain != nullptr;
+    if (walking) {
+        //Walking goes where the camera looks, but along the ground
+        forward = glm::normalize(glm::vec3(std::cos(yaw), 0, std::sin(yaw)));
+    }
+
+    glm::vec3 move(0);
+    if (input.heldKeys & SIMULATION_KEY_FORWARD) move += forward;
+    if (input.heldKeys & SIMULATION_KEY_BACKWARD) move -= forward;
+    if (input.heldKeys & SIMULATION_KEY_RIGHT) move += right;
+    if (input.heldKeys & SIMULATION_KEY_LEFT) move -= right;
+    if (!walking && (input.heldKeys & SIMULATION_KEY_UP)) move += up;
+    if (!walking && (input.heldKeys & SIMULATION_KEY_DOWN)) move -= up;
+    //Same speed in every direction, diagonals included
+    if (glm::dot(move, move) > 0) state.eye += glm::normalize(move) * moveSpeed * deltaTime;
+
+    if (terrain != nullptr && state.cameraMode != CAMERA_MODE_FREE) {
+        float ground = terrain->heightAt(glm::vec2(state.eye.x, state.eye.z));
+        if (walking) state.eye.y = ground + eyeHeight;
+        else state.eye.y = std::max(state.eye.y, ground + collisionClearance);
+    }
+
+    state.lightAngle += lightSpeed * deltaTime;
+    state.step++;
+}
+
+SimulationState FixedStepSimulation::interpolated() const {
+    float alpha = (float) (accumulator / stepSeconds);
+    SimulationState state = currentState;
+    state.eye = glm::mix(previousState.eye, currentState.eye, alpha);
+    state.angle = glm::mix(previousState.angle, currentState.angle, alpha);
+    state.lightAngle = glm::mix(previousState.lightAngle, currentState.lightAngle, alpha);
+    return state;
+}
+
+const SimulationState &FixedStepSimulation::current() const {
+    return currentState;
+}
+
+uint64_t FixedStepSimulation::stateHash() const {
+    uint64_t hash = 14695981039346656037ull;
+    hashValue(hash, currentState.eye.x);
+    hashValue(hash, currentState.eye.y);
+    hashValue(hash, currentState.eye.z);
+    hashValue(hash, currentState.angle.x);
+    hashValue(hash, currentState.angle.y);
+    hashValue(hash, currentState.lightAngle);
+    hashValue(hash, (uint32_t) currentState.cameraMode);
+    hashValue(hash, currentState.step);
+    return hash;
+}
@@ -0,0 +1,132 @@
+#ifndef VULKANBASE_SIMULATION_H
+#define VULKANBASE_SIMULATION_H
+
+#include <cstdint>
+#include <string>
+#include <fstream>
+#include <glm/glm.hpp>
+#include "TerrainHeightField.h"
+
+//Keys held during a step, they act on every step they are held for
+enum SimulationKey {
+    SIMULATION_KEY_FORWARD = 1 << 0,
+    SIMULATION_KEY_BACKWARD = 1 << 1,
+    SIMULATION_KEY_RIGHT = 1 << 2,
+    SIMULATION_KEY_LEFT = 1 << 3,
+    SIMULATION_KEY_UP = 1 << 4,
+    SIMULATION_KEY_DOWN = 1 << 5
+};
+
+//Presses, they act once on the first step after them
+enum SimulationAction {
+    SIMULATION_ACTION_NEXT_CAMERA_MODE = 1 << 0
+};
+
+enum CameraMode {
+    //Flies anywhere
+    CAMERA_MODE_FREE = 0,
+    //Flies anywhere above the terrain surface
+    CAMERA_MODE_COLLISION = 1,
+    //Walks on the terrain at a fixed eye height
+    CAMERA_MODE_TERRAIN_FOLLOW = 2
+};
+
+/*
+ * Input of one step, what a recording stores
+ */
+struct SimulationInput {
+    uint32_t heldKeys = 0;
+    uint32_t actions = 0;
+    //Pitch and yaw change in degrees
+    glm::vec2 look = glm::vec2(0);
+};
+
+struct SimulationState {
+    glm::vec3 eye = glm::vec3(0, 0, 1);
+    //Pitch and yaw in degrees
+    glm::vec2 angle = glm::vec2(0);
+    //Rotation of the light around the scene in radians
+    float lightAngle = 0;
+    CameraMode cameraMode = CAMERA_MODE_FREE;
+    uint64_t step = 0;
+};
+
+/*
+ * Camera and scene animation advanced in fixed steps, independent of the frame rate and of key repeat.
+ * Rendering reads a state interpolated between the last two steps. The same initial state and the same input per
+ * step always give the same states, which is what recordings rely on: a replay feeds the recorded input step by
+ * step and reaches the same states whatever the frame rate was when recording or replaying.
+ */
+class FixedStepSimulation {
+public:
+    //World units per second
+    float moveSpeed = 1.0f;
+    //Radians per second
+    float lightSpeed = 0.06f;
+    float collisionClearance = 0.05f;
+    float eyeHeight = 0.15f;
+
+    FixedStepSimulation(double stepSeconds, const SimulationState &initialState);
+
+    /*
+     * Height queries of the collision and terrain follow modes, without a terrain every mode flies freely
+     */
+    void setTerrain(const TerrainHeightField *terrain);
+
+    /*
+     * Writes the input of every step to the file, false when it cannot be created
+     */
+    bool startRecording(const std::string &path);
+
+    /*
+     * Takes the input of every step from a recording instead of the live input, false when it cannot be read
+     */
+    bool startReplay(const std::string &path);
+
+    bool isReplaying() const;
+
+    bool replayFinished() const;
+
+    /*
+     * Runs the steps that fit in the elapsed time plus what was left over from the previous call. The held keys of
+     * the input apply to all of them, the actions and look only to the first one.
+     * Returns the amount of steps run.
+     */
+    uint32_t advance(double elapsedSeconds, const SimulationInput &input);
+
+    /*
+     * State between the last two steps at the leftover time
+     */
+    SimulationState interpolated() const;
+
+    const SimulationState &current() const;
+
+    /*
+     * FNV-1a of the current state, equal for equal runs
+     */
+    uint64_t stateHash() const;
+
+private:
+    //Past this many steps per call the simulation slows down instead of trying to catch up forever
+    static const uint32_t MAX_STEPS_PER_ADVANCE = 8;
+
+    double stepSeconds;
+    double accumulator = 0;
+    SimulationState previousState;
+    SimulationState currentState;
+    const TerrainHeightField *terrain = nullptr;
+    //Live input not taken by a step yet
+    SimulationInput pendingInput;
+
+    std::ofstream recording;
+    std::ifstream replay;
+    bool replaying = false;
+    bool replayEnded = false;
+
+    void step(const SimulationInput &input);
+
+    bool readReplayInput(SimulationInput &input);
+};
+
+
+#endif //VULKANBASE_SIMULATION_H
@@ -0,0 +1,52 @@
+#ifndef VULKANBASE_SPAN_H
+#define VULKANBASE_SPAN_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Non owning view of contiguous elements, so the callers can pass a single handle, an array or a vector
+ * without building a vector for the call. The viewed elements must outlive the span.
+ */
+template<typename T>
+class Span {
+public:
+    Span() = default;
+
+    Span(const T &element) : elements(&element), count(1) {}
+
+    Span(const T *elements, uint32_t count) : elements(elements), count(count) {}
+
+    template<size_t N>
+    Span(const T (&array)[N]) : elements(array), count(N) {}
+
+    Span(const std::vector<T> &vector) : elements(vector.data()), count(vector.size()) {}
+
+    const T *data() const {
+        return elements;
+    }
+
+    uint32_t size() const {
+        return count;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    const T *begin() const {
+        return elements;
+    }
+
+    const T *end() const {
+        return elements + count;
+    }
+
+private:
+    const T *elements = nullptr;
+    uint32_t count = 0;
+};
+
+
+#endif //VULKANBASE_SPAN_H
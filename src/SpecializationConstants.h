@@ -0,0 +1,92 @@
+#ifndef VULKANBASE_SPECIALIZATIONCONSTANTS_H
+#define VULKANBASE_SPECIALIZATIONCONSTANTS_H
+
+#define GLFW_INCLUDE_VULKAN
+
+#include <GLFW/glfw3.h>
+#include <array>
+#include <cstring>
+#include <type_traits>
+
+/*
+ * Compile time description of a shader specialization constant, the id matches layout(constant_id = ConstantId)
+ */
+template<uint32_t ConstantId, typename T>
+struct SpecializationConstant {
+    static_assert(sizeof(T) == 4, "Specialization constants are packed as 32 bit values, use VkBool32 for booleans");
+    static constexpr uint32_t id = ConstantId;
+    using Type = T;
+};
+
+/*
+ * Packs the values of a fixed list of specialization constants in one block, with the map entries generated from
+ * the list. The same block can be given to every stage, each stage only reads the ids it declares.
+ */
+template<typename... Constants>
+class SpecializationBlock {
+public:
+    static constexpr uint32_t count = sizeof...(Constants);
+
+    SpecializationBlock() {
+        uint32_t ids[count] = {Constants::id...};
+        for (uint32_t i = 0; i < count; ++i) {
+            mapEntries[i].constantID = ids[i];
+            mapEntries[i].offset = i * sizeof(uint32_t);
+            mapEntries[i].size = sizeof(uint32_t);
+        }
+        data.fill(0);
+    }
+
+    template<typename Constant>
+    void set(typename Constant::Type value) {
+        static_assert(indexOf<Constant>() < count, "The constant is not part of this block");
+        std::memcpy(&data[indexOf<Constant>()], &value, sizeof(uint32_t));
+    }
+
+    template<typename Constant>
+    typename Constant::Type get() const {
+        static_assert(indexOf<Constant>() < count, "The constant is not part of this block");
+        typename Constant::Type value;
+        std::memcpy(&value, &data[indexOf<Constant>()], sizeof(uint32_t));
+        return value;
+    }
+
+    /*
+     * Points into this block, it must outlive the pipeline creation
+     */
+    const VkSpecializationInfo *info() {
+        specializationInfo.mapEntryCount = count;
+        specializationInfo.pMapEntries = mapEntries.data();
+        specializationInfo.dataSize = sizeof(data);
+        specializationInfo.pData = data.data();
+        return &specializationInfo;
+    }
+
+private:
+    std::array<uint32_t, count> data;
+    std::array<VkSpecializationMapEntry, count> mapEntries;
+    VkSpecializationInfo specializationInfo{};
+
+    template<typename Constant>
+    static constexpr uint32_t indexOf() {
+        bool matches[count] = {std::is_same<Constant, Constants>::value...};
+        for (uint32_t i = 0; i < count; ++i) {
+            if (matches[i]) return i;
+        }
+        return count;
+    }
+};
+
+/*
+ * Specialization of each graphics stage, a null stage is not specialized
+ */
+struct PipelineSpecialization {
+    const VkSpecializationInfo *vertex = nullptr;
+    const VkSpecializationInfo *fragment = nullptr;
+    const VkSpecializationInfo *tessellationControl = nullptr;
+    const VkSpecializationInfo *tessellationEvaluation = nullptr;
+    const VkSpecializationInfo *geometry = nullptr;
+};
+
+
+#endif //VULKANBASE_SPECIALIZATIONCONSTANTS_H
@@ -0,0 +1,198 @@
+#include "StagingManager.h"
+#include "CommandBufferUtils.h"
+#include <algorithm>
+#include <iostream>
+
+StagingManager::StagingManager(const DeviceContext &deviceContext, DeviceMemoryTracker &memoryTracker,
+                               VkDeviceSize chunkSize, uint32_t chunkCount) : deviceContext(deviceContext),
+                                                                              memoryTracker(memoryTracker),
+                                                                              chunkSize(chunkSize) {
+    chunks.resize(chunkCount);
+    for (auto &chunk : chunks) {
+        void *mapped = nullptr;
+        chunk.buffer = vulkanCreateBuffer(chunkSize, mapped);
+        chunk.mapped = static_cast<uint8_t *>(mapped);
+        chunk.offset = 0;
+        chunk.groupCount = 0;
+    }
+    if (!chunks.empty()) {
+        heapIndex = memoryTracker.heapIndex(chunks[0].buffer.memoryRequirements.memoryTypeBits,
+                                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    }
+    evictionHandlerId = memoryTracker.addEvictionHandler([this](uint32_t heapIndex, VkDeviceSize bytes) {
+        vulkanEvict(heapIndex, bytes);
+    });
+}
+
+StagingAllocation StagingManager::vulkanAllocate(VkDeviceSize size, VkDeviceSize alignment) {
+    vulkanRecycle();
+    allocationCount++;
+    alignment = std::max(alignment,
+                         deviceContext.physicalDeviceInfo.physicalDeviceProperties.limits.optimalBufferCopyOffsetAlignment);
+    StagingAllocation allocation{};
+    if (size <= chunkSize && !chunks.empty()) {
+        if (tryAllocate(currentChunk, size, alignment, allocation)) return allocation;
+        for (;;) {
+            for (uint32_t i = 0; i < chunks.size(); ++i) {
+                if (chunks[i].groupCount == 0 && vulkanRestoreChunk(i)) {
+                    currentChunk = i;
+                    if (tryAllocate(i, size, alignment, allocation)) return allocation;
+                }
+            }
+            //Every chunk holds allocations of the open group, waiting would never free them
+            if (pendingGroups.empty()) break;
+            CommandBufferUtils::vulkanWaitForFences(deviceContext.handles, {pendingGroups.front().fence}, false);
+            release(pendingGroups.front());
+            pendingGroups.erase(pendingGroups.begin());
+            waitCount++;
+        }
+    }
+
+    void *mapped = nullptr;
+    Buffer temporary = vulkanCreateBuffer(size, mapped);
+    openGroup.temporaries.push_back(temporary);
+    temporaryCount++;
+    temporaryBytes += size;
+    allocation.buffer = temporary.buffer;
+    allocation.offset = 0;
+    allocation.size = size;
+    allocation.data = mapped;
+    return allocation;
+}
+
+void StagingManager::vulkanSubmitted(VkFence fence) {
+    //A fence is only resubmitted after it was waited, so the groups it signaled before are done
+    for (auto group = pendingGroups.begin(); group != pendingGroups.end();) {
+        if (group->fence == fence) {
+            release(*group);
+            group = pendingGroups.erase(group);
+        } else {
+            ++group;
+        }
+    }
+    if (openGroup.chunks.empty() && openGroup.temporaries.empty()) return;
+    openGroup.fence = fence;
+    pendingGroups.push_back(std::move(openGroup));
+    openGroup = Group();
+}
+
+void StagingManager::vulkanRecycle() {
+    for (auto group = pendingGroups.begin(); group != pendingGroups.end();) {
+        if (vkGetFenceStatus(deviceContext.handles.device, group->fence) == VK_SUCCESS) {
+            release(*group);
+            group = pendingGroups.erase(group);
+        } else {
+            ++group;
+        }
+    }
+}
+
+void StagingManager::report() const {
+    const double megabyte = 1024.0 * 1024.0;
+    std::cout << "STAGING: " << allocationCount << " uploads, " << chunkBytes / megabyte << " MB through "
+              << chunks.size() << " chunks of " << chunkSize / megabyte << " MB, " << waitCount << " waits, "
+              << temporaryCount << " temporary allocations (" << temporaryBytes / megabyte << " MB), "
+              << evictedChunkCount << " evicted chunks" << std::endl;
+}
+
+void StagingManager::vulkanEvict(uint32_t heapIndex, VkDeviceSize bytes) {
+    //Temporaries of any heap go with their groups, the GPU is done with them
+    vulkanRecycle();
+    if (heapIndex != this->heapIndex) return;
+    VkDeviceSize freed = 0;
+    for (auto &chunk : chunks) {
+        if (freed >= bytes) break;
+        if (chunk.groupCount != 0 || chunk.buffer.buffer == VK_NULL_HANDLE) continue;
+        freed += chunk.buffer.memoryRequirements.size;
+        vulkanDestroyBuffer(chunk.buffer);
+        chunk.mapped = nullptr;
+        evictedChunkCount++;
+    }
+}
+
+void StagingManager::vulkanDestroy() {
+    report();
+    memoryTracker.removeEvictionHandler(evictionHandlerId);
+    for (auto &group : pendingGroups) {
+        CommandBufferUtils::vulkanWaitForFences(deviceContext.handles, {group.fence}, false);
+        release(group);
+    }
+    pendingGroups.clear();
+    //Allocated but never submitted, nothing reads them
+    release(openGroup);
+    openGroup = Group();
+    for (auto &chunk : chunks) {
+        if (chunk.buffer.buffer != VK_NULL_HANDLE) vulkanDestroyBuffer(chunk.buffer);
+    }
+    chunks.clear();
+}
+
+Buffer StagingManager::vulkanCreateBuffer(VkDeviceSize size, void *&mapped) {
+    VkDevice device = deviceContext.handles.device;
+    VkBufferCreateInfo vkBufferCreateInfo{};
+    vkBufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    vkBufferCreateInfo.size = size;
+    vkBufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    vkBufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    Buffer buffer{};
+    buffer.size = size;
+    VK_ASSERT(vkCreateBuffer(device, &vkBufferCreateInfo, nullptr, &buffer.buffer));
+    vkGetBufferMemoryRequirements(device, buffer.buffer, &buffer.memoryRequirements);
+    buffer.deviceMemory = memoryTracker.vulkanAllocate(buffer.memoryRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                                                                  VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                       MEMORY_TAG_STAGING);
+    VK_ASSERT(vkBindBufferMemory(device, buffer.buffer, buffer.deviceMemory, 0));
+    VK_ASSERT(vkMapMemory(device, buffer.deviceMemory, 0, size, 0, &mapped));
+    return buffer;
+}
+
+void StagingManager::vulkanDestroyBuffer(Buffer &buffer) {
+    vkUnmapMemory(deviceContext.handles.device, buffer.deviceMemory);
+    vkDestroyBuffer(deviceContext.handles.device, buffer.buffer, nullptr);
+    memoryTracker.vulkanFree(buffer.deviceMemory);
+    buffer = Buffer{};
+}
+
+bool StagingManager::vulkanRestoreChunk(uint32_t chunkIndex) {
+    Chunk &chunk = chunks[chunkIndex];
+    if (chunk.buffer.buffer != VK_NULL_HANDLE) return true;
+    //Waiting for the chunks still there is better than pushing the heap over budget
+    if (memoryTracker.availableBytes(heapIndex) < chunkSize) return false;
+    void *mapped = nullptr;
+    Buffer buffer = vulkanCreateBuffer(chunkSize, mapped);
+    chunk.buffer = buffer;
+    chunk.mapped = static_cast<uint8_t *>(mapped);
+    chunk.offset = 0;
+    return true;
+}
+
+bool StagingManager::tryAllocate(uint32_t chunkIndex, VkDeviceSize size, VkDeviceSize alignment,
+                                 StagingAllocation &allocation) {
+    Chunk &chunk = chunks[chunkIndex];
+    if (chunk.buffer.buffer == VK_NULL_HANDLE) return false;
+    VkDeviceSize offset = (chunk.offset + alignment - 1) / alignment * alignment;
+    if (offset > chunkSize || size > chunkSize - offset) return false;
+    chunk.offset = offset + size;
+    if (std::find(openGroup.chunks.begin(), openGroup.chunks.end(), chunkIndex) == openGroup.chunks.end()) {
+        openGroup.chunks.push_back(chunkIndex);
+        chunk.groupCount++;
+    }
+    chunkBytes += size;
+    allocation.buffer = chunk.buffer.buffer;
+    allocation.offset = offset;
+    allocation.size = size;
+    allocation.data = chunk.mapped + offset;
+    return true;
+}
+
+void StagingManager::release(Group &group) {
+    for (uint32_t chunkIndex : group.chunks) {
+        //Rewound once nothing in flight reads it
+        if (--chunks[chunkIndex].groupCount == 0) chunks[chunkIndex].offset = 0;
+    }
+    group.chunks.clear();
+    for (auto &temporary : group.temporaries) {
+        vulkanDestroyBuffer(temporary);
+    }
+    group.temporaries.clear();
+}
@@ -0,0 +1,121 @@
+#ifndef VULKANBASE_STAGINGMANAGER_H
+#define VULKANBASE_STAGINGMANAGER_H
+
+#define GLFW_INCLUDE_VULKAN
+
+#include <GLFW/glfw3.h>
+#include <vector>
+#include "VulkanStructures.h"
+#include "DeviceContext.h"
+#include "DeviceMemoryTracker.h"
+
+/*
+ * Range of a staging buffer the CPU writes and a transfer reads from, data points at offset of the mapped buffer
+ */
+struct StagingAllocation {
+    VkBuffer buffer;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    void *data;
+};
+
+/*
+ * Staging memory for every upload, out of a fixed set of chunks allocated once, persistently mapped and host
+ * coherent, so nothing needs flushing. Allocations are carved linearly out of a chunk and are released in groups:
+ * vulkanSubmitted closes the group of everything allocated since the previous call and ties it to the fence of the
+ * submit that reads it. A chunk is rewound once the fences of all its groups were signaled.
+ * When every chunk is in use the oldest group is waited, so a long stream of uploads is throttled by the transfers
+ * instead of growing. Uploads larger than a chunk, or made while the open group already holds every chunk, get a
+ * temporary buffer of their own released with their group.
+ * Over the budget of the staging heap the memory tracker evicts the released groups and the idle chunks. An evicted
+ * chunk is allocated again when an upload needs it and the heap has room for it, waiting the oldest group otherwise.
+ * The fence of a group must not be reset until it was waited again, which vulkanBeginCommandBuffer does before it
+ * resets, and nothing may be allocated between resetting a fence and the submit that signals it.
+ */
+class StagingManager {
+public:
+    StagingManager(const DeviceContext &deviceContext, DeviceMemoryTracker &memoryTracker, VkDeviceSize chunkSize,
+                   uint32_t chunkCount);
+
+    /*
+     * The offset is aligned to the alignment and to the optimal copy offset of the device
+     */
+    StagingAllocation vulkanAllocate(VkDeviceSize size, VkDeviceSize alignment = 16);
+
+    /*
+     * Everything allocated since the last call is read by the submit that signals the fence
+     */
+    void vulkanSubmitted(VkFence fence);
+
+    /*
+     * Release the groups whose fence was signaled, without waiting
+     */
+    void vulkanRecycle();
+
+    /*
+     * Print how the uploads were served, temporary allocations mean the chunks are too few or too small
+     */
+    void report() const;
+
+    /*
+     * Report, then wait every group and free the chunks, nothing may be allocated afterwards
+     */
+    void vulkanDestroy();
+
+private:
+    struct Chunk {
+        Buffer buffer;
+        uint8_t *mapped;
+        VkDeviceSize offset;
+        //Groups, the open one included, with allocations in the chunk
+        uint32_t groupCount;
+    };
+
+    struct Group {
+        VkFence fence = VK_NULL_HANDLE;
+        std::vector<uint32_t> chunks;
+        std::vector<Buffer> temporaries;
+    };
+
+    const DeviceContext &deviceContext;
+    DeviceMemoryTracker &memoryTracker;
+    VkDeviceSize chunkSize;
+    //Heap of the chunks and the temporaries
+    uint32_t heapIndex = 0;
+    uint32_t evictionHandlerId;
+    std::vector<Chunk> chunks;
+    uint32_t currentChunk = 0;
+    Group openGroup;
+    //Oldest first
+    std::vector<Group> pendingGroups;
+    uint64_t allocationCount = 0;
+    VkDeviceSize chunkBytes = 0;
+    uint64_t temporaryCount = 0;
+    VkDeviceSize temporaryBytes = 0;
+    uint64_t waitCount = 0;
+    uint64_t evictedChunkCount = 0;
+
+    Buffer vulkanCreateBuffer(VkDeviceSize size, void *&mapped);
+
+    void vulkanDestroyBuffer(Buffer &buffer);
+
+    /*
+     * Eviction handler of the memory tracker: releases the signaled groups, then frees idle chunks of the heap
+     */
+    void vulkanEvict(uint32_t heapIndex, VkDeviceSize bytes);
+
+    /*
+     * Allocate the chunk again if it was evicted, false when the heap has no room left for it
+     */
+    bool vulkanRestoreChunk(uint32_t chunkIndex);
+
+    /*
+     * Carve the range out of the chunk, false if it does not fit or the chunk was evicted
+     */
+    bool tryAllocate(uint32_t chunkIndex, VkDeviceSize size, VkDeviceSize alignment, StagingAllocation &allocation);
+
+    void release(Group &group);
+};
+
+
+#endif //VULKANBASE_STAGINGMANAGER_H
@@ -0,0 +1,250 @@
+#include "TerrainHeightField.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+
+#include <emmintrin.h>
+
+#endif
+
+TerrainHeightField::TerrainHeightField(const HeightPyramid &pyramid, glm::vec3 origin, glm::vec3 size) : pyramid(pyramid),
+                                                                                                      heightTexels(pyramid.getHeights()),
+                                                                                                      width(pyramid.getLevelWidth(0)),
+                                                                                                      height(pyramid.getLevelHeight(0)),
+                                                                                                      origin(origin),
+                                                                                                      size(size) {}
+
+float TerrainHeightField::sampleTexels(float x, float z) const {
+    //Clamped first so the conversions below stay in range, anything past the edge reads the edge texels
+    float fx = glm::clamp(x - 0.5f, -1.0f, (float) width);
+    float fz = glm::clamp(z - 0.5f, -1.0f, (float) height);
+    float x0f = std::floor(fx), z0f = std::floor(fz);
+    float tx = fx - x0f, tz = fz - z0f;
+    uint32_t x0 = (uint32_t) glm::clamp(x0f, 0.0f, (float) width - 1), x1 = (uint32_t) glm::clamp(x0f + 1, 0.0f, (float) width - 1);
+    uint32_t z0 = (uint32_t) glm::clamp(z0f, 0.0f, (float) height - 1), z1 = (uint32_t) glm::clamp(z0f + 1, 0.0f, (float) height - 1);
+    const float *row0 = heightTexels + (size_t) z0 * width;
+    const float *row1 = heightTexels + (size_t) z1 * width;
+    float top = row0[x0] + (row0[x1] - row0[x0]) * tx;
+    float bottom = row1[x0] + (row1[x1] - row1[x0]) * tx;
+    return top + (bottom - top) * tz;
+}
+
+float TerrainHeightField::sampleHeight(glm::vec2 uv) const {
+    return sampleTexels(uv.x * width, uv.y * height);
+}
+
+void TerrainHeightField::sampleHeights(const glm::vec2 *uvs, float *heights, size_t count) const {
+    size_t i = 0;
+#if defined(__SSE2__)
+    //The filter weights are computed four at a time, SSE2 has no gather so the texel reads stay scalar
+    const __m128 one = _mm_set1_ps(1.0f), zero = _mm_setzero_ps(), half = _mm_set1_ps(0.5f);
+    const __m128 sizeX = _mm_set1_ps((float) width), sizeZ = _mm_set1_ps((float) height);
+    const __m128 lastX = _mm_set1_ps((float) width - 1), lastZ = _mm_set1_ps((float) height - 1);
+    auto floorPs = [&](__m128 value) {
+        __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(value));
+        return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, value), one));
+    };
+    alignas(16) int32_t x0[4], x1[4], z0[4], z1[4];
+    alignas(16) float h00[4], h10[4], h01[4], h11[4];
+    for (; i + 4 <= count; i += 4) {
+        __m128 uv01 = _mm_loadu_ps(&uvs[i].x), uv23 = _mm_loadu_ps(&uvs[i + 2].x);
+        __m128 u = _mm_shuffle_ps(uv01, uv23, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 v = _mm_shuffle_ps(uv01, uv23, _MM_SHUFFLE(3, 1, 3, 1));
+        __m128 fx = _mm_min_ps(_mm_max_ps(_mm_sub_ps(_mm_mul_ps(u, sizeX), half), _mm_set1_ps(-1.0f)), sizeX);
+        __m128 fz = _mm_min_ps(_mm_max_ps(_mm_sub_ps(_mm_mul_ps(v, sizeZ), half), _mm_set1_ps(-1.0f)), sizeZ);
+        __m128 x0f = floorPs(fx), z0f = floorPs(fz);
+        __m128 tx = _mm_sub_ps(fx, x0f), tz = _mm_sub_ps(fz, z0f);
+        _mm_store_si128((__m128i *) x0, _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(x0f, zero), lastX)));
+        _mm_store_si128((__m128i *) x1, _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_add_ps(x0f, one), zero), lastX)));
+        _mm_store_si128((__m128i *) z0, _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(z0f, zero), lastZ)));
+        _mm_store_si128((__m128i *) z1, _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_add_ps(z0f, one), zero), lastZ)));
+        for (int k = 0; k < 4; ++k) {
+            const float *row0 = heightTexels + (size_t) z0[k] * width;
+            const float *row1 = heightTexels + (size_t) z1[k] * width;
+            h00[k] = row0[x0[k]];
+            h10[k] = row0[x1[k]];
+            h01[k] = row1[x0[k]];
+            h11[k] = row1[x1[k]];
+        }
+        __m128 a00 = _mm_load_ps(h00), a10 = _mm_load_ps(h10), a01 = _mm_load_ps(h01), a11 = _mm_load_ps(h11);
+        __m128 top = _mm_add_ps(a00, _mm_mul_ps(_mm_sub_ps(a10, a00), tx));
+        __m128 bottom = _mm_add_ps(a01, _mm_mul_ps(_mm_sub_ps(a11, a01), tx));
+        _mm_storeu_ps(heights + i, _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), tz)));
+    }
+#endif
+    for (; i < count; ++i) {
+        heights[i] = sampleHeight(uvs[i]);
+    }
+}
+
+float TerrainHeightField::heightAt(glm::vec2 positionXZ) const {
+    glm::vec2 uv = (positionXZ - glm::vec2(origin.x, origin.z)) / glm::vec2(size.x, size.z);
+    return origin.y + sampleHeight(uv) * size.y;
+}
+
+void TerrainHeightField::heightsAt(const glm::vec2 *positionsXZ, float *heights, size_t count) const {
+    //Converted to UVs in small batches on the stack
+    const size_t batchSize = 64;
+    glm::vec2 uvs[batchSize];
+    glm::vec2 originXZ(origin.x, origin.z), sizeXZ(size.x, size.z);
+    for (size_t begin = 0; begin < count; begin += batchSize) {
+        size_t batch = std::min(batchSize, count - begin);
+        for (size_t i = 0; i < batch; ++i) {
+            uvs[i] = (positionsXZ[begin + i] - originXZ) / sizeXZ;
+        }
+        sampleHeights(uvs, heights + begin, batch);
+        for (size_t i = 0; i < batch; ++i) {
+            heights[begin + i] = origin.y + heights[begin + i] * size.y;
+        }
+    }
+}
+
+glm::vec3 TerrainHeightField::normalAt(glm::vec2 positionXZ) const {
+    glm::vec2 uv = (positionXZ - glm::vec2(origin.x, origin.z)) / glm::vec2(size.x, size.z);
+    glm::vec2 texel = 1.0f / glm::vec2(width, height);
+    float left = sampleHeight(uv - glm::vec2(texel.x, 0));
+    float right = sampleHeight(uv + glm::vec2(texel.x, 0));
+    float down = sampleHeight(uv - glm::vec2(0, texel.y));
+    float up = sampleHeight(uv + glm::vec2(0, texel.y));
+    //Slopes in world units, two texels apart
+    glm::vec2 texelWorld = texel * glm::vec2(size.x, size.z);
+    return glm::normalize(glm::vec3((left - right) * size.y / (2.0f * texelWorld.x), 1.0f,
+                                    (down - up) * size.y / (2.0f * texelWorld.y)));
+}
+
+void TerrainHeightField::nodeBounds(uint32_t level, uint32_t x, uint32_t z, glm::vec3 &boundsMin,
+                                    glm::vec3 &boundsMax) const {
+    uint32_t levelWidth = pyramid.getLevelWidth(level), levelHeight = pyramid.getLevelHeight(level);
+    glm::vec2 range(INFINITY, -INFINITY);
+    for (uint32_t j = (z > 0 ? z - 1 : 0); j <= std::min(z + 1, levelHeight - 1); ++j) {
+        for (uint32_t i = (x > 0 ? x - 1 : 0); i <= std::min(x + 1, levelWidth - 1); ++i) {
+            glm::vec2 texelRange = pyramid.getRange(level, i, j);
+            range.x = std::min(range.x, texelRange.x);
+            range.y = std::max(range.y, texelRange.y);
+        }
+    }
+    boundsMin = glm::vec3(x << level, range.x, z << level);
+    boundsMax = glm::vec3(std::min((x + 1) << level, width), range.y, std::min((z + 1) << level, height));
+}
+
+/*
+ * Slab test, false when the ray line misses the box
+ */
+static bool intersectBox(glm::vec3 origin, glm::vec3 direction, glm::vec3 boundsMin, glm::vec3 boundsMax,
+                         float &tEnter, float &tExit) {
+    tEnter = -INFINITY;
+    tExit = INFINITY;
+    for (int axis = 0; axis < 3; ++axis) {
+        if (direction[axis] == 0) {
+            if (origin[axis] < boundsMin[axis] || origin[axis] > boundsMax[axis]) return false;
+            continue;
+        }
+        float inverse = 1.0f / direction[axis];
+        float t0 = (boundsMin[axis] - origin[axis]) * inverse;
+        float t1 = (boundsMax[axis] - origin[axis]) * inverse;
+        if (t0 > t1) std::swap(t0, t1);
+        tEnter = std::max(tEnter, t0);
+        tExit = std::min(tExit, t1);
+    }
+    return tEnter <= tExit;
+}
+
+bool TerrainHeightField::intersectTexel(uint32_t x, uint32_t z, glm::vec3 rayOrigin, glm::vec3 rayDirection,
+                                        float tEnter, float tExit, float &distance) const {
+    //The texel center splits it in four bilinear cells, the ray is cut where it crosses the center lines
+    float cuts[4] = {tEnter, tExit, tExit, tExit};
+    uint32_t cutCount = 2;
+    if (rayDirection.x != 0) {
+        float t = (x + 0.5f - rayOrigin.x) / rayDirection.x;
+        if (t > tEnter && t < tExit) cuts[cutCount++] = t;
+    }
+    if (rayDirection.z != 0) {
+        float t = (z + 0.5f - rayOrigin.z) / rayDirection.z;
+        if (t > tEnter && t < tExit) cuts[cutCount++] = t;
+    }
+    std::sort(cuts, cuts + cutCount);
+
+    auto aboveSurface = [&](float t) {
+        glm::vec3 point = rayOrigin + rayDirection * t;
+        return point.y - sampleTexels(point.x, point.z);
+    };
+    for (uint32_t segment = 0; segment + 1 < cutCount; ++segment) {
+        float a = cuts[segment], b = cuts[segment + 1];
+        //Along a line a bilinear cell is a quadratic, so three samples give it exactly, s goes from 0 at a to 1 at b
+        float fa = aboveSurface(a), fm = aboveSurface((a + b) * 0.5f), fb = aboveSurface(b);
+        if (fa <= 0) {
+            distance = a;
+            return true;
+        }
+        float c0 = fa, c1 = 4 * fm - 3 * fa - fb, c2 = 2 * fa - 4 * fm + 2 * fb;
+        float s = INFINITY;
+        float discriminant = c1 * c1 - 4 * c2 * c0;
+        if (discriminant >= 0) {
+            //Roots without the cancellation of the textbook formula, c2 is close to zero on almost flat cells
+            float q = -0.5f * (c1 + std::copysign(std::sqrt(discriminant), c1));
+            float s0 = c2 != 0 ? q / c2 : INFINITY, s1 = q != 0 ? c0 / q : INFINITY;
+            if (s0 > s1) std::swap(s0, s1);
+            s = s0 >= 0 ? s0 : s1;
+        }
+        if (s >= 0 && s <= 1) {
+            distance = a + s * (b - a);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TerrainHeightField::raycast(glm::vec3 origin, glm::vec3 direction, float maxDistance, TerrainRayHit &hit) const {
+    //Texel space: x and z in texels of level 0, y in heightmap units. It is a per axis scale, so distances along
+    //the ray are the same as in the world.
+    glm::vec3 scale(width / size.x, 1.0f / size.y, height / size.z);
+    glm::vec3 rayOrigin = (origin - this->origin) * scale;
+    glm::vec3 rayDirection = direction * scale;
+
+    struct Node {
+        uint32_t level;
+        uint32_t x;
+        uint32_t z;
+    };
+    //Every level pushes at most four children on top of its own pop
+    Node stack[4 * 32];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = {pyramid.getLevelCount() - 1, 0, 0};
+    float closest = maxDistance;
+    bool found = false;
+    //Near children are pushed last so they are visited first, then any farther node starting past a hit is skipped
+    uint32_t nearX = rayDirection.x >= 0 ? 0 : 1, nearZ = rayDirection.z >= 0 ? 0 : 1;
+    uint32_t order[4][2] = {{1 - nearX, 1 - nearZ}, {1 - nearX, nearZ}, {nearX, 1 - nearZ}, {nearX, nearZ}};
+    while (stackSize > 0) {
+        Node node = stack[--stackSize];
+        glm::vec3 boundsMin, boundsMax;
+        nodeBounds(node.level, node.x, node.z, boundsMin, boundsMax);
+        float tEnter, tExit;
+        if (!intersectBox(rayOrigin, rayDirection, boundsMin, boundsMax, tEnter, tExit)) continue;
+        tEnter = std::max(tEnter, 0.0f);
+        tExit = std::min(tExit, closest);
+        if (tEnter > tExit) continue;
+
+        if (node.level == 0) {
+            float distance;
+            if (intersectTexel(node.x, node.z, rayOrigin, rayDirection, tEnter, tExit, distance)) {
+                closest = distance;
+                found = true;
+            }
+            continue;
+        }
+        uint32_t childLevel = node.level - 1;
+        for (auto &child : order) {
+            uint32_t childX = 2 * node.x + child[0], childZ = 2 * node.z + child[1];
+            if (childX >= pyramid.getLevelWidth(childLevel) || childZ >= pyramid.getLevelHeight(childLevel)) continue;
+            stack[stackSize++] = {childLevel, childX, childZ};
+        }
+    }
+    if (!found) return false;
+
+    hit.distance = closest;
+    hit.position = origin + direction * closest;
+    hit.normal = normalAt(glm::vec2(hit.position.x, hit.position.z));
+    return true;
+}
@@ -0,0 +1,79 @@
+#ifndef VULKANBASE_TERRAINHEIGHTFIELD_H
+#define VULKANBASE_TERRAINHEIGHTFIELD_H
+
+#include <cstdint>
+#include <cstddef>
+#include <glm/glm.hpp>
+#include "HeightPyramid.h"
+
+struct TerrainRayHit {
+    float distance;
+    glm::vec3 position;
+    glm::vec3 normal;
+};
+
+/*
+ * CPU queries against the terrain surface, for the camera and gameplay.
+ * The surface is the bilinear interpolation of the heightmap with texel centers at (i + 0.5) / size and clamped
+ * edges, the same one the tessellation shaders read through a linear sampler. Heights come from level 0 of the
+ * pyramid and the ray casts skip empty space with its min/max levels, the pyramid must outlive this object.
+ *
+ * The heightmap covers the world rectangle [origin.xz, origin.xz + size.xz], u along x and v along z, and a
+ * height h of the heightmap is at origin.y + h * size.y.
+ */
+class TerrainHeightField {
+public:
+    TerrainHeightField(const HeightPyramid &pyramid, glm::vec3 origin, glm::vec3 size);
+
+    /*
+     * Heightmap value at the UV, not transformed to the world
+     */
+    float sampleHeight(glm::vec2 uv) const;
+
+    /*
+     * sampleHeight of count UVs, four at a time with SSE2 when available
+     */
+    void sampleHeights(const glm::vec2 *uvs, float *heights, size_t count) const;
+
+    /*
+     * World height of the surface under the world position
+     */
+    float heightAt(glm::vec2 positionXZ) const;
+
+    /*
+     * heightAt of count world positions
+     */
+    void heightsAt(const glm::vec2 *positionsXZ, float *heights, size_t count) const;
+
+    /*
+     * World normal from central differences one texel apart, like the heightmap normals of the shaders
+     */
+    glm::vec3 normalAt(glm::vec2 positionXZ) const;
+
+    /*
+     * First point where the ray goes below the surface within maxDistance, measured in units of direction.
+     * A ray starting below the surface hits where it starts.
+     */
+    bool raycast(glm::vec3 origin, glm::vec3 direction, float maxDistance, TerrainRayHit &hit) const;
+
+private:
+    const HeightPyramid &pyramid;
+    const float *heightTexels;
+    uint32_t width;
+    uint32_t height;
+    glm::vec3 origin;
+    glm::vec3 size;
+
+    //Bilinear height at a position given in texels of level 0
+    float sampleTexels(float x, float z) const;
+
+    //Texel space box of a pyramid node, grown by its neighbours since the bilinear surface reaches half a texel out
+    void nodeBounds(uint32_t level, uint32_t x, uint32_t z, glm::vec3 &boundsMin, glm::vec3 &boundsMax) const;
+
+    //Crossing inside one texel of level 0, between the entry and exit distances of the ray in texel space
+    bool intersectTexel(uint32_t x, uint32_t z, glm::vec3 rayOrigin, glm::vec3 rayDirection, float tEnter, float tExit,
+                        float &distance) const;
+};
+
+
+#endif //VULKANBASE_TERRAINHEIGHTFIELD_H
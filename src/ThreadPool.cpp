@@ -0,0 +1,94 @@
+#include "ThreadPool.h"
+#include <atomic>
+#include <algorithm>
+#include <exception>
+
+ThreadPool::ThreadPool(uint32_t threadCount) {
+    if (threadCount == 0) {
+        uint32_t hardwareThreads = std::thread::hardware_concurrency();
+        threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+    }
+    for (uint32_t i = 0; i < threadCount; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueCondition.notify_all();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueCondition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            //Pending tasks are still drained on shutdown so no future is left without a value
+            if (tasks.empty()) return;
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        task();
+    }
+}
+
+bool ThreadPool::tryRunPendingTask() {
+    std::function<void()> task;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (tasks.empty()) return false;
+        task = std::move(tasks.front());
+        tasks.pop();
+    }
+    task();
+    return true;
+}
+
+void ThreadPool::parallelFor(uint32_t count, uint32_t grainSize, const std::function<void(uint32_t, uint32_t)> &body) {
+    if (count == 0) return;
+    grainSize = std::max(grainSize, 1u);
+    uint32_t chunkCount = std::min((count + grainSize - 1) / grainSize, (uint32_t) workers.size() + 1);
+    uint32_t chunkSize = (count + chunkCount - 1) / chunkCount;
+    if (chunkCount <= 1) {
+        body(0, count);
+        return;
+    }
+
+    std::atomic<uint32_t> remaining(chunkCount - 1);
+    std::mutex errorMutex;
+    std::exception_ptr firstError;
+    //The chunks reference this frame, so even a throwing one must count down before the caller can return
+    auto runChunk = [&body, &errorMutex, &firstError](uint32_t begin, uint32_t end) {
+        try {
+            if (begin < end) body(begin, end);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!firstError) firstError = std::current_exception();
+        }
+    };
+    for (uint32_t chunk = 1; chunk < chunkCount; ++chunk) {
+        uint32_t begin = chunk * chunkSize;
+        uint32_t end = std::min(begin + chunkSize, count);
+        submit([&runChunk, &remaining, begin, end]() {
+            runChunk(begin, end);
+            remaining--;
+        });
+    }
+    runChunk(0, std::min(chunkSize, count));
+    //Help with the queue instead of blocking, otherwise a parallelFor inside a task could starve the pool
+    while (remaining.load() > 0) {
+        if (!tryRunPendingTask()) std::this_thread::yield();
+    }
+    if (firstError) std::rethrow_exception(firstError);
+}
+
+uint32_t ThreadPool::getThreadCount() const {
+    return workers.size();
+}
@@ -0,0 +1,66 @@
+#ifndef VULKANBASE_THREADPOOL_H
+#define VULKANBASE_THREADPOOL_H
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+
+/*
+ * Fixed amount of worker threads consuming a single task queue.
+ * Tasks are expressed as futures, a task that depends on another one simply calls get() on its future,
+ * which is how the startup task graph is built.
+ */
+class ThreadPool {
+public:
+    /*
+     * A threadCount of 0 uses one thread per hardware thread minus the caller, with a minimum of one
+     */
+    explicit ThreadPool(uint32_t threadCount = 0);
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    template<typename Task>
+    auto submit(Task task) -> std::future<decltype(task())> {
+        using Result = decltype(task());
+        auto packagedTask = std::make_shared<std::packaged_task<Result()>>(std::move(task));
+        std::future<Result> future = packagedTask->get_future();
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            tasks.emplace([packagedTask]() { (*packagedTask)(); });
+        }
+        queueCondition.notify_one();
+        return future;
+    }
+
+    /*
+     * Split [0, count) in chunks of at least grainSize and run body(begin, end) on each one.
+     * The caller works on the chunks too, so it is safe to call from inside a task.
+     * If body throws, the other chunks still run and the first exception is rethrown on the caller once all are done.
+     */
+    void parallelFor(uint32_t count, uint32_t grainSize, const std::function<void(uint32_t, uint32_t)> &body);
+
+    uint32_t getThreadCount() const;
+
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    bool stopping = false;
+
+    void workerLoop();
+
+    bool tryRunPendingTask();
+};
+
+
+#endif //VULKANBASE_THREADPOOL_H
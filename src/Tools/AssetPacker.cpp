@@ -0,0 +1,61 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include "../FileManagers/MappedFile.h"
+#include "../FileManagers/PackArchive.h"
+
+/*
+ * Cooks files into a pack archive for the virtual file system.
+ * Usage: AssetPacker [--store] [--alignment=N] OUTPUT ROOT FILE...
+ * Every FILE is relative to ROOT and keeps that relative path as its name in the archive, so the archive can be
+ * mounted where ROOT was. --store skips the LZ4 compression, blobs start at multiples of N bytes (64 by default).
+ */
+int main(int argc, char **argv) {
+    bool compress = true;
+    uint32_t alignment = 64;
+    std::vector<std::string> arguments;
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument == "--store") compress = false;
+        else if (argument.rfind("--alignment=", 0) == 0) alignment = (uint32_t) std::stoul(argument.substr(12));
+        else arguments.push_back(argument);
+    }
+    if (arguments.size() < 3) {
+        std::cerr << "USAGE: AssetPacker [--store] [--alignment=N] OUTPUT ROOT FILE..." << std::endl;
+        return 1;
+    }
+    std::string root = arguments[1];
+    if (root.back() != '/' && root.back() != '\\') root += '/';
+
+    PackArchiveWriter writer(alignment);
+    if (!writer.open(arguments[0])) {
+        std::cerr << "CANNOT CREATE ARCHIVE: " << arguments[0] << std::endl;
+        return 1;
+    }
+    std::unordered_set<std::string> names;
+    uint64_t totalBytes = 0;
+    for (size_t i = 2; i < arguments.size(); ++i) {
+        std::string name = arguments[i];
+        for (char &c : name) {
+            if (c == '\\') c = '/';
+        }
+        if (!names.insert(name).second) continue;
+        MappedFile file;
+        if (!file.open(root + arguments[i])) {
+            std::cerr << "CANNOT OPEN FILE: " << root + arguments[i] << std::endl;
+            return 1;
+        }
+        if (!writer.add(name, file.data(), file.size(), compress)) {
+            std::cerr << "CANNOT WRITE ARCHIVE: " << arguments[0] << std::endl;
+            return 1;
+        }
+        totalBytes += file.size();
+    }
+    if (!writer.finish()) {
+        std::cerr << "CANNOT WRITE ARCHIVE: " << arguments[0] << std::endl;
+        return 1;
+    }
+    std::cout << names.size() << " files, " << totalBytes << " bytes stored in " << writer.getStoredBytes() << std::endl;
+    return 0;
+}
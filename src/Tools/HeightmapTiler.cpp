@@ -0,0 +1,81 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../ThreadPool.h"
+#include "../FileManagers/ImageDecoders.h"
+#include "../FileManagers/TiledHeightfield.h"
+
+/*
+ * Cooks a heightmap in any format the image decoder registry reads into a tiled heightfield, from the red channel.
+ * Usage: HeightmapTiler [--codec=raw|lz4|zstd] [--format=r16|r32f] [--tile=N] [--level=N] INPUT OUTPUT
+ * Defaults to LZ4 tiles of 256 unsigned 16 bit samples, --level is the Zstd compression level.
+ */
+int main(int argc, char **argv) {
+    TiledHeightfield::Codec codec = TiledHeightfield::CODEC_LZ4;
+    TiledHeightfield::SampleFormat format = TiledHeightfield::UNORM16;
+    uint32_t tileSize = TiledHeightfield::DEFAULT_TILE_SIZE;
+    int level = 9;
+    std::vector<std::string> arguments;
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument == "--codec=raw") codec = TiledHeightfield::CODEC_RAW;
+        else if (argument == "--codec=lz4") codec = TiledHeightfield::CODEC_LZ4;
+        else if (argument == "--codec=zstd") codec = TiledHeightfield::CODEC_ZSTD;
+        else if (argument == "--format=r16") format = TiledHeightfield::UNORM16;
+        else if (argument == "--format=r32f") format = TiledHeightfield::FLOAT32;
+        else if (argument.rfind("--tile=", 0) == 0) tileSize = (uint32_t) std::stoul(argument.substr(7));
+        else if (argument.rfind("--level=", 0) == 0) level = std::stoi(argument.substr(8));
+        else arguments.push_back(argument);
+    }
+    if (arguments.size() != 2) {
+        std::cerr << "USAGE: HeightmapTiler [--codec=raw|lz4|zstd] [--format=r16|r32f] [--tile=N] [--level=N] INPUT OUTPUT"
+                  << std::endl;
+        return 1;
+    }
+    if (!TiledHeightfield::codecSupported(codec)) {
+        std::cerr << "CODEC NOT AVAILABLE IN THIS BUILD" << std::endl;
+        return 1;
+    }
+
+    //Keeps the red channel of every row
+    class HeightSink : public BitmapSink {
+    public:
+        std::vector<float> heights;
+        uint32_t width = 0;
+        uint32_t height = 0;
+
+        void begin(uint32_t width, uint32_t height) override {
+            this->width = width;
+            this->height = height;
+            heights.resize((size_t) width * height);
+            band.resize(width);
+        }
+
+        uint32_t acquireRows(uint32_t firstRow, uint32_t rowCount, glm::vec4 *&rows) override {
+            rows = band.data();
+            return 1;
+        }
+
+        void commitRows(uint32_t firstRow, uint32_t rowCount) override {
+            for (uint32_t x = 0; x < width; ++x) heights[(size_t) firstRow * width + x] = band[x].x;
+        }
+
+    private:
+        std::vector<glm::vec4> band;
+    };
+
+    ImageDecoderRegistry imageDecoders;
+    HeightSink sink;
+    if (!imageDecoders.decode(arguments[0], sink)) {
+        std::cerr << "CANNOT DECODE: " << arguments[0] << std::endl;
+        return 1;
+    }
+    ThreadPool threadPool;
+    if (!TiledHeightfield::write(arguments[1], sink.heights.data(), sink.width, sink.height, format, codec, tileSize,
+                                 level, &threadPool)) {
+        std::cerr << "CANNOT WRITE: " << arguments[1] << std::endl;
+        return 1;
+    }
+    std::cout << sink.width << "x" << sink.height << " heightfield written to " << arguments[1] << std::endl;
+    return 0;
+}
@@ -0,0 +1,76 @@
+#ifndef VULKANBASE_UNIQUEHANDLE_H
+#define VULKANBASE_UNIQUEHANDLE_H
+
+#define GLFW_INCLUDE_VULKAN
+
+#include <GLFW/glfw3.h>
+#include <utility>
+
+/*
+ * Move only owner of a handle created from a device, destroyed when the owner goes out of scope.
+ * The destroy function is stored with the handle because non dispatchable handles may all be the same
+ * integer type on 32 bit platforms, so the handle type alone cannot select it.
+ * The device must outlive every handle created from it.
+ */
+template<typename Handle>
+class UniqueHandle {
+public:
+    using Destroy = void (*)(VkDevice device, Handle handle);
+
+    UniqueHandle() = default;
+
+    UniqueHandle(VkDevice device, Handle handle, Destroy destroy) : device(device), handle(handle), destroy(destroy) {}
+
+    UniqueHandle(const UniqueHandle &) = delete;
+
+    UniqueHandle &operator=(const UniqueHandle &) = delete;
+
+    UniqueHandle(UniqueHandle &&other) noexcept: device(other.device), handle(other.handle), destroy(other.destroy) {
+        other.handle = VK_NULL_HANDLE;
+    }
+
+    UniqueHandle &operator=(UniqueHandle &&other) noexcept {
+        if (this != &other) {
+            reset();
+            device = other.device;
+            handle = other.handle;
+            destroy = other.destroy;
+            other.handle = VK_NULL_HANDLE;
+        }
+        return *this;
+    }
+
+    ~UniqueHandle() {
+        reset();
+    }
+
+    Handle get() const {
+        return handle;
+    }
+
+    /*
+     * For the calls that take an array of handles
+     */
+    const Handle *address() const {
+        return &handle;
+    }
+
+    explicit operator bool() const {
+        return handle != VK_NULL_HANDLE;
+    }
+
+    void reset() {
+        if (handle != VK_NULL_HANDLE) {
+            destroy(device, handle);
+            handle = VK_NULL_HANDLE;
+        }
+    }
+
+private:
+    VkDevice device = VK_NULL_HANDLE;
+    Handle handle = VK_NULL_HANDLE;
+    Destroy destroy = nullptr;
+};
+
+
+#endif //VULKANBASE_UNIQUEHANDLE_H
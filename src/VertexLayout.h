@@ -0,0 +1,98 @@
+#ifndef VULKANBASE_VERTEXLAYOUT_H
+#define VULKANBASE_VERTEXLAYOUT_H
+
+#define GLFW_INCLUDE_VULKAN
+
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+/*
+ * Two 16 bit unsigned values read by the shader as floats in [0, 1]
+ */
+struct UNorm16x2 {
+    uint16_t x;
+    uint16_t y;
+
+    static UNorm16x2 fromFloat(glm::vec2 value) {
+        glm::vec2 scaled = glm::round(glm::clamp(value, glm::vec2(0), glm::vec2(1)) * 65535.0f);
+        return {(uint16_t) scaled.x, (uint16_t) scaled.y};
+    }
+};
+
+/*
+ * Format of a vertex member of type T, a new packed format only needs its type and a specialization here
+ */
+template<typename T>
+struct VertexFormat;
+
+template<>
+struct VertexFormat<float> {
+    static constexpr VkFormat format = VK_FORMAT_R32_SFLOAT;
+};
+
+template<>
+struct VertexFormat<glm::vec2> {
+    static constexpr VkFormat format = VK_FORMAT_R32G32_SFLOAT;
+};
+
+template<>
+struct VertexFormat<glm::vec3> {
+    static constexpr VkFormat format = VK_FORMAT_R32G32B32_SFLOAT;
+};
+
+template<>
+struct VertexFormat<glm::vec4> {
+    static constexpr VkFormat format = VK_FORMAT_R32G32B32A32_SFLOAT;
+};
+
+template<>
+struct VertexFormat<UNorm16x2> {
+    static constexpr VkFormat format = VK_FORMAT_R16G16_UNORM;
+};
+
+/*
+ * Vertex input state of one binding, the stride comes from Vertex and the format of each attribute from the type of
+ * its member. The create info points into this object, it must outlive the pipeline creation.
+ */
+template<typename Vertex>
+class VertexLayout {
+public:
+    explicit VertexLayout(uint32_t binding = 0, VkVertexInputRate inputRate = VK_VERTEX_INPUT_RATE_VERTEX) {
+        bindingDescription.binding = binding;
+        bindingDescription.inputRate = inputRate;
+        bindingDescription.stride = sizeof(Vertex);
+    }
+
+    template<typename Member>
+    VertexLayout &attribute(uint32_t location, Member Vertex::*member) {
+        //Offset of the member without offsetof, which cannot take a member pointer
+        Vertex probe{};
+        VkVertexInputAttributeDescription attributeDescription{};
+        attributeDescription.binding = bindingDescription.binding;
+        attributeDescription.location = location;
+        attributeDescription.format = VertexFormat<Member>::format;
+        attributeDescription.offset = (uint32_t) (reinterpret_cast<const char *>(&(probe.*member)) -
+                                                  reinterpret_cast<const char *>(&probe));
+        attributeDescriptions.push_back(attributeDescription);
+        return *this;
+    }
+
+    const VkPipelineVertexInputStateCreateInfo *createInfo() {
+        vertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        vertexInputStateCreateInfo.vertexBindingDescriptionCount = 1;
+        vertexInputStateCreateInfo.pVertexBindingDescriptions = &bindingDescription;
+        vertexInputStateCreateInfo.vertexAttributeDescriptionCount = attributeDescriptions.size();
+        vertexInputStateCreateInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+        return &vertexInputStateCreateInfo;
+    }
+
+private:
+    VkVertexInputBindingDescription bindingDescription{};
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+    VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo{};
+};
+
+
+#endif //VULKANBASE_VERTEXLAYOUT_H
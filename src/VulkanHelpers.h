@@ -13,72 +13,28 @@
 #include <fstream>
 #include <iostream>
 #include <cstring>
+#include <algorithm>
 #include "VulkanStructures.h"
 #include "CommandBufferUtils.h"
+#include "DeviceContext.h"
+#include "DeviceMemoryTracker.h"
+#include "StagingManager.h"
 
-VkMemoryRequirements vulkanGetBufferMemoryRequirements(VulkanHandles vulkanHandles, VkBuffer vkBuffer) {
+VkMemoryRequirements vulkanGetBufferMemoryRequirements(const VulkanHandles &vulkanHandles, VkBuffer vkBuffer) {
     VkMemoryRequirements vkMemoryRequirements{};
     vkGetBufferMemoryRequirements(vulkanHandles.device, vkBuffer, &vkMemoryRequirements);
     return vkMemoryRequirements;
 }
 
-VkMemoryRequirements vulkanGetImageMemoryRequirements(VulkanHandles vulkanHandles, VkImage vkImage) {
+VkMemoryRequirements vulkanGetImageMemoryRequirements(const VulkanHandles &vulkanHandles, VkImage vkImage) {
     VkMemoryRequirements vkMemoryRequirements{};
     vkGetImageMemoryRequirements(vulkanHandles.device, vkImage, &vkMemoryRequirements);
     return vkMemoryRequirements;
 }
 
-int vulkanGetMemoryTypeIndex(PhysicalDeviceInfo physicalDeviceInfo, uint32_t memoryTypeBits,
-                             VkMemoryPropertyFlagBits flagBits) {
-    for (int i = 0; i < physicalDeviceInfo.memoryProperties.memoryTypeCount; ++i) {
-        VkMemoryType memoryType = physicalDeviceInfo.memoryProperties.memoryTypes[i];
-        if ((memoryTypeBits & (1 << i)) && (memoryType.propertyFlags & flagBits) == flagBits) {
-            return i;
-        }
-    }
-    return -1;
-}
-
-
-VkSemaphore vulkanCreateSemaphore(VulkanHandles vulkanHandles) {
-    VkSemaphoreCreateInfo vkSemaphoreCreateInfo{};
-    vkSemaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-    VkSemaphore vkSemaphore;
-    VK_ASSERT(vkCreateSemaphore(vulkanHandles.device, &vkSemaphoreCreateInfo, nullptr, &vkSemaphore));
-    return vkSemaphore;
-}
-
-
-std::vector<char> vulkanLoadShader(const std::string filename) {
-    std::ifstream file(filename, std::ios::binary | std::ios::in | std::ios::ate);
-    if (!file.is_open()) {
-        std::cerr << "CANNOT OPEN SHADER FILE" << std::endl;
-        exit(-1);
-    }
-    size_t fileSize = (size_t) file.tellg();
-    std::vector<char> buffer(fileSize);
-
-    file.seekg(0);
-    file.read(buffer.data(), fileSize);
-    file.close();
-    return buffer;
-}
-
-VkShaderModule vulkanCreateShaderModule(const VulkanHandles vulkanHandles, const std::vector<char> shaderBytes) {
-    VkShaderModuleCreateInfo vkShaderModuleCreateInfo{};
-    vkShaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    vkShaderModuleCreateInfo.pNext = nullptr;
-    vkShaderModuleCreateInfo.codeSize = shaderBytes.size();
-    vkShaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t *>(shaderBytes.data());
 
-    VkShaderModule shaderModule;
-    VK_ASSERT(vkCreateShaderModule(vulkanHandles.device, &vkShaderModuleCreateInfo, nullptr, &shaderModule));
-    return shaderModule;
-}
-
-
-VkFramebuffer vulkanCreateFrameBuffer(const VulkanHandles vulkanHandles, uint32_t width, uint32_t height,VkRenderPass renderPass,
-                                      std::vector<VkImageView> attachments) {
+VkFramebuffer vulkanCreateFrameBuffer(const VulkanHandles &vulkanHandles, uint32_t width, uint32_t height,VkRenderPass renderPass,
+                                      const std::vector<VkImageView> &attachments) {
     VkFramebufferCreateInfo vkFramebufferCreateInfo{};
     vkFramebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
     vkFramebufferCreateInfo.attachmentCount = attachments.size();
@@ -92,7 +48,7 @@ VkFramebuffer vulkanCreateFrameBuffer(const VulkanHandles vulkanHandles, uint32_
     return vkFramebuffer;
 }
 
-VkFence vulkanCreateFence(VulkanHandles vulkanHandles, VkFenceCreateFlags flags) {
+VkFence vulkanCreateFence(const VulkanHandles &vulkanHandles, VkFenceCreateFlags flags) {
     VkFence vkFence{};
     VkFenceCreateInfo fenceCreateInfo = {};
     fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
@@ -102,18 +58,17 @@ VkFence vulkanCreateFence(VulkanHandles vulkanHandles, VkFenceCreateFlags flags)
     return vkFence;
 }
 
-RenderFrame createRenderFrame(VulkanHandles vulkanHandles, VkCommandPool vkCommandPool) {
+RenderFrame createRenderFrame(const DeviceContext &deviceContext, VkCommandPool vkCommandPool) {
     RenderFrame renderFrame{};
-    renderFrame.commandBuffer = CommandBufferUtils::vulkanCreateCommandBuffers(vulkanHandles, vkCommandPool, 1)[0];
-    renderFrame.imageReadySemaphore = vulkanCreateSemaphore(vulkanHandles);
-    renderFrame.presentationReadySemaphore = vulkanCreateSemaphore(vulkanHandles);
-    renderFrame.bufferFinishedFence = vulkanCreateFence(vulkanHandles, VK_FENCE_CREATE_SIGNALED_BIT);
-    renderFrame.frameBuffer = VK_NULL_HANDLE;
+    renderFrame.commandBuffer = CommandBufferUtils::vulkanCreateCommandBuffers(deviceContext.handles, vkCommandPool, 1)[0];
+    renderFrame.imageReadySemaphore = deviceContext.vulkanCreateSemaphore();
+    renderFrame.presentationReadySemaphore = deviceContext.vulkanCreateSemaphore();
+    renderFrame.bufferFinishedFence = deviceContext.vulkanCreateFence(VK_FENCE_CREATE_SIGNALED_BIT);
     return renderFrame;
 }
 
 
-VkBuffer vulkanAllocateExclusiveBuffer(VulkanHandles vulkanHandles, uint32_t size, VkBufferUsageFlags usageFlags) {
+VkBuffer vulkanAllocateExclusiveBuffer(const VulkanHandles &vulkanHandles, uint32_t size, VkBufferUsageFlags usageFlags) {
     VkBuffer buffer;
     VkBufferCreateInfo vkVertexBufferCreateInfo{};
     vkVertexBufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -124,25 +79,7 @@ VkBuffer vulkanAllocateExclusiveBuffer(VulkanHandles vulkanHandles, uint32_t siz
     return buffer;
 }
 
-VkDeviceMemory
-vulkanAllocateDeviceMemory(VulkanHandles vulkanHandles, PhysicalDeviceInfo physicalDeviceInfo,
-                           VkMemoryRequirements vkMemoryRequirements,
-                           VkMemoryPropertyFlagBits memoryPropertyFlags) {
-
-    VkMemoryAllocateInfo vkMemoryAllocateInfo{};
-    vkMemoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    vkMemoryAllocateInfo.memoryTypeIndex = vulkanGetMemoryTypeIndex(physicalDeviceInfo,
-                                                                    vkMemoryRequirements.memoryTypeBits,
-                                                                    memoryPropertyFlags);
-    VkDeviceMemory vkDeviceMemory{};
-    vkMemoryAllocateInfo.allocationSize = vkMemoryRequirements.size;
-    VK_ASSERT(vkAllocateMemory(vulkanHandles.device, &vkMemoryAllocateInfo, nullptr,
-                               &vkDeviceMemory));
-    return vkDeviceMemory;
-
-}
-
-void vulkanMapMemoryWithFlush(VulkanHandles vulkanHandles, Buffer buffer, void *data) {
+void vulkanMapMemoryWithFlush(const VulkanHandles &vulkanHandles, Buffer buffer, void *data) {
     void *memoryPointer;
     VK_ASSERT(vkMapMemory(vulkanHandles.device, buffer.deviceMemory, 0, buffer.size, 0,
                           &memoryPointer));
@@ -161,52 +98,83 @@ void vulkanMapMemoryWithFlush(VulkanHandles vulkanHandles, Buffer buffer, void *
 
 }
 
-Buffer allocateExclusiveBuffer(VulkanHandles vulkanHandles, PhysicalDeviceInfo physicalDeviceInfo, uint32_t size,
-                               VkBufferUsageFlags usageFlags, VkMemoryPropertyFlagBits memoryPropertyFlags) {
+void vulkanReadMemoryWithInvalidate(const VulkanHandles &vulkanHandles, Buffer buffer, void *data) {
+    void *memoryPointer;
+    VK_ASSERT(vkMapMemory(vulkanHandles.device, buffer.deviceMemory, 0, buffer.size, 0,
+                          &memoryPointer));
+
+    VkMappedMemoryRange vkMappedMemoryRange{};
+    vkMappedMemoryRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    vkMappedMemoryRange.memory = buffer.deviceMemory;
+    vkMappedMemoryRange.size = VK_WHOLE_SIZE;
+    vkMappedMemoryRange.offset = 0;
+
+    vkInvalidateMappedMemoryRanges(vulkanHandles.device, 1, &vkMappedMemoryRange);
+    memcpy(data, memoryPointer, buffer.size);
+    memoryPointer = nullptr;
+    vkUnmapMemory(vulkanHandles.device, buffer.deviceMemory);
+}
+
+Buffer allocateExclusiveBuffer(const VulkanHandles &vulkanHandles, DeviceMemoryTracker &memoryTracker, uint32_t size,
+                               VkBufferUsageFlags usageFlags, VkMemoryPropertyFlagBits memoryPropertyFlags, MemoryTag tag) {
     Buffer buffer{};
     buffer.size = size;
     buffer.buffer = vulkanAllocateExclusiveBuffer(vulkanHandles, size, usageFlags);
     buffer.memoryRequirements = vulkanGetBufferMemoryRequirements(vulkanHandles, buffer.buffer);
-    buffer.deviceMemory = vulkanAllocateDeviceMemory(vulkanHandles, physicalDeviceInfo, buffer.memoryRequirements,
-                                                     memoryPropertyFlags);
+    buffer.deviceMemory = memoryTracker.vulkanAllocate(buffer.memoryRequirements, memoryPropertyFlags, tag);
 
     VK_ASSERT(vkBindBufferMemory(vulkanHandles.device, buffer.buffer, buffer.deviceMemory, 0));
 
     return buffer;
 }
 
-void copyBufferHostDevice(VulkanHandles vulkanHandles, PhysicalDeviceInfo physicalDeviceInfo,
-                          CommandBufferStructure transferStructure, Buffer source, Buffer destination,
-                          VkAccessFlags dstAccess, VkPipelineStageFlags dstStageMask, uint32_t dstQueueFamilyIndex) {
+/*
+ * Staging range copied to the start of a device buffer, and the access that reads the buffer afterwards
+ */
+struct BufferUpload {
+    StagingAllocation source;
+    Buffer destination;
+    VkAccessFlags dstAccess;
+};
+
+/*
+ * Every upload is copied and released to the destination queue family in one submit of the transfer command buffer
+ */
+void copyBufferHostDevice(const VulkanHandles &vulkanHandles, const PhysicalDeviceInfo &physicalDeviceInfo,
+                          const CommandBufferStructure &transferStructure, Span<BufferUpload> uploads,
+                          VkPipelineStageFlags dstStageMask, uint32_t dstQueueFamilyIndex) {
     CommandBufferUtils::vulkanBeginCommandBuffer(vulkanHandles, transferStructure.commandBuffer,
                                                  VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
                                                  {transferStructure.bufferAvaibleFence});
     {
-        VkBufferCopy vkBufferCopy{};
-        vkBufferCopy.size = destination.size;
-        vkBufferCopy.srcOffset = 0;
-        vkBufferCopy.dstOffset = 0;
-        vkCmdCopyBuffer(transferStructure.commandBuffer, source.buffer, destination.buffer, 1, &vkBufferCopy);
-        VkBufferMemoryBarrier vkBufferMemoryBarrier{};
-        vkBufferMemoryBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
-        vkBufferMemoryBarrier.buffer = destination.buffer;
-        vkBufferMemoryBarrier.size = VK_WHOLE_SIZE;
-        vkBufferMemoryBarrier.offset = 0;
-        vkBufferMemoryBarrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
-        vkBufferMemoryBarrier.dstAccessMask = dstAccess;
-        vkBufferMemoryBarrier.srcQueueFamilyIndex = transferStructure.queueFamilyIndex;
-        vkBufferMemoryBarrier.dstQueueFamilyIndex = dstQueueFamilyIndex;
+        std::vector<VkBufferMemoryBarrier> vkBufferMemoryBarriers(uploads.size());
+        for (uint32_t i = 0; i < uploads.size(); ++i) {
+            const BufferUpload &upload = uploads.data()[i];
+            VkBufferCopy vkBufferCopy{};
+            vkBufferCopy.size = upload.destination.size;
+            vkBufferCopy.srcOffset = upload.source.offset;
+            vkBufferCopy.dstOffset = 0;
+            vkCmdCopyBuffer(transferStructure.commandBuffer, upload.source.buffer, upload.destination.buffer, 1, &vkBufferCopy);
+            vkBufferMemoryBarriers[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            vkBufferMemoryBarriers[i].buffer = upload.destination.buffer;
+            vkBufferMemoryBarriers[i].size = VK_WHOLE_SIZE;
+            vkBufferMemoryBarriers[i].offset = 0;
+            vkBufferMemoryBarriers[i].srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+            vkBufferMemoryBarriers[i].dstAccessMask = upload.dstAccess;
+            vkBufferMemoryBarriers[i].srcQueueFamilyIndex = transferStructure.queueFamilyIndex;
+            vkBufferMemoryBarriers[i].dstQueueFamilyIndex = dstQueueFamilyIndex;
+        }
         vkCmdPipelineBarrier(transferStructure.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
                              dstStageMask, 0,
-                             0, nullptr, 1, &vkBufferMemoryBarrier, 0, nullptr);
+                             0, nullptr, vkBufferMemoryBarriers.size(), vkBufferMemoryBarriers.data(), 0, nullptr);
     }
     CommandBufferUtils::vulkanSubmitCommandBuffer(transferStructure.queue, transferStructure.commandBuffer,
-                                                  std::vector<VkSemaphore>(), std::vector<VkSemaphore>(), nullptr,
+                                                  Span<VkSemaphore>(), Span<VkSemaphore>(), nullptr,
                                                   transferStructure.bufferAvaibleFence);
 }
 
 std::vector<VkImage>
-vulkanGetSwapchainImages(const VulkanHandles vulkanHandles, PresentationEngineInfo &presentationEngineInfo) {
+vulkanGetSwapchainImages(const VulkanHandles &vulkanHandles, PresentationEngineInfo &presentationEngineInfo) {
     unsigned int imageCount = 0;
     vkGetSwapchainImagesKHR(vulkanHandles.device, vulkanHandles.swapchain, &imageCount, nullptr);
     std::vector<VkImage> images(imageCount);
@@ -215,8 +183,8 @@ vulkanGetSwapchainImages(const VulkanHandles vulkanHandles, PresentationEngineIn
     return images;
 }
 
-std::vector<VkImageView> vulkanCreateSwapchainImageViews(const VulkanHandles vulkanHandles,
-                                                         const PresentationEngineInfo presentationEngineInfo,
+std::vector<VkImageView> vulkanCreateSwapchainImageViews(const VulkanHandles &vulkanHandles,
+                                                         const PresentationEngineInfo &presentationEngineInfo,
                                                          const std::vector<VkImage> images) {
 
     std::vector<VkImageView> imageViews(presentationEngineInfo.imageCount);
@@ -242,7 +210,8 @@ std::vector<VkImageView> vulkanCreateSwapchainImageViews(const VulkanHandles vul
 }
 
 
-VkImage vulkanCreateImage2D(VulkanHandles vulkanHandles, VkExtent2D extent, VkFormat format, VkImageUsageFlags usage) {
+VkImage vulkanCreateImage2D(const VulkanHandles &vulkanHandles, VkExtent2D extent, VkFormat format, VkImageUsageFlags usage,
+                            uint32_t mipLevels = 1) {
     VkImageCreateInfo imageCreateInfo{};
     imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -254,21 +223,22 @@ VkImage vulkanCreateImage2D(VulkanHandles vulkanHandles, VkExtent2D extent, VkFo
     imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
     imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-    imageCreateInfo.mipLevels = 1;
+    imageCreateInfo.mipLevels = mipLevels;
     VkImage image;
     VK_ASSERT(vkCreateImage(vulkanHandles.device, &imageCreateInfo, nullptr, &image));
     return image;
 }
 
 VkImageView
-vulkanCreateImageView2D(VulkanHandles vulkanHandles, VkImage image, VkFormat format, VkImageAspectFlags aspectMask) {
+vulkanCreateImageView2D(const VulkanHandles &vulkanHandles, VkImage image, VkFormat format, VkImageAspectFlags aspectMask,
+                        uint32_t mipLevels = 1, uint32_t baseMipLevel = 0) {
 
     VkImageViewCreateInfo vkImageViewCreateInfo{};
     vkImageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     vkImageViewCreateInfo.image = image;
     vkImageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
     vkImageViewCreateInfo.format = format;
-    vkImageViewCreateInfo.subresourceRange = {aspectMask, 0, 1, 0, 1};
+    vkImageViewCreateInfo.subresourceRange = {aspectMask, baseMipLevel, mipLevels, 0, 1};
     vkImageViewCreateInfo.components = {VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY,
                                         VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY};
 
@@ -279,7 +249,8 @@ vulkanCreateImageView2D(VulkanHandles vulkanHandles, VkImage image, VkFormat for
 
 }
 
-VkSampler vulkanCreateSampler2D(VulkanHandles vulkanHandles, VkSamplerAddressMode addressMode, VkBool32 unnormalizedCoordinates) {
+VkSampler vulkanCreateSampler2D(const VulkanHandles &vulkanHandles, VkSamplerAddressMode addressMode, VkBool32 unnormalizedCoordinates,
+                                VkFilter filter = VK_FILTER_LINEAR) {
     VkSamplerCreateInfo textureSamplerInfo{};
     textureSamplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
     textureSamplerInfo.addressModeU = addressMode;
@@ -289,8 +260,8 @@ VkSampler vulkanCreateSampler2D(VulkanHandles vulkanHandles, VkSamplerAddressMod
     textureSamplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
     textureSamplerInfo.anisotropyEnable = VK_FALSE;
     textureSamplerInfo.compareEnable = VK_FALSE;
-    textureSamplerInfo.minFilter = VK_FILTER_LINEAR;
-    textureSamplerInfo.magFilter = VK_FILTER_LINEAR;
+    textureSamplerInfo.minFilter = filter;
+    textureSamplerInfo.magFilter = filter;
     textureSamplerInfo.unnormalizedCoordinates = unnormalizedCoordinates;
 
     VkSampler sampler;
@@ -300,23 +271,23 @@ VkSampler vulkanCreateSampler2D(VulkanHandles vulkanHandles, VkSamplerAddressMod
 }
 
 Texture2D
-createTexture2D(VulkanHandles vulkanHandles, PhysicalDeviceInfo physicalDeviceInfo, void *data, VkExtent2D extents,
+createTexture2D(const VulkanHandles &vulkanHandles, DeviceMemoryTracker &memoryTracker, void *data, VkExtent2D extents,
                 VkFormat format, VkImageUsageFlags usage,
                 VkImageAspectFlags aspectMask, VkSamplerAddressMode addressMode,
-                VkMemoryPropertyFlagBits memoryPropertyFlags, VkBool32 unnormalizedCoordinates) {
+                VkMemoryPropertyFlagBits memoryPropertyFlags, MemoryTag tag, VkBool32 unnormalizedCoordinates,
+                uint32_t mipLevels = 1) {
     Texture2D texture2D{};
     texture2D.data = data;
     texture2D.width = extents.width;
     texture2D.height = extents.height;
-    texture2D.image = vulkanCreateImage2D(vulkanHandles, extents, format, usage);
+    texture2D.mipLevels = mipLevels;
+    texture2D.image = vulkanCreateImage2D(vulkanHandles, extents, format, usage, mipLevels);
     texture2D.memoryRequirements = vulkanGetImageMemoryRequirements(vulkanHandles, texture2D.image);
-    texture2D.deviceMemory = vulkanAllocateDeviceMemory(vulkanHandles, physicalDeviceInfo,
-                                                        texture2D.memoryRequirements,
-                                                        memoryPropertyFlags);
+    texture2D.deviceMemory = memoryTracker.vulkanAllocate(texture2D.memoryRequirements, memoryPropertyFlags, tag);
 
     VK_ASSERT(vkBindImageMemory(vulkanHandles.device, texture2D.image, texture2D.deviceMemory, 0));
 
-    texture2D.imageView = vulkanCreateImageView2D(vulkanHandles, texture2D.image, format, aspectMask);
+    texture2D.imageView = vulkanCreateImageView2D(vulkanHandles, texture2D.image, format, aspectMask, mipLevels);
     texture2D.sampler = vulkanCreateSampler2D(vulkanHandles, addressMode,unnormalizedCoordinates);
     return texture2D;
 }
@@ -329,7 +300,7 @@ VkDescriptorPoolSize vulkanAllocateDescriptorPoolSize(VkDescriptorType descripto
 }
 
 VkDescriptorPool
-vulkanAllocateDescriptorPool(VulkanHandles vulkanHandles, std::vector<VkDescriptorPoolSize> descriptorPoolSizes,
+vulkanAllocateDescriptorPool(const VulkanHandles &vulkanHandles, const std::vector<VkDescriptorPoolSize> &descriptorPoolSizes,
                              uint32_t maxSets) {
     VkDescriptorPoolCreateInfo vkDescriptorPoolCreateInfo{};
     vkDescriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -352,7 +323,7 @@ VkDescriptorSetLayoutBinding vulkanCreateDescriptorSetLayoutBinding(uint32_t bin
     return descriptorBinding;
 }
 
-VkDescriptorSetLayout vulkanCreateDescriptorSetLayout(VulkanHandles vulkanHandles, std::vector<VkDescriptorSetLayoutBinding> bindings) {
+VkDescriptorSetLayout vulkanCreateDescriptorSetLayout(const VulkanHandles &vulkanHandles, const std::vector<VkDescriptorSetLayoutBinding> &bindings) {
     VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{};
     descriptorSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
     descriptorSetLayoutInfo.bindingCount = bindings.size();
@@ -364,8 +335,12 @@ VkDescriptorSetLayout vulkanCreateDescriptorSetLayout(VulkanHandles vulkanHandle
     return vkDescriptorSetLayout;
 }
 
-void copyBufferTextureHostDevice(VulkanHandles vulkanHandles, CommandBufferStructure transferStructure, Buffer sourceBuffer, Texture2D texture, VkPipelineStageFlags srcStage,
-                                 VkPipelineStageFlags dstStage, uint32_t dstQueueFamilyIndex) {
+/*
+ * Copy every mip level of the texture, mipOffsets holds the byte offset of each level inside the staging allocation
+ */
+void copyBufferTextureHostDevice(const VulkanHandles &vulkanHandles, const CommandBufferStructure &transferStructure, const StagingAllocation &source, Texture2D texture, VkPipelineStageFlags srcStage,
+                                 VkPipelineStageFlags dstStage, uint32_t dstQueueFamilyIndex,
+                                 std::vector<uint32_t> mipOffsets = {0}) {
     VkImageMemoryBarrier vkImageMemoryBarrier{};
     vkImageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
     CommandBufferUtils::vulkanBeginCommandBuffer(vulkanHandles, transferStructure.commandBuffer,
@@ -373,7 +348,7 @@ void copyBufferTextureHostDevice(VulkanHandles vulkanHandles, CommandBufferStruc
                                                  {transferStructure.bufferAvaibleFence});
     {
         vkImageMemoryBarrier.image = texture.image;
-        vkImageMemoryBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        vkImageMemoryBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, texture.mipLevels, 0, 1};
         vkImageMemoryBarrier.srcAccessMask = 0;
         vkImageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
         vkImageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -385,26 +360,72 @@ void copyBufferTextureHostDevice(VulkanHandles vulkanHandles, CommandBufferStruc
                              dstStage, 0, 0,
                              nullptr, 0, nullptr,
                              1, &vkImageMemoryBarrier);
-        VkImageSubresourceLayers vkImageSubresourceLayers = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
-        VkBufferImageCopy vkBufferImageCopy{};
-        vkBufferImageCopy.imageExtent = {texture.width, texture.height, 1};
-        vkBufferImageCopy.bufferImageHeight = 0;
-        vkBufferImageCopy.bufferRowLength = 0;
-        vkBufferImageCopy.bufferOffset = 0;
-        vkBufferImageCopy.imageOffset = {0, 0, 0};
-        vkBufferImageCopy.imageSubresource = vkImageSubresourceLayers;
+        std::vector<VkBufferImageCopy> vkBufferImageCopies(mipOffsets.size());
+        for (uint32_t i = 0; i < mipOffsets.size(); ++i) {
+            VkImageSubresourceLayers vkImageSubresourceLayers = {VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1};
+            vkBufferImageCopies[i] = {};
+            vkBufferImageCopies[i].imageExtent = {std::max(texture.width >> i, 1u), std::max(texture.height >> i, 1u), 1};
+            vkBufferImageCopies[i].bufferImageHeight = 0;
+            vkBufferImageCopies[i].bufferRowLength = 0;
+            vkBufferImageCopies[i].bufferOffset = source.offset + mipOffsets[i];
+            vkBufferImageCopies[i].imageOffset = {0, 0, 0};
+            vkBufferImageCopies[i].imageSubresource = vkImageSubresourceLayers;
+        }
 
-        vkCmdCopyBufferToImage(transferStructure.commandBuffer, sourceBuffer.buffer, texture.image,
+        vkCmdCopyBufferToImage(transferStructure.commandBuffer, source.buffer, texture.image,
                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                               1, &vkBufferImageCopy);
+                               vkBufferImageCopies.size(), vkBufferImageCopies.data());
     }
     CommandBufferUtils::vulkanSubmitCommandBuffer(transferStructure.queue, transferStructure.commandBuffer,
-                                                  std::vector<VkSemaphore>(), std::vector<VkSemaphore>(), nullptr,
+                                                  Span<VkSemaphore>(), Span<VkSemaphore>(), nullptr,
                                                   transferStructure.bufferAvaibleFence);
 
 }
 
-void transitionImageInPipeline(VulkanHandles vulkanHandles, CommandBufferStructure graphicsStructure, Texture2D texture, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, VkImageLayout oldLayout,
+/*
+ * Copy rowCount tightly packed rows of the staging allocation to mip 0 of the texture from firstRow on.
+ * The texture is moved from oldLayout to TRANSFER_DST_OPTIMAL first unless it is already there, so only the first of
+ * a series of copies into disjoint rows needs a barrier.
+ */
+void copyBufferRowsToTexture(const VulkanHandles &vulkanHandles, const CommandBufferStructure &transferStructure,
+                             const StagingAllocation &source, Texture2D texture, uint32_t firstRow, uint32_t rowCount,
+                             VkImageLayout oldLayout) {
+    CommandBufferUtils::vulkanBeginCommandBuffer(vulkanHandles, transferStructure.commandBuffer,
+                                                 VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+                                                 {transferStructure.bufferAvaibleFence});
+    {
+        if (oldLayout != VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+            VkImageMemoryBarrier vkImageMemoryBarrier{};
+            vkImageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            vkImageMemoryBarrier.image = texture.image;
+            vkImageMemoryBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, texture.mipLevels, 0, 1};
+            vkImageMemoryBarrier.srcAccessMask = 0;
+            vkImageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            vkImageMemoryBarrier.oldLayout = oldLayout;
+            vkImageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            vkImageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            vkImageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            vkCmdPipelineBarrier(transferStructure.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                                 nullptr, 0, nullptr,
+                                 1, &vkImageMemoryBarrier);
+        }
+        VkBufferImageCopy vkBufferImageCopy{};
+        vkBufferImageCopy.bufferOffset = source.offset;
+        vkBufferImageCopy.bufferRowLength = 0;
+        vkBufferImageCopy.bufferImageHeight = 0;
+        vkBufferImageCopy.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        vkBufferImageCopy.imageOffset = {0, (int32_t) firstRow, 0};
+        vkBufferImageCopy.imageExtent = {texture.width, rowCount, 1};
+        vkCmdCopyBufferToImage(transferStructure.commandBuffer, source.buffer, texture.image,
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &vkBufferImageCopy);
+    }
+    CommandBufferUtils::vulkanSubmitCommandBuffer(transferStructure.queue, transferStructure.commandBuffer,
+                                                  Span<VkSemaphore>(), Span<VkSemaphore>(), nullptr,
+                                                  transferStructure.bufferAvaibleFence);
+}
+
+void transitionImageInPipeline(const VulkanHandles &vulkanHandles, const CommandBufferStructure &graphicsStructure, Texture2D texture, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, VkImageLayout oldLayout,
                                VkImageLayout newLayout, VkPipelineStageFlags srcStage,
                                VkPipelineStageFlags dstStage) {
     VkImageMemoryBarrier vkImageMemoryBarrier{};
@@ -414,7 +435,7 @@ void transitionImageInPipeline(VulkanHandles vulkanHandles, CommandBufferStructu
                                                  {graphicsStructure.bufferAvaibleFence});
     {
         vkImageMemoryBarrier.image = texture.image;
-        vkImageMemoryBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        vkImageMemoryBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, texture.mipLevels, 0, 1};
         vkImageMemoryBarrier.srcAccessMask = srcAccessMask;
         vkImageMemoryBarrier.dstAccessMask = dstAccessMask;
         vkImageMemoryBarrier.oldLayout = oldLayout;
@@ -429,11 +450,11 @@ void transitionImageInPipeline(VulkanHandles vulkanHandles, CommandBufferStructu
     }
 
     CommandBufferUtils::vulkanSubmitCommandBuffer(graphicsStructure.queue, graphicsStructure.commandBuffer,
-                                                  std::vector<VkSemaphore>(), std::vector<VkSemaphore>(), nullptr,
+                                                  Span<VkSemaphore>(), Span<VkSemaphore>(), nullptr,
                                                   graphicsStructure.bufferAvaibleFence);
 }
 
-VkDescriptorSet vulkanAllocateDescriptorSet(VulkanHandles vulkanHandles, VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout) {
+VkDescriptorSet vulkanAllocateDescriptorSet(const VulkanHandles &vulkanHandles, VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout) {
     VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{};
     descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
     descriptorSetAllocateInfo.descriptorPool = descriptorPool;
@@ -444,7 +465,7 @@ VkDescriptorSet vulkanAllocateDescriptorSet(VulkanHandles vulkanHandles, VkDescr
     return descriptorSet;
 }
 
-VkWriteDescriptorSet vulkanGetWriteDescriptorSet(VulkanHandles vulkanHandles, int descriptorCount,
+VkWriteDescriptorSet vulkanGetWriteDescriptorSet(const VulkanHandles &vulkanHandles, int descriptorCount,
                                                  VkDescriptorType descriptorType, VkDescriptorSet descriptorSet, uint32_t dstBinding,
                                                  VkDescriptorBufferInfo *bufferInfo, VkDescriptorImageInfo *imageInfo) {
     VkWriteDescriptorSet writeDesciptorSet{};
@@ -11,6 +11,7 @@
 #include <stdexcept>
 #include <set>
 #include <iostream>
+#include <algorithm>
 #include "VulkanSetup.h"
 #include "VulkanStructures.h"
 #include "VulkanDebug.h"
@@ -146,6 +147,27 @@ void VulkanSetup::vulkanGetPhysicalDevicesInfo(VkPhysicalDevice vkPhysicalDevice
     VkPhysicalDeviceMemoryProperties vkPhysicalDeviceMemoryProperties;
     vkGetPhysicalDeviceMemoryProperties(vkPhysicalDevice, &vkPhysicalDeviceMemoryProperties);
 
+    VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures{};
+    descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+    VkPhysicalDeviceFeatures2 vkPhysicalDeviceFeatures2{};
+    vkPhysicalDeviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    vkPhysicalDeviceFeatures2.pNext = &descriptorIndexingFeatures;
+    //The 1.2 feature struct is only known by 1.2 devices, drawIndirectCount has no struct of its own
+    bool vulkan12Device = vkPhysicalDeviceProperties.apiVersion >= VK_API_VERSION_1_2;
+    VkPhysicalDeviceVulkan12Features vulkan12Features{};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    if (vulkan12Device) {
+        descriptorIndexingFeatures.pNext = &vulkan12Features;
+    }
+    vkGetPhysicalDeviceFeatures2(vkPhysicalDevice, &vkPhysicalDeviceFeatures2);
+
+    VkPhysicalDeviceDescriptorIndexingProperties descriptorIndexingProperties{};
+    descriptorIndexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+    VkPhysicalDeviceProperties2 vkPhysicalDeviceProperties2{};
+    vkPhysicalDeviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    vkPhysicalDeviceProperties2.pNext = &descriptorIndexingProperties;
+    vkGetPhysicalDeviceProperties2(vkPhysicalDevice, &vkPhysicalDeviceProperties2);
+
     physicalDeviceInfo->memoryProperties = vkPhysicalDeviceMemoryProperties;
     physicalDeviceInfo->physicalDeviceFeatures = vkPhysicalDeviceFeatures;
     physicalDeviceInfo->physicalDeviceProperties = vkPhysicalDeviceProperties;
@@ -153,11 +175,28 @@ void VulkanSetup::vulkanGetPhysicalDevicesInfo(VkPhysicalDevice vkPhysicalDevice
     physicalDeviceInfo->surfaceFormats = vkSurfaceFormat;
     physicalDeviceInfo->queueFamilyProperties = vkQueueFamilyProperties;
     physicalDeviceInfo->surfacePresentMode = vkSurfacePresentMode;
+    descriptorIndexingFeatures.pNext = nullptr;
+    descriptorIndexingProperties.pNext = nullptr;
+    physicalDeviceInfo->descriptorIndexingFeatures = descriptorIndexingFeatures;
+    physicalDeviceInfo->descriptorIndexingProperties = descriptorIndexingProperties;
+    //The table is an array of combined image samplers indexed in the shader, each one counts as a sampler and as a
+    //sampled image against both the per stage and the per set limits
+    physicalDeviceInfo->bindlessSupported =
+            vkPhysicalDeviceFeatures.shaderSampledImageArrayDynamicIndexing == VK_TRUE &&
+            descriptorIndexingFeatures.descriptorBindingPartiallyBound == VK_TRUE &&
+            descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind == VK_TRUE &&
+            descriptorIndexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers >= BINDLESS_MAX_TEXTURES &&
+            descriptorIndexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages >= BINDLESS_MAX_TEXTURES &&
+            descriptorIndexingProperties.maxPerStageUpdateAfterBindResources >= BINDLESS_MAX_TEXTURES &&
+            descriptorIndexingProperties.maxDescriptorSetUpdateAfterBindSamplers >= BINDLESS_MAX_TEXTURES &&
+            descriptorIndexingProperties.maxDescriptorSetUpdateAfterBindSampledImages >= BINDLESS_MAX_TEXTURES;
+    physicalDeviceInfo->vulkan12Supported = vulkan12Device;
+    physicalDeviceInfo->drawIndirectCountSupported = vulkan12Device && vulkan12Features.drawIndirectCount == VK_TRUE;
 }
 
 QueueFamilyInfo
 VulkanSetup::vulkanGetQueueFamilyInfo(const VkPhysicalDevice vkPhysicalDevice, const VkSurfaceKHR vkSurfaceKhr,
-                                      const PhysicalDeviceInfo physicalDeviceInfo) {
+                                      const PhysicalDeviceInfo &physicalDeviceInfo) {
     QueueFamilyInfo queueFamilyInfo;
     for (int i = 0; i < physicalDeviceInfo.queueFamilyProperties.size(); ++i) {
         if (physicalDeviceInfo.queueFamilyProperties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
@@ -174,7 +213,7 @@ VulkanSetup::vulkanGetQueueFamilyInfo(const VkPhysicalDevice vkPhysicalDevice, c
     return queueFamilyInfo;
 }
 
-int VulkanSetup::vulkanScorePhysicalDevices(const PhysicalDeviceInfo physicalDeviceInfo) {
+int VulkanSetup::vulkanScorePhysicalDevices(const PhysicalDeviceInfo &physicalDeviceInfo) {
     int score = 0;
 
     if (physicalDeviceInfo.queueFamilyInfo.presentationFamilyIndex == -1) {
@@ -192,7 +231,7 @@ int VulkanSetup::vulkanScorePhysicalDevices(const PhysicalDeviceInfo physicalDev
 }
 
 VkPhysicalDevice
-VulkanSetup::vulkanQueryPhysicalDevice(const VulkanHandles vulkanHandles, PhysicalDeviceInfo &physicalDeviceInfo) {
+VulkanSetup::vulkanQueryPhysicalDevice(const VulkanHandles &vulkanHandles, PhysicalDeviceInfo &physicalDeviceInfo) {
     unsigned int physicalDevicesCount = 0;
     vkEnumeratePhysicalDevices(vulkanHandles.instance, &physicalDevicesCount, nullptr);
     std::vector<VkPhysicalDevice> physicalDevices(physicalDevicesCount);
@@ -207,6 +246,7 @@ VulkanSetup::vulkanQueryPhysicalDevice(const VulkanHandles vulkanHandles, Physic
             break;
         }
         vulkanGetPhysicalDevicesInfo(physicalDevices[i], vulkanHandles.surface, &physicalDeviceInfoList[i]);
+        physicalDeviceInfoList[i].memoryBudgetSupported = vulkanValidateExtensions({VK_EXT_MEMORY_BUDGET_EXTENSION_NAME}, extensions);
         physicalDeviceInfoList[i].queueFamilyInfo = vulkanGetQueueFamilyInfo(physicalDevices[i], vulkanHandles.surface,
                                                                              physicalDeviceInfoList[i]);
         int score = vulkanScorePhysicalDevices(physicalDeviceInfoList[i]);
@@ -223,12 +263,18 @@ VulkanSetup::vulkanQueryPhysicalDevice(const VulkanHandles vulkanHandles, Physic
     physicalDeviceInfo.surfaceFormats = physicalDeviceInfoList[lastScoreIndex].surfaceFormats;
     physicalDeviceInfo.surfaceCapabilities = physicalDeviceInfoList[lastScoreIndex].surfaceCapabilities;
     physicalDeviceInfo.surfacePresentMode = physicalDeviceInfoList[lastScoreIndex].surfacePresentMode;
+    physicalDeviceInfo.descriptorIndexingFeatures = physicalDeviceInfoList[lastScoreIndex].descriptorIndexingFeatures;
+    physicalDeviceInfo.descriptorIndexingProperties = physicalDeviceInfoList[lastScoreIndex].descriptorIndexingProperties;
+    physicalDeviceInfo.bindlessSupported = physicalDeviceInfoList[lastScoreIndex].bindlessSupported;
+    physicalDeviceInfo.vulkan12Supported = physicalDeviceInfoList[lastScoreIndex].vulkan12Supported;
+    physicalDeviceInfo.drawIndirectCountSupported = physicalDeviceInfoList[lastScoreIndex].drawIndirectCountSupported;
+    physicalDeviceInfo.memoryBudgetSupported = physicalDeviceInfoList[lastScoreIndex].memoryBudgetSupported;
 
     return physicalDevices[lastScoreIndex];
 }
 
 VkDevice
-VulkanSetup::vulkanCreateLogicalDevice(const VulkanHandles vulkanHandles, const PhysicalDeviceInfo physicalDeviceInfo) {
+VulkanSetup::vulkanCreateLogicalDevice(const VulkanHandles &vulkanHandles, const PhysicalDeviceInfo &physicalDeviceInfo) {
     float priority = 1.00;
 
     std::set<int> queueFamilyIndex = {physicalDeviceInfo.queueFamilyInfo.graphicsFamilyIndex,
@@ -250,15 +296,45 @@ VulkanSetup::vulkanCreateLogicalDevice(const VulkanHandles vulkanHandles, const
         std::cout << "TESSELATION IS PRESENT" << std::endl;
     }
 
+    //Only the descriptor indexing features needed by the bindless texture table are enabled
+    VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures{};
+    descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+    //A 1.2 device takes every 1.2 feature through this struct, it cannot be chained with the one above
+    VkPhysicalDeviceVulkan12Features vulkan12Features{};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    if (physicalDeviceInfo.bindlessSupported) {
+        std::cout << "BINDLESS TEXTURES ARE PRESENT" << std::endl;
+        descriptorIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+        descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        vulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
+        vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    }
+    if (physicalDeviceInfo.drawIndirectCountSupported) {
+        std::cout << "DRAW INDIRECT COUNT IS PRESENT" << std::endl;
+        vulkan12Features.drawIndirectCount = VK_TRUE;
+    }
+
+    //Optional extensions are only enabled on the devices that have them
+    std::vector<const char *> enabledExtensions = deviceExtensions;
+    if (physicalDeviceInfo.memoryBudgetSupported) {
+        std::cout << "MEMORY BUDGET IS PRESENT" << std::endl;
+        enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+
     VkDeviceCreateInfo vkDeviceCreateInfo{};
     vkDeviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    if (physicalDeviceInfo.vulkan12Supported) {
+        vkDeviceCreateInfo.pNext = &vulkan12Features;
+    } else {
+        vkDeviceCreateInfo.pNext = physicalDeviceInfo.bindlessSupported ? &descriptorIndexingFeatures : nullptr;
+    }
     vkDeviceCreateInfo.pEnabledFeatures = &physicalDeviceInfo.physicalDeviceFeatures;
     vkDeviceCreateInfo.queueCreateInfoCount = queueFamilyIndex.size();
     vkDeviceCreateInfo.pQueueCreateInfos = vkDeviceQueueCreateInfo;
     vkDeviceCreateInfo.enabledLayerCount = 0;
     vkDeviceCreateInfo.ppEnabledLayerNames = nullptr;
-    vkDeviceCreateInfo.enabledExtensionCount = deviceExtensions.size();
-    vkDeviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    vkDeviceCreateInfo.enabledExtensionCount = enabledExtensions.size();
+    vkDeviceCreateInfo.ppEnabledExtensionNames = enabledExtensions.data();
     VkDevice vkDevice;
     VK_ASSERT(vkCreateDevice(vulkanHandles.physicalDevice, &vkDeviceCreateInfo, nullptr, &vkDevice));
     return vkDevice;
@@ -266,27 +342,40 @@ VulkanSetup::vulkanCreateLogicalDevice(const VulkanHandles vulkanHandles, const
 
 
 PresentationEngineInfo
-VulkanSetup::vulkanGetPresentationEngineInfo(VulkanHandles vulkanHandles, const PhysicalDeviceInfo physicalDeviceInfo) {
+VulkanSetup::vulkanGetPresentationEngineInfo(const VulkanHandles &vulkanHandles, const PhysicalDeviceInfo &physicalDeviceInfo) {
     PresentationEngineInfo presentationEngineInfo{};
     presentationEngineInfo.format = vulkanGetSwapchainImageFormat(vulkanHandles, physicalDeviceInfo);
     presentationEngineInfo.presentMode = vulkanGetSwapchainPresentMode(vulkanHandles, physicalDeviceInfo);
     presentationEngineInfo.extents = vulkanGetSwapchainImageExtent(vulkanHandles, physicalDeviceInfo);
+    presentationEngineInfo.imageCount = vulkanGetSwapchainImageCount(physicalDeviceInfo);
     return presentationEngineInfo;
 }
 
 
 VkPresentModeKHR
-VulkanSetup::vulkanGetSwapchainPresentMode(const VulkanHandles vulkanHandles,
-                                           const PhysicalDeviceInfo physicalDeviceInfo) {
+VulkanSetup::vulkanGetSwapchainPresentMode(const VulkanHandles &vulkanHandles,
+                                           const PhysicalDeviceInfo &physicalDeviceInfo) {
     for (auto presentMode: physicalDeviceInfo.surfacePresentMode) {
-        if (presentMode == VK_PRESENT_MODE_FIFO_KHR) return presentMode;
+        if (presentMode == swapchainSettings.preferredPresentMode) return presentMode;
     }
-    return physicalDeviceInfo.surfacePresentMode[0];
+    //FIFO is the only mode every surface is required to support
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+uint32_t VulkanSetup::vulkanGetSwapchainImageCount(const PhysicalDeviceInfo &physicalDeviceInfo) {
+    const VkSurfaceCapabilitiesKHR &capabilities = physicalDeviceInfo.surfaceCapabilities;
+    uint32_t imageCount = swapchainSettings.imageCount == 0 ? capabilities.minImageCount + 1
+                                                            : swapchainSettings.imageCount;
+    if (imageCount < capabilities.minImageCount) imageCount = capabilities.minImageCount;
+    //A maxImageCount of 0 means there is no upper limit
+    if (capabilities.maxImageCount > 0 && imageCount > capabilities.maxImageCount)
+        imageCount = capabilities.maxImageCount;
+    return imageCount;
 }
 
 VkSurfaceFormatKHR
-VulkanSetup::vulkanGetSwapchainImageFormat(const VulkanHandles vulkanHandles,
-                                           const PhysicalDeviceInfo physicalDeviceInfo) {
+VulkanSetup::vulkanGetSwapchainImageFormat(const VulkanHandles &vulkanHandles,
+                                           const PhysicalDeviceInfo &physicalDeviceInfo) {
     for (auto imageFormat: physicalDeviceInfo.surfaceFormats) {
         if (imageFormat.format == VK_FORMAT_B8G8R8A8_SRGB &&
             imageFormat.colorSpace == VK_COLORSPACE_SRGB_NONLINEAR_KHR)
@@ -296,37 +385,61 @@ VulkanSetup::vulkanGetSwapchainImageFormat(const VulkanHandles vulkanHandles,
 }
 
 VkExtent2D
-VulkanSetup::vulkanGetSwapchainImageExtent(const VulkanHandles vulkanHandles,
-                                           const PhysicalDeviceInfo physicalDeviceInfo) {
-    return physicalDeviceInfo.surfaceCapabilities.minImageExtent;
+VulkanSetup::vulkanGetSwapchainImageExtent(const VulkanHandles &vulkanHandles,
+                                           const PhysicalDeviceInfo &physicalDeviceInfo) {
+    const VkSurfaceCapabilitiesKHR &capabilities = physicalDeviceInfo.surfaceCapabilities;
+    if (capabilities.currentExtent.width != UINT32_MAX) {
+        return capabilities.currentExtent;
+    }
+    //The surface size is defined by the swapchain, use the window framebuffer size
+    int width, height;
+    glfwGetFramebufferSize(window, &width, &height);
+    VkExtent2D extent = {(uint32_t) width, (uint32_t) height};
+    extent.width = std::max(capabilities.minImageExtent.width, std::min(capabilities.maxImageExtent.width, extent.width));
+    extent.height = std::max(capabilities.minImageExtent.height, std::min(capabilities.maxImageExtent.height, extent.height));
+    return extent;
 }
 
 
 void
 VulkanSetup::vulkanSetup(GLFWwindow *glfWwindow, VulkanHandles &vulkanHandles, PhysicalDeviceInfo &physicalDeviceInfo,
                          PresentationEngineInfo &presentationEngineInfo) {
+    window = glfWwindow;
     vulkanHandles.instance = vulkanCreateInstance();
     vulkanHandles.surface = vulkanCreateSurface(vulkanHandles.instance, glfWwindow);
     vulkanHandles.physicalDevice = vulkanQueryPhysicalDevice(vulkanHandles, physicalDeviceInfo);
     vulkanHandles.device = vulkanCreateLogicalDevice(vulkanHandles, physicalDeviceInfo);
     presentationEngineInfo = vulkanGetPresentationEngineInfo(vulkanHandles, physicalDeviceInfo);
-    vulkanHandles.swapchain = vulkanCreateSwapchain(vulkanHandles, physicalDeviceInfo, presentationEngineInfo);
+    vulkanHandles.swapchain = vulkanCreateSwapchain(vulkanHandles, physicalDeviceInfo, presentationEngineInfo,
+                                                    VK_NULL_HANDLE);
+
+}
 
+void VulkanSetup::vulkanRecreateSwapchain(VulkanHandles &vulkanHandles, PhysicalDeviceInfo &physicalDeviceInfo,
+                                          PresentationEngineInfo &presentationEngineInfo) {
+    VK_ASSERT(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(vulkanHandles.physicalDevice, vulkanHandles.surface,
+                                                        &physicalDeviceInfo.surfaceCapabilities));
+    presentationEngineInfo = vulkanGetPresentationEngineInfo(vulkanHandles, physicalDeviceInfo);
+    VkSwapchainKHR oldSwapchain = vulkanHandles.swapchain;
+    vulkanHandles.swapchain = vulkanCreateSwapchain(vulkanHandles, physicalDeviceInfo, presentationEngineInfo,
+                                                    oldSwapchain);
+    vkDestroySwapchainKHR(vulkanHandles.device, oldSwapchain, nullptr);
 }
 
 
-VkSwapchainKHR VulkanSetup::vulkanCreateSwapchain(VulkanHandles vulkanHandles, const PhysicalDeviceInfo physicalDeviceInfo,
-                                     const PresentationEngineInfo presentationEngineInfo) {
+VkSwapchainKHR VulkanSetup::vulkanCreateSwapchain(const VulkanHandles &vulkanHandles, const PhysicalDeviceInfo &physicalDeviceInfo,
+                                                  const PresentationEngineInfo &presentationEngineInfo,
+                                                  VkSwapchainKHR oldSwapchain) {
 
     VkSwapchainCreateInfoKHR vkSwapchainCreateInfoKhr{};
     vkSwapchainCreateInfoKhr.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-    vkSwapchainCreateInfoKhr.oldSwapchain = VK_NULL_HANDLE;
+    vkSwapchainCreateInfoKhr.oldSwapchain = oldSwapchain;
     vkSwapchainCreateInfoKhr.surface = vulkanHandles.surface;
     vkSwapchainCreateInfoKhr.presentMode = presentationEngineInfo.presentMode;
     vkSwapchainCreateInfoKhr.imageFormat = presentationEngineInfo.format.format;
     vkSwapchainCreateInfoKhr.imageColorSpace = presentationEngineInfo.format.colorSpace;
     vkSwapchainCreateInfoKhr.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-    vkSwapchainCreateInfoKhr.minImageCount = physicalDeviceInfo.surfaceCapabilities.minImageCount;
+    vkSwapchainCreateInfoKhr.minImageCount = presentationEngineInfo.imageCount;
     vkSwapchainCreateInfoKhr.preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
     vkSwapchainCreateInfoKhr.imageArrayLayers = 1;
     vkSwapchainCreateInfoKhr.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
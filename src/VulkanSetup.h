@@ -10,11 +10,22 @@
 
 class VulkanSetup {
 public:
+    SwapchainSettings swapchainSettings;
+
     void
     vulkanSetup(GLFWwindow *glfWwindow, VulkanHandles &vulkanHandles, PhysicalDeviceInfo &physicalDeviceInfo,
                 PresentationEngineInfo &presentationEngineInfo);
 
+    /*
+     * Create a new swapchain from the current surface state and settings, replacing and destroying the old one.
+     * The caller must make sure the device is idle and recreate everything that depends on the swapchain images
+     */
+    void vulkanRecreateSwapchain(VulkanHandles &vulkanHandles, PhysicalDeviceInfo &physicalDeviceInfo,
+                                 PresentationEngineInfo &presentationEngineInfo);
+
 private:
+    GLFWwindow *window = nullptr;
+
     std::vector<const char *> instanceExtensions = {};
 
     std::vector<const char *> instanceLayers = {"VK_LAYER_KHRONOS_validation"};
@@ -38,15 +49,15 @@ private:
 
     VkInstance vulkanCreateInstance();
 
-    VkDevice vulkanCreateLogicalDevice(const VulkanHandles vulkanHandles, const PhysicalDeviceInfo physicalDeviceInfo);
+    VkDevice vulkanCreateLogicalDevice(const VulkanHandles &vulkanHandles, const PhysicalDeviceInfo &physicalDeviceInfo);
 
     VkPhysicalDevice
-    vulkanQueryPhysicalDevice(const VulkanHandles vulkanHandles, PhysicalDeviceInfo &physicalDeviceInfo);
+    vulkanQueryPhysicalDevice(const VulkanHandles &vulkanHandles, PhysicalDeviceInfo &physicalDeviceInfo);
 
-    int vulkanScorePhysicalDevices(const PhysicalDeviceInfo physicalDeviceInfo);
+    int vulkanScorePhysicalDevices(const PhysicalDeviceInfo &physicalDeviceInfo);
 
     QueueFamilyInfo vulkanGetQueueFamilyInfo(VkPhysicalDevice const vkPhysicalDevice, VkSurfaceKHR const vkSurfaceKhr,
-                                             const PhysicalDeviceInfo physicalDeviceInfo);
+                                             const PhysicalDeviceInfo &physicalDeviceInfo);
 
     void vulkanGetPhysicalDevicesInfo(VkPhysicalDevice vkPhysicalDevice, VkSurfaceKHR vkSurfaceKhr,
                                       PhysicalDeviceInfo *physicalDeviceInfo);
@@ -54,19 +65,22 @@ private:
     VkSurfaceKHR vulkanCreateSurface(VkInstance const instance, GLFWwindow *window);
 
     PresentationEngineInfo
-    vulkanGetPresentationEngineInfo(VulkanHandles vulkanHandles, const PhysicalDeviceInfo physicalDeviceInfo);
+    vulkanGetPresentationEngineInfo(const VulkanHandles &vulkanHandles, const PhysicalDeviceInfo &physicalDeviceInfo);
 
     VkExtent2D
-    vulkanGetSwapchainImageExtent(const VulkanHandles vulkanHandles, const PhysicalDeviceInfo physicalDeviceInfo);
+    vulkanGetSwapchainImageExtent(const VulkanHandles &vulkanHandles, const PhysicalDeviceInfo &physicalDeviceInfo);
 
     VkSurfaceFormatKHR
-    vulkanGetSwapchainImageFormat(const VulkanHandles vulkanHandles, const PhysicalDeviceInfo physicalDeviceInfo);
+    vulkanGetSwapchainImageFormat(const VulkanHandles &vulkanHandles, const PhysicalDeviceInfo &physicalDeviceInfo);
 
     VkPresentModeKHR
-    vulkanGetSwapchainPresentMode(const VulkanHandles vulkanHandles, const PhysicalDeviceInfo physicalDeviceInfo);
+    vulkanGetSwapchainPresentMode(const VulkanHandles &vulkanHandles, const PhysicalDeviceInfo &physicalDeviceInfo);
+
+    uint32_t vulkanGetSwapchainImageCount(const PhysicalDeviceInfo &physicalDeviceInfo);
 
-    VkSwapchainKHR vulkanCreateSwapchain(VulkanHandles vulkanHandles, const PhysicalDeviceInfo physicalDeviceInfo,
-                                         const PresentationEngineInfo presentationEngineInfo);
+    VkSwapchainKHR vulkanCreateSwapchain(const VulkanHandles &vulkanHandles, const PhysicalDeviceInfo &physicalDeviceInfo,
+                                         const PresentationEngineInfo &presentationEngineInfo,
+                                         VkSwapchainKHR oldSwapchain);
 };
 
 
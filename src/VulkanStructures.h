@@ -9,9 +9,13 @@
 
 #include <GLFW/glfw3.h>
 #include <vector>
+#include "UniqueHandle.h"
 
 #define VK_ASSERT(VK_RESULT) if(VK_RESULT != VK_SUCCESS) throw std::runtime_error("ERROR ON VKRESULT");
 
+//Size of the sampler array of the bindless texture table, must match the shaders that index it
+uint32_t const BINDLESS_MAX_TEXTURES = 1024;
+
 struct QueueFamilyInfo {
     int graphicsFamilyIndex = -1;
     int presentationFamilyIndex = -1;
@@ -27,6 +31,14 @@ struct PhysicalDeviceInfo {
     std::vector<VkPresentModeKHR> surfacePresentMode;
     std::vector<VkSurfaceFormatKHR> surfaceFormats;
     std::vector<VkQueueFamilyProperties> queueFamilyProperties;
+    VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures;
+    VkPhysicalDeviceDescriptorIndexingProperties descriptorIndexingProperties;
+    bool bindlessSupported;
+    //The device reports 1.2 and takes VkPhysicalDeviceVulkan12Features at creation
+    bool vulkan12Supported;
+    bool drawIndirectCountSupported;
+    //VK_EXT_memory_budget is enabled, the driver reports the budget and usage of each heap
+    bool memoryBudgetSupported;
 };
 
 struct PresentationEngineInfo {
@@ -36,17 +48,25 @@ struct PresentationEngineInfo {
     VkPresentModeKHR presentMode;
 };
 
+struct SwapchainSettings {
+    //Used when the surface supports it, FIFO otherwise
+    VkPresentModeKHR preferredPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+    //0 requests one image more than the surface minimum, clamped to the surface limits
+    uint32_t imageCount = 0;
+};
+
+//Move only, the synchronization objects are destroyed with the frame
 struct RenderFrame {
     VkCommandBuffer commandBuffer;
-    VkSemaphore imageReadySemaphore;
-    VkSemaphore presentationReadySemaphore;
-    VkFramebuffer frameBuffer;
-    VkFence bufferFinishedFence;
+    UniqueHandle<VkSemaphore> imageReadySemaphore;
+    UniqueHandle<VkSemaphore> presentationReadySemaphore;
+    UniqueHandle<VkFence> bufferFinishedFence;
 };
 
 struct SwapchainReferences {
     std::vector<VkImage> images;
     std::vector<VkImageView> imageViews;
+    std::vector<VkFramebuffer> frameBuffers;
 };
 
 struct CommandBufferStructure {
@@ -80,6 +100,7 @@ struct Texture2D {
     VkSampler sampler;
     VkMemoryRequirements memoryRequirements;
     VkDeviceMemory deviceMemory;
+    uint32_t mipLevels = 1;
 };
 
 
@@ -7,52 +7,268 @@
 #include <vector>
 #include <cstring>
 #include <set>
+#include <unordered_map>
 #include <fstream>
 #include <cmath>
+#include <limits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cerrno>
+#include <random>
+#include <chrono>
 #include "VulkanStructures.h"
 #include "VulkanSetup.h"
 #include "FileManagers/Bitmap/Bitmap.h"
+#include "FileManagers/Bitmap/BitmapKernels.h"
 #include "FileManagers/FileLoader.h"
+#include "FileManagers/ImageDecoders.h"
+#include "FileManagers/Inflate.h"
+#include "FileManagers/MappedFile.h"
+#include "FileManagers/VirtualFileSystem.h"
+#include "FileManagers/TiledHeightfield.h"
 #include "VulkanHelpers.h"
+#include "DescriptorAllocator.h"
+#include "BindlessTextureTable.h"
+#include "FrameProfiler.h"
+#include "ThreadPool.h"
+#include "ShaderLibrary.h"
+#include "SpecializationConstants.h"
+#include "HeightPyramid.h"
+#include "VertexLayout.h"
+#include "DeviceContext.h"
+#include "DeviceMemoryTracker.h"
+#include "DeletionQueue.h"
+#include "AllocationCounter.h"
+#include "FrameArena.h"
+#include "TerrainHeightField.h"
+#include "Simulation.h"
+#include "ProcessMemory.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#ifndef SHADER_DIRECTORY
+#define SHADER_DIRECTORY "../src/Shaders"
+#endif
+
 int const WIDTH = 500;
 int const HEIGHT = 500;
 #define PI 3.14159265359
-struct InputVertex {
-    glm::vec3 position;
-    glm::vec2 texCoord;
+//Corner of the unit quad shared by every patch, the patch data places it in the world and on the heightmap
+struct TerrainVertex {
+    UNorm16x2 position;
 };
 
-struct MVP {
-    glm::mat4 model;
+struct ViewProjection {
     glm::mat4 view;
-    glm::mat4 projetion;
+    glm::mat4 projection;
 };
 
+//Triangle patches use the first three edge levels and the first inner level
 struct TessInfo {
-    glm::vec3 tessLevelOuter;
-    float tessLevelInner;
+    glm::vec4 tessLevelOuter;
+    glm::vec2 tessLevelInner;
 };
 
-struct TerrainPatch {
+//Per patch data read by the culling pass and the terrain shaders, must match Shaders/PatchData.glsl
+struct PatchData {
+    glm::mat4 model;
     TessInfo tessInfo;
-    std::vector<InputVertex> vertices;
-    std::vector<uint32_t> indices;
-    MVP mvp;
+    //Heightmap coordinates of the patch are uvOffset + corner * uvScale
+    glm::vec2 uvOffset;
+    glm::vec2 uvScale;
+    uint32_t heightmapIndex;
+    //Range of the patch in the shared terrain buffers
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    int32_t vertexOffset;
+    uint32_t padding[2];
+    //World space box of the displaced patch
+    glm::vec4 boundsMin;
+    glm::vec4 boundsMax;
+};
+static_assert(sizeof(PatchData) == 160, "PatchData must match the std430 layout of the shaders");
+
+struct TerrainPatch {
+    PatchData patchData;
+    //Min and max of the heightmap under the patch, before the model transform
+    glm::vec2 heightBounds;
+};
+
+/*
+ * Primitive the tessellator works on. Changes the shaders and the amount of control points, so unlike the
+ * specialization constants it is not folded into an existing pipeline.
+ */
+enum TessellationDomain : uint32_t {
+    //Each quad is split in two patches of 3 control points
+    TESSELLATION_DOMAIN_TRIANGLES = 0,
+    //One patch of 4 control points per quad, with a level per edge
+    TESSELLATION_DOMAIN_QUADS = 1
+};
+
+struct IndexRange {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+};
+
+//Unit quad drawn once per patch, so all of them are drawn by one indirect draw
+struct TerrainMesh {
     Buffer vertexBuffer;
     Buffer indexBuffer;
+    //Indices of the quad for each tessellation domain
+    IndexRange domainRanges[2];
+};
 
-    Buffer tessInfoUniform;
-    VkDescriptorSet tessInfoDescriptorSet;
+//Uniforms of the culling pass, must match CullUniforms in cullPatches.comp
+struct CullUniforms {
+    glm::vec4 frustumPlanes[6];
+    glm::mat4 viewProjection;
+    //Camera the Hi-Z was rendered from
+    glm::mat4 previousViewProjection;
+    glm::vec2 depthSize;
+    uint32_t patchCount;
+    uint32_t compact;
+    uint32_t occlusionEnabled;
+};
+
+//The culling pass runs twice per frame, see cullPatches.comp
+enum CullPhase : uint32_t {
+    CULL_PHASE_PREVIOUS_DEPTH = 0,
+    CULL_PHASE_RETEST = 1
+};
+
+//Render passes of a frame, see vulkanCreateRenderPass
+enum FramePass {
+    //Clears and keeps the depth for the Hi-Z reduction
+    FRAME_PASS_FIRST,
+    //Draws the patches recovered by the occlusion re-test and presents
+    FRAME_PASS_RESUME,
+    //Clears and presents, the whole frame when occlusion culling is off
+    FRAME_PASS_SINGLE
+};
+
+//Must match the CullStatistics block in cullPatches.comp
+struct CullStatistics {
+    uint32_t drawn;
+    uint32_t frustumRejected;
+    uint32_t occlusionRejected;
+    uint32_t retestRecovered;
+};
 
-    Buffer mvpUniform;
-    VkDescriptorSet mvpDescriptorSet;
+//Must match local_size_x in cullPatches.comp
+uint32_t const CULL_GROUP_SIZE = 64;
+//Must match local_size_x and local_size_y in hiZReduce.comp
+uint32_t const HI_Z_GROUP_SIZE = 8;
+
+//Buffers written once per render frame, one copy per frame in flight
+struct FrameUniforms {
+    Buffer viewProjectionUniform;
+    Buffer patchBuffer;
+    VkDescriptorSet viewProjectionDescriptorSet;
+    Buffer cullUniformBuffer;
+    //Output of the culling pass, consumed by the indirect draws of the same frame
+    Buffer drawCommandBuffer;
+    Buffer drawCountBuffer;
+    Buffer occludedBuffer;
+    //Host visible, read once the fence of the frame is signaled
+    Buffer statisticsBuffer;
+    bool statisticsPending = false;
+    //Start and end of the GPU work of the frame, empty when the graphics queue has no timestamps
+    UniqueHandle<VkQueryPool> timestampQueryPool;
+    bool timestampsPending = false;
 };
 
+/*
+ * How the patches reach the GPU. The indirect modes are only used when the device supports them.
+ */
+enum CullingMode {
+    //One vkCmdDrawIndexed per patch, nothing is culled
+    CULLING_NONE,
+    //One indirect command per patch, culled patches draw zero instances
+    CULLING_GPU,
+    //Visible patches are compacted and drawn with vkCmdDrawIndexedIndirectCount
+    CULLING_GPU_COMPACT
+};
+
+//Values of the specialization constants declared by the terrain shaders
+enum LodMode : uint32_t {
+    LOD_MODE_PER_PATCH = 0,
+    LOD_MODE_FIXED = 1
+};
+
+enum NormalSource : uint32_t {
+    NORMAL_SOURCE_FACE = 0,
+    NORMAL_SOURCE_HEIGHTMAP = 1
+};
+
+enum ShadingModel : uint32_t {
+    SHADING_MODEL_DIFFUSE = 0,
+    SHADING_MODEL_BLINN_PHONG = 1,
+    SHADING_MODEL_NORMALS = 2
+};
+
+using LodModeConstant = SpecializationConstant<0, uint32_t>;
+using MaxTessellationConstant = SpecializationConstant<1, float>;
+using NormalSourceConstant = SpecializationConstant<2, uint32_t>;
+using ShadingModelConstant = SpecializationConstant<3, uint32_t>;
+using TerrainSpecialization = SpecializationBlock<LodModeConstant, MaxTessellationConstant, NormalSourceConstant, ShadingModelConstant>;
+
+/*
+ * Every combination is a separate pipeline, the driver folds the constants and removes the unused paths
+ */
+struct TerrainVariant {
+    VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+    LodMode lodMode = LOD_MODE_PER_PATCH;
+    NormalSource normalSource = NORMAL_SOURCE_FACE;
+    ShadingModel shadingModel = SHADING_MODEL_DIFFUSE;
+    TessellationDomain domain = TESSELLATION_DOMAIN_TRIANGLES;
+    float maxTessellation = 64;
+
+    TerrainSpecialization specialization() const {
+        TerrainSpecialization specialization;
+        specialization.set<LodModeConstant>(lodMode);
+        specialization.set<MaxTessellationConstant>(maxTessellation);
+        specialization.set<NormalSourceConstant>(normalSource);
+        specialization.set<ShadingModelConstant>(shadingModel);
+        return specialization;
+    }
+
+    uint64_t key() const {
+        uint32_t maxTessellationBits;
+        std::memcpy(&maxTessellationBits, &maxTessellation, sizeof(float));
+        return (uint64_t) maxTessellationBits << 32 | domain << 12 | polygonMode << 8 | lodMode << 4 | normalSource << 2 | shadingModel;
+    }
+};
+
+struct DepthAttachment {
+    VkImage image;
+    VkDeviceMemory deviceMemory;
+    VkImageView imageView;
+};
+
+/*
+ * Max depth pyramid of the depth attachment, level 0 is half its size and each level halves the previous one.
+ * Lives in VK_IMAGE_LAYOUT_GENERAL, written as storage image and read with texelFetch.
+ */
+struct HiZPyramid {
+    VkImage image;
+    VkDeviceMemory deviceMemory;
+    //Every level, read by the culling pass
+    VkImageView imageView;
+    //One view per level, written by the reduction
+    std::vector<VkImageView> levelViews;
+    std::vector<VkExtent2D> levelExtents;
+    //The image was moved out of the undefined layout
+    bool initialized = false;
+    //Holds the depth of the last frame, false after a resize or while occlusion culling is off
+    bool valid = false;
+};
+
+VkShaderStageFlags const PATCH_DATA_STAGES = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT | VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT |
+                                             VK_SHADER_STAGE_GEOMETRY_BIT;
+
+//View of the interpolated simulation state, only the simulation moves it
 struct Camera {
-    float speed = 2;
     glm::vec3 eye = glm::vec3(0, 0, 1);
     glm::vec3 center = glm::vec3(1, 0, 0);
     glm::vec3 up = glm::vec3(0, 1, 0);
@@ -68,62 +284,75 @@ struct Camera {
     }
 } camera;
 
+//std140: a vec3 is aligned to 16 bytes, cameraPosition is at offset 16 and the block takes 28 bytes
 struct LightInformation {
-    glm::vec3 position;
-    glm::vec3 cameraPosition;
+    alignas(16) glm::vec3 position;
+    alignas(16) glm::vec3 cameraPosition;
 } lightInformation;
+static_assert(offsetof(LightInformation, cameraPosition) == 16 && sizeof(LightInformation) >= 28,
+              "LightInformation must match the std140 layout of the fragment shader block");
 
 glm::vec2 lastMousePosition;
 float mouseSensitivity = 0.5;
 float globalInnerTess = 1;
 float globalOuterTess = 1;
 int activePatch = 0;
-VkPipeline activePipeline;
-VkPipeline shadedPipeline;
-VkPipeline wirePipeline;
+TerrainVariant terrainVariant;
 std::vector<TerrainPatch> terrainPatches;
 float maxTesselationLevel = -1;
-float angle = 0;
-void keyboard(GLFWwindow *window, int key, int scancode, int action, int mods) {
-    float moveSpeed = camera.speed * 0.01;
-
-    glm::vec3 forward = glm::normalize(camera.center - camera.eye);
-    glm::vec3 right = glm::normalize(glm::cross(forward, camera.up));
-    if (key == GLFW_KEY_W) {
-        camera.eye = camera.eye + forward * moveSpeed;
-        camera.center = camera.center + forward * moveSpeed;
-        camera.up = glm::vec3(0, 1, 0);
-
-    } else if (key == GLFW_KEY_S) {
-        camera.eye = camera.eye + forward * -moveSpeed;
-        camera.center = camera.center + forward * -moveSpeed;
-        camera.up = glm::vec3(0, 1, 0);
-    } else if (key == GLFW_KEY_D) {
-        camera.eye = camera.eye + right * moveSpeed;
-        camera.center = camera.center + right * moveSpeed;
-        camera.up = glm::vec3(0, 1, 0);
-
-    } else if (key == GLFW_KEY_A) {
-        camera.eye = camera.eye + right * -moveSpeed;
-        camera.center = camera.center + right * -moveSpeed;
-        camera.up = glm::vec3(0, 1, 0);
-    } else if (key == GLFW_KEY_Q) {
-        camera.eye = camera.eye + glm::vec3(0, 1, 0) * moveSpeed;
-        camera.center = camera.center + glm::vec3(0, 1, 0) * moveSpeed;
-        camera.up = glm::vec3(0, 1, 0);
-
-    } else if (key == GLFW_KEY_E) {
-        camera.eye = camera.eye + glm::vec3(0, 1, 0) * -moveSpeed;
-        camera.center = camera.center + glm::vec3(0, 1, 0) * -moveSpeed;
-        camera.up = glm::vec3(0, 1, 0);
+bool framebufferResized = false;
+bool presentModeChanged = false;
+bool latencyMode = false;
+bool gpuCullingEnabled = true;
+bool occlusionCullingEnabled = true;
+bool terrainPickRequested = false;
+bool memoryReportRequested = false;
+bool benchmarkTerrainQueries = false;
+bool benchmarkBitmapKernels = false;
+bool benchmarkImageDecoders = false;
+bool benchmarkHeightmapTiles = false;
+//Warm-up frames before every frame must be free of heap allocations, zero when not checked
+uint32_t checkFrameAllocations = 0;
+//Relative to the resource root, any format the image decoder registry knows
+std::string heightmapPath = "Resources/heightmap.bmp";
+//Mounted over the loose files when given, see AssetPacker
+std::string assetPackPath;
+std::string recordInputPath;
+std::string replayInputPath;
+//Input events since the last simulation update
+uint32_t pendingSimulationActions = 0;
+glm::vec2 pendingLook = glm::vec2(0);
+VulkanSetup vulkanSetup;
+
+const char *presentModeName(VkPresentModeKHR presentMode) {
+    switch (presentMode) {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR:
+            return "IMMEDIATE";
+        case VK_PRESENT_MODE_MAILBOX_KHR:
+            return "MAILBOX";
+        case VK_PRESENT_MODE_FIFO_KHR:
+            return "FIFO";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+            return "FIFO_RELAXED";
+        default:
+            return "UNKNOWN";
     }
+}
 
+void framebufferResize(GLFWwindow *window, int width, int height) {
+    framebufferResized = true;
+}
+
+/*
+ * Movement keys are polled once per frame by gatherSimulationInput, the callback only handles presses
+ */
+void keyboard(GLFWwindow *window, int key, int scancode, int action, int mods) {
     if (key == GLFW_KEY_LEFT) {
-        terrainPatches[activePatch].tessInfo.tessLevelInner -= 1;
-        if (terrainPatches[activePatch].tessInfo.tessLevelInner < 1) terrainPatches[activePatch].tessInfo.tessLevelInner = 1;
+        glm::vec2 &tessLevelInner = terrainPatches[activePatch].patchData.tessInfo.tessLevelInner;
+        tessLevelInner = glm::max(tessLevelInner - 1.0f, glm::vec2(1));
     } else if (key == GLFW_KEY_RIGHT) {
-        terrainPatches[activePatch].tessInfo.tessLevelInner += 1;
-        if (terrainPatches[activePatch].tessInfo.tessLevelInner > maxTesselationLevel) terrainPatches[activePatch].tessInfo.tessLevelInner = maxTesselationLevel;
+        glm::vec2 &tessLevelInner = terrainPatches[activePatch].patchData.tessInfo.tessLevelInner;
+        tessLevelInner = glm::min(tessLevelInner + 1.0f, glm::vec2(maxTesselationLevel));
     }
 
     if (key == GLFW_KEY_DOWN) {
@@ -135,13 +364,65 @@ void keyboard(GLFWwindow *window, int key, int scancode, int action, int mods) {
     }
 
     if (key == GLFW_KEY_O) {
-        activePipeline = wirePipeline;
+        terrainVariant.polygonMode = VK_POLYGON_MODE_LINE;
     } else if (key == GLFW_KEY_P) {
-        activePipeline = shadedPipeline;
+        terrainVariant.polygonMode = VK_POLYGON_MODE_FILL;
+    }
+
+    if (key == GLFW_KEY_F && action == GLFW_PRESS) {
+        terrainVariant.lodMode = terrainVariant.lodMode == LOD_MODE_FIXED ? LOD_MODE_PER_PATCH : LOD_MODE_FIXED;
+    } else if (key == GLFW_KEY_N && action == GLFW_PRESS) {
+        terrainVariant.normalSource = terrainVariant.normalSource == NORMAL_SOURCE_FACE ? NORMAL_SOURCE_HEIGHTMAP : NORMAL_SOURCE_FACE;
+    } else if (key == GLFW_KEY_B && action == GLFW_PRESS) {
+        terrainVariant.shadingModel = (ShadingModel) ((terrainVariant.shadingModel + 1) % 3);
+    } else if (key == GLFW_KEY_T && action == GLFW_PRESS) {
+        terrainVariant.domain = terrainVariant.domain == TESSELLATION_DOMAIN_TRIANGLES ? TESSELLATION_DOMAIN_QUADS : TESSELLATION_DOMAIN_TRIANGLES;
     }
 
     if (key >= GLFW_KEY_1 && key <= GLFW_KEY_9)
         activePatch = key - GLFW_KEY_1;
+
+    if (key == GLFW_KEY_M && action == GLFW_PRESS) {
+        //Cycle the present modes, unsupported ones fall back to FIFO when the swapchain is recreated
+        VkPresentModeKHR presentModes[4] = {VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+                                            VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR};
+        int current = 0;
+        for (int i = 0; i < 4; ++i) {
+            if (presentModes[i] == vulkanSetup.swapchainSettings.preferredPresentMode) current = i;
+        }
+        vulkanSetup.swapchainSettings.preferredPresentMode = presentModes[(current + 1) % 4];
+        presentModeChanged = true;
+    } else if (key == GLFW_KEY_L && action == GLFW_PRESS) {
+        latencyMode = !latencyMode;
+    } else if (key == GLFW_KEY_C && action == GLFW_PRESS) {
+        gpuCullingEnabled = !gpuCullingEnabled;
+    } else if (key == GLFW_KEY_H && action == GLFW_PRESS) {
+        occlusionCullingEnabled = !occlusionCullingEnabled;
+    } else if (key == GLFW_KEY_G && action == GLFW_PRESS) {
+        pendingSimulationActions |= SIMULATION_ACTION_NEXT_CAMERA_MODE;
+    } else if (key == GLFW_KEY_R && action == GLFW_PRESS) {
+        terrainPickRequested = true;
+    } else if (key == GLFW_KEY_V && action == GLFW_PRESS) {
+        memoryReportRequested = true;
+    }
+}
+
+/*
+ * Held movement keys plus the presses and mouse look since the previous call
+ */
+SimulationInput gatherSimulationInput(GLFWwindow *window) {
+    SimulationInput input{};
+    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) input.heldKeys |= SIMULATION_KEY_FORWARD;
+    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) input.heldKeys |= SIMULATION_KEY_BACKWARD;
+    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) input.heldKeys |= SIMULATION_KEY_RIGHT;
+    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) input.heldKeys |= SIMULATION_KEY_LEFT;
+    if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS) input.heldKeys |= SIMULATION_KEY_UP;
+    if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS) input.heldKeys |= SIMULATION_KEY_DOWN;
+    input.actions = pendingSimulationActions;
+    input.look = pendingLook;
+    pendingSimulationActions = 0;
+    pendingLook = glm::vec2(0);
+    return input;
 }
 
 void mouseButton(GLFWwindow *window, int button, int action, int modifier) {
@@ -153,7 +434,9 @@ void mouseButton(GLFWwindow *window, int button, int action, int modifier) {
 }
 
 void mouseMovement(GLFWwindow *window, double xpos, double ypos) {
-    ypos = HEIGHT - ypos;
+    int windowHeight;
+    glfwGetWindowSize(window, nullptr, &windowHeight);
+    ypos = windowHeight - ypos;
     if (camera.isDragging) {
 
         float xDelta = (xpos - lastMousePosition.x);
@@ -161,39 +444,40 @@ void mouseMovement(GLFWwindow *window, double xpos, double ypos) {
         float xOffset = xDelta * mouseSensitivity;
         float yOffset = yDelta * mouseSensitivity;
 
-        camera.angle.x += yOffset;
-        camera.angle.y += xOffset;
-
-        if (camera.angle.x >= 89) {
-            camera.angle.x = 89;
-        } else if (camera.angle.x <= -89) {
-            camera.angle.x = -89;
-        }
-
-        camera.positionCameraCenter();
+        //Pitch and yaw, applied and clamped by the next simulation step
+        pendingLook += glm::vec2(yOffset, xOffset);
     }
     lastMousePosition = glm::vec2(xpos, ypos);
 
 }
 
+/*
+ * With occlusion culling the frame is drawn in two passes, the first clears and keeps the depth for the Hi-Z
+ * reduction, the second resumes both attachments to draw the patches recovered by the occlusion re-test and presents.
+ * Without it a single pass clears and presents. All passes are compatible, the same framebuffers and pipelines are
+ * used with any of them.
+ */
 VkRenderPass
-vulkanCreateRenderPass(const VulkanHandles vulkanHandles, const PresentationEngineInfo presentationEngineInfo) {
+vulkanCreateRenderPass(const VulkanHandles &vulkanHandles, const PresentationEngineInfo &presentationEngineInfo, FramePass framePass) {
+    bool resumePass = framePass == FRAME_PASS_RESUME;
+    bool presents = framePass != FRAME_PASS_FIRST;
     VkAttachmentDescription colorAttachment{};
     colorAttachment.format = presentationEngineInfo.format.format;
-    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.initialLayout = resumePass ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+    colorAttachment.finalLayout = presents ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.loadOp = resumePass ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
     colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
 
+    //The depth is read by the Hi-Z reduction between the passes
     VkAttachmentDescription depthAttachment{};
     depthAttachment.format = VK_FORMAT_D32_SFLOAT;
-    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout = resumePass ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    depthAttachment.loadOp = resumePass ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = presents ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
     depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -219,61 +503,54 @@ vulkanCreateRenderPass(const VulkanHandles vulkanHandles, const PresentationEngi
     vkSubpassDescription.pResolveAttachments = nullptr;
     vkSubpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
 
+    //The depth may still be read by the reduction of the previous frame, or by the one of this frame for the second pass
     VkSubpassDependency vkSubpassDependency{};
     vkSubpassDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
     vkSubpassDependency.dstSubpass = 0;
-    vkSubpassDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    vkSubpassDependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    vkSubpassDependency.srcAccessMask = 0;
-    vkSubpassDependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    vkSubpassDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                       VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    vkSubpassDependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                       VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    vkSubpassDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    vkSubpassDependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
     vkSubpassDependency.dependencyFlags = 0;
 
+    //The depth written by the first pass is sampled by the Hi-Z reduction
+    VkSubpassDependency depthReadDependency{};
+    depthReadDependency.srcSubpass = 0;
+    depthReadDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+    depthReadDependency.srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    depthReadDependency.dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    depthReadDependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    depthReadDependency.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    depthReadDependency.dependencyFlags = 0;
+    VkSubpassDependency dependencies[2] = {vkSubpassDependency, depthReadDependency};
+
     VkRenderPassCreateInfo vkRenderPassCreateInfo{};
     vkRenderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
     vkRenderPassCreateInfo.subpassCount = 1;
     vkRenderPassCreateInfo.pSubpasses = &vkSubpassDescription;
     vkRenderPassCreateInfo.attachmentCount = attachments.size();
     vkRenderPassCreateInfo.pAttachments = attachments.data();
-    vkRenderPassCreateInfo.dependencyCount = 1;
-    vkRenderPassCreateInfo.pDependencies = &vkSubpassDependency;
+    vkRenderPassCreateInfo.dependencyCount = framePass == FRAME_PASS_FIRST ? 2 : 1;
+    vkRenderPassCreateInfo.pDependencies = dependencies;
     VkRenderPass vkRenderPass;
     VK_ASSERT(vkCreateRenderPass(vulkanHandles.device, &vkRenderPassCreateInfo, nullptr, &vkRenderPass));
     return vkRenderPass;
 }
 
-VkPipeline vulkanCreatePipeline(const VulkanHandles vulkanHandles, const PresentationEngineInfo presentationEngineInfo, VkPipelineLayout vkPipelineLayout, VkRenderPass renderPass, VkPolygonMode polygonMode,
+VkPipeline vulkanCreatePipeline(const VulkanHandles &vulkanHandles, VkPipelineLayout vkPipelineLayout, VkRenderPass renderPass, VkPolygonMode polygonMode,
                                 const VkShaderModule vertexShaderModule,
                                 const VkShaderModule fragmentShaderModule, const VkShaderModule tesselationControlShaderModule,
-                                const VkShaderModule tesselationEvaluationShaderModule, const VkShaderModule geometryShaderModule) {
+                                const VkShaderModule tesselationEvaluationShaderModule, const VkShaderModule geometryShaderModule,
+                                const PipelineSpecialization &specialization, uint32_t patchControlPoints) {
 
 
 
     /////// Define Vertex Input
-    VkVertexInputBindingDescription vkVertexInputBindingDescription{};
-    vkVertexInputBindingDescription.binding = 0;
-    vkVertexInputBindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-    vkVertexInputBindingDescription.stride = sizeof(InputVertex);
-
-    VkVertexInputAttributeDescription vkVertexAttrPosition{};
-    vkVertexAttrPosition.binding = 0;
-    vkVertexAttrPosition.offset = offsetof(struct InputVertex, position);
-    vkVertexAttrPosition.format = VK_FORMAT_R32G32B32_SFLOAT;
-    vkVertexAttrPosition.location = 0;
-
-    VkVertexInputAttributeDescription vkVertexAttrTexCoord{};
-    vkVertexAttrTexCoord.binding = 0;
-    vkVertexAttrTexCoord.offset = offsetof(struct InputVertex, texCoord);
-    vkVertexAttrTexCoord.format = VK_FORMAT_R32G32_SFLOAT;
-    vkVertexAttrTexCoord.location = 1;
-
-    std::vector<VkVertexInputAttributeDescription> vkDescriptions{vkVertexAttrPosition,
-                                                                  vkVertexAttrTexCoord};
-    VkPipelineVertexInputStateCreateInfo vkVertexInputStateCreateInfo{};
-    vkVertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vkVertexInputStateCreateInfo.vertexAttributeDescriptionCount = vkDescriptions.size();
-    vkVertexInputStateCreateInfo.vertexBindingDescriptionCount = 1;
-    vkVertexInputStateCreateInfo.pVertexBindingDescriptions = &vkVertexInputBindingDescription;
-    vkVertexInputStateCreateInfo.pVertexAttributeDescriptions = vkDescriptions.data();
+    VertexLayout<TerrainVertex> vertexLayout;
+    vertexLayout.attribute(0, &TerrainVertex::position);
 
     ///////
     VkPipelineInputAssemblyStateCreateInfo vkPipelineInputAssemblyStateCreateInfo{};
@@ -283,26 +560,21 @@ VkPipeline vulkanCreatePipeline(const VulkanHandles vulkanHandles, const Present
 
     VkPipelineTessellationStateCreateInfo vkPipelineTessellationStateCreateInfo{};
     vkPipelineTessellationStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_TESSELLATION_STATE_CREATE_INFO;
-    vkPipelineTessellationStateCreateInfo.patchControlPoints = 3;
-
-    VkViewport vkViewport{};
-    vkViewport.width = presentationEngineInfo.extents.width;
-    vkViewport.height = -float(presentationEngineInfo.extents.height);
-    vkViewport.x = 0;
-    vkViewport.y = presentationEngineInfo.extents.height;
-    vkViewport.minDepth = 0.0;
-    vkViewport.maxDepth = 1.0;
-
-    VkRect2D vkScissor{};
-    vkScissor.offset = {0, 0};
-    vkScissor.extent = presentationEngineInfo.extents;
+    vkPipelineTessellationStateCreateInfo.patchControlPoints = patchControlPoints;
 
+    //Viewport and scissor are dynamic so the pipelines survive swapchain recreation
     VkPipelineViewportStateCreateInfo vkPipelineViewportStateCreateInfo{};
     vkPipelineViewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     vkPipelineViewportStateCreateInfo.viewportCount = 1;
-    vkPipelineViewportStateCreateInfo.pViewports = &vkViewport;
+    vkPipelineViewportStateCreateInfo.pViewports = nullptr;
     vkPipelineViewportStateCreateInfo.scissorCount = 1;
-    vkPipelineViewportStateCreateInfo.pScissors = &vkScissor;
+    vkPipelineViewportStateCreateInfo.pScissors = nullptr;
+
+    VkDynamicState dynamicStates[2] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo vkPipelineDynamicStateCreateInfo{};
+    vkPipelineDynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    vkPipelineDynamicStateCreateInfo.dynamicStateCount = 2;
+    vkPipelineDynamicStateCreateInfo.pDynamicStates = dynamicStates;
 
     VkPipelineRasterizationStateCreateInfo vkPipelineRasterizationStateCreateInfo{};
     vkPipelineRasterizationStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -347,30 +619,35 @@ VkPipeline vulkanCreatePipeline(const VulkanHandles vulkanHandles, const Present
     vkVertexShaderStageCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
     vkVertexShaderStageCreateInfo.pName = "main";
     vkVertexShaderStageCreateInfo.module = vertexShaderModule;
+    vkVertexShaderStageCreateInfo.pSpecializationInfo = specialization.vertex;
 
     VkPipelineShaderStageCreateInfo vkFragmentShaderStageCreateInfo{};
     vkFragmentShaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     vkFragmentShaderStageCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
     vkFragmentShaderStageCreateInfo.pName = "main";
     vkFragmentShaderStageCreateInfo.module = fragmentShaderModule;
+    vkFragmentShaderStageCreateInfo.pSpecializationInfo = specialization.fragment;
 
     VkPipelineShaderStageCreateInfo vkTesselationControlShaderStageCreateInfo{};
     vkTesselationControlShaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     vkTesselationControlShaderStageCreateInfo.stage = VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
     vkTesselationControlShaderStageCreateInfo.pName = "main";
     vkTesselationControlShaderStageCreateInfo.module = tesselationControlShaderModule;
+    vkTesselationControlShaderStageCreateInfo.pSpecializationInfo = specialization.tessellationControl;
 
     VkPipelineShaderStageCreateInfo vkTesselationEvaluationShaderStageCreateInfo{};
     vkTesselationEvaluationShaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     vkTesselationEvaluationShaderStageCreateInfo.stage = VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
     vkTesselationEvaluationShaderStageCreateInfo.pName = "main";
     vkTesselationEvaluationShaderStageCreateInfo.module = tesselationEvaluationShaderModule;
+    vkTesselationEvaluationShaderStageCreateInfo.pSpecializationInfo = specialization.tessellationEvaluation;
 
     VkPipelineShaderStageCreateInfo vkGeometryShaderStageCreateInfo{};
     vkGeometryShaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     vkGeometryShaderStageCreateInfo.stage = VK_SHADER_STAGE_GEOMETRY_BIT;
     vkGeometryShaderStageCreateInfo.pName = "main";
     vkGeometryShaderStageCreateInfo.module = geometryShaderModule;
+    vkGeometryShaderStageCreateInfo.pSpecializationInfo = specialization.geometry;
 
     VkPipelineShaderStageCreateInfo stages[5]{vkVertexShaderStageCreateInfo, vkFragmentShaderStageCreateInfo,
                                               vkTesselationControlShaderStageCreateInfo, vkTesselationEvaluationShaderStageCreateInfo, vkGeometryShaderStageCreateInfo};
@@ -381,14 +658,14 @@ VkPipeline vulkanCreatePipeline(const VulkanHandles vulkanHandles, const Present
     vkGraphicsPipelineCreateInfo.stageCount = 5;
     vkGraphicsPipelineCreateInfo.pStages = stages;
     vkGraphicsPipelineCreateInfo.pColorBlendState = &vkPipelineColorBlendStateCreateInfo;
-    vkGraphicsPipelineCreateInfo.pVertexInputState = &vkVertexInputStateCreateInfo;
+    vkGraphicsPipelineCreateInfo.pVertexInputState = vertexLayout.createInfo();
     vkGraphicsPipelineCreateInfo.pInputAssemblyState = &vkPipelineInputAssemblyStateCreateInfo;
     vkGraphicsPipelineCreateInfo.pMultisampleState = &vkPipelineMultisampleStateCreateInfo;
     vkGraphicsPipelineCreateInfo.pViewportState = &vkPipelineViewportStateCreateInfo;
     vkGraphicsPipelineCreateInfo.pRasterizationState = &vkPipelineRasterizationStateCreateInfo;
     vkGraphicsPipelineCreateInfo.pTessellationState = &vkPipelineTessellationStateCreateInfo;
     vkGraphicsPipelineCreateInfo.pDepthStencilState = &vkPipelineDepthStencilStateCreateInfo;
-    vkGraphicsPipelineCreateInfo.pDynamicState = nullptr;
+    vkGraphicsPipelineCreateInfo.pDynamicState = &vkPipelineDynamicStateCreateInfo;
     vkGraphicsPipelineCreateInfo.layout = vkPipelineLayout;
 
     VkPipeline vkPipeline;
@@ -397,109 +674,698 @@ VkPipeline vulkanCreatePipeline(const VulkanHandles vulkanHandles, const Present
     return vkPipeline;
 }
 
+VkPipeline vulkanCreateComputePipeline(const VulkanHandles &vulkanHandles, VkPipelineLayout vkPipelineLayout, const VkShaderModule computeShaderModule) {
+    VkPipelineShaderStageCreateInfo vkComputeShaderStageCreateInfo{};
+    vkComputeShaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    vkComputeShaderStageCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    vkComputeShaderStageCreateInfo.pName = "main";
+    vkComputeShaderStageCreateInfo.module = computeShaderModule;
+
+    VkComputePipelineCreateInfo vkComputePipelineCreateInfo{};
+    vkComputePipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    vkComputePipelineCreateInfo.stage = vkComputeShaderStageCreateInfo;
+    vkComputePipelineCreateInfo.layout = vkPipelineLayout;
+
+    VkPipeline vkPipeline;
+    VK_ASSERT(vkCreateComputePipelines(vulkanHandles.device, VK_NULL_HANDLE, 1,
+                                       &vkComputePipelineCreateInfo, nullptr, &vkPipeline));
+    return vkPipeline;
+}
+
+DepthAttachment createDepthAttachment(const VulkanHandles &vulkanHandles, DeviceMemoryTracker &memoryTracker, VkExtent2D extent) {
+    DepthAttachment depthAttachment{};
+    depthAttachment.image = vulkanCreateImage2D(vulkanHandles, extent, VK_FORMAT_D32_SFLOAT,
+                                                VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+    VkMemoryRequirements depthMapRequirement = vulkanGetImageMemoryRequirements(vulkanHandles, depthAttachment.image);
+    depthAttachment.deviceMemory = memoryTracker.vulkanAllocate(depthMapRequirement, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_TAG_ATTACHMENTS);
+    VK_ASSERT(vkBindImageMemory(vulkanHandles.device, depthAttachment.image, depthAttachment.deviceMemory, 0));
+    depthAttachment.imageView = vulkanCreateImageView2D(vulkanHandles, depthAttachment.image, VK_FORMAT_D32_SFLOAT, VK_IMAGE_ASPECT_DEPTH_BIT);
+    return depthAttachment;
+}
+
+HiZPyramid createHiZPyramid(const VulkanHandles &vulkanHandles, DeviceMemoryTracker &memoryTracker, VkExtent2D depthExtent) {
+    HiZPyramid hiZPyramid{};
+    VkExtent2D extent = {std::max(depthExtent.width / 2, 1u), std::max(depthExtent.height / 2, 1u)};
+    uint32_t levelCount = 1;
+    while ((std::max(extent.width, extent.height) >> levelCount) > 0) levelCount++;
+
+    hiZPyramid.image = vulkanCreateImage2D(vulkanHandles, extent, VK_FORMAT_R32_SFLOAT,
+                                           VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, levelCount);
+    VkMemoryRequirements memoryRequirements = vulkanGetImageMemoryRequirements(vulkanHandles, hiZPyramid.image);
+    hiZPyramid.deviceMemory = memoryTracker.vulkanAllocate(memoryRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_TAG_ATTACHMENTS);
+    VK_ASSERT(vkBindImageMemory(vulkanHandles.device, hiZPyramid.image, hiZPyramid.deviceMemory, 0));
+    hiZPyramid.imageView = vulkanCreateImageView2D(vulkanHandles, hiZPyramid.image, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, levelCount);
+    for (uint32_t level = 0; level < levelCount; ++level) {
+        hiZPyramid.levelViews.push_back(vulkanCreateImageView2D(vulkanHandles, hiZPyramid.image, VK_FORMAT_R32_SFLOAT,
+                                                                VK_IMAGE_ASPECT_COLOR_BIT, 1, level));
+        hiZPyramid.levelExtents.push_back({std::max(extent.width >> level, 1u), std::max(extent.height >> level, 1u)});
+    }
+    return hiZPyramid;
+}
+
+void destroyHiZPyramid(const VulkanHandles &vulkanHandles, DeviceMemoryTracker &memoryTracker, HiZPyramid &hiZPyramid) {
+    for (auto levelView : hiZPyramid.levelViews) {
+        vkDestroyImageView(vulkanHandles.device, levelView, nullptr);
+    }
+    vkDestroyImageView(vulkanHandles.device, hiZPyramid.imageView, nullptr);
+    vkDestroyImage(vulkanHandles.device, hiZPyramid.image, nullptr);
+    memoryTracker.vulkanFree(hiZPyramid.deviceMemory);
+    hiZPyramid = HiZPyramid{};
+}
+
+/*
+ * Create the image views, depth attachment, its Hi-Z pyramid and one framebuffer per image of the current swapchain
+ */
+void createSwapchainResources(const VulkanHandles &vulkanHandles, DeviceMemoryTracker &memoryTracker, PresentationEngineInfo &presentationEngineInfo,
+                              VkRenderPass renderPass, SwapchainReferences &swapchainReferences, DepthAttachment &depthAttachment,
+                              HiZPyramid &hiZPyramid) {
+    swapchainReferences.images = vulkanGetSwapchainImages(vulkanHandles, presentationEngineInfo);
+    swapchainReferences.imageViews = vulkanCreateSwapchainImageViews(vulkanHandles, presentationEngineInfo,
+                                                                     swapchainReferences.images);
+    depthAttachment = createDepthAttachment(vulkanHandles, memoryTracker, presentationEngineInfo.extents);
+    hiZPyramid = createHiZPyramid(vulkanHandles, memoryTracker, presentationEngineInfo.extents);
+    swapchainReferences.frameBuffers.resize(presentationEngineInfo.imageCount);
+    for (int i = 0; i < presentationEngineInfo.imageCount; ++i) {
+        swapchainReferences.frameBuffers[i] = vulkanCreateFrameBuffer(vulkanHandles,
+                                                                      presentationEngineInfo.extents.width,
+                                                                      presentationEngineInfo.extents.height, renderPass,
+                                                                      {swapchainReferences.imageViews[i], depthAttachment.imageView});
+    }
+}
+
+void destroySwapchainResources(const VulkanHandles &vulkanHandles, DeviceMemoryTracker &memoryTracker, SwapchainReferences &swapchainReferences,
+                               DepthAttachment &depthAttachment, HiZPyramid &hiZPyramid) {
+    for (auto frameBuffer : swapchainReferences.frameBuffers) {
+        vkDestroyFramebuffer(vulkanHandles.device, frameBuffer, nullptr);
+    }
+    for (auto imageView : swapchainReferences.imageViews) {
+        vkDestroyImageView(vulkanHandles.device, imageView, nullptr);
+    }
+    vkDestroyImageView(vulkanHandles.device, depthAttachment.imageView, nullptr);
+    vkDestroyImage(vulkanHandles.device, depthAttachment.image, nullptr);
+    memoryTracker.vulkanFree(depthAttachment.deviceMemory);
+    destroyHiZPyramid(vulkanHandles, memoryTracker, hiZPyramid);
+    swapchainReferences.frameBuffers.clear();
+    swapchainReferences.imageViews.clear();
+    swapchainReferences.images.clear();
+}
+
+/*
+ * Positive decimal number that fits in 32 bits, false for anything else, signs and trailing characters included
+ */
+bool parsePositiveInteger(const std::string &text, uint32_t &value) {
+    if (text.empty() || text[0] < '0' || text[0] > '9') return false;
+    errno = 0;
+    char *end = nullptr;
+    unsigned long parsed = strtoul(text.c_str(), &end, 10);
+    if (errno == ERANGE || *end != '\0' || parsed == 0 || parsed > std::numeric_limits<uint32_t>::max()) return false;
+    value = (uint32_t) parsed;
+    return true;
+}
+
+/*
+ * Options: --present-mode=fifo|fifo-relaxed|mailbox|immediate --swapchain-images=N --latency-mode
+ * --benchmark-terrain-queries --benchmark-bitmap-kernels --benchmark-image-decoders --record-input=FILE
+ * --replay-input=FILE --heightmap=FILE (bmp, png, pgm, r16, r32 or vth, relative to src) --asset-pack=FILE
+ * --benchmark-heightmap-tiles --check-frame-allocations=N
+ */
+void parseArguments(int argc, char **argv, SwapchainSettings &swapchainSettings) {
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument == "--present-mode=fifo") swapchainSettings.preferredPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+        else if (argument == "--present-mode=fifo-relaxed") swapchainSettings.preferredPresentMode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+        else if (argument == "--present-mode=mailbox") swapchainSettings.preferredPresentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+        else if (argument == "--present-mode=immediate") swapchainSettings.preferredPresentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+        else if (argument.rfind("--swapchain-images=", 0) == 0) {
+            if (!parsePositiveInteger(argument.substr(19), swapchainSettings.imageCount)) {
+                std::cerr << "USAGE: --swapchain-images=N with N a positive integer, got " << argument.substr(19)
+                          << ", the surface minimum is used" << std::endl;
+            }
+        }
+        else if (argument.rfind("--check-frame-allocations=", 0) == 0) {
+            if (!parsePositiveInteger(argument.substr(26), checkFrameAllocations)) {
+                std::cerr << "USAGE: --check-frame-allocations=N with N a positive integer, got " << argument.substr(26)
+                          << ", the frames are not checked" << std::endl;
+            }
+        }
+        else if (argument == "--latency-mode") latencyMode = true;
+        else if (argument == "--benchmark-terrain-queries") benchmarkTerrainQueries = true;
+        else if (argument == "--benchmark-bitmap-kernels") benchmarkBitmapKernels = true;
+        else if (argument == "--benchmark-image-decoders") benchmarkImageDecoders = true;
+        else if (argument == "--benchmark-heightmap-tiles") benchmarkHeightmapTiles = true;
+        else if (argument.rfind("--heightmap=", 0) == 0) heightmapPath = argument.substr(12);
+        else if (argument.rfind("--asset-pack=", 0) == 0) assetPackPath = argument.substr(13);
+        else if (argument.rfind("--record-input=", 0) == 0) recordInputPath = argument.substr(15);
+        else if (argument.rfind("--replay-input=", 0) == 0) replayInputPath = argument.substr(15);
+        else std::cerr << "UNKNOWN ARGUMENT: " << argument << std::endl;
+    }
+}
+
 float round(float var) {
     float value = (int) (var * 100 + .5);
     return (float) value / 100;
 }
 
 std::vector<TerrainPatch>
-buildTerrainPatches(VulkanHandles vulkanHandles, PhysicalDeviceInfo physicalDeviceInfo, CommandBufferStructure transferStructure,
-                    int xAmount, int zAmount, glm::vec3 patchSize, glm::vec3 initialPosition, VkDescriptorSetLayout tessInfoLayout, VkDescriptorSetLayout mvpLayout, VkDescriptorPool descriptorPool) {
+buildTerrainPatches(const VulkanHandles &vulkanHandles, const PhysicalDeviceInfo &physicalDeviceInfo, DeviceMemoryTracker &memoryTracker,
+                    StagingManager &stagingManager, const CommandBufferStructure &transferStructure, int xAmount, int zAmount, glm::vec3 patchSize, glm::vec3 initialPosition, TerrainMesh &terrainMesh) {
     std::vector<TerrainPatch> patches;
-    std::vector<VkWriteDescriptorSet> descriptorWrites;
+    //Corners go counter clockwise from the one at the lowest x and z
+    std::vector<TerrainVertex> vertices = {{UNorm16x2::fromFloat(glm::vec2(0, 0))},
+                                           {UNorm16x2::fromFloat(glm::vec2(1, 0))},
+                                           {UNorm16x2::fromFloat(glm::vec2(1, 1))},
+                                           {UNorm16x2::fromFloat(glm::vec2(0, 1))}};
+    //Two triangle patches followed by one quad patch
+    std::vector<uint16_t> indices = {0, 1, 2, 0, 2, 3,
+                                     0, 1, 2, 3};
+    terrainMesh.domainRanges[TESSELLATION_DOMAIN_TRIANGLES] = {0, 6};
+    terrainMesh.domainRanges[TESSELLATION_DOMAIN_QUADS] = {6, 4};
 
-    Buffer stagingBuffer = allocateExclusiveBuffer(vulkanHandles, physicalDeviceInfo,
-                                                   sizeof(InputVertex) * 4,
-                                                   VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-    glm::vec3 totalSize = patchSize * glm::vec3(xAmount, 0, zAmount);
     glm::vec3 uvStep = glm::vec3(1.0, 1, 1.0) / glm::vec3(xAmount, 0, zAmount);
     for (int x = 0; x < xAmount; x++) {
         for (int z = 0; z < zAmount; z++) {
             TerrainPatch terrainPatch{};
             glm::vec3 patchSizeXZ = patchSize * glm::vec3(x, 0, z);
             glm::vec3 patchPosition = initialPosition + patchSizeXZ;
-            glm::vec3 leftBottom = glm::vec3(-0.5, 0, -0.5);
-            glm::vec3 rightTop = glm::vec3(0.5, 0, 0.5);
-            glm::vec3 rightBottom = glm::vec3(0.5, 0, -0.5);
-            glm::vec3 leftTop = glm::vec3(-0.5, 0, 0.5);
-
-            terrainPatch.vertices = {{leftBottom,  glm::vec2(round(uvStep.x * (x + 0)), round(uvStep.z * (z + 0)))},
-                                     {rightBottom, glm::vec2(round(uvStep.x * (x + 1)), round(uvStep.z * (z + 0)))},
-                                     {rightTop,    glm::vec2(round(uvStep.x * (x + 1)), round(uvStep.z * (z + 1)))},
-                                     {leftTop,     glm::vec2(round(uvStep.x * (x + 0)), round(uvStep.z * (z + 1)))}};
+
+            glm::vec2 uvMin(round(uvStep.x * (x + 0)), round(uvStep.z * (z + 0)));
+            glm::vec2 uvMax(round(uvStep.x * (x + 1)), round(uvStep.z * (z + 1)));
+            terrainPatch.patchData.uvOffset = uvMin;
+            terrainPatch.patchData.uvScale = uvMax - uvMin;
             std::cout << "PATCH{" << std::endl;
-            for (int i = 0; i < terrainPatch.vertices.size(); ++i) {
-                std::cout << "UV: " << terrainPatch.vertices[i].texCoord.x << " " << terrainPatch.vertices[i].texCoord.y << std::endl;
-            }
+            std::cout << "UV: " << uvMin.x << " " << uvMin.y << " TO " << uvMax.x << " " << uvMax.y << std::endl;
             std::cout << "}" << std::endl;
 
-            terrainPatch.indices = {0, 1, 2, 0, 2, 3};
-            terrainPatch.tessInfo.tessLevelInner = 4;
-            terrainPatch.tessInfo.tessLevelOuter = glm::vec3(1, 1, 1);
-            terrainPatch.mvp.model = {glm::vec4(patchSize.x, 0, 0, patchPosition.x),
-                                      glm::vec4(0, patchSize.y, 0, patchPosition.y),
-                                      glm::vec4(0, 0, patchSize.z, patchPosition.z),
-                                      glm::vec4(0, 0, 0, 1)};
-            terrainPatch.mvp.model = glm::transpose(terrainPatch.mvp.model);
+            terrainPatch.patchData.tessInfo.tessLevelInner = glm::vec2(4);
+            terrainPatch.patchData.tessInfo.tessLevelOuter = glm::vec4(1);
+            terrainPatch.patchData.model = {glm::vec4(patchSize.x, 0, 0, patchPosition.x),
+                                            glm::vec4(0, patchSize.y, 0, patchPosition.y),
+                                            glm::vec4(0, 0, patchSize.z, patchPosition.z),
+                                            glm::vec4(0, 0, 0, 1)};
+            terrainPatch.patchData.model = glm::transpose(terrainPatch.patchData.model);
 
-            vulkanMapMemoryWithFlush(vulkanHandles, stagingBuffer, terrainPatch.vertices.data());
+            //Every patch draws the whole shared quad, the index range follows the tessellation domain of the frame
+            terrainPatch.patchData.vertexOffset = 0;
 
+            patches.push_back(terrainPatch);
+        }
+    }
 
-            terrainPatch.vertexBuffer = allocateExclusiveBuffer(vulkanHandles, physicalDeviceInfo,
-                                                                sizeof(InputVertex) * terrainPatch.vertices.size(),
-                                                                VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-                                                                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                                                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    StagingAllocation vertexStaging = stagingManager.vulkanAllocate(sizeof(TerrainVertex) * vertices.size());
+    memcpy(vertexStaging.data, vertices.data(), vertexStaging.size);
+    StagingAllocation indexStaging = stagingManager.vulkanAllocate(sizeof(uint16_t) * indices.size());
+    memcpy(indexStaging.data, indices.data(), indexStaging.size);
+
+    terrainMesh.vertexBuffer = allocateExclusiveBuffer(vulkanHandles, memoryTracker,
+                                                       sizeof(TerrainVertex) * vertices.size(),
+                                                       VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                                                       VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_TAG_TERRAIN);
+    terrainMesh.indexBuffer = allocateExclusiveBuffer(vulkanHandles, memoryTracker,
+                                                      sizeof(uint16_t) * indices.size(),
+                                                      VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                                                      VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                                                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_TAG_TERRAIN);
+
+    //Both buffers in a single submit
+    BufferUpload meshUploads[2] = {{vertexStaging, terrainMesh.vertexBuffer, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT},
+                                   {indexStaging, terrainMesh.indexBuffer, VK_ACCESS_INDEX_READ_BIT}};
+    copyBufferHostDevice(vulkanHandles, physicalDeviceInfo, transferStructure, meshUploads, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                         physicalDeviceInfo.queueFamilyInfo.graphicsFamilyIndex);
+    stagingManager.vulkanSubmitted(transferStructure.bufferAvaibleFence);
 
-            copyBufferHostDevice(vulkanHandles, physicalDeviceInfo, transferStructure, stagingBuffer, terrainPatch.vertexBuffer,
-                                 VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-                                 physicalDeviceInfo.queueFamilyInfo.graphicsFamilyIndex);
+    return patches;
+}
 
-            terrainPatch.indexBuffer = allocateExclusiveBuffer(vulkanHandles, physicalDeviceInfo,
-                                                               sizeof(uint32_t) * terrainPatch.indices.size(),
-                                                               VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-                                                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+/*
+ * Sink of the heightmap decode. Rows are decoded a few at a time into a band that stays in cache, then the band is
+ * copied into a chunk of rows allocated from the staging manager and its heights into the plane of the height pyramid.
+ * A chunk is copied to the texture once full while the next one is filled, so an image larger than the staging
+ * memory goes up in pieces and neither a decoded copy of the image nor a staging buffer of its size ever exist.
+ * The band keeps the height extraction from reading back the write combined staging memory.
+ * Tiled heightfields write the heights themselves, so they get the staging rows of a whole band to decode into.
+ */
+class HeightmapUpload : public BitmapSink {
+public:
+    Texture2D texture{};
+    //Level 0 of the height pyramid, red channel of the rows
+    std::vector<float> heights;
+    uint32_t width = 0;
+    uint32_t height = 0;
+
+    HeightmapUpload(const VulkanHandles &vulkanHandles, DeviceMemoryTracker &memoryTracker,
+                    StagingManager &stagingManager, const CommandBufferStructure &transferStructure)
+            : vulkanHandles(vulkanHandles), memoryTracker(memoryTracker), stagingManager(stagingManager),
+              transferStructure(transferStructure) {}
+
+    void begin(uint32_t width, uint32_t height) override {
+        this->width = width;
+        this->height = height;
+        heights.resize((size_t) width * height);
+        texture = createTexture2D(vulkanHandles, memoryTracker, nullptr, {width, height},
+                                  VK_FORMAT_R32G32B32A32_SFLOAT,
+                                  VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                                  VK_IMAGE_ASPECT_COLOR_BIT, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_TAG_TEXTURES, VK_FALSE);
+
+        size_t rowBytes = (size_t) width * sizeof(glm::vec4);
+        chunkRows = (uint32_t) std::max<size_t>(std::min<size_t>(UPLOAD_CHUNK_BYTES / rowBytes, height), 1);
+        bandRows = (uint32_t) std::min<size_t>(std::max<size_t>(DECODE_BAND_BYTES / rowBytes, 1), chunkRows);
+        band.resize((size_t) bandRows * width);
+    }
 
-            vulkanMapMemoryWithFlush(vulkanHandles, terrainPatch.indexBuffer, terrainPatch.indices.data());
+    uint32_t acquireRows(uint32_t firstRow, uint32_t rowCount, glm::vec4 *&rows) override {
+        rows = band.data();
+        //A band never straddles two chunks
+        return std::min(std::min(rowCount, bandRows), chunkRows - chunkFill);
+    }
 
-            terrainPatch.mvpUniform = allocateExclusiveBuffer(vulkanHandles, physicalDeviceInfo, sizeof(MVP), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-            terrainPatch.mvpDescriptorSet = vulkanAllocateDescriptorSet(vulkanHandles, descriptorPool, mvpLayout);
+    uint32_t acquireHeightRows(uint32_t firstRow, uint32_t rowCount, glm::vec4 *&rows, float *&heights) override {
+        //The whole range becomes a chunk of its own, larger than a staging chunk it gets a temporary buffer
+        chunk = stagingManager.vulkanAllocate((VkDeviceSize) rowCount * width * sizeof(glm::vec4), sizeof(glm::vec4));
+        chunkDecoded = true;
+        rows = static_cast<glm::vec4 *>(chunk.data);
+        heights = this->heights.data() + (size_t) firstRow * width;
+        return rowCount;
+    }
 
-            VkDescriptorBufferInfo mvpBufferInfo{};
-            mvpBufferInfo.buffer = terrainPatch.mvpUniform.buffer;
-            mvpBufferInfo.range = terrainPatch.mvpUniform.size;
-            mvpBufferInfo.offset = 0;
+    void commitRows(uint32_t firstRow, uint32_t rowCount) override {
+        if (!chunkDecoded) {
+            size_t pixelCount = (size_t) rowCount * width;
+            if (chunkFill == 0) {
+                //The last chunk only takes the rows left
+                uint32_t rows = std::min(chunkRows, height - firstRow);
+                chunk = stagingManager.vulkanAllocate((VkDeviceSize) rows * width * sizeof(glm::vec4),
+                                                      sizeof(glm::vec4));
+            }
+            memcpy(static_cast<glm::vec4 *>(chunk.data) + (size_t) chunkFill * width, band.data(),
+                   pixelCount * sizeof(glm::vec4));
+            float *rowHeights = heights.data() + (size_t) firstRow * width;
+            for (size_t i = 0; i < pixelCount; ++i) {
+                rowHeights[i] = band[i].x;
+            }
+        }
+        chunkFill += rowCount;
+        if (!chunkDecoded && chunkFill < chunkRows && firstRow + rowCount < height) return;
+
+        //The staging memory is coherent, the chunk is given back once the copy signals the fence
+        copyBufferRowsToTexture(vulkanHandles, transferStructure, chunk, texture, firstRow + rowCount - chunkFill,
+                                chunkFill, textureLayout);
+        stagingManager.vulkanSubmitted(transferStructure.bufferAvaibleFence);
+        textureLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        chunk = StagingAllocation{};
+        chunkFill = 0;
+        chunkDecoded = false;
+    }
 
+    /*
+     * Waits for the last copy and releases the band, the texture is left in TRANSFER_DST_OPTIMAL
+     */
+    void finish() {
+        CommandBufferUtils::vulkanWaitForFences(vulkanHandles, {transferStructure.bufferAvaibleFence}, false);
+        band = std::vector<glm::vec4>();
+    }
 
-            descriptorWrites.push_back(vulkanGetWriteDescriptorSet(vulkanHandles, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, terrainPatch.mvpDescriptorSet, 0, &mvpBufferInfo, nullptr));
+private:
+    //Rows copied to the texture at once, half of a staging chunk so the next one can be filled during the copy
+    static const size_t UPLOAD_CHUNK_BYTES = 4 * 1024 * 1024;
+    static const size_t DECODE_BAND_BYTES = 64 * 1024;
+
+    const VulkanHandles &vulkanHandles;
+    DeviceMemoryTracker &memoryTracker;
+    StagingManager &stagingManager;
+    const CommandBufferStructure &transferStructure;
+    StagingAllocation chunk{};
+    std::vector<glm::vec4> band;
+    uint32_t bandRows = 0;
+    uint32_t chunkRows = 0;
+    //Rows of the current chunk already written
+    uint32_t chunkFill = 0;
+    //The chunk was handed out by acquireHeightRows and holds the rows and heights of one commit
+    bool chunkDecoded = false;
+    VkImageLayout textureLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+};
 
-            terrainPatch.tessInfoUniform = allocateExclusiveBuffer(vulkanHandles, physicalDeviceInfo, sizeof(TessInfo), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-            terrainPatch.tessInfoDescriptorSet = vulkanAllocateDescriptorSet(vulkanHandles, descriptorPool, tessInfoLayout);
+/*
+ * Throughput of the CPU terrain queries over random points of the terrain, printed as millions per second
+ */
+void runTerrainQueryBenchmark(const TerrainHeightField &heightField, glm::vec3 origin, glm::vec3 size) {
+    const size_t queryCount = 1 << 20;
+    const size_t rayCount = 1 << 16;
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<glm::vec2> uvs(queryCount), positions(queryCount);
+    for (size_t i = 0; i < queryCount; ++i) {
+        uvs[i] = glm::vec2(unit(random), unit(random));
+        positions[i] = glm::vec2(origin.x, origin.z) + uvs[i] * glm::vec2(size.x, size.z);
+    }
+    std::vector<float> heights(queryCount);
+    //Accumulated so the queries cannot be optimized away
+    double checksum = 0;
+    auto rate = [](size_t count, std::chrono::steady_clock::time_point start) {
+        return count / FrameProfiler::milliseconds(start, std::chrono::steady_clock::now()) / 1000.0;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    heightField.sampleHeights(uvs.data(), heights.data(), queryCount);
+    double batchedRate = rate(queryCount, start);
+    for (float height : heights) checksum += height;
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < queryCount; ++i) checksum += heightField.heightAt(positions[i]);
+    double scalarRate = rate(queryCount, start);
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < queryCount; ++i) checksum += heightField.normalAt(positions[i]).y;
+    double normalRate = rate(queryCount, start);
+
+    //Rays from above the terrain towards random points of it, most of them hit
+    uint32_t hits = 0;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < rayCount; ++i) {
+        glm::vec3 rayOrigin(positions[i].x, origin.y + size.y * 2, positions[i].y);
+        glm::vec3 target(positions[rayCount + i].x, origin.y, positions[rayCount + i].y);
+        TerrainRayHit hit{};
+        if (heightField.raycast(rayOrigin, glm::normalize(target - rayOrigin), INFINITY, hit)) {
+            checksum += hit.distance;
+            hits++;
+        }
+    }
+    double rayRate = rate(rayCount, start);
 
-            VkDescriptorBufferInfo tessInfoBufferInfo{};
-            tessInfoBufferInfo.buffer = terrainPatch.tessInfoUniform.buffer;
-            tessInfoBufferInfo.range = terrainPatch.tessInfoUniform.size;
-            tessInfoBufferInfo.offset = 0;
-            descriptorWrites.push_back(vulkanGetWriteDescriptorSet(vulkanHandles, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                                                                   terrainPatch.tessInfoDescriptorSet, 0, &tessInfoBufferInfo, nullptr));
-            vkUpdateDescriptorSets(vulkanHandles.device, descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
-            descriptorWrites.clear();
-            patches.push_back(terrainPatch);
+    std::cout << "TERRAIN QUERIES (M/s): batched heights " << batchedRate << " single heights " << scalarRate
+              << " normals " << normalRate << " raycasts " << rayRate << " (" << hits << "/" << rayCount << " hit)"
+              << " CHECKSUM: " << checksum << std::endl;
+}
+
+/*
+ * Time of the Bitmap transforms on an 8K image, on the calling thread and split across the pool.
+ * The float image is 530MB, the rotation only runs on the packed one and is cropped to the source size.
+ */
+void runBitmapKernelBenchmark(ThreadPool &threadPool) {
+    const uint32_t width = 7680, height = 4320;
+    std::vector<glm::vec4> floatImage((size_t) width * height);
+    for (uint32_t l = 0; l < height; ++l) {
+        for (uint32_t c = 0; c < width; ++c) {
+            floatImage[(size_t) l * width + c] = glm::vec4((float) c / width, (float) l / height, 0.5f, 1.0f);
         }
     }
+    std::vector<uint32_t> packedImage(floatImage.size());
+    std::vector<uint32_t> packedDestination(floatImage.size());
+
+    auto measure = [&](const char *name, const std::function<void(ThreadPool *)> &kernel) {
+        auto start = std::chrono::steady_clock::now();
+        kernel(nullptr);
+        double singleThread = FrameProfiler::milliseconds(start, std::chrono::steady_clock::now());
+        start = std::chrono::steady_clock::now();
+        kernel(&threadPool);
+        double pool = FrameProfiler::milliseconds(start, std::chrono::steady_clock::now());
+        std::cout << "    " << name << ": " << singleThread << "ms, " << pool << "ms on " << threadPool.getThreadCount() + 1
+                  << " threads (" << width * (double) height / pool / 1000.0 << " Mpixels/s)" << std::endl;
+    };
+    std::cout << "BITMAP KERNELS " << width << "x" << height << ":" << std::endl;
+    measure("pack RGBA8", [&](ThreadPool *pool) {
+        BitmapKernels::packRGBA8(floatImage.data(), packedImage.data(), width, height, pool);
+    });
+    measure("flip X float", [&](ThreadPool *pool) { BitmapKernels::flipX(floatImage.data(), width, height, pool); });
+    measure("flip Y float", [&](ThreadPool *pool) { BitmapKernels::flipY(floatImage.data(), width, height, pool); });
+    measure("grayscale float", [&](ThreadPool *pool) { BitmapKernels::grayscale(floatImage.data(), width, height, pool); });
+    measure("flip X RGBA8", [&](ThreadPool *pool) { BitmapKernels::flipX(packedImage.data(), width, height, pool); });
+    measure("flip Y RGBA8", [&](ThreadPool *pool) { BitmapKernels::flipY(packedImage.data(), width, height, pool); });
+    measure("grayscale RGBA8", [&](ThreadPool *pool) { BitmapKernels::grayscale(packedImage.data(), width, height, pool); });
+    measure("scale x0.5 RGBA8", [&](ThreadPool *pool) {
+        BitmapKernels::scaleNearest(packedImage.data(), width, height, packedDestination.data(), width / 2, height / 2, pool);
+    });
+    measure("rotate 30 degrees RGBA8", [&](ThreadPool *pool) {
+        BitmapKernels::rotateNearest(packedImage.data(), width, height, packedDestination.data(), width, height,
+                                     glm::radians(30.0f), 0xFF000000u, pool);
+    });
+}
 
-    return patches;
+//Takes the rows in bands and only keeps a checksum
+class ChecksumSink : public BitmapSink {
+public:
+    double checksum = 0;
+    uint64_t pixels = 0;
+
+    void begin(uint32_t width, uint32_t height) override {
+        this->width = width;
+        band.resize((size_t) width * 16);
+    }
+
+    uint32_t acquireRows(uint32_t firstRow, uint32_t rowCount, glm::vec4 *&rows) override {
+        rows = band.data();
+        return std::min(rowCount, 16u);
+    }
+
+    //Whole bands like the heightmap upload, so tiles are not decompressed again for every 16 rows
+    uint32_t acquireHeightRows(uint32_t firstRow, uint32_t rowCount, glm::vec4 *&rows, float *&heights) override {
+        if (band.size() < (size_t) rowCount * width) band.resize((size_t) rowCount * width);
+        rows = band.data();
+        heights = nullptr;
+        return rowCount;
+    }
+
+    void commitRows(uint32_t firstRow, uint32_t rowCount) override {
+        checksum += band[0].x;
+        pixels += (uint64_t) rowCount * width;
+    }
+
+private:
+    uint32_t width = 0;
+    std::vector<glm::vec4> band;
+};
+
+/*
+ * Decode throughput of every heightmap format on a generated 4096x4096 16 bit field, plus the configured heightmap.
+ * The PNG is written with stored deflate blocks, it measures the chunk, unfilter and conversion work but not the
+ * Huffman decoding of a compressed file.
+ */
+void runImageDecoderBenchmark(const ImageDecoderRegistry &imageDecoders) {
+    const uint32_t side = 4096;
+    std::vector<uint16_t> heights((size_t) side * side);
+    for (uint32_t y = 0; y < side; ++y) {
+        for (uint32_t x = 0; x < side; ++x) {
+            heights[(size_t) y * side + x] = (uint16_t) (32767 + 16000 * std::sin(x * 0.01f) * std::cos(y * 0.013f));
+        }
+    }
+    auto bigEndian = [](std::vector<uint8_t> &bytes, uint32_t value, int byteCount) {
+        for (int i = byteCount - 1; i >= 0; --i) bytes.push_back((uint8_t) (value >> (8 * i)));
+    };
+
+    std::string header = "P5 " + std::to_string(side) + " " + std::to_string(side) + " 65535\n";
+    std::vector<uint8_t> pgm(header.begin(), header.end());
+    std::vector<uint8_t> raw16(heights.size() * 2);
+    std::vector<uint8_t> raw32(heights.size() * 4);
+    //Every row with the Up filter, the first one against zeros
+    std::vector<uint8_t> scanlines;
+    for (size_t i = 0; i < heights.size(); ++i) {
+        if (i % side == 0) scanlines.push_back(2);
+        bigEndian(pgm, heights[i], 2);
+        raw16[2 * i] = (uint8_t) heights[i];
+        raw16[2 * i + 1] = (uint8_t) (heights[i] >> 8);
+        float value = heights[i] / 65535.0f;
+        memcpy(&raw32[4 * i], &value, sizeof(float));
+        uint16_t up = i >= side ? heights[i - side] : 0;
+        bigEndian(scanlines, (uint16_t) (heights[i] - up), 2);
+    }
+    std::vector<uint8_t> zlib = {0x78, 0x01};
+    for (size_t offset = 0; offset < scanlines.size(); offset += 65535) {
+        uint32_t length = (uint32_t) std::min<size_t>(65535, scanlines.size() - offset);
+        zlib.push_back(offset + length == scanlines.size() ? 1 : 0);
+        zlib.push_back((uint8_t) length);
+        zlib.push_back((uint8_t) (length >> 8));
+        zlib.push_back((uint8_t) ~length);
+        zlib.push_back((uint8_t) (~length >> 8));
+        zlib.insert(zlib.end(), scanlines.begin() + offset, scanlines.begin() + offset + length);
+    }
+    bigEndian(zlib, Inflate::adler32(scanlines.data(), scanlines.size()), 4);
+    //Chunk CRCs are left at zero, the decoder does not read them
+    std::vector<uint8_t> png = {137, 80, 78, 71, 13, 10, 26, 10};
+    auto pngChunk = [&](const char *type, const uint8_t *data, uint32_t size) {
+        bigEndian(png, size, 4);
+        png.insert(png.end(), type, type + 4);
+        png.insert(png.end(), data, data + size);
+        bigEndian(png, 0, 4);
+    };
+    std::vector<uint8_t> pngHeader;
+    bigEndian(pngHeader, side, 4);
+    bigEndian(pngHeader, side, 4);
+    pngHeader.insert(pngHeader.end(), {16, 0, 0, 0, 0});
+    pngChunk("IHDR", pngHeader.data(), (uint32_t) pngHeader.size());
+    pngChunk("IDAT", zlib.data(), (uint32_t) zlib.size());
+    pngChunk("IEND", nullptr, 0);
+
+    auto measure = [](const char *name, const std::function<bool(BitmapSink &)> &decode) {
+        ChecksumSink sink;
+        auto start = std::chrono::steady_clock::now();
+        bool decoded = decode(sink);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "IMAGE DECODE " << name << ": ";
+        if (!decoded) {
+            std::cout << "FAILED" << std::endl;
+            return;
+        }
+        std::cout << sink.pixels / seconds / 1e6 << " Mpixel/s (" << seconds * 1000.0 << " ms) CHECKSUM: "
+                  << sink.checksum << std::endl;
+    };
+    measure("PNG 16 bit", [&](BitmapSink &sink) { return ImageDecoders::decodePNG(png.data(), png.size(), sink); });
+    measure("PGM 16 bit", [&](BitmapSink &sink) { return ImageDecoders::decodePGM(pgm.data(), pgm.size(), sink); });
+    measure("R16", [&](BitmapSink &sink) { return ImageDecoders::decodeRaw16(raw16.data(), raw16.size(), sink); });
+    measure("R32", [&](BitmapSink &sink) { return ImageDecoders::decodeRaw32(raw32.data(), raw32.size(), sink); });
+    measure(heightmapPath.c_str(), [&](BitmapSink &sink) {
+        return imageDecoders.decode(FileLoader::getPath(heightmapPath), sink);
+    });
+}
+
+/*
+ * Load time of a 4096x4096 heightfield with raw, LZ4 and Zstd tiles, mapping and decoding the file on the pool.
+ * Cold loads evict the file from the page cache first, where the platform allows it.
+ */
+void runHeightmapTileBenchmark(ThreadPool &threadPool) {
+    const uint32_t side = 4096;
+    std::vector<float> heights((size_t) side * side);
+    //A few octaves, so the tiles compress like terrain and not like a single wave
+    for (uint32_t y = 0; y < side; ++y) {
+        for (uint32_t x = 0; x < side; ++x) {
+            heights[(size_t) y * side + x] = 0.5f + 0.25f * std::sin(x * 0.01f) * std::cos(y * 0.013f) +
+                                             0.1f * std::sin(x * 0.071f + y * 0.053f) +
+                                             0.02f * std::sin(x * 0.53f) * std::cos(y * 0.61f);
+        }
+    }
+    const std::string path = "heightmapTileBenchmark.vth";
+    auto load = [&](ChecksumSink &sink) {
+        auto start = std::chrono::steady_clock::now();
+        MappedFile file;
+        bool decoded = file.open(path) && TiledHeightfield::decode(file.data(), file.size(), sink, &threadPool);
+        return decoded ? FrameProfiler::milliseconds(start, std::chrono::steady_clock::now()) : -1.0;
+    };
+    std::pair<const char *, TiledHeightfield::Codec> codecs[] = {{"raw", TiledHeightfield::CODEC_RAW},
+                                                                 {"LZ4", TiledHeightfield::CODEC_LZ4},
+                                                                 {"Zstd", TiledHeightfield::CODEC_ZSTD}};
+    for (auto &codec : codecs) {
+        std::cout << "HEIGHTMAP TILES " << codec.first << ": ";
+        if (!TiledHeightfield::codecSupported(codec.second)) {
+            std::cout << "NOT AVAILABLE" << std::endl;
+            continue;
+        }
+        if (!TiledHeightfield::write(path, heights.data(), side, side, TiledHeightfield::UNORM16, codec.second,
+                                     TiledHeightfield::DEFAULT_TILE_SIZE, 9, &threadPool)) {
+            std::cout << "CANNOT WRITE " << path << std::endl;
+            continue;
+        }
+        MappedFile file;
+        file.open(path);
+        double megabytes = file.size() / (1024.0 * 1024.0);
+        file.close();
+        ChecksumSink sink;
+        bool cold = MappedFile::dropCachedPages(path);
+        double coldMilliseconds = load(sink);
+        double warmMilliseconds = std::numeric_limits<double>::max();
+        for (int i = 0; i < 3; ++i) {
+            ChecksumSink warmSink;
+            warmMilliseconds = std::min(warmMilliseconds, load(warmSink));
+        }
+        std::cout << megabytes << " MB, cold " << (cold ? std::to_string(coldMilliseconds) + " ms" : "n/a")
+                  << ", warm " << warmMilliseconds << " ms CHECKSUM: " << sink.checksum << std::endl;
+    }
+    std::remove(path.c_str());
+}
+
+/*
+ * World space box of a patch, the unit quad displaced by its height bounds and moved by its model matrix
+ */
+void computePatchBounds(PatchData &patchData, glm::vec2 heightBounds) {
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+    for (int corner = 0; corner < 8; ++corner) {
+        glm::vec4 localCorner((corner & 1) ? 0.5f : -0.5f, (corner & 2) ? heightBounds.y : heightBounds.x,
+                              (corner & 4) ? 0.5f : -0.5f, 1.0f);
+        glm::vec3 worldCorner = glm::vec3(patchData.model * localCorner);
+        boundsMin = glm::min(boundsMin, worldCorner);
+        boundsMax = glm::max(boundsMax, worldCorner);
+    }
+    patchData.boundsMin = glm::vec4(boundsMin, 1);
+    patchData.boundsMax = glm::vec4(boundsMax, 1);
 }
 
-int main() {
+/*
+ * Planes of the view frustum pointing inwards, extracted from the rows of the combined matrix
+ */
+void extractFrustumPlanes(const glm::mat4 &viewProjection, glm::vec4 planes[6]) {
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; ++i) {
+        rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+    }
+    planes[0] = rows[3] + rows[0];
+    planes[1] = rows[3] - rows[0];
+    planes[2] = rows[3] + rows[1];
+    planes[3] = rows[3] - rows[1];
+    planes[4] = rows[3] + rows[2];
+    planes[5] = rows[3] - rows[2];
+    for (int i = 0; i < 6; ++i) {
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+    }
+}
+
+int main(int argc, char **argv) {
+    StartupTimeline startupTimeline;
+    ThreadPool threadPool;
+    parseArguments(argc, argv, vulkanSetup.swapchainSettings);
+    if (checkFrameAllocations > 0 && !AllocationCounter::enabled()) {
+        std::cerr << "--check-frame-allocations NEEDS A BUILD CONFIGURED WITH COUNT_ALLOCATIONS" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (benchmarkBitmapKernels) {
+        runBitmapKernelBenchmark(threadPool);
+    }
+    ImageDecoderRegistry imageDecoders;
+    //Tiled heightfields decompress their tiles on the workers
+    imageDecoders.registerDecoder("vth", [&threadPool](const uint8_t *data, size_t size, BitmapSink &sink) {
+        return TiledHeightfield::decode(data, size, sink, &threadPool);
+    });
+    if (benchmarkImageDecoders) {
+        runImageDecoderBenchmark(imageDecoders);
+    }
+    if (benchmarkHeightmapTiles) {
+        runHeightmapTileBenchmark(threadPool);
+    }
+
+    //Loose files from the source tree, an asset pack replaces the ones it contains
+    VirtualFileSystem fileSystem(threadPool);
+    fileSystem.mountDirectory("", FileLoader::getPath(""));
+    fileSystem.mountDirectory("Shaders", SHADER_DIRECTORY);
+    if (!assetPackPath.empty() && !fileSystem.mountArchive("", assetPackPath)) {
+        throw std::runtime_error("CANNOT MOUNT ASSET PACK: " + assetPackPath);
+    }
+
+    //Startup task graph: file reads do not need the device, so they run on the workers while the instance, device
+    //and swapchain are created. The pipelines wait on the shader bytes and are compiled concurrently while the main
+    //thread streams the heightmap to the GPU and builds the patches.
+    ShaderLibrary shaderLibrary(SHADER_DIRECTORY, threadPool);
+    shaderLibrary.registerShader("vert", "VertexShader.vert", "vert.spv");
+    shaderLibrary.registerShader("frag", "FragmentShader.frag", "frag.spv");
+    shaderLibrary.registerShader("tessControl", "tessControlShader.tesc", "tessControl.spv");
+    shaderLibrary.registerShader("tessEval", "tessEvaluationShader.tese", "tessEval.spv");
+    shaderLibrary.registerShader("tessEvalBindless", "tessEvaluationShaderBindless.tese", "tessEvalBindless.spv");
+    shaderLibrary.registerShader("tessControlQuad", "tessControlQuad.tesc", "tessControlQuad.spv");
+    shaderLibrary.registerShader("tessEvalQuad", "tessEvaluationQuad.tese", "tessEvalQuad.spv");
+    shaderLibrary.registerShader("tessEvalQuadBindless", "tessEvaluationQuadBindless.tese", "tessEvalQuadBindless.spv");
+    shaderLibrary.registerShader("geometry", "geometry.geom", "geometry.spv");
+    shaderLibrary.registerShader("cullPatches", "cullPatches.comp", "cullPatches.spv");
+    shaderLibrary.registerShader("hiZReduce", "hiZReduce.comp", "hiZReduce.spv");
+    auto shaderBinariesFuture = threadPool.submit([&]() {
+        startupTimeline.measure("read SPIR-V", [&]() { shaderLibrary.loadBinaries(fileSystem, "Shaders"); });
+    });
+    std::future<FileData> heightmapFileFuture = fileSystem.readAsync(heightmapPath);
     glfwInit();
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
     GLFWwindow *window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan HelloTriangle", nullptr, nullptr);
     glfwSetKeyCallback(window, keyboard);
     glfwSetMouseButtonCallback(window, mouseButton);
     glfwSetCursorPosCallback(window, mouseMovement);
+    glfwSetFramebufferSizeCallback(window, framebufferResize);
     VulkanHandles vulkanHandles{};
     PhysicalDeviceInfo physicalDeviceInfo;
     PresentationEngineInfo presentationEngineInfo;
@@ -508,40 +1374,37 @@ int main() {
     VkSemaphore getImageSemaphore{}, presentImageSemaphore{};
     VkQueue graphicsQueue, presentationQueue, transferQueue;
 
-    VulkanSetup vulkanSetup;
-    vulkanSetup.vulkanSetup(window, vulkanHandles, physicalDeviceInfo, presentationEngineInfo);
+    startupTimeline.measure("vulkan setup", [&]() {
+        vulkanSetup.vulkanSetup(window, vulkanHandles, physicalDeviceInfo, presentationEngineInfo);
+    });
+    DeviceContext deviceContext(vulkanHandles, physicalDeviceInfo);
+    DeviceMemoryTracker memoryTracker(deviceContext);
     maxTesselationLevel = physicalDeviceInfo.physicalDeviceProperties.limits.maxTessellationGenerationLevel;
     vkGraphicsPool = CommandBufferUtils::vulkanCreateCommandPool(vulkanHandles,
                                                                  physicalDeviceInfo.queueFamilyInfo.graphicsFamilyIndex);
     vkTransferPool = CommandBufferUtils::vulkanCreateCommandPool(vulkanHandles,
                                                                  physicalDeviceInfo.queueFamilyInfo.transferFamilyIndex);
-    swapchainReferences.images = vulkanGetSwapchainImages(vulkanHandles, presentationEngineInfo);
-    swapchainReferences.imageViews = vulkanCreateSwapchainImageViews(vulkanHandles, presentationEngineInfo,
-                                                                     swapchainReferences.images);
-
-    VkImage depthMap = vulkanCreateImage2D(vulkanHandles, {WIDTH, HEIGHT}, VK_FORMAT_D32_SFLOAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
-    VkMemoryRequirements depthMapRequirement = vulkanGetImageMemoryRequirements(vulkanHandles, depthMap);
-    VkDeviceMemory depthMapMemory = vulkanAllocateDeviceMemory(vulkanHandles, physicalDeviceInfo, depthMapRequirement, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    VK_ASSERT(vkBindImageMemory(vulkanHandles.device, depthMap, depthMapMemory, 0));
-    VkImageView depthMapImageView = vulkanCreateImageView2D(vulkanHandles, depthMap, VK_FORMAT_D32_SFLOAT, VK_IMAGE_ASPECT_DEPTH_BIT);
-    VkRenderPass renderPass = vulkanCreateRenderPass(vulkanHandles, presentationEngineInfo);
-
-    auto vert = vulkanLoadShader("../src/Shaders/vert.spv");
-    auto frag = vulkanLoadShader("../src/Shaders/frag.spv");
-    auto tessControl = vulkanLoadShader("../src/Shaders/tessControl.spv");
-    auto tessEval = vulkanLoadShader("../src/Shaders/tessEval.spv");
-    auto geometry = vulkanLoadShader("../src/Shaders/geometry.spv");
-    auto vertModule = vulkanCreateShaderModule(vulkanHandles, vert);
-    auto fragModule = vulkanCreateShaderModule(vulkanHandles, frag);
-    auto tessModule = vulkanCreateShaderModule(vulkanHandles, tessControl);
-    auto tessEvalModule = vulkanCreateShaderModule(vulkanHandles, tessEval);
-    auto geometryModule = vulkanCreateShaderModule(vulkanHandles, geometry);
-
-    VkDescriptorPool descriptorPool = vulkanAllocateDescriptorPool(vulkanHandles,
-                                                                   {vulkanAllocateDescriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 24),
-                                                                    vulkanAllocateDescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 24)},
-                                                                   24);
+    VkRenderPass renderPass = vulkanCreateRenderPass(vulkanHandles, presentationEngineInfo, FRAME_PASS_FIRST);
+    VkRenderPass resumeRenderPass = vulkanCreateRenderPass(vulkanHandles, presentationEngineInfo, FRAME_PASS_RESUME);
+    VkRenderPass singleRenderPass = vulkanCreateRenderPass(vulkanHandles, presentationEngineInfo, FRAME_PASS_SINGLE);
+    DepthAttachment depthAttachment{};
+    HiZPyramid hiZPyramid{};
+    createSwapchainResources(vulkanHandles, memoryTracker, presentationEngineInfo, renderPass, swapchainReferences, depthAttachment, hiZPyramid);
+
+    //The bindless evaluation shader reads the heightmap from the texture table instead of set 0
+    bool bindlessEnabled = physicalDeviceInfo.bindlessSupported;
+    startupTimeline.measure("wait SPIR-V", [&]() { shaderBinariesFuture.get(); });
+    shaderLibrary.vulkanCreateModules(vulkanHandles.device);
+    std::string tessEvalName = bindlessEnabled ? "tessEvalBindless" : "tessEval";
+    std::string tessEvalQuadName = bindlessEnabled ? "tessEvalQuadBindless" : "tessEvalQuad";
 
+    int renderFramesAmount = 2;
+    DescriptorAllocator descriptorAllocator;
+    descriptorAllocator.vulkanInit(vulkanHandles.device, renderFramesAmount);
+    DescriptorCache descriptorCache(descriptorAllocator);
+    DeletionQueue deletionQueue(deviceContext, memoryTracker, renderFramesAmount);
+    //Every upload is staged in these chunks, allocated once
+    StagingManager stagingManager(deviceContext, memoryTracker, 8 * 1024 * 1024, 3);
 
     VkDescriptorSetLayout vkDescriptorSetLayout0 = vulkanCreateDescriptorSetLayout(vulkanHandles,
                                                                                    {
@@ -549,11 +1412,15 @@ int main() {
                                                                                                                                   VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT),
                                                                                            vulkanCreateDescriptorSetLayoutBinding(1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT)});
     VkDescriptorSetLayout vkDescriptorSetLayout1 = vulkanCreateDescriptorSetLayout(vulkanHandles,
-                                                                                   {vulkanCreateDescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_GEOMETRY_BIT)});
-    VkDescriptorSetLayout vkDescriptorSetLayout2 = vulkanCreateDescriptorSetLayout(vulkanHandles,
-                                                                                   {vulkanCreateDescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT)});
-
-    std::vector<VkDescriptorSetLayout> descriptorSetLayouts = {vkDescriptorSetLayout0, vkDescriptorSetLayout1, vkDescriptorSetLayout2};
+                                                                                   {vulkanCreateDescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_GEOMETRY_BIT),
+                                                                                    vulkanCreateDescriptorSetLayoutBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, PATCH_DATA_STAGES)});
+
+    BindlessTextureTable bindlessTextureTable;
+    std::vector<VkDescriptorSetLayout> descriptorSetLayouts = {vkDescriptorSetLayout0, vkDescriptorSetLayout1};
+    if (bindlessEnabled) {
+        bindlessTextureTable.vulkanInit(vulkanHandles.device, VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
+        descriptorSetLayouts.push_back(bindlessTextureTable.layout);
+    }
     VkPipelineLayoutCreateInfo vkPipelineLayoutCreateInfo{};
     vkPipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     vkPipelineLayoutCreateInfo.setLayoutCount = descriptorSetLayouts.size();
@@ -564,12 +1431,105 @@ int main() {
     VkPipelineLayout vkPipelineLayout;
     VK_ASSERT(vkCreatePipelineLayout(vulkanHandles.device, &vkPipelineLayoutCreateInfo, nullptr, &vkPipelineLayout));
 
-    shadedPipeline = vulkanCreatePipeline(vulkanHandles, presentationEngineInfo,
-                                          vkPipelineLayout, renderPass, VK_POLYGON_MODE_FILL, vertModule, fragModule, tessModule, tessEvalModule, geometryModule);
+    //Culling pass: patch data and Hi-Z in, draw commands, their counts and the statistics out
+    VkDescriptorSetLayout cullDescriptorSetLayout = vulkanCreateDescriptorSetLayout(vulkanHandles,
+                                                                                    {vulkanCreateDescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT),
+                                                                                     vulkanCreateDescriptorSetLayoutBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT),
+                                                                                     vulkanCreateDescriptorSetLayoutBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT),
+                                                                                     vulkanCreateDescriptorSetLayoutBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT),
+                                                                                     vulkanCreateDescriptorSetLayoutBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT),
+                                                                                     vulkanCreateDescriptorSetLayoutBinding(5, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT),
+                                                                                     vulkanCreateDescriptorSetLayoutBinding(6, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT)});
+    VkPushConstantRange cullPhaseRange{};
+    cullPhaseRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    cullPhaseRange.offset = 0;
+    cullPhaseRange.size = sizeof(uint32_t);
+
+    VkPipelineLayoutCreateInfo cullPipelineLayoutCreateInfo{};
+    cullPipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    cullPipelineLayoutCreateInfo.setLayoutCount = 1;
+    cullPipelineLayoutCreateInfo.pSetLayouts = &cullDescriptorSetLayout;
+    cullPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+    cullPipelineLayoutCreateInfo.pPushConstantRanges = &cullPhaseRange;
+
+    VkPipelineLayout cullPipelineLayout;
+    VK_ASSERT(vkCreatePipelineLayout(vulkanHandles.device, &cullPipelineLayoutCreateInfo, nullptr, &cullPipelineLayout));
+
+    //Hi-Z reduction: one level in, the next one out
+    VkDescriptorSetLayout hiZDescriptorSetLayout = vulkanCreateDescriptorSetLayout(vulkanHandles,
+                                                                                   {vulkanCreateDescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT),
+                                                                                    vulkanCreateDescriptorSetLayoutBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT)});
+    VkPipelineLayoutCreateInfo hiZPipelineLayoutCreateInfo{};
+    hiZPipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    hiZPipelineLayoutCreateInfo.setLayoutCount = 1;
+    hiZPipelineLayoutCreateInfo.pSetLayouts = &hiZDescriptorSetLayout;
+
+    VkPipelineLayout hiZPipelineLayout;
+    VK_ASSERT(vkCreatePipelineLayout(vulkanHandles.device, &hiZPipelineLayoutCreateInfo, nullptr, &hiZPipelineLayout));
+    //Depth is not filterable on every device, the reduction and the culling only use texelFetch anyway
+    VkSampler hiZSampler = vulkanCreateSampler2D(vulkanHandles, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_FALSE, VK_FILTER_NEAREST);
+
+    //The patch index reaches the shaders as the first instance of each indirect command, which needs
+    //drawIndirectFirstInstance, and one indirect call draws every patch, which needs multiDrawIndirect
+    VkPhysicalDeviceFeatures &deviceFeatures = physicalDeviceInfo.physicalDeviceFeatures;
+    CullingMode supportedCullingMode = CULLING_NONE;
+    if (deviceFeatures.multiDrawIndirect == VK_TRUE && deviceFeatures.drawIndirectFirstInstance == VK_TRUE) {
+        supportedCullingMode = physicalDeviceInfo.drawIndirectCountSupported ? CULLING_GPU_COMPACT : CULLING_GPU;
+    }
 
-    wirePipeline = vulkanCreatePipeline(vulkanHandles, presentationEngineInfo,
-                                        vkPipelineLayout, renderPass, VK_POLYGON_MODE_LINE, vertModule, fragModule, tessModule, tessEvalModule, geometryModule);
-    activePipeline = shadedPipeline;
+    //The library rebuilds these pipelines on its own when one of their shaders is edited.
+    //The map owns the handles the library writes to, its references stay valid when it grows.
+    std::unordered_map<uint64_t, VkPipeline> terrainPipelines;
+    auto registerTerrainVariant = [&](const TerrainVariant &variant) {
+        bool quads = variant.domain == TESSELLATION_DOMAIN_QUADS;
+        std::string tessControl = quads ? "tessControlQuad" : "tessControl";
+        std::string tessEval = quads ? tessEvalQuadName : tessEvalName;
+        uint32_t patchControlPoints = quads ? 4 : 3;
+        std::vector<std::string> terrainShaders = {"vert", "frag", tessControl, tessEval, "geometry"};
+        return shaderLibrary.registerPipeline(&terrainPipelines[variant.key()], terrainShaders,
+                                              [vulkanHandles, vkPipelineLayout, renderPass, tessControl, tessEval, patchControlPoints,
+                                                      variant](const ShaderLibrary::ModuleLookup &module) {
+                                                  TerrainSpecialization specialization = variant.specialization();
+                                                  PipelineSpecialization stages{};
+                                                  stages.tessellationControl = specialization.info();
+                                                  stages.tessellationEvaluation = specialization.info();
+                                                  stages.geometry = specialization.info();
+                                                  stages.fragment = specialization.info();
+                                                  return vulkanCreatePipeline(vulkanHandles, vkPipelineLayout, renderPass, variant.polygonMode,
+                                                                              module("vert"), module("frag"), module(tessControl),
+                                                                              module(tessEval), module("geometry"), stages, patchControlPoints);
+                                              });
+    };
+    terrainVariant.maxTessellation = maxTesselationLevel;
+    TerrainVariant wireVariant = terrainVariant;
+    wireVariant.polygonMode = VK_POLYGON_MODE_LINE;
+    uint32_t shadedPipelineId = registerTerrainVariant(terrainVariant);
+    uint32_t wirePipelineId = registerTerrainVariant(wireVariant);
+
+    //Pipeline creation is thread safe on the device, both default variants are compiled on the workers.
+    //Other variants are compiled the first time they are selected.
+    auto shadedPipelineFuture = threadPool.submit([&]() {
+        return startupTimeline.measure("shaded pipeline", [&]() { return shaderLibrary.vulkanBuildPipeline(shadedPipelineId); });
+    });
+    auto wirePipelineFuture = threadPool.submit([&]() {
+        return startupTimeline.measure("wire pipeline", [&]() { return shaderLibrary.vulkanBuildPipeline(wirePipelineId); });
+    });
+    VkPipeline cullPipeline = VK_NULL_HANDLE;
+    uint32_t cullPipelineId = shaderLibrary.registerPipeline(&cullPipeline, {"cullPatches"},
+                                                             [vulkanHandles, cullPipelineLayout](const ShaderLibrary::ModuleLookup &module) {
+                                                                 return vulkanCreateComputePipeline(vulkanHandles, cullPipelineLayout, module("cullPatches"));
+                                                             });
+    auto cullPipelineFuture = threadPool.submit([&]() {
+        return startupTimeline.measure("cull pipeline", [&]() { return shaderLibrary.vulkanBuildPipeline(cullPipelineId); });
+    });
+    VkPipeline hiZPipeline = VK_NULL_HANDLE;
+    uint32_t hiZPipelineId = shaderLibrary.registerPipeline(&hiZPipeline, {"hiZReduce"},
+                                                            [vulkanHandles, hiZPipelineLayout](const ShaderLibrary::ModuleLookup &module) {
+                                                                return vulkanCreateComputePipeline(vulkanHandles, hiZPipelineLayout, module("hiZReduce"));
+                                                            });
+    auto hiZPipelineFuture = threadPool.submit([&]() {
+        return startupTimeline.measure("Hi-Z pipeline", [&]() { return shaderLibrary.vulkanBuildPipeline(hiZPipelineId); });
+    });
     vkGetDeviceQueue(vulkanHandles.device, physicalDeviceInfo.queueFamilyInfo.graphicsFamilyIndex, 0,
                      &graphicsQueue);
     vkGetDeviceQueue(vulkanHandles.device, physicalDeviceInfo.queueFamilyInfo.presentationFamilyIndex, 0,
@@ -590,166 +1550,592 @@ int main() {
     graphicsStructure.queue = graphicsQueue;
     graphicsStructure.queueFamilyIndex = physicalDeviceInfo.queueFamilyInfo.graphicsFamilyIndex;
 
-    VkRect2D viewRect{};
-    viewRect.extent = presentationEngineInfo.extents;
-    viewRect.offset = {0, 0};
     VkClearValue colorClearValue = {1.0, 0.0, 0.0, 1.0};
     VkClearValue depthClearValue = {1.0, 0.0};
     VkFence vkFence = vulkanCreateFence(vulkanHandles, VK_FENCE_CREATE_SIGNALED_BIT);
 
-    Bitmap *image1 = new Bitmap(FileLoader::getPath("Resources/heightmap.bmp"));
-    Texture2D texture1 = createTexture2D(vulkanHandles, physicalDeviceInfo, image1->originalBitmapArray,
-                                         {(uint32_t) image1->width, (uint32_t) image1->height},
-                                         VK_FORMAT_R32G32B32A32_SFLOAT,
-                                         VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
-                                         VK_IMAGE_ASPECT_COLOR_BIT, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
-                                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_FALSE);
-
-    Buffer stagingBuffer = allocateExclusiveBuffer(vulkanHandles, physicalDeviceInfo, image1->width * image1->height * 4 * 4,
-                                                   VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-
-    vulkanMapMemoryWithFlush(vulkanHandles, stagingBuffer, image1->originalBitmapArray);
-
-    copyBufferTextureHostDevice(vulkanHandles, transferStructure, stagingBuffer, texture1, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, transferStructure.queueFamilyIndex);
+    //The heightmap is decoded straight into the staging buffer and the height plane, the rows are never all in memory
+    uint64_t peakResidentBeforeHeightmap = ProcessMemory::peakResidentBytes();
+    HeightmapUpload heightmapUpload(vulkanHandles, memoryTracker, stagingManager, transferStructure);
+    FileData heightmapFile = startupTimeline.measure("wait heightmap file", [&]() { return heightmapFileFuture.get(); });
+    startupTimeline.measure("stream heightmap", [&]() {
+        if (!imageDecoders.decode(heightmapPath, heightmapFile.data(), heightmapFile.size(), heightmapUpload)) {
+            throw std::runtime_error("CANNOT DECODE HEIGHTMAP: " + heightmapPath);
+        }
+        heightmapUpload.finish();
+    });
+    heightmapFile = FileData();
+    std::cout << "PEAK RSS (MB): " << peakResidentBeforeHeightmap / (1024.0 * 1024.0) << " before heightmap upload, "
+              << ProcessMemory::peakResidentBytes() / (1024.0 * 1024.0) << " after" << std::endl;
+    uint32_t heightmapWidth = heightmapUpload.width, heightmapHeight = heightmapUpload.height;
+    Texture2D texture1 = heightmapUpload.texture;
     transitionImageInPipeline(vulkanHandles, graphicsStructure, texture1, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
                               VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
 
 
-    VkDescriptorSet textureDescriptorSet = vulkanAllocateDescriptorSet(vulkanHandles, descriptorPool, vkDescriptorSetLayout0);
-
-    VkDescriptorImageInfo vkDescriptorImageInfo{};
-    vkDescriptorImageInfo.imageView = texture1.imageView;
-    vkDescriptorImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    vkDescriptorImageInfo.sampler = texture1.sampler;
+    //Min/max pyramid, the conservative height bounds of every patch are read from it
+    HeightPyramid heightPyramid;
+    startupTimeline.measure("build height pyramid", [&]() {
+        heightPyramid.build(std::move(heightmapUpload.heights), heightmapWidth, heightmapHeight, &threadPool);
+    });
 
-    VkWriteDescriptorSet vkWriteDescriptorSet = vulkanGetWriteDescriptorSet(vulkanHandles, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textureDescriptorSet, 0, nullptr, &vkDescriptorImageInfo);
-    Buffer lightInformationBuffer = allocateExclusiveBuffer(vulkanHandles, physicalDeviceInfo, sizeof(LightInformation), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-    VkDescriptorBufferInfo lightInformationBufferInfo{};
-    lightInformationBufferInfo.buffer = lightInformationBuffer.buffer;
-    lightInformationBufferInfo.range = lightInformationBuffer.size;
-    lightInformationBufferInfo.offset = 0;
+    Buffer lightInformationBuffer = allocateExclusiveBuffer(vulkanHandles, memoryTracker, sizeof(LightInformation), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, MEMORY_TAG_UNIFORMS);
+    VkDescriptorSet textureDescriptorSet = descriptorCache.vulkanGetDescriptorSet(vulkanHandles.device, vkDescriptorSetLayout0,
+                                                                                  {DescriptorBinding::image(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, texture1, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+                                                                                   DescriptorBinding::buffer(1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, lightInformationBuffer)});
 
-    VkWriteDescriptorSet writeLightInformation = vulkanGetWriteDescriptorSet(vulkanHandles, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, textureDescriptorSet, 1, &lightInformationBufferInfo, nullptr);
+    uint32_t heightmapIndex = 0;
+    if (bindlessEnabled) {
+        heightmapIndex = bindlessTextureTable.vulkanRegisterTexture(texture1, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
 
-    std::vector<VkWriteDescriptorSet> descriptorWriteInfo = {vkWriteDescriptorSet, writeLightInformation};
+    ViewProjection viewProjection{};
+    viewProjection.projection = glm::perspective(45.0, (double) presentationEngineInfo.extents.width / presentationEngineInfo.extents.height, 0.001, 1000.0);
+    camera.positionCameraCenter();
 
-    vkUpdateDescriptorSets(vulkanHandles.device, descriptorWriteInfo.size(), descriptorWriteInfo.data(), 0, nullptr);
 
-    MVP mvp{};
-    mvp.model = glm::mat4(1);
-    mvp.projetion = glm::perspective(45.0, 1.0, 0.001, 1000.0);
-    camera.positionCameraCenter();
+    TerrainMesh terrainMesh{};
+    glm::ivec2 patchGrid(2, 2);
+    glm::vec3 patchSize(2, 2, 2);
+    glm::vec3 firstPatchPosition(-2, -3, -2);
+    terrainPatches = startupTimeline.measure("build terrain patches", [&]() {
+        return buildTerrainPatches(vulkanHandles, physicalDeviceInfo, memoryTracker, stagingManager, transferStructure, patchGrid.x, patchGrid.y,
+                                   patchSize, firstPatchPosition, terrainMesh);
+    });
+    for (auto &terrainPatch : terrainPatches) {
+        terrainPatch.patchData.heightmapIndex = heightmapIndex;
+        PatchData &data = terrainPatch.patchData;
+        terrainPatch.heightBounds = heightPyramid.queryRange(data.uvOffset, data.uvOffset + data.uvScale);
+        computePatchBounds(terrainPatch.patchData, terrainPatch.heightBounds);
+    }
+    uint32_t patchCount = terrainPatches.size();
+
+    //The patches are centered on their position and tile the heightmap, heights are scaled by the patch height
+    glm::vec3 terrainOrigin = firstPatchPosition - glm::vec3(patchSize.x, 0, patchSize.z) * 0.5f;
+    glm::vec3 terrainSize = patchSize * glm::vec3(patchGrid.x, 1, patchGrid.y);
+    TerrainHeightField terrainHeightField(heightPyramid, terrainOrigin, terrainSize);
+    if (benchmarkTerrainQueries) {
+        runTerrainQueryBenchmark(terrainHeightField, terrainOrigin, terrainSize);
+    }
 
+    SimulationState initialState{};
+    initialState.eye = camera.eye;
+    initialState.angle = camera.angle;
+    FixedStepSimulation simulation(1.0 / 120.0, initialState);
+    simulation.setTerrain(&terrainHeightField);
+    if (!recordInputPath.empty() && !simulation.startRecording(recordInputPath)) {
+        throw std::runtime_error("CANNOT CREATE INPUT RECORDING: " + recordInputPath);
+    }
+    if (!replayInputPath.empty() && !simulation.startReplay(replayInputPath)) {
+        throw std::runtime_error("CANNOT REPLAY INPUT RECORDING: " + replayInputPath);
+    }
+    //Transient CPU data of each frame, sized for the patch data with room to spare for smaller lists
+    FrameArena frameArena(renderFramesAmount, sizeof(PatchData) * patchCount + 64 * 1024);
 
-    terrainPatches = buildTerrainPatches(vulkanHandles, physicalDeviceInfo, transferStructure, 2, 2,
-                                         glm::vec3(2, 2, 2), glm::vec3(-2, -3, -2), vkDescriptorSetLayout2, vkDescriptorSetLayout1, descriptorPool);
 
+    //GPU time of the frame, to compare the pipeline variants
+    uint32_t timestampValidBits = physicalDeviceInfo.queueFamilyProperties[physicalDeviceInfo.queueFamilyInfo.graphicsFamilyIndex].timestampValidBits;
+    double timestampPeriod = physicalDeviceInfo.physicalDeviceProperties.limits.timestampPeriod;
 
-    int renderFramesAmount = 2;
     std::vector<RenderFrame> renderFrames(renderFramesAmount);
+    std::vector<FrameUniforms> frameUniforms(renderFramesAmount);
     for (int i = 0; i < renderFramesAmount; ++i) {
-        renderFrames[i] = createRenderFrame(vulkanHandles, vkGraphicsPool);
+        renderFrames[i] = createRenderFrame(deviceContext, vkGraphicsPool);
+        frameUniforms[i].viewProjectionUniform = allocateExclusiveBuffer(vulkanHandles, memoryTracker, sizeof(ViewProjection), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                                                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, MEMORY_TAG_UNIFORMS);
+        frameUniforms[i].patchBuffer = allocateExclusiveBuffer(vulkanHandles, memoryTracker, sizeof(PatchData) * patchCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, MEMORY_TAG_TERRAIN);
+        frameUniforms[i].viewProjectionDescriptorSet = descriptorCache.vulkanGetDescriptorSet(vulkanHandles.device, vkDescriptorSetLayout1,
+                                                                                              {DescriptorBinding::buffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                                                                                                                         frameUniforms[i].viewProjectionUniform),
+                                                                                               DescriptorBinding::buffer(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                                                                                                         frameUniforms[i].patchBuffer)});
+        frameUniforms[i].cullUniformBuffer = allocateExclusiveBuffer(vulkanHandles, memoryTracker, sizeof(CullUniforms), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, MEMORY_TAG_UNIFORMS);
+        //One list for each culling phase
+        frameUniforms[i].drawCommandBuffer = allocateExclusiveBuffer(vulkanHandles, memoryTracker, sizeof(VkDrawIndexedIndirectCommand) * patchCount * 2,
+                                                                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                                                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_TAG_TERRAIN);
+        frameUniforms[i].drawCountBuffer = allocateExclusiveBuffer(vulkanHandles, memoryTracker, sizeof(uint32_t) * 2,
+                                                                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                                                   VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_TAG_TERRAIN);
+        frameUniforms[i].occludedBuffer = allocateExclusiveBuffer(vulkanHandles, memoryTracker, sizeof(uint32_t) * patchCount,
+                                                                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                                                  MEMORY_TAG_TERRAIN);
+        frameUniforms[i].statisticsBuffer = allocateExclusiveBuffer(vulkanHandles, memoryTracker, sizeof(CullStatistics),
+                                                                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, MEMORY_TAG_TERRAIN);
+        if (timestampValidBits > 0) {
+            frameUniforms[i].timestampQueryPool = deviceContext.vulkanCreateQueryPool(VK_QUERY_TYPE_TIMESTAMP, 2);
+        }
+    }
+    startupTimeline.measure("wait pipelines", [&]() {
+        VkPipeline shadedPipeline = shadedPipelineFuture.get();
+        VkPipeline wirePipeline = wirePipelineFuture.get();
+        terrainPipelines[terrainVariant.key()] = shadedPipeline;
+        terrainPipelines[wireVariant.key()] = wirePipeline;
+        cullPipeline = cullPipelineFuture.get();
+        hiZPipeline = hiZPipelineFuture.get();
+    });
+    if (!shaderLibrary.enableHotReload()) {
+        std::cerr << "SHADER HOT RELOAD UNAVAILABLE" << std::endl;
     }
+    memoryTracker.vulkanReport();
+    stagingManager.report();
+
+    auto recreateSwapchain = [&]() {
+        //A minimized window has a zero sized framebuffer, no swapchain can be created until it is restored
+        int width = 0, height = 0;
+        glfwGetFramebufferSize(window, &width, &height);
+        while (width == 0 || height == 0) {
+            glfwWaitEvents();
+            glfwGetFramebufferSize(window, &width, &height);
+        }
+        vkDeviceWaitIdle(vulkanHandles.device);
+        //Recreated views may get the handles of the destroyed ones back, cached sets must not outlive them
+        descriptorCache.vulkanInvalidateImageView(depthAttachment.imageView);
+        descriptorCache.vulkanInvalidateImageView(hiZPyramid.imageView);
+        for (auto levelView : hiZPyramid.levelViews) {
+            descriptorCache.vulkanInvalidateImageView(levelView);
+        }
+        destroySwapchainResources(vulkanHandles, memoryTracker, swapchainReferences, depthAttachment, hiZPyramid);
+        vulkanSetup.vulkanRecreateSwapchain(vulkanHandles, physicalDeviceInfo, presentationEngineInfo);
+        createSwapchainResources(vulkanHandles, memoryTracker, presentationEngineInfo, renderPass, swapchainReferences, depthAttachment, hiZPyramid);
+        viewProjection.projection = glm::perspective(45.0, (double) presentationEngineInfo.extents.width / presentationEngineInfo.extents.height, 0.001, 1000.0);
+        framebufferResized = false;
+        presentModeChanged = false;
+    };
+
+    FrameProfiler frameProfiler(renderFramesAmount);
+    //Camera the current Hi-Z was rendered from
+    glm::mat4 previousViewProjection = glm::mat4(1);
     float frameNumber = 0;
+    uint32_t currentFrame = 0;
+    uint32_t checkedFrames = 0, allocatingFrames = 0;
+    std::chrono::steady_clock::time_point lastSimulationTime = std::chrono::steady_clock::now();
     while (!glfwWindowShouldClose(window)) {
+        uint64_t frameAllocations = AllocationCounter::count();
+        shaderLibrary.pollChanges();
+
+        RenderFrame &renderFrame = renderFrames[currentFrame];
+        //The fence is only reset once an image was acquired, otherwise a failed acquire would leave it unsignaled forever
+        CommandBufferUtils::vulkanWaitForFences(vulkanHandles, {renderFrame.bufferFinishedFence.get()}, false);
+        frameProfiler.markGpuFinished(currentFrame);
+        deletionQueue.vulkanRetireFrame(currentFrame);
+        descriptorAllocator.vulkanResetFrame(currentFrame);
+        frameArena.resetFrame(currentFrame);
+        //Frame boundary, rebuilt pipelines are only swapped in here and the replaced ones retire with this slot
+        shaderLibrary.vulkanApplyReloads(deletionQueue, currentFrame);
+        if (frameUniforms[currentFrame].statisticsPending) {
+            CullStatistics cullStatistics{};
+            vulkanReadMemoryWithInvalidate(vulkanHandles, frameUniforms[currentFrame].statisticsBuffer, &cullStatistics);
+            frameProfiler.recordCulling(cullStatistics.drawn, cullStatistics.frustumRejected, cullStatistics.occlusionRejected,
+                                        cullStatistics.retestRecovered);
+            frameUniforms[currentFrame].statisticsPending = false;
+        }
+        if (frameUniforms[currentFrame].timestampsPending) {
+            uint64_t timestamps[2];
+            VkResult queryResult = vkGetQueryPoolResults(vulkanHandles.device, frameUniforms[currentFrame].timestampQueryPool.get(), 0, 2,
+                                                         sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+            if (queryResult == VK_SUCCESS) {
+                uint64_t validMask = timestampValidBits >= 64 ? ~0ull : (1ull << timestampValidBits) - 1;
+                uint64_t ticks = (timestamps[1] - timestamps[0]) & validMask;
+                frameProfiler.recordGpuTime(ticks * timestampPeriod / 1e6);
+            }
+            frameUniforms[currentFrame].timestampsPending = false;
+        }
+
+        //Input is sampled as late as possible, after the wait for the frame slot
         glfwPollEvents();
+        std::chrono::steady_clock::time_point simulationTime = std::chrono::steady_clock::now();
+        simulation.advance(FrameProfiler::milliseconds(lastSimulationTime, simulationTime) / 1000.0, gatherSimulationInput(window));
+        lastSimulationTime = simulationTime;
+        if (simulation.replayFinished()) {
+            std::cout << "INPUT REPLAY FINISHED" << std::endl;
+            glfwSetWindowShouldClose(window, GLFW_TRUE);
+        }
+        SimulationState simulationState = simulation.interpolated();
+        camera.eye = simulationState.eye;
+        camera.angle = simulationState.angle;
+        camera.positionCameraCenter();
+        if (terrainPickRequested) {
+            TerrainRayHit hit{};
+            if (terrainHeightField.raycast(camera.eye, glm::normalize(camera.center - camera.eye), INFINITY, hit)) {
+                std::cout << "TERRAIN HIT: " << hit.position.x << " " << hit.position.y << " " << hit.position.z
+                          << " DISTANCE: " << hit.distance << std::endl;
+            } else {
+                std::cout << "TERRAIN MISSED" << std::endl;
+            }
+            terrainPickRequested = false;
+        }
+        if (memoryReportRequested) {
+            memoryTracker.vulkanReport();
+            stagingManager.report();
+            memoryReportRequested = false;
+        }
+        frameProfiler.latencyMode = latencyMode;
+        frameProfiler.beginFrame(currentFrame);
         colorClearValue.color = {{11.f / 255.f, 13.f / 255.f, 14.f / 255.f, 1.0f}};
 
-        for (int i = 0; i < renderFramesAmount; ++i) {
-            RenderFrame &renderFrame = renderFrames[i];
-            CommandBufferUtils::vulkanWaitForFences(vulkanHandles, {renderFrame.bufferFinishedFence});
-            unsigned int imageIndex = 0;
-            vkAcquireNextImageKHR(vulkanHandles.device, vulkanHandles.swapchain, UINT64_MAX,
-                                  renderFrame.imageReadySemaphore,
-                                  VK_NULL_HANDLE,
-                                  &imageIndex);
-
-            if (renderFrame.frameBuffer != VK_NULL_HANDLE) {
-                vkDestroyFramebuffer(vulkanHandles.device, renderFrame.frameBuffer, nullptr);
-            }
-            renderFrame.frameBuffer = vulkanCreateFrameBuffer(vulkanHandles,
-                                                              presentationEngineInfo.extents.width,
-                                                              presentationEngineInfo.extents.height, renderPass,
-                                                              {swapchainReferences.imageViews[imageIndex], depthMapImageView});
-
-            std::vector<VkClearValue> clearValues = {colorClearValue, depthClearValue};
-            VkRenderPassBeginInfo vkRenderPassBeginInfo{};
-            vkRenderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-            vkRenderPassBeginInfo.renderPass = renderPass;
-            vkRenderPassBeginInfo.framebuffer = renderFrame.frameBuffer;
-            vkRenderPassBeginInfo.renderArea = viewRect;
-            vkRenderPassBeginInfo.clearValueCount = clearValues.size();
-            vkRenderPassBeginInfo.pClearValues = clearValues.data();
-
-
-            mvp.view = glm::lookAt(camera.eye, camera.center, camera.up);
-            lightInformation.cameraPosition = camera.center;
-            glm::mat4 model = glm::mat4(1);
-            model = glm::rotate(model, angle, glm::vec3(0, 0, -1));
-            angle += 0.001;
-            lightInformation.position = model * glm::vec4(0, -2, 0, 1);
-            vulkanMapMemoryWithFlush(vulkanHandles, lightInformationBuffer, &lightInformation);
-
-            for (int j = 0; j < terrainPatches.size(); ++j) {
-                vulkanMapMemoryWithFlush(vulkanHandles, terrainPatches[j].tessInfoUniform, &terrainPatches[j].tessInfo);
+        unsigned int imageIndex = 0;
+        VkResult acquireResult = vkAcquireNextImageKHR(vulkanHandles.device, vulkanHandles.swapchain, UINT64_MAX,
+                                                       renderFrame.imageReadySemaphore.get(),
+                                                       VK_NULL_HANDLE,
+                                                       &imageIndex);
+        if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR) {
+            recreateSwapchain();
+            continue;
+        }
+        if (acquireResult != VK_SUBOPTIMAL_KHR) VK_ASSERT(acquireResult);
+        VK_ASSERT(vkResetFences(vulkanHandles.device, 1, renderFrame.bufferFinishedFence.address()));
+
+        VkRect2D viewRect{};
+        viewRect.extent = presentationEngineInfo.extents;
+        viewRect.offset = {0, 0};
+
+        //Flipped viewport so the Y axis points up like in OpenGL
+        VkViewport vkViewport{};
+        vkViewport.width = presentationEngineInfo.extents.width;
+        vkViewport.height = -float(presentationEngineInfo.extents.height);
+        vkViewport.x = 0;
+        vkViewport.y = presentationEngineInfo.extents.height;
+        vkViewport.minDepth = 0.0;
+        vkViewport.maxDepth = 1.0;
+
+        VkClearValue clearValues[2] = {colorClearValue, depthClearValue};
+        VkRenderPassBeginInfo vkRenderPassBeginInfo{};
+        vkRenderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        vkRenderPassBeginInfo.renderPass = renderPass;
+        vkRenderPassBeginInfo.framebuffer = swapchainReferences.frameBuffers[imageIndex];
+        vkRenderPassBeginInfo.renderArea = viewRect;
+        vkRenderPassBeginInfo.clearValueCount = 2;
+        vkRenderPassBeginInfo.pClearValues = clearValues;
+
+
+        viewProjection.view = glm::lookAt(camera.eye, camera.center, camera.up);
+        vulkanMapMemoryWithFlush(vulkanHandles, frameUniforms[currentFrame].viewProjectionUniform, &viewProjection);
+        lightInformation.cameraPosition = camera.eye;
+        glm::mat4 model = glm::mat4(1);
+        model = glm::rotate(model, simulationState.lightAngle, glm::vec3(0, 0, -1));
+        lightInformation.position = model * glm::vec4(0, -2, 0, 1);
+        vulkanMapMemoryWithFlush(vulkanHandles, lightInformationBuffer, &lightInformation);
+
+        FrameVector<PatchData> patchData(patchCount, ArenaAllocator<PatchData>(frameArena));
+        for (uint32_t j = 0; j < patchCount; ++j) {
+            terrainPatches[j].patchData.tessInfo.tessLevelOuter = glm::vec4(globalOuterTess);
+            patchData[j] = terrainPatches[j].patchData;
+            patchData[j].firstIndex = terrainMesh.domainRanges[terrainVariant.domain].firstIndex;
+            patchData[j].indexCount = terrainMesh.domainRanges[terrainVariant.domain].indexCount;
+        }
+        vulkanMapMemoryWithFlush(vulkanHandles, frameUniforms[currentFrame].patchBuffer, patchData.data());
+        CullingMode cullingMode = gpuCullingEnabled ? supportedCullingMode : CULLING_NONE;
+
+        auto terrainPipeline = terrainPipelines.find(terrainVariant.key());
+        if (terrainPipeline == terrainPipelines.end()) {
+            uint32_t pipelineId = registerTerrainVariant(terrainVariant);
+            terrainPipelines[terrainVariant.key()] = shaderLibrary.vulkanBuildPipeline(pipelineId);
+            terrainPipeline = terrainPipelines.find(terrainVariant.key());
+        }
+
+        FrameUniforms &uniforms = frameUniforms[currentFrame];
+        bool occlusionCulling = cullingMode != CULLING_NONE && occlusionCullingEnabled;
+        if (!occlusionCulling) hiZPyramid.valid = false;
+        glm::mat4 currentViewProjection = viewProjection.projection * viewProjection.view;
+        VkDescriptorSet cullDescriptorSet = VK_NULL_HANDLE;
+        if (cullingMode != CULLING_NONE) {
+            CullUniforms cullUniforms{};
+            extractFrustumPlanes(currentViewProjection, cullUniforms.frustumPlanes);
+            cullUniforms.viewProjection = currentViewProjection;
+            cullUniforms.previousViewProjection = previousViewProjection;
+            cullUniforms.depthSize = glm::vec2(presentationEngineInfo.extents.width, presentationEngineInfo.extents.height);
+            cullUniforms.patchCount = patchCount;
+            cullUniforms.compact = cullingMode == CULLING_GPU_COMPACT;
+            cullUniforms.occlusionEnabled = occlusionCulling && hiZPyramid.valid;
+            vulkanMapMemoryWithFlush(vulkanHandles, uniforms.cullUniformBuffer, &cullUniforms);
+            //The Hi-Z is recreated with the swapchain, so the set is written every frame into the transient pools
+            //Arrays instead of a vector so the per frame write does not allocate
+            DescriptorBinding cullBindings[7] = {DescriptorBinding::buffer(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, uniforms.patchBuffer),
+                                                 DescriptorBinding::buffer(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, uniforms.drawCommandBuffer),
+                                                 DescriptorBinding::buffer(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, uniforms.drawCountBuffer),
+                                                 DescriptorBinding::buffer(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, uniforms.occludedBuffer),
+                                                 DescriptorBinding::buffer(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, uniforms.statisticsBuffer),
+                                                 DescriptorBinding::buffer(5, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniforms.cullUniformBuffer),
+                                                 DescriptorBinding::image(6, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, hiZPyramid.imageView,
+                                                                          hiZSampler, VK_IMAGE_LAYOUT_GENERAL)};
+            cullDescriptorSet = descriptorAllocator.vulkanAllocateTransientDescriptorSet(currentFrame, cullDescriptorSetLayout,
+                                                                                        cullBindings, 7);
+            uniforms.statisticsPending = true;
+        }
+
+        auto dispatchCulling = [&](CullPhase phase) {
+            uint32_t phaseValue = phase;
+            vkCmdBindPipeline(renderFrame.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+            vkCmdBindDescriptorSets(renderFrame.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0,
+                                    1, &cullDescriptorSet, 0, nullptr);
+            vkCmdPushConstants(renderFrame.commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                               sizeof(uint32_t), &phaseValue);
+            vkCmdDispatch(renderFrame.commandBuffer, (patchCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+            VkMemoryBarrier cullBarrier{};
+            cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+            vkCmdPipelineBarrier(renderFrame.commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                                 1, &cullBarrier, 0, nullptr, 0, nullptr);
+        };
+
+        auto drawTerrain = [&](uint32_t list) {
+            VkDeviceSize commandsOffset = sizeof(VkDrawIndexedIndirectCommand) * patchCount * list;
+            if (cullingMode == CULLING_GPU_COMPACT) {
+                vkCmdDrawIndexedIndirectCount(renderFrame.commandBuffer, uniforms.drawCommandBuffer.buffer, commandsOffset,
+                                              uniforms.drawCountBuffer.buffer, sizeof(uint32_t) * list, patchCount,
+                                              sizeof(VkDrawIndexedIndirectCommand));
+            } else if (cullingMode == CULLING_GPU) {
+                vkCmdDrawIndexedIndirect(renderFrame.commandBuffer, uniforms.drawCommandBuffer.buffer, commandsOffset, patchCount,
+                                         sizeof(VkDrawIndexedIndirectCommand));
+            } else if (list == 0) {
+                for (uint32_t j = 0; j < patchCount; ++j) {
+                    PatchData &data = patchData[j];
+                    vkCmdDrawIndexed(renderFrame.commandBuffer, data.indexCount, 1, data.firstIndex, data.vertexOffset, j);
+                }
             }
+        };
 
-            CommandBufferUtils::vulkanBeginCommandBuffer(vulkanHandles, renderFrame.commandBuffer, 0);
-            {
-                vkCmdBeginRenderPass(renderFrame.commandBuffer, &vkRenderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-                vkCmdBindPipeline(renderFrame.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, activePipeline);
-                VkDeviceSize offset = 0;
+        CommandBufferUtils::vulkanBeginCommandBuffer(vulkanHandles, renderFrame.commandBuffer, 0);
+        {
+            if (uniforms.timestampQueryPool) {
+                vkCmdResetQueryPool(renderFrame.commandBuffer, uniforms.timestampQueryPool.get(), 0, 2);
+                vkCmdWriteTimestamp(renderFrame.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, uniforms.timestampQueryPool.get(), 0);
+            }
+            if (cullingMode != CULLING_NONE) {
+                if (!hiZPyramid.initialized) {
+                    //Never read before it holds a depth, but it is bound in the general layout from the first frame
+                    VkImageMemoryBarrier hiZBarrier{};
+                    hiZBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                    hiZBarrier.image = hiZPyramid.image;
+                    hiZBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                    hiZBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+                    hiZBarrier.srcAccessMask = 0;
+                    hiZBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+                    hiZBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    hiZBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    hiZBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, (uint32_t) hiZPyramid.levelViews.size(), 0, 1};
+                    vkCmdPipelineBarrier(renderFrame.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                                         0, nullptr, 0, nullptr, 1, &hiZBarrier);
+                    hiZPyramid.initialized = true;
+                }
+                //The counts are appended to by the culling pass, they start from zero every frame
+                vkCmdFillBuffer(renderFrame.commandBuffer, uniforms.drawCountBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+                vkCmdFillBuffer(renderFrame.commandBuffer, uniforms.statisticsBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+                //Also orders the Hi-Z written by the previous frame before this frame reads it
+                VkMemoryBarrier fillBarrier{};
+                fillBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                fillBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+                fillBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+                vkCmdPipelineBarrier(renderFrame.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                                     1, &fillBarrier, 0, nullptr, 0, nullptr);
+                dispatchCulling(CULL_PHASE_PREVIOUS_DEPTH);
+            }
 
-                vkCmdBindDescriptorSets(renderFrame.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vkPipelineLayout, 0,
+            //Without the Hi-Z reduction in between there is nothing to resume, one pass draws the frame and presents
+            if (!occlusionCulling) vkRenderPassBeginInfo.renderPass = singleRenderPass;
+            vkCmdBeginRenderPass(renderFrame.commandBuffer, &vkRenderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+            vkCmdBindPipeline(renderFrame.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, terrainPipeline->second);
+            vkCmdSetViewport(renderFrame.commandBuffer, 0, 1, &vkViewport);
+            vkCmdSetScissor(renderFrame.commandBuffer, 0, 1, &viewRect);
+            VkDeviceSize offset = 0;
+
+            VkDescriptorSet frameDescriptorSets[2] = {textureDescriptorSet, uniforms.viewProjectionDescriptorSet};
+            vkCmdBindDescriptorSets(renderFrame.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vkPipelineLayout, 0,
+                                    2,
+                                    frameDescriptorSets, 0,
+                                    nullptr);
+            if (bindlessEnabled) {
+                vkCmdBindDescriptorSets(renderFrame.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vkPipelineLayout, 2,
                                         1,
-                                        &textureDescriptorSet, 0,
+                                        &bindlessTextureTable.descriptorSet, 0,
                                         nullptr);
+            }
 
-                for (int j = 0; j < terrainPatches.size(); ++j) {
-                    terrainPatches[j].mvp.view = mvp.view;
-                    terrainPatches[j].mvp.projetion = mvp.projetion;
-                    terrainPatches[j].tessInfo.tessLevelOuter = glm::vec3(globalOuterTess);
-                    vulkanMapMemoryWithFlush(vulkanHandles, terrainPatches[j].mvpUniform, &terrainPatches[j].mvp);
-                    vulkanMapMemoryWithFlush(vulkanHandles, terrainPatches[j].tessInfoUniform, &terrainPatches[j].tessInfo);
-
-                    vkCmdBindVertexBuffers(renderFrame.commandBuffer, 0, 1, &terrainPatches[j].vertexBuffer.buffer, &offset);
-                    vkCmdBindIndexBuffer(renderFrame.commandBuffer, terrainPatches[j].indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-                    vkCmdBindDescriptorSets(renderFrame.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vkPipelineLayout, 2,
-                                            1,
-                                            &terrainPatches[j].tessInfoDescriptorSet, 0,
-                                            nullptr);
-                    vkCmdBindDescriptorSets(renderFrame.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vkPipelineLayout, 1,
-                                            1,
-                                            &terrainPatches[j].mvpDescriptorSet, 0,
-                                            nullptr);
-                    vkCmdDrawIndexed(renderFrame.commandBuffer, terrainPatches[j].indices.size(), 1, 0, 0, 1);
+            vkCmdBindVertexBuffers(renderFrame.commandBuffer, 0, 1, &terrainMesh.vertexBuffer.buffer, &offset);
+            vkCmdBindIndexBuffer(renderFrame.commandBuffer, terrainMesh.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+            drawTerrain(0);
+            vkCmdEndRenderPass(renderFrame.commandBuffer);
+
+            if (occlusionCulling) {
+                //Max depth pyramid of what was drawn so far, the reduction overwrites what the first phase read
+                VkMemoryBarrier readBarrier{};
+                readBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                readBarrier.srcAccessMask = 0;
+                readBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+                vkCmdPipelineBarrier(renderFrame.commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                                     1, &readBarrier, 0, nullptr, 0, nullptr);
+                vkCmdBindPipeline(renderFrame.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, hiZPipeline);
+                for (uint32_t level = 0; level < hiZPyramid.levelViews.size(); ++level) {
+                    DescriptorBinding source = level == 0 ?
+                                               DescriptorBinding::image(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, depthAttachment.imageView, hiZSampler,
+                                                                        VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL) :
+                                               DescriptorBinding::image(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, hiZPyramid.levelViews[level - 1], hiZSampler,
+                                                                        VK_IMAGE_LAYOUT_GENERAL);
+                    DescriptorBinding hiZBindings[2] = {source,
+                                                        DescriptorBinding::image(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, hiZPyramid.levelViews[level],
+                                                                                 VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL)};
+                    VkDescriptorSet hiZDescriptorSet = descriptorAllocator.vulkanAllocateTransientDescriptorSet(currentFrame, hiZDescriptorSetLayout,
+                                                                                                               hiZBindings, 2);
+                    vkCmdBindDescriptorSets(renderFrame.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, hiZPipelineLayout, 0,
+                                            1, &hiZDescriptorSet, 0, nullptr);
+                    VkExtent2D levelExtent = hiZPyramid.levelExtents[level];
+                    vkCmdDispatch(renderFrame.commandBuffer, (levelExtent.width + HI_Z_GROUP_SIZE - 1) / HI_Z_GROUP_SIZE,
+                                  (levelExtent.height + HI_Z_GROUP_SIZE - 1) / HI_Z_GROUP_SIZE, 1);
+
+                    VkMemoryBarrier levelBarrier{};
+                    levelBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                    levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+                    levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                    vkCmdPipelineBarrier(renderFrame.commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                                         1, &levelBarrier, 0, nullptr, 0, nullptr);
                 }
+                hiZPyramid.valid = true;
+                previousViewProjection = currentViewProjection;
+                dispatchCulling(CULL_PHASE_RETEST);
+
+                //Bound graphics state is kept between the passes of a command buffer
+                VkRenderPassBeginInfo resumeRenderPassBeginInfo = vkRenderPassBeginInfo;
+                resumeRenderPassBeginInfo.renderPass = resumeRenderPass;
+                vkCmdBeginRenderPass(renderFrame.commandBuffer, &resumeRenderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+                drawTerrain(1);
                 vkCmdEndRenderPass(renderFrame.commandBuffer);
             }
-            VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-            CommandBufferUtils::vulkanSubmitCommandBuffer(graphicsQueue, renderFrame.commandBuffer,
-                                                          {renderFrame.imageReadySemaphore},
-                                                          {renderFrame.presentationReadySemaphore}, &waitStage,
-                                                          renderFrame.bufferFinishedFence);
 
-            VkPresentInfoKHR vkPresentInfoKhr{};
-            vkPresentInfoKhr.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-            vkPresentInfoKhr.waitSemaphoreCount = 1;
-            vkPresentInfoKhr.pWaitSemaphores = &renderFrame.presentationReadySemaphore;
-            vkPresentInfoKhr.swapchainCount = 1;
-            vkPresentInfoKhr.pSwapchains = &vulkanHandles.swapchain;
-            vkPresentInfoKhr.pImageIndices = &imageIndex;
+            if (uniforms.statisticsPending) {
+                //The fence only orders execution, the statistics are read on the host once it is signaled
+                VkBufferMemoryBarrier statisticsBarrier{};
+                statisticsBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                statisticsBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+                statisticsBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+                statisticsBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                statisticsBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                statisticsBarrier.buffer = uniforms.statisticsBuffer.buffer;
+                statisticsBarrier.offset = 0;
+                statisticsBarrier.size = VK_WHOLE_SIZE;
+                vkCmdPipelineBarrier(renderFrame.commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                                     0, nullptr, 1, &statisticsBarrier, 0, nullptr);
+            }
 
-            VK_ASSERT(vkQueuePresentKHR(presentationQueue, &vkPresentInfoKhr));
+            if (uniforms.timestampQueryPool) {
+                vkCmdWriteTimestamp(renderFrame.commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, uniforms.timestampQueryPool.get(), 1);
+                uniforms.timestampsPending = true;
+            }
+        }
+        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        CommandBufferUtils::vulkanSubmitCommandBuffer(graphicsQueue, renderFrame.commandBuffer,
+                                                      {renderFrame.imageReadySemaphore.get()},
+                                                      {renderFrame.presentationReadySemaphore.get()}, &waitStage,
+                                                      renderFrame.bufferFinishedFence.get());
+
+        VkPresentInfoKHR vkPresentInfoKhr{};
+        vkPresentInfoKhr.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        vkPresentInfoKhr.waitSemaphoreCount = 1;
+        vkPresentInfoKhr.pWaitSemaphores = renderFrame.presentationReadySemaphore.address();
+        vkPresentInfoKhr.swapchainCount = 1;
+        vkPresentInfoKhr.pSwapchains = &vulkanHandles.swapchain;
+        vkPresentInfoKhr.pImageIndices = &imageIndex;
+
+        VkResult presentResult = vkQueuePresentKHR(presentationQueue, &vkPresentInfoKhr);
+        if (presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR || framebufferResized || presentModeChanged) {
+            recreateSwapchain();
+        } else {
+            VK_ASSERT(presentResult);
+        }
 
-            frameNumber++;
+        //In latency mode there is never more than one frame queued, trading throughput for input latency
+        if (latencyMode) {
+            CommandBufferUtils::vulkanWaitForFences(vulkanHandles, {renderFrame.bufferFinishedFence.get()}, false);
+            frameProfiler.markGpuFinished(currentFrame);
         }
+        frameProfiler.recordArena(frameArena.frameUsage(), frameArena.frameOverflow(), frameArena.frameCapacity());
+        if (AllocationCounter::enabled()) {
+            uint64_t allocations = AllocationCounter::count() - frameAllocations;
+            frameProfiler.recordAllocations(allocations);
+            //Checks as many frames as were warmed up, then closes
+            if (checkFrameAllocations > 0 && frameNumber >= checkFrameAllocations) {
+                checkedFrames++;
+                if (allocations != 0) {
+                    std::cerr << "FRAME " << frameNumber << " MADE " << allocations << " HEAP ALLOCATIONS AFTER THE WARM-UP" << std::endl;
+                    allocatingFrames++;
+                }
+                if (checkedFrames == checkFrameAllocations) glfwSetWindowShouldClose(window, GLFW_TRUE);
+            }
+        }
+        frameProfiler.label = terrainVariant.domain == TESSELLATION_DOMAIN_QUADS ? "QUAD PATCHES" : "TRIANGLE PATCHES";
+        frameProfiler.endFrame(presentModeName(presentationEngineInfo.presentMode));
+        if (frameNumber == 0) {
+            startupTimeline.report("first frame presented");
+        }
+
+        frameNumber++;
+        currentFrame = (currentFrame + 1) % renderFramesAmount;
+    }
+
+    if (!recordInputPath.empty() || simulation.isReplaying()) {
+        //Equal for a recording and its replay
+        std::cout << "SIMULATION STEP " << simulation.current().step << " STATE HASH: " << std::hex << simulation.stateHash()
+                  << std::dec << std::endl;
     }
 
+    vkDeviceWaitIdle(vulkanHandles.device);
+    //The owned handles must go before the device
+    for (auto &uniforms : frameUniforms) {
+        for (const Buffer *buffer : {&uniforms.viewProjectionUniform, &uniforms.patchBuffer, &uniforms.cullUniformBuffer,
+                                     &uniforms.drawCommandBuffer, &uniforms.drawCountBuffer, &uniforms.occludedBuffer,
+                                     &uniforms.statisticsBuffer}) {
+            deletionQueue.destroyBuffer(currentFrame, *buffer);
+        }
+    }
+    frameUniforms.clear();
+    renderFrames.clear();
+    deletionQueue.destroyBuffer(currentFrame, terrainMesh.vertexBuffer);
+    deletionQueue.destroyBuffer(currentFrame, terrainMesh.indexBuffer);
+    deletionQueue.destroyBuffer(currentFrame, lightInformationBuffer);
+    deletionQueue.destroyTexture(currentFrame, texture1);
+    deletionQueue.destroySampler(currentFrame, hiZSampler);
+    deletionQueue.destroyPipelineLayout(currentFrame, vkPipelineLayout);
+    deletionQueue.destroyPipelineLayout(currentFrame, cullPipelineLayout);
+    deletionQueue.destroyPipelineLayout(currentFrame, hiZPipelineLayout);
+    for (auto descriptorSetLayout : {vkDescriptorSetLayout0, vkDescriptorSetLayout1, cullDescriptorSetLayout, hiZDescriptorSetLayout}) {
+        deletionQueue.destroyDescriptorSetLayout(currentFrame, descriptorSetLayout);
+    }
+    deletionQueue.destroyRenderPass(currentFrame, renderPass);
+    deletionQueue.destroyRenderPass(currentFrame, resumeRenderPass);
+    deletionQueue.destroyRenderPass(currentFrame, singleRenderPass);
+    shaderLibrary.vulkanDestroy();
+    descriptorAllocator.vulkanDestroy();
+    if (bindlessEnabled) {
+        bindlessTextureTable.vulkanDestroy();
+    }
+    destroySwapchainResources(vulkanHandles, memoryTracker, swapchainReferences, depthAttachment, hiZPyramid);
+    stagingManager.vulkanDestroy();
+    deletionQueue.vulkanDestroy();
+    for (auto fence : {transferStructure.bufferAvaibleFence, graphicsStructure.bufferAvaibleFence, vkFence}) {
+        vkDestroyFence(vulkanHandles.device, fence, nullptr);
+    }
+    vkDestroyCommandPool(vulkanHandles.device, vkGraphicsPool, nullptr);
+    vkDestroyCommandPool(vulkanHandles.device, vkTransferPool, nullptr);
     vkDestroySwapchainKHR(vulkanHandles.device, vulkanHandles.swapchain, nullptr);
     vkDestroyDevice(vulkanHandles.device, nullptr);
     vkDestroySurfaceKHR(vulkanHandles.instance, vulkanHandles.surface, nullptr);
     vkDestroyInstance(vulkanHandles.instance, nullptr);
     glfwDestroyWindow(window);
     glfwTerminate();
+    if (checkFrameAllocations > 0) {
+        std::cout << "FRAME ALLOCATION CHECK: " << allocatingFrames << " OF " << checkedFrames
+                  << " FRAMES ALLOCATED AFTER " << checkFrameAllocations << " WARM-UP FRAMES" << std::endl;
+        //A window closed before the end did not check enough frames
+        if (allocatingFrames != 0 || checkedFrames < checkFrameAllocations) return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
 }
@@ -0,0 +1,140 @@
+#include "../src/EvictionHandlers.h"
+#include "TestSupport.h"
+
+/*
+ * Runs the eviction policy of DeviceMemoryTracker against a stub allocator: heaps that only count bytes, allocating
+ * like vulkanAllocate does, and handlers that own blocks of them
+ */
+
+/*
+ * vulkanAllocate without the device: an allocation that would go over the budget first evicts down to the budget
+ * minus its size, then allocates anyway
+ */
+class StubAllocator {
+public:
+    EvictionHandlers evictionHandlers;
+    uint64_t budget;
+    uint64_t usage[2] = {};
+    uint32_t overBudgetAllocations = 0;
+
+    explicit StubAllocator(uint64_t budget) : budget(budget) {}
+
+    void allocate(uint32_t heapIndex, uint64_t size) {
+        if (usage[heapIndex] + size > budget) {
+            evictionHandlers.evict(heapIndex, budget > size ? budget - size : 0, [this, heapIndex]() { return usage[heapIndex]; });
+            if (usage[heapIndex] + size > budget) overBudgetAllocations++;
+        }
+        usage[heapIndex] += size;
+    }
+
+    void free(uint32_t heapIndex, uint64_t size) {
+        usage[heapIndex] -= size;
+    }
+};
+
+/*
+ * Owns blocks of one heap and frees up to blocksPerCall of them, oldest first, each time it is asked
+ */
+struct BlockOwner {
+    StubAllocator &allocator;
+    uint32_t heapIndex;
+    uint32_t blocksPerCall;
+    std::vector<uint64_t> blocks;
+    uint32_t calls = 0;
+    uint64_t lastRequest = 0;
+
+    void allocate(uint64_t size) {
+        allocator.allocate(heapIndex, size);
+        blocks.push_back(size);
+    }
+
+    void operator()(uint32_t heapIndex, uint64_t bytes) {
+        calls++;
+        lastRequest = bytes;
+        if (heapIndex != this->heapIndex) return;
+        for (uint32_t i = 0; i < blocksPerCall && !blocks.empty(); ++i) {
+            allocator.free(heapIndex, blocks.front());
+            blocks.erase(blocks.begin());
+        }
+    }
+};
+
+static uint32_t addOwner(StubAllocator &allocator, BlockOwner &owner) {
+    return allocator.evictionHandlers.add([&owner](uint32_t heapIndex, uint64_t bytes) { owner(heapIndex, bytes); });
+}
+
+int main() {
+    {
+        //Under budget nothing is asked
+        StubAllocator allocator(1000);
+        BlockOwner owner{allocator, 0, 1};
+        addOwner(allocator, owner);
+        for (uint32_t i = 0; i < 10; ++i) owner.allocate(100);
+        check(owner.calls == 0 && allocator.usage[0] == 1000 && allocator.overBudgetAllocations == 0, "UNDER BUDGET");
+        //Over it the first handler is asked one block at a time until the new allocation fits
+        owner.allocate(250);
+        check(owner.calls == 3 && allocator.usage[0] == 950 && allocator.overBudgetAllocations == 0, "EVICT TO FIT");
+        check(owner.lastRequest == 50, "BYTES ASKED ARE WHAT IS LEFT TO RELEASE");
+    }
+    {
+        //The first handler runs dry, the second finishes, the third is never asked
+        StubAllocator allocator(1000);
+        BlockOwner first{allocator, 0, 2}, second{allocator, 0, 1}, third{allocator, 0, 1};
+        addOwner(allocator, first);
+        addOwner(allocator, second);
+        addOwner(allocator, third);
+        first.allocate(100);
+        for (uint32_t i = 0; i < 3; ++i) second.allocate(200);
+        third.allocate(300);
+        first.allocate(500);
+        check(first.blocks.size() == 1 && second.blocks.size() == 1 && third.calls == 0 && allocator.usage[0] == 1000 &&
+              allocator.overBudgetAllocations == 0, "HANDLERS IN ORDER");
+        //A handler that frees nothing is asked once, then the allocation goes over budget
+        first.calls = second.calls = third.calls = 0;
+        first.blocksPerCall = second.blocksPerCall = third.blocksPerCall = 0;
+        allocator.allocate(0, 200);
+        check(first.calls == 1 && second.calls == 1 && third.calls == 1 && allocator.overBudgetAllocations == 1 &&
+              allocator.usage[0] == 1200, "NOTHING TO FREE GOES OVER BUDGET");
+    }
+    {
+        //Only the heap over budget is evicted
+        StubAllocator allocator(1000);
+        BlockOwner heap0{allocator, 0, 4}, heap1{allocator, 1, 4};
+        addOwner(allocator, heap0);
+        addOwner(allocator, heap1);
+        heap0.allocate(600);
+        heap1.allocate(900);
+        heap1.allocate(900);
+        check(heap0.blocks.size() == 1 && heap1.blocks.size() == 1 && allocator.usage[0] == 600 &&
+              allocator.usage[1] == 900, "PER HEAP");
+    }
+    {
+        //A removed handler is not asked, the ids of the others stay valid
+        StubAllocator allocator(1000);
+        BlockOwner first{allocator, 0, 1}, second{allocator, 0, 1};
+        uint32_t firstId = addOwner(allocator, first);
+        uint32_t secondId = addOwner(allocator, second);
+        check(firstId != secondId, "UNIQUE IDS");
+        allocator.evictionHandlers.remove(firstId);
+        allocator.evictionHandlers.remove(firstId);
+        first.allocate(500);
+        second.allocate(500);
+        allocator.allocate(0, 500);
+        check(first.calls == 0 && second.calls == 1 && second.blocks.empty() && allocator.usage[0] == 1000,
+              "REMOVED HANDLER");
+        allocator.evictionHandlers.remove(secondId);
+        allocator.allocate(0, 100);
+        check(second.calls == 1 && allocator.overBudgetAllocations == 1, "NO HANDLERS");
+    }
+    {
+        //Larger than the whole budget, everything is released before it goes over
+        StubAllocator allocator(1000);
+        BlockOwner owner{allocator, 0, 1};
+        addOwner(allocator, owner);
+        for (uint32_t i = 0; i < 5; ++i) owner.allocate(150);
+        allocator.allocate(0, 2000);
+        check(owner.blocks.empty() && allocator.usage[0] == 2000 && allocator.overBudgetAllocations == 1,
+              "LARGER THAN THE BUDGET");
+    }
+    return checkResult("EVICTION HANDLERS");
+}
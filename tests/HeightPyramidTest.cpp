@@ -0,0 +1,97 @@
+#include "../src/HeightPyramid.h"
+#include "TestSupport.h"
+#include <cmath>
+
+/*
+ * Checks every level and random queries of pyramids of random sizes against a brute force min/max over the heightmap
+ */
+
+/*
+ * Names the heightmap size, only building the message on a failure
+ */
+static void check(bool condition, const char *what, uint32_t width, uint32_t height) {
+    if (!condition) check(false, std::string(what) + " FOR " + std::to_string(width) + "x" + std::to_string(height));
+}
+
+static glm::vec2 bruteRange(const std::vector<float> &heights, uint32_t width, uint32_t x0, uint32_t y0, uint32_t x1,
+                            uint32_t y1) {
+    glm::vec2 range(INFINITY, -INFINITY);
+    for (uint32_t y = y0; y <= y1; ++y) {
+        for (uint32_t x = x0; x <= x1; ++x) {
+            range.x = std::min(range.x, heights[(size_t) y * width + x]);
+            range.y = std::max(range.y, heights[(size_t) y * width + x]);
+        }
+    }
+    return range;
+}
+
+static void testPyramid(std::mt19937 &random, uint32_t width, uint32_t height, ThreadPool *threadPool) {
+    std::uniform_real_distribution<float> heightDistribution(-100.0f, 100.0f);
+    std::vector<float> heights((size_t) width * height);
+    for (auto &value : heights) value = heightDistribution(random);
+
+    HeightPyramid heightPyramid;
+    heightPyramid.build(std::vector<float>(heights), width, height, threadPool);
+
+    //Each texel of level l is the exact range of the 2^l x 2^l block of heights below it
+    for (uint32_t level = 0; level < heightPyramid.getLevelCount(); ++level) {
+        uint32_t levelWidth = heightPyramid.getLevelWidth(level), levelHeight = heightPyramid.getLevelHeight(level);
+        check(levelWidth == std::max((width + (1u << level) - 1) >> level, 1u), "LEVEL WIDTH", width, height);
+        check(levelHeight == std::max((height + (1u << level) - 1) >> level, 1u), "LEVEL HEIGHT", width, height);
+        for (uint32_t y = 0; y < levelHeight; ++y) {
+            for (uint32_t x = 0; x < levelWidth; ++x) {
+                glm::vec2 expected = bruteRange(heights, width, x << level, y << level,
+                                                std::min(((x + 1) << level) - 1, width - 1),
+                                                std::min(((y + 1) << level) - 1, height - 1));
+                check(heightPyramid.getRange(level, x, y) == expected, "LEVEL RANGE", width, height);
+            }
+        }
+    }
+
+    uint32_t topLevel = heightPyramid.getLevelCount() - 1;
+    check(heightPyramid.getLevelWidth(topLevel) == 1 && heightPyramid.getLevelHeight(topLevel) == 1, "TOP LEVEL SIZE",
+          width, height);
+    check(heightPyramid.getRange(topLevel, 0, 0) == bruteRange(heights, width, 0, 0, width - 1, height - 1),
+          "TOP LEVEL RANGE", width, height);
+
+    //Queries may widen the range to the coarser texels they read, never narrow it
+    std::uniform_real_distribution<float> uvDistribution(-0.1f, 1.1f);
+    auto texel = [](float uv, uint32_t size) {
+        return (uint32_t) glm::clamp((int64_t) std::floor(uv * size), (int64_t) 0, (int64_t) size - 1);
+    };
+    for (uint32_t query = 0; query < 200; ++query) {
+        glm::vec2 a(uvDistribution(random), uvDistribution(random)), b(uvDistribution(random), uvDistribution(random));
+        glm::vec2 range = heightPyramid.queryRange(a, b);
+        glm::vec2 expected = bruteRange(heights, width,
+                                        texel(std::min(a.x, b.x), width), texel(std::min(a.y, b.y), height),
+                                        texel(std::max(a.x, b.x), width), texel(std::max(a.y, b.y), height));
+        check(range.x <= expected.x && range.y >= expected.y, "QUERY RANGE", width, height);
+        check(range.x >= heightPyramid.getRange(topLevel, 0, 0).x && range.y <= heightPyramid.getRange(topLevel, 0, 0).y,
+              "QUERY INSIDE HEIGHTMAP", width, height);
+    }
+
+    //The RGBA build reads the requested channel
+    std::vector<glm::vec4> pixels(heights.size());
+    for (size_t i = 0; i < heights.size(); ++i) pixels[i] = glm::vec4(0.0f, heights[i], 0.0f, 0.0f);
+    HeightPyramid channelPyramid;
+    channelPyramid.build(pixels.data(), width, height, 1, threadPool);
+    check(channelPyramid.getLevelCount() == heightPyramid.getLevelCount() &&
+          channelPyramid.getRange(topLevel, 0, 0) == heightPyramid.getRange(topLevel, 0, 0), "CHANNEL BUILD", width,
+          height);
+}
+
+int main() {
+    std::mt19937 random(1);
+    ThreadPool threadPool(3);
+    //Single rows and columns, odd sizes and sizes large enough to be reduced on the thread pool
+    const uint32_t sizes[][2] = {{1, 1}, {1, 37}, {64, 1}, {2, 2}, {3, 5}, {255, 256}, {300, 129}};
+    for (auto &size : sizes) {
+        testPyramid(random, size[0], size[1], nullptr);
+        testPyramid(random, size[0], size[1], &threadPool);
+    }
+    std::uniform_int_distribution<uint32_t> sizeDistribution(1, 300);
+    for (uint32_t i = 0; i < 20; ++i) {
+        testPyramid(random, sizeDistribution(random), sizeDistribution(random), &threadPool);
+    }
+    return checkResult("HEIGHT PYRAMID");
+}
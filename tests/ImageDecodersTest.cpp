@@ -0,0 +1,317 @@
+#include "../src/FileManagers/ImageDecoders.h"
+#include "../src/FileManagers/Inflate.h"
+#include "TestSupport.h"
+#include <cmath>
+
+/*
+ * Encodes random images in every supported layout, decodes them back and compares every pixel, then feeds mutated
+ * copies of the files to the decoders, which must either reject them before writing a row or decode a whole image
+ */
+
+/*
+ * Collects the rows bottom first, in bands of random height to exercise the partial acquires
+ */
+class ImageSink : public BitmapSink {
+public:
+    explicit ImageSink(std::mt19937 &random) : random(random) {}
+
+    bool begun = false;
+    uint32_t width = 0, height = 0, committedRows = 0;
+    std::vector<glm::vec4> pixels;
+
+    void begin(uint32_t width, uint32_t height) override {
+        begun = true;
+        this->width = width;
+        this->height = height;
+        pixels.assign((size_t) width * height, glm::vec4(-1));
+    }
+
+    uint32_t acquireRows(uint32_t firstRow, uint32_t rowCount, glm::vec4 *&rows) override {
+        rows = pixels.data() + (size_t) firstRow * width;
+        return std::min<uint32_t>(rowCount, 1 + random() % 3);
+    }
+
+    void commitRows(uint32_t firstRow, uint32_t rowCount) override {
+        committedRows += rowCount;
+    }
+
+private:
+    std::mt19937 &random;
+};
+
+struct Image {
+    uint32_t width, height;
+    //Top row first, like the files
+    std::vector<glm::vec4> pixels;
+};
+
+static bool samePixels(const ImageSink &sink, const Image &image) {
+    if (!sink.begun || sink.width != image.width || sink.height != image.height || sink.committedRows != image.height)
+        return false;
+    for (uint32_t y = 0; y < image.height; ++y) {
+        for (uint32_t x = 0; x < image.width; ++x) {
+            glm::vec4 difference = sink.pixels[(size_t) (image.height - 1 - y) * image.width + x] -
+                                   image.pixels[(size_t) y * image.width + x];
+            if (glm::max(glm::max(std::abs(difference.x), std::abs(difference.y)),
+                         glm::max(std::abs(difference.z), std::abs(difference.w))) > 1e-6f)
+                return false;
+        }
+    }
+    return true;
+}
+
+static void appendBigEndian32(std::vector<uint8_t> &bytes, uint32_t value) {
+    for (int shift = 24; shift >= 0; shift -= 8) bytes.push_back((uint8_t) (value >> shift));
+}
+
+static uint32_t crc32(const uint8_t *data, size_t size) {
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; ++bit) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+    }
+    return ~crc;
+}
+
+static void appendPngChunk(std::vector<uint8_t> &png, const char *type, const std::vector<uint8_t> &data) {
+    appendBigEndian32(png, data.size());
+    size_t typeStart = png.size();
+    png.insert(png.end(), type, type + 4);
+    png.insert(png.end(), data.begin(), data.end());
+    appendBigEndian32(png, crc32(png.data() + typeStart, png.size() - typeStart));
+}
+
+/*
+ * zlib stream of stored deflate blocks
+ */
+static std::vector<uint8_t> zlibStore(const std::vector<uint8_t> &data) {
+    std::vector<uint8_t> stream = {0x78, 0x01};
+    size_t position = 0;
+    do {
+        size_t length = std::min<size_t>(data.size() - position, 65535);
+        stream.push_back(position + length == data.size() ? 1 : 0);
+        stream.push_back((uint8_t) length);
+        stream.push_back((uint8_t) (length >> 8));
+        stream.push_back((uint8_t) ~length);
+        stream.push_back((uint8_t) (~length >> 8));
+        stream.insert(stream.end(), data.begin() + position, data.begin() + position + length);
+        position += length;
+    } while (position < data.size());
+    appendBigEndian32(stream, Inflate::adler32(data.data(), data.size()));
+    return stream;
+}
+
+static uint8_t paethPredictor(int left, int up, int upLeft) {
+    int estimate = left + up - upLeft;
+    int distanceLeft = std::abs(estimate - left), distanceUp = std::abs(estimate - up);
+    int distanceUpLeft = std::abs(estimate - upLeft);
+    if (distanceLeft <= distanceUp && distanceLeft <= distanceUpLeft) return (uint8_t) left;
+    if (distanceUp <= distanceUpLeft) return (uint8_t) up;
+    return (uint8_t) upLeft;
+}
+
+/*
+ * Random PNG of the layout and the image it must decode to. Each row uses the next of the five filters, the IDAT is
+ * split in several chunks and palettes get a partial tRNS.
+ */
+static std::vector<uint8_t> encodePNG(std::mt19937 &random, uint32_t width, uint32_t height, uint32_t colorType,
+                                      uint32_t depth, Image &image) {
+    uint32_t channels = colorType == 2 ? 3 : colorType == 4 ? 2 : colorType == 6 ? 4 : 1;
+    uint32_t maximum = (1u << depth) - 1;
+    float scale = 1.0f / (float) maximum;
+    uint32_t paletteSize = colorType == 3 ? 1 + random() % (maximum + 1) : 0;
+    std::vector<glm::vec4> palette(paletteSize);
+    std::vector<uint8_t> paletteBytes, alphaBytes;
+    for (uint32_t i = 0; i < paletteSize; ++i) {
+        uint8_t r = random(), g = random(), b = random(), a = i % 2 == 0 ? random() : 255;
+        paletteBytes.insert(paletteBytes.end(), {r, g, b});
+        if (i < paletteSize / 2) alphaBytes.push_back(a);
+        palette[i] = glm::vec4(r, g, b, i < paletteSize / 2 ? a : 255) / 255.0f;
+    }
+
+    size_t rowBytes = ((size_t) width * channels * depth + 7) / 8;
+    size_t pixelBytes = std::max<size_t>(channels * depth / 8, 1);
+    std::vector<uint8_t> raw((size_t) height * rowBytes, 0);
+    image.width = width;
+    image.height = height;
+    image.pixels.resize((size_t) width * height);
+    for (uint32_t y = 0; y < height; ++y) {
+        uint8_t *row = raw.data() + (size_t) y * rowBytes;
+        for (uint32_t x = 0; x < width; ++x) {
+            uint32_t samples[4];
+            for (uint32_t c = 0; c < channels; ++c) {
+                samples[c] = colorType == 3 ? random() % paletteSize : random() & maximum;
+                size_t index = (size_t) x * channels + c;
+                if (depth == 16) {
+                    row[2 * index] = (uint8_t) (samples[c] >> 8);
+                    row[2 * index + 1] = (uint8_t) samples[c];
+                } else {
+                    size_t bit = index * depth;
+                    row[bit >> 3] |= (uint8_t) (samples[c] << (8 - depth - (bit & 7)));
+                }
+            }
+            glm::vec4 &pixel = image.pixels[(size_t) y * width + x];
+            switch (colorType) {
+                case 0:
+                    pixel = glm::vec4(glm::vec3((float) samples[0] * scale), 1);
+                    break;
+                case 2:
+                    pixel = glm::vec4((float) samples[0] * scale, (float) samples[1] * scale, (float) samples[2] * scale, 1);
+                    break;
+                case 3:
+                    pixel = palette[samples[0]];
+                    break;
+                case 4:
+                    pixel = glm::vec4(glm::vec3((float) samples[0] * scale), (float) samples[1] * scale);
+                    break;
+                default:
+                    pixel = glm::vec4(samples[0], samples[1], samples[2], samples[3]) * scale;
+                    break;
+            }
+        }
+    }
+
+    std::vector<uint8_t> filtered;
+    std::vector<uint8_t> zeroRow(rowBytes, 0);
+    for (uint32_t y = 0; y < height; ++y) {
+        const uint8_t *row = raw.data() + (size_t) y * rowBytes;
+        const uint8_t *prior = y == 0 ? zeroRow.data() : row - rowBytes;
+        uint8_t filter = y % 5;
+        filtered.push_back(filter);
+        for (size_t i = 0; i < rowBytes; ++i) {
+            int left = i >= pixelBytes ? row[i - pixelBytes] : 0;
+            int upLeft = i >= pixelBytes ? prior[i - pixelBytes] : 0;
+            uint8_t prediction = filter == 1 ? left : filter == 2 ? prior[i] : filter == 3 ? (left + prior[i]) >> 1 :
+                                                                               filter == 4 ? paethPredictor(left, prior[i], upLeft) : 0;
+            filtered.push_back((uint8_t) (row[i] - prediction));
+        }
+    }
+    std::vector<uint8_t> compressed = zlibStore(filtered);
+
+    std::vector<uint8_t> png = {137, 80, 78, 71, 13, 10, 26, 10};
+    std::vector<uint8_t> header;
+    appendBigEndian32(header, width);
+    appendBigEndian32(header, height);
+    header.insert(header.end(), {(uint8_t) depth, (uint8_t) colorType, 0, 0, 0});
+    appendPngChunk(png, "IHDR", header);
+    //Ancillary chunks are skipped
+    appendPngChunk(png, "tEXt", {'K', 'e', 'y', 0, 'v'});
+    if (colorType == 3) {
+        appendPngChunk(png, "PLTE", paletteBytes);
+        if (!alphaBytes.empty()) appendPngChunk(png, "tRNS", alphaBytes);
+    }
+    size_t split = compressed.size() / 3;
+    appendPngChunk(png, "IDAT", std::vector<uint8_t>(compressed.begin(), compressed.begin() + split));
+    appendPngChunk(png, "IDAT", std::vector<uint8_t>(compressed.begin() + split, compressed.end()));
+    appendPngChunk(png, "IEND", {});
+    return png;
+}
+
+static std::vector<uint8_t> encodePGM(std::mt19937 &random, uint32_t width, uint32_t height, uint32_t maximum,
+                                      Image &image) {
+    std::string header = "P5\n# heightmap\n" + std::to_string(width) + " " + std::to_string(height) + "\n" +
+                         std::to_string(maximum) + "\n";
+    std::vector<uint8_t> pgm(header.begin(), header.end());
+    image = {width, height, std::vector<glm::vec4>((size_t) width * height)};
+    for (auto &pixel : image.pixels) {
+        uint32_t sample = random() % (maximum + 1);
+        if (maximum > 255) pgm.push_back((uint8_t) (sample >> 8));
+        pgm.push_back((uint8_t) sample);
+        pixel = glm::vec4(glm::vec3((float) sample * (1.0f / (float) maximum)), 1);
+    }
+    return pgm;
+}
+
+static std::vector<uint8_t> encodeRaw16(std::mt19937 &random, uint32_t side, Image &image) {
+    std::vector<uint8_t> raw;
+    image = {side, side, std::vector<glm::vec4>((size_t) side * side)};
+    for (auto &pixel : image.pixels) {
+        uint32_t sample = random() & 0xFFFF;
+        raw.push_back((uint8_t) sample);
+        raw.push_back((uint8_t) (sample >> 8));
+        pixel = glm::vec4(glm::vec3((float) sample * (1.0f / 65535.0f)), 1);
+    }
+    return raw;
+}
+
+static std::vector<uint8_t> encodeRaw32(std::mt19937 &random, uint32_t side, Image &image) {
+    std::uniform_real_distribution<float> heights(-1000.0f, 1000.0f);
+    std::vector<uint8_t> raw((size_t) side * side * sizeof(float));
+    image = {side, side, std::vector<glm::vec4>((size_t) side * side)};
+    for (size_t i = 0; i < image.pixels.size(); ++i) {
+        float height = heights(random);
+        memcpy(raw.data() + i * sizeof(float), &height, sizeof(float));
+        image.pixels[i] = glm::vec4(glm::vec3(height), 1);
+    }
+    return raw;
+}
+
+/*
+ * Flipped bytes, truncations and extensions. A rejected file must not have reached the sink and an accepted one must
+ * have been written whole.
+ */
+static void mutate(std::mt19937 &random, const ImageDecoderRegistry &registry, const std::string &name,
+                   const std::vector<uint8_t> &file) {
+    for (uint32_t i = 0; i < 200; ++i) {
+        //Headers are where a flip changes the most
+        const MutationKind kinds[] = {MUTATION_TRUNCATE, MUTATION_EXTEND, MUTATION_FLIP, MUTATION_FLIP};
+        std::vector<uint8_t> mutated = mutateBytes(random, file, kinds[i % 4], 64);
+        ImageSink sink(random);
+        std::unique_ptr<uint8_t[]> exact = exactCopy(mutated);
+        if (registry.decode(name, exact.get(), mutated.size(), sink)) {
+            check(sink.begun && sink.committedRows == sink.height, "ACCEPTED " + name + " MUTATION WRITTEN WHOLE");
+        } else {
+            check(!sink.begun, "REJECTED " + name + " MUTATION NOT WRITTEN");
+        }
+    }
+}
+
+static void roundTrip(std::mt19937 &random, const ImageDecoderRegistry &registry, const std::string &name,
+                      const std::vector<uint8_t> &file, const Image &image) {
+    ImageSink sink(random);
+    check(registry.decode(name, file.data(), file.size(), sink) && samePixels(sink, image), "ROUND TRIP " + name);
+    mutate(random, registry, name, file);
+}
+
+int main() {
+    std::mt19937 random(1);
+    ImageDecoderRegistry registry;
+    Image image{};
+
+    const uint32_t pngLayouts[][2] = {{0, 1}, {0, 2}, {0, 4}, {0, 8}, {0, 16}, {2, 8}, {2, 16}, {3, 1}, {3, 2}, {3, 4},
+                                      {3, 8}, {4, 8}, {4, 16}, {6, 8}, {6, 16}};
+    for (auto &layout : pngLayouts) {
+        //Odd widths leave partial bytes at the end of the sub byte rows
+        for (auto size : {std::make_pair(1u, 1u), std::make_pair(13u, 7u), std::make_pair(64u, 33u)}) {
+            std::vector<uint8_t> png = encodePNG(random, size.first, size.second, layout[0], layout[1], image);
+            roundTrip(random, registry, "type" + std::to_string(layout[0]) + "-" + std::to_string(layout[1]) + ".png",
+                      png, image);
+        }
+    }
+    //Larger than a stored block
+    std::vector<uint8_t> largePng = encodePNG(random, 300, 200, 6, 16, image);
+    ImageSink largeSink(random);
+    check(ImageDecoders::decodePNG(largePng.data(), largePng.size(), largeSink) && samePixels(largeSink, image),
+          "ROUND TRIP MULTI BLOCK PNG");
+
+    for (uint32_t maximum : {1u, 255u, 1000u, 65535u}) {
+        std::vector<uint8_t> pgm = encodePGM(random, 17, 9, maximum, image);
+        roundTrip(random, registry, "max" + std::to_string(maximum) + ".pgm", pgm, image);
+    }
+    for (uint32_t side : {1u, 5u, 32u}) {
+        std::vector<uint8_t> raw16 = encodeRaw16(random, side, image);
+        roundTrip(random, registry, "side" + std::to_string(side) + ".r16", raw16, image);
+        std::vector<uint8_t> raw32 = encodeRaw32(random, side, image);
+        roundTrip(random, registry, "side" + std::to_string(side) + ".R32", raw32, image);
+    }
+
+    //Sizes that are not a square of whole samples
+    ImageSink rejectSink(random);
+    std::vector<uint8_t> notSquare(2 * 15);
+    check(!ImageDecoders::decodeRaw16(notSquare.data(), notSquare.size(), rejectSink) &&
+          !ImageDecoders::decodeRaw32(notSquare.data(), 6, rejectSink) && !rejectSink.begun, "NON SQUARE RAW REJECTED");
+    check(!registry.canDecode("heightmap.tga") && registry.canDecode("dir.png/heightmap.PGM") &&
+          !registry.canDecode("dir.png/heightmap"), "EXTENSION LOOKUP");
+
+    return checkResult("IMAGE DECODERS");
+}
@@ -0,0 +1,99 @@
+#include "../src/FileManagers/LZ4.h"
+#include "TestSupport.h"
+
+/*
+ * Round trips blocks of every kind of content and size through the compressor, decodes a block laid out by hand
+ * from the format description, then feeds mutated blocks to the decompressor, which must reject truncated ones and
+ * never write or read outside its buffers
+ */
+
+static std::vector<uint8_t> compress(const std::vector<uint8_t> &data) {
+    std::vector<uint8_t> compressed(LZ4::compressBound(data.size()));
+    size_t compressedSize = LZ4::compress(data.data(), data.size(), compressed.data(), compressed.size());
+    compressed.resize(compressedSize);
+    return compressed;
+}
+
+static void mutate(std::mt19937 &random, const std::vector<uint8_t> &block, size_t size, const std::string &what) {
+    //Guard bytes after the destination, which a decoder writing past destinationSize would change
+    const size_t guardSize = 64;
+    const uint8_t guard = 0xA5;
+    std::unique_ptr<uint8_t[]> destination(new uint8_t[size + guardSize]);
+    for (uint32_t i = 0; i < 100; ++i) {
+        std::vector<uint8_t> mutated = mutateBytes(random, block, i % 3 == 0 ? MUTATION_TRUNCATE : MUTATION_FLIP);
+        memset(destination.get() + size, guard, guardSize);
+        std::unique_ptr<uint8_t[]> source = exactCopy(mutated);
+        bool decoded = LZ4::decompress(source.get(), mutated.size(), destination.get(), size);
+        //The end of a block is its last literals, a shorter block never decodes to the whole size
+        if (i % 3 == 0) check(!decoded, "TRUNCATED BLOCK REJECTED " + what);
+        check(std::all_of(destination.get() + size, destination.get() + size + guardSize,
+                          [&](uint8_t byte) { return byte == guard; }), "GUARD BYTES KEPT " + what);
+    }
+}
+
+static void roundTrip(std::mt19937 &random, const std::vector<uint8_t> &data, const std::string &what) {
+    std::vector<uint8_t> block = compress(data);
+    check(!block.empty() && block.size() <= LZ4::compressBound(data.size()), "COMPRESS " + what);
+    std::unique_ptr<uint8_t[]> source = exactCopy(block);
+    std::vector<uint8_t> decompressed(data.size() + 1);
+    check(LZ4::decompress(source.get(), block.size(), decompressed.data(), data.size()) &&
+          std::equal(data.begin(), data.end(), decompressed.begin()), "ROUND TRIP " + what);
+    //The size is part of the contract, one byte more or less is a failure
+    check(!LZ4::decompress(source.get(), block.size(), decompressed.data(), data.size() + 1), "LARGER SIZE " + what);
+    if (!data.empty()) {
+        check(!LZ4::decompress(source.get(), block.size(), decompressed.data(), data.size() - 1), "SMALLER SIZE " + what);
+        mutate(random, block, data.size(), what);
+    }
+}
+
+int main() {
+    std::mt19937 random(1);
+
+    //Every size around the end of block rules, in content that matches and content that does not
+    for (size_t size = 0; size <= 40; ++size) {
+        std::vector<uint8_t> zeros(size, 0), noise(size);
+        for (auto &byte : noise) byte = (uint8_t) random();
+        roundTrip(random, zeros, "ZEROS " + std::to_string(size));
+        roundTrip(random, noise, "NOISE " + std::to_string(size));
+    }
+
+    std::vector<uint8_t> run(100000, 'a');
+    roundTrip(random, run, "RUN");
+    check(compress(run).size() < 1000, "RUN COMPRESSES");
+
+    //Repeats at every distance up to past the 64 KB window, with literal and match lengths that need extra bytes
+    std::vector<uint8_t> mixed;
+    while (mixed.size() < (1 << 20)) {
+        uint32_t kind = random() % 3;
+        size_t length = 1 + random() % (random() % 8 == 0 ? 2000 : 40);
+        if (kind == 0 || mixed.empty()) {
+            for (size_t i = 0; i < length; ++i) mixed.push_back((uint8_t) random());
+        } else {
+            size_t distance = 1 + random() % std::min<size_t>(mixed.size(), kind == 1 ? 16 : 70000);
+            for (size_t i = 0; i < length; ++i) mixed.push_back(mixed[mixed.size() - distance]);
+        }
+    }
+    roundTrip(random, mixed, "MIXED");
+
+    std::string text;
+    while (text.size() < 50000) text += "height " + std::to_string(random() % 100) + " tile " + std::to_string(random() % 10) + "\n";
+    roundTrip(random, std::vector<uint8_t>(text.begin(), text.end()), "TEXT");
+
+    //Compression into too small a buffer gives up instead of writing past it
+    std::vector<uint8_t> noise(4096);
+    for (auto &byte : noise) byte = (uint8_t) random();
+    std::vector<uint8_t> small(noise.size() / 2);
+    check(LZ4::compress(noise.data(), noise.size(), small.data(), small.size()) == 0, "TOO SMALL DESTINATION");
+
+    //Three literals, a match of 9 at distance 3 that overlaps itself, then the five final literals
+    const uint8_t handmade[] = {0x35, 'a', 'b', 'c', 0x03, 0x00, 0x50, 'x', 'y', 'z', 'z', 'y'};
+    const char expected[] = "abcabcabcabcxyzzy";
+    uint8_t decoded[17];
+    check(LZ4::decompress(handmade, sizeof(handmade), decoded, sizeof(decoded)) &&
+          memcmp(decoded, expected, sizeof(decoded)) == 0, "HANDMADE BLOCK");
+    //A match reaching before the start of the output
+    const uint8_t before[] = {0x15, 'a', 0x02, 0x00, 0x50, 'a', 'b', 'c', 'd', 'e'};
+    check(!LZ4::decompress(before, sizeof(before), decoded, 15), "MATCH BEFORE THE OUTPUT");
+
+    return checkResult("LZ4");
+}
@@ -0,0 +1,105 @@
+#include "../src/FileManagers/PackArchive.h"
+#include "TestSupport.h"
+
+/*
+ * Writes archives of stored and compressed entries at several alignments, reads every entry back, then opens
+ * mutated copies of an archive, which must either be rejected or have every entry read without leaving the file.
+ * The archives are written to the working directory and removed at the end.
+ */
+
+struct Asset {
+    std::string name;
+    std::vector<uint8_t> data;
+};
+
+static std::vector<Asset> makeAssets(std::mt19937 &random) {
+    std::vector<Asset> assets;
+    assets.push_back({"empty", {}});
+    assets.push_back({"Shaders/vert.spv", std::vector<uint8_t>(5000, 7)});
+    std::vector<uint8_t> noise(3000);
+    for (auto &byte : noise) byte = (uint8_t) random();
+    assets.push_back({"Resources/noise.bin", noise});
+    std::string text;
+    while (text.size() < 20000) text += "vertex " + std::to_string(random() % 50) + "\n";
+    assets.push_back({"Resources/deep/path/text.txt", std::vector<uint8_t>(text.begin(), text.end())});
+    assets.push_back({"one", {42}});
+    return assets;
+}
+
+static bool writeArchive(const std::string &path, const std::vector<Asset> &assets, uint32_t alignment, bool compress) {
+    PackArchiveWriter writer(alignment);
+    if (!writer.open(path)) return false;
+    for (auto &asset : assets) {
+        if (!writer.add(asset.name, asset.data.data(), asset.data.size(), compress)) return false;
+    }
+    return writer.finish();
+}
+
+static void roundTrip(const std::vector<Asset> &assets, const std::string &path, uint32_t alignment, bool compress) {
+    std::string what = " ALIGNMENT " + std::to_string(alignment) + (compress ? " COMPRESSED" : " STORED");
+    check(writeArchive(path, assets, alignment, compress), "WRITE" + what);
+    PackArchive archive;
+    check(archive.open(path), "OPEN" + what);
+    check(archive.names().size() == assets.size(), "ENTRY COUNT" + what);
+    for (auto &asset : assets) {
+        const PackArchive::Entry *entry = archive.find(asset.name);
+        check(entry != nullptr, "FIND " + asset.name + what);
+        if (entry == nullptr) continue;
+        check(entry->size == asset.data.size() && entry->offset % alignment == 0, "ENTRY " + asset.name + what);
+        //Only entries that shrink are stored compressed
+        bool compressed = (entry->flags & PackArchive::COMPRESSED_LZ4) != 0;
+        check(!compressed || (compress && entry->storedSize < entry->size), "FLAGS " + asset.name + what);
+        std::vector<uint8_t> data(entry->size);
+        check(archive.read(*entry, data.data()) && data == asset.data, "READ " + asset.name + what);
+        if (!compressed) {
+            check(asset.data.empty() || memcmp(archive.storedData(*entry), asset.data.data(), asset.data.size()) == 0,
+                  "IN PLACE " + asset.name + what);
+        }
+    }
+    check(compress == (archive.find("Resources/deep/path/text.txt")->flags == PackArchive::COMPRESSED_LZ4),
+          "TEXT COMPRESSION" + what);
+    check(archive.find("missing") == nullptr && archive.find("Shaders") == nullptr, "MISSING NAMES" + what);
+}
+
+static void mutate(std::mt19937 &random, const std::vector<uint8_t> &file, const std::string &path) {
+    for (uint32_t i = 0; i < 300; ++i) {
+        //The header and the index at the end decide what gets read
+        std::vector<uint8_t> mutated = mutateBytes(random, file, i % 4 == 0 ? MUTATION_TRUNCATE : MUTATION_FLIP,
+                                                   PackArchive::HEADER_SIZE, 200);
+        if (!writeFile(path, mutated)) {
+            check(false, "WRITE MUTATION");
+            return;
+        }
+        PackArchive archive;
+        if (!archive.open(path)) continue;
+        for (auto &name : archive.names()) {
+            const PackArchive::Entry *entry = archive.find(name);
+            check(entry->offset + entry->storedSize <= mutated.size(), "ENTRY INSIDE THE FILE");
+            //A corrupt compressed blob may fail, it must not write past the entry size
+            std::unique_ptr<uint8_t[]> destination(new uint8_t[std::max<uint64_t>(entry->size, 1)]);
+            archive.read(*entry, destination.get());
+        }
+    }
+}
+
+int main() {
+    std::mt19937 random(1);
+    std::vector<Asset> assets = makeAssets(random);
+    const std::string path = "PackArchiveTest.pak", mutatedPath = "PackArchiveTestMutated.pak";
+
+    for (uint32_t alignment : {1u, 64u, 4096u}) {
+        roundTrip(assets, path, alignment, false);
+        roundTrip(assets, path, alignment, true);
+    }
+
+    PackArchive archive;
+    check(!archive.open("PackArchiveTestMissing.pak"), "MISSING ARCHIVE");
+    check(writeArchive(path, {}, 64, true) && archive.open(path) && archive.names().empty(), "EMPTY ARCHIVE");
+
+    check(writeArchive(path, assets, 16, true), "WRITE MUTATION SOURCE");
+    mutate(random, readFile(path), mutatedPath);
+
+    std::remove(path.c_str());
+    std::remove(mutatedPath.c_str());
+    return checkResult("PACK ARCHIVE");
+}
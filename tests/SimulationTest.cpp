@@ -0,0 +1,93 @@
+#include "../src/Simulation.h"
+#include "TestSupport.h"
+#include <cmath>
+#include <map>
+
+/*
+ * Records random input over frames of random length on a terrain, then replays the recording with frames of other
+ * lengths, which must reach the same step and state hash at every step both runs stopped at. The recording is written
+ * to the working directory and removed at the end.
+ */
+
+static const double STEP_SECONDS = 1.0 / 120.0;
+
+static SimulationInput randomInput(std::mt19937 &random) {
+    SimulationInput input;
+    input.heldKeys = (uint32_t) random() & 0x3F;
+    //Now and then, so every camera mode is reached
+    input.actions = random() % 30 == 0 ? SIMULATION_ACTION_NEXT_CAMERA_MODE : 0;
+    std::uniform_real_distribution<float> lookDistribution(-3.0f, 3.0f);
+    input.look = glm::vec2(lookDistribution(random), lookDistribution(random));
+    return input;
+}
+
+/*
+ * From a tenth of a step to past the steps one advance catches up with
+ */
+static double randomFrameSeconds(std::mt19937 &random) {
+    std::uniform_real_distribution<double> frameDistribution(0.1, 10.0);
+    return STEP_SECONDS * frameDistribution(random);
+}
+
+int main() {
+    std::mt19937 random(1);
+    const std::string path = "SimulationTest.rec";
+
+    const uint32_t size = 65;
+    std::vector<float> heights((size_t) size * size);
+    for (uint32_t y = 0; y < size; ++y) {
+        for (uint32_t x = 0; x < size; ++x) heights[(size_t) y * size + x] = 0.5f + 0.5f * std::sin(x * 0.3f) * std::cos(y * 0.2f);
+    }
+    HeightPyramid pyramid;
+    pyramid.build(std::move(heights), size, size);
+    TerrainHeightField terrain(pyramid, glm::vec3(-2, 0, -2), glm::vec3(4, 0.5f, 4));
+
+    SimulationState initialState{};
+    initialState.eye = glm::vec3(0, 1, 0);
+
+    //Step and state hash after every frame of the recording
+    std::map<uint64_t, uint64_t> recordedHashes;
+    uint64_t recordedSteps = 0, recordedHash = 0;
+    uint32_t cameraModes = 0;
+    {
+        FixedStepSimulation simulation(STEP_SECONDS, initialState);
+        simulation.setTerrain(&terrain);
+        check(simulation.startRecording(path), "START RECORDING");
+        for (uint32_t frame = 0; frame < 2000; ++frame) {
+            simulation.advance(randomFrameSeconds(random), randomInput(random));
+            recordedHashes[simulation.current().step] = simulation.stateHash();
+            cameraModes |= 1u << simulation.current().cameraMode;
+        }
+        recordedSteps = simulation.current().step;
+        recordedHash = simulation.stateHash();
+    }
+    check(cameraModes == 7, "EVERY CAMERA MODE RECORDED");
+    check(recordedSteps > 1000, "RECORDING LENGTH");
+
+    for (uint32_t replayRun = 0; replayRun < 3; ++replayRun) {
+        std::string what = " RUN " + std::to_string(replayRun);
+        FixedStepSimulation simulation(STEP_SECONDS, initialState);
+        simulation.setTerrain(&terrain);
+        check(simulation.startReplay(path) && simulation.isReplaying(), "START REPLAY" + what);
+        uint32_t matched = 0, mismatched = 0;
+        for (uint32_t frame = 0; frame < 100000 && !simulation.replayFinished(); ++frame) {
+            //The live input is ignored while replaying
+            simulation.advance(randomFrameSeconds(random), randomInput(random));
+            auto recorded = recordedHashes.find(simulation.current().step);
+            if (recorded == recordedHashes.end()) continue;
+            if (recorded->second == simulation.stateHash()) matched++;
+            else mismatched++;
+        }
+        check(simulation.replayFinished(), "REPLAY FINISHED" + what);
+        check(simulation.current().step == recordedSteps && simulation.stateHash() == recordedHash, "FINAL STATE" + what);
+        check(mismatched == 0 && matched > 0, "INTERMEDIATE STATES" + what);
+    }
+
+    //Other step sizes would diverge and are refused, as are missing recordings
+    FixedStepSimulation otherStep(STEP_SECONDS / 2, initialState);
+    FixedStepSimulation missing(STEP_SECONDS, initialState);
+    check(!otherStep.startReplay(path) && !missing.startReplay("SimulationTestMissing.rec"), "REPLAY REJECTED");
+
+    std::remove(path.c_str());
+    return checkResult("SIMULATION");
+}
@@ -0,0 +1,104 @@
+#ifndef VULKANBASE_TESTSUPPORT_H
+#define VULKANBASE_TESTSUPPORT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+ * What the unit tests share: the failure count, exact size copies for the sanitizer builds, whole file reads and
+ * writes and the byte mutations of the fuzz loops. Each test is a single translation unit with its own failure count.
+ */
+
+static uint32_t failures = 0;
+
+inline void check(bool condition, const std::string &what) {
+    if (condition) return;
+    failures++;
+    std::cerr << "FAILED: " << what << std::endl;
+}
+
+/*
+ * The exit code of the test, named by what in the success line
+ */
+inline int checkResult(const std::string &what) {
+    if (failures != 0) {
+        std::cerr << failures << " CHECKS FAILED" << std::endl;
+        return 1;
+    }
+    std::cout << what << ": ALL CHECKS PASSED" << std::endl;
+    return 0;
+}
+
+/*
+ * Exact size heap copy, so a sanitizer build catches any access past the end
+ */
+inline std::unique_ptr<uint8_t[]> exactCopy(const std::vector<uint8_t> &bytes) {
+    std::unique_ptr<uint8_t[]> copy(new uint8_t[std::max<size_t>(bytes.size(), 1)]);
+    if (!bytes.empty()) memcpy(copy.get(), bytes.data(), bytes.size());
+    return copy;
+}
+
+/*
+ * Empty when the file cannot be opened
+ */
+inline std::vector<uint8_t> readFile(const std::string &path) {
+    std::vector<uint8_t> bytes;
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == nullptr) return bytes;
+    uint8_t buffer[4096];
+    for (size_t read; (read = fread(buffer, 1, sizeof(buffer), file)) > 0;) bytes.insert(bytes.end(), buffer, buffer + read);
+    fclose(file);
+    return bytes;
+}
+
+inline bool writeFile(const std::string &path, const std::vector<uint8_t> &bytes) {
+    FILE *file = fopen(path.c_str(), "wb");
+    if (file == nullptr) return false;
+    bool written = bytes.empty() || fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    return fclose(file) == 0 && written;
+}
+
+enum MutationKind {
+    MUTATION_TRUNCATE, MUTATION_EXTEND, MUTATION_FLIP
+};
+
+/*
+ * A strictly shorter copy, a copy with 1 to 8 random bytes appended, or a copy with 1 to 4 bytes flipped. Half of the
+ * flips land in the first headerSize or the last trailerSize bytes, where the headers and indices that decide what
+ * gets read live, the others anywhere. The bytes must not be empty.
+ */
+inline std::vector<uint8_t> mutateBytes(std::mt19937 &random, const std::vector<uint8_t> &bytes, MutationKind kind,
+                                        size_t headerSize = 0, size_t trailerSize = 0) {
+    std::vector<uint8_t> mutated = bytes;
+    switch (kind) {
+        case MUTATION_TRUNCATE:
+            mutated.resize(random() % mutated.size());
+            break;
+        case MUTATION_EXTEND:
+            mutated.resize(mutated.size() + 1 + random() % 8, (uint8_t) random());
+            break;
+        case MUTATION_FLIP:
+            headerSize = std::min(headerSize, mutated.size());
+            trailerSize = std::min(trailerSize, mutated.size());
+            for (uint32_t flips = 1 + random() % 4; flips > 0; --flips) {
+                size_t position = random() % mutated.size();
+                if ((headerSize != 0 || trailerSize != 0) && random() % 2 == 0) {
+                    bool header = trailerSize == 0 || (headerSize != 0 && random() % 2 == 0);
+                    position = header ? random() % headerSize : mutated.size() - 1 - random() % trailerSize;
+                }
+                mutated[position] ^= (uint8_t) (1 + random() % 255);
+            }
+            break;
+    }
+    return mutated;
+}
+
+
+#endif //VULKANBASE_TESTSUPPORT_H
@@ -0,0 +1,178 @@
+#include "../src/FileManagers/TiledHeightfield.h"
+#include "TestSupport.h"
+#include <cmath>
+
+/*
+ * Writes heightfields of every sample format and codec, with clipped edge tiles, decodes them back with and without
+ * the thread pool and compares every sample, then decodes mutated copies of the files, which must not read outside
+ * them. The files are written to the working directory and removed at the end.
+ */
+
+/*
+ * Keeps the rows, in bands of random height. With a height plane it takes every band whole, like the heightmap upload.
+ */
+class HeightSink : public BitmapSink {
+public:
+    HeightSink(std::mt19937 &random, bool keepHeights) : random(random), keepHeights(keepHeights) {}
+
+    bool begun = false;
+    uint32_t width = 0, height = 0, committedRows = 0;
+    std::vector<glm::vec4> rows;
+    std::vector<float> heights;
+
+    void begin(uint32_t width, uint32_t height) override {
+        begun = true;
+        this->width = width;
+        this->height = height;
+        rows.assign((size_t) width * height, glm::vec4(-1));
+        if (keepHeights) heights.assign((size_t) width * height, -1.0f);
+    }
+
+    uint32_t acquireRows(uint32_t firstRow, uint32_t rowCount, glm::vec4 *&rows) override {
+        rows = this->rows.data() + (size_t) firstRow * width;
+        return std::min<uint32_t>(rowCount, 1 + random() % 40);
+    }
+
+    uint32_t acquireHeightRows(uint32_t firstRow, uint32_t rowCount, glm::vec4 *&rows, float *&heights) override {
+        if (!keepHeights) return BitmapSink::acquireHeightRows(firstRow, rowCount, rows, heights);
+        rows = this->rows.data() + (size_t) firstRow * width;
+        heights = this->heights.data() + (size_t) firstRow * width;
+        return rowCount;
+    }
+
+    void commitRows(uint32_t firstRow, uint32_t rowCount) override {
+        committedRows += rowCount;
+    }
+
+private:
+    std::mt19937 &random;
+    bool keepHeights;
+};
+
+/*
+ * What a height reads back as: UNORM16 quantizes, FLOAT32 keeps the bits
+ */
+static float expectedHeight(float height, TiledHeightfield::SampleFormat format) {
+    if (format == TiledHeightfield::FLOAT32) return height;
+    return (float) std::lround(std::min(std::max(height, 0.0f), 1.0f) * 65535.0f) / 65535.0f;
+}
+
+static bool sameHeights(const HeightSink &sink, const std::vector<float> &heights, uint32_t width, uint32_t height,
+                        TiledHeightfield::SampleFormat format) {
+    if (!sink.begun || sink.width != width || sink.height != height || sink.committedRows != height) return false;
+    for (size_t i = 0; i < heights.size(); ++i) {
+        float expected = expectedHeight(heights[i], format);
+        glm::vec4 pixel = sink.rows[i];
+        if (memcmp(&pixel.x, &expected, sizeof(float)) != 0 || pixel.y != pixel.x || pixel.z != pixel.x || pixel.w != 1.0f)
+            return false;
+        if (!sink.heights.empty() && memcmp(&sink.heights[i], &expected, sizeof(float)) != 0) return false;
+    }
+    return true;
+}
+
+static uint32_t tileCodec(const std::vector<uint8_t> &file, uint32_t tile) {
+    const uint8_t *record = file.data() + 32 + (size_t) tile * 16 + 12;
+    return (uint32_t) record[0] | (uint32_t) record[1] << 8 | (uint32_t) record[2] << 16 | (uint32_t) record[3] << 24;
+}
+
+static void mutate(std::mt19937 &random, const std::vector<uint8_t> &file, ThreadPool &threadPool) {
+    for (uint32_t i = 0; i < 100; ++i) {
+        //The header and the tile index decide what gets read
+        std::vector<uint8_t> mutated = mutateBytes(random, file, i % 4 == 0 ? MUTATION_TRUNCATE : MUTATION_FLIP, 96);
+        std::unique_ptr<uint8_t[]> data = exactCopy(mutated);
+        HeightSink sink(random, i % 3 == 0);
+        //A corrupt tile is allowed to fail after the previous bands were written, a success must be whole
+        if (TiledHeightfield::decode(data.get(), mutated.size(), sink, i % 2 == 0 ? &threadPool : nullptr)) {
+            check(sink.begun && sink.committedRows == sink.height, "ACCEPTED MUTATION WRITTEN WHOLE");
+        }
+    }
+}
+
+int main() {
+    std::mt19937 random(1);
+    ThreadPool threadPool(3);
+    const std::string path = "TiledHeightfieldTest.vth";
+
+    struct Case {
+        uint32_t width, height, tileSize;
+    };
+    //Single tiles, clipped edge tiles on both axes and more tiles than a band
+    const Case cases[] = {{1, 1, 16}, {16, 16, 16}, {17, 33, 16}, {300, 200, 64}, {513, 70, 32}};
+    const TiledHeightfield::SampleFormat formats[] = {TiledHeightfield::UNORM16, TiledHeightfield::FLOAT32};
+    const TiledHeightfield::Codec codecs[] = {TiledHeightfield::CODEC_RAW, TiledHeightfield::CODEC_LZ4,
+                                              TiledHeightfield::CODEC_ZSTD};
+    std::uniform_real_distribution<float> noiseDistribution(-0.1f, 1.1f);
+    for (const Case &size : cases) {
+        std::vector<float> smooth((size_t) size.width * size.height), noise(smooth.size());
+        for (uint32_t y = 0; y < size.height; ++y) {
+            for (uint32_t x = 0; x < size.width; ++x) {
+                smooth[(size_t) y * size.width + x] = 0.5f + 0.25f * std::sin(x * 0.05f) * std::cos(y * 0.07f);
+            }
+        }
+        //Out of range values clamp in UNORM16 and keep their bits in FLOAT32
+        for (auto &height : noise) height = noiseDistribution(random);
+        noise[0] = -0.0f;
+        noise[noise.size() - 1] = 1e30f;
+
+        for (auto format : formats) {
+            for (auto codec : codecs) {
+                if (!TiledHeightfield::codecSupported(codec)) {
+                    check(!TiledHeightfield::write(path, smooth.data(), size.width, size.height, format, codec,
+                                                   size.tileSize), "UNSUPPORTED CODEC REJECTED");
+                    continue;
+                }
+                for (const std::vector<float> *heights : {&smooth, &noise}) {
+                    std::string what = " " + std::to_string(size.width) + "x" + std::to_string(size.height) +
+                                       " FORMAT " + std::to_string(format) + " CODEC " + std::to_string(codec) +
+                                       (heights == &smooth ? " SMOOTH" : " NOISE");
+                    check(TiledHeightfield::write(path, heights->data(), size.width, size.height, format, codec,
+                                                  size.tileSize, 3, &threadPool), "WRITE" + what);
+                    std::vector<uint8_t> file = readFile(path);
+                    std::unique_ptr<uint8_t[]> data = exactCopy(file);
+                    for (ThreadPool *pool : {(ThreadPool *) nullptr, &threadPool}) {
+                        for (bool keepHeights : {false, true}) {
+                            HeightSink sink(random, keepHeights);
+                            check(TiledHeightfield::decode(data.get(), file.size(), sink, pool) &&
+                                  sameHeights(sink, *heights, size.width, size.height, format),
+                                  "ROUND TRIP" + what + (pool ? " POOL" : " CALLING THREAD") +
+                                  (keepHeights ? " HEIGHT PLANE" : ""));
+                        }
+                    }
+                    uint32_t tileCount = ((size.width + size.tileSize - 1) / size.tileSize) *
+                                         ((size.height + size.tileSize - 1) / size.tileSize);
+                    size_t rawBytes = (size_t) size.width * size.height * (format == TiledHeightfield::UNORM16 ? 2 : 4);
+                    if (codec != TiledHeightfield::CODEC_RAW && heights == &smooth && size.width >= 300) {
+                        check(file.size() < rawBytes, "SMOOTH TERRAIN COMPRESSES" + what);
+                    }
+                    bool knownCodecs = true;
+                    for (uint32_t tile = 0; tile < tileCount; ++tile) {
+                        knownCodecs = knownCodecs && (tileCodec(file, tile) == codec || tileCodec(file, tile) == 0);
+                    }
+                    check(knownCodecs, "TILE CODECS" + what);
+                    if (size.width == 300) mutate(random, file, threadPool);
+                }
+            }
+        }
+    }
+
+    //Random bits, without the exponent of infinities and NaNs, do not shrink under LZ4 and are kept raw
+    std::vector<float> randomBits(64 * 64);
+    for (auto &height : randomBits) {
+        uint32_t bits = (uint32_t) random() & 0xBFFFFFFFu;
+        memcpy(&height, &bits, sizeof(float));
+    }
+    check(TiledHeightfield::write(path, randomBits.data(), 64, 64, TiledHeightfield::FLOAT32, TiledHeightfield::CODEC_LZ4, 16),
+          "WRITE RANDOM BITS");
+    std::vector<uint8_t> randomFile = readFile(path);
+    bool allRaw = randomFile.size() > 32 + 16 * 16;
+    for (uint32_t tile = 0; allRaw && tile < 16; ++tile) allRaw = tileCodec(randomFile, tile) == TiledHeightfield::CODEC_RAW;
+    check(allRaw, "INCOMPRESSIBLE TILES KEPT RAW");
+
+    std::vector<float> heights(64, 0.5f);
+    check(!TiledHeightfield::write(path, heights.data(), 8, 8, TiledHeightfield::UNORM16, TiledHeightfield::CODEC_RAW, 8) &&
+          !TiledHeightfield::write(path, heights.data(), 0, 8, TiledHeightfield::UNORM16, TiledHeightfield::CODEC_RAW, 16),
+          "INVALID LAYOUT REJECTED");
+
+    std::remove(path.c_str());
+    return checkResult("TILED HEIGHTFIELD");
+}